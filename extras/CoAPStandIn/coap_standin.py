@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+#
+# coap_standin.py
+# Twilio Breakout SDK
+#
+# Copyright (c) 2018 Twilio, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""
+Local stand-in for the Twilio Commands server, over plain-text CoAP, to measure the To-SIM Command delivery latency.
+
+Commands are generated every --interval seconds. With an active Observe registration on /v1/Commands, each one is
+pushed right away as a notification. Otherwise, it waits for the next POST /v1/Heartbeats and is then sent as a
+POST /v1/Commands. The latency is measured from the generation of the Command to the reception of its ACK.
+
+Build the device with TESTING_WITH_DTLS 0 and BREAKOUT_IP set to the address of the host running this script.
+"""
+
+import argparse
+import random
+import select
+import socket
+import struct
+import time
+
+CON, NON, ACK, RST = 0, 1, 2, 3
+
+GET, POST = 0x01, 0x02
+CREATED, CHANGED, CONTENT, CONTINUE = 0x41, 0x44, 0x45, 0x5F
+
+OPT_OBSERVE = 6
+OPT_URI_PATH = 11
+OPT_CONTENT_FORMAT = 12
+CONTENT_FORMAT_CBOR = 60
+OPT_URI_QUERY = 15
+OPT_BLOCK1 = 27
+OPT_QUEUED_COMMAND_COUNT = 50000
+
+ACK_TIMEOUT = 2.0
+MAX_RETRANSMIT = 4
+
+
+def encode_uint(value):
+    out = b""
+    while value:
+        out = bytes([value & 0xFF]) + out
+        value >>= 8
+    return out
+
+
+def decode_uint(data):
+    value = 0
+    for b in data:
+        value = (value << 8) | b
+    return value
+
+
+def encode_option_nibble(value):
+    if value < 13:
+        return value, b""
+    if value < 269:
+        return 13, bytes([value - 13])
+    return 14, struct.pack("!H", value - 269)
+
+
+def encode(mtype, code, mid, token=b"", options=(), payload=b""):
+    out = bytes([0x40 | (mtype << 4) | len(token), code]) + struct.pack("!H", mid) + token
+    last = 0
+    for number, value in sorted(options, key=lambda o: o[0]):
+        delta, delta_ext = encode_option_nibble(number - last)
+        length, length_ext = encode_option_nibble(len(value))
+        out += bytes([(delta << 4) | length]) + delta_ext + length_ext + value
+        last = number
+    if payload:
+        out += b"\xff" + payload
+    return out
+
+
+def decode(data):
+    tkl = data[0] & 0x0F
+    msg = {
+        "type": (data[0] >> 4) & 0x03,
+        "code": data[1],
+        "mid": struct.unpack("!H", data[2:4])[0],
+        "token": data[4:4 + tkl],
+        "options": [],
+        "payload": b"",
+    }
+    i, number = 4 + tkl, 0
+    while i < len(data):
+        if data[i] == 0xFF:
+            msg["payload"] = data[i + 1:]
+            break
+        delta, length = data[i] >> 4, data[i] & 0x0F
+        i += 1
+        if delta == 13:
+            delta, i = data[i] + 13, i + 1
+        elif delta == 14:
+            delta, i = struct.unpack("!H", data[i:i + 2])[0] + 269, i + 2
+        if length == 13:
+            length, i = data[i] + 13, i + 1
+        elif length == 14:
+            length, i = struct.unpack("!H", data[i:i + 2])[0] + 269, i + 2
+        number += delta
+        msg["options"].append((number, data[i:i + length]))
+        i += length
+    return msg
+
+
+def option(msg, number):
+    for n, v in msg["options"]:
+        if n == number:
+            return v
+    return None
+
+
+def decode_cbor_batch(data):
+    """Decode the indefinite CBOR array of text/byte strings used for batched From-SIM Commands."""
+    items, i = [], 1
+    while i < len(data) and data[i] != 0xFF:
+        major, info = data[i] >> 5, data[i] & 0x1F
+        i += 1
+        if info == 24:
+            info, i = data[i], i + 1
+        elif info == 25:
+            info, i = struct.unpack("!H", data[i:i + 2])[0], i + 2
+        value = data[i:i + info]
+        i += info
+        items.append(value.decode(errors="replace") if major == 3 else value)
+    return items
+
+
+def uri_path(msg):
+    return "/" + "/".join(v.decode(errors="replace") for n, v in msg["options"] if n == OPT_URI_PATH)
+
+
+class StandIn:
+    def __init__(self, args):
+        self.args = args
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(("0.0.0.0", args.port))
+        self.mid = random.randint(0, 0xFFFF)
+        self.device = None
+        self.observer = None  # token of the Observe registration
+        self.sequence = 0
+        self.queue = []  # (generation time, payload)
+        self.outstanding = {}  # mid -> [datagram, generation time, mode, retransmissions left, next retransmission]
+        self.blocks = b""
+        self.latencies = {"push": [], "poll": []}
+        self.counter = 0
+
+    def next_mid(self):
+        self.mid = (self.mid + 1) & 0xFFFF
+        return self.mid
+
+    def send(self, datagram):
+        self.sock.sendto(datagram, self.device)
+
+    def send_con(self, datagram, mid, generated, mode):
+        self.outstanding[mid] = [datagram, generated, mode, MAX_RETRANSMIT, time.time() + ACK_TIMEOUT]
+        self.send(datagram)
+
+    def push(self, generated, payload):
+        self.sequence = (self.sequence + 1) & 0xFFFFFF
+        mid = self.next_mid()
+        options = [(OPT_OBSERVE, encode_uint(self.sequence)), (OPT_CONTENT_FORMAT, b""),
+                   (OPT_QUEUED_COMMAND_COUNT, encode_uint(len(self.queue)))]
+        self.send_con(encode(CON, CONTENT, mid, self.observer, options, payload), mid, generated, "push")
+
+    def deliver(self, generated, payload):
+        mid = self.next_mid()
+        options = [(OPT_URI_PATH, b"Commands"), (OPT_CONTENT_FORMAT, b"")]
+        self.send_con(encode(CON, POST, mid, b"", options, payload), mid, generated, "poll")
+
+    def generate(self):
+        self.counter += 1
+        payload = ("standin command %d" % self.counter).encode()
+        generated = time.time()
+        if self.observer is not None and self.device:
+            self.push(generated, payload)
+        else:
+            self.queue.append((generated, payload))
+        print("Generated %r - %s" % (payload, "pushed" if self.observer is not None else "queued"))
+
+    def handle(self, data, addr):
+        msg = decode(data)
+        self.device = addr
+        if msg["type"] in (ACK, RST):
+            entry = self.outstanding.pop(msg["mid"], None)
+            if entry is None:
+                return
+            if msg["type"] == RST:
+                if entry[2] == "push":
+                    print("RST on notification - observer removed")
+                    self.observer = None
+                return
+            latency = (time.time() - entry[1]) * 1000
+            self.latencies[entry[2]].append(latency)
+            print("Delivered in %d ms by %s" % (latency, entry[2]))
+            return
+        if msg["type"] not in (CON, NON):
+            return
+        path = uri_path(msg)
+        reply_type = ACK if msg["type"] == CON else NON
+        reply_mid = msg["mid"] if msg["type"] == CON else self.next_mid()
+
+        if msg["code"] == POST and path == "/v1/Heartbeats":
+            options = [(OPT_QUEUED_COMMAND_COUNT, encode_uint(len(self.queue)))]
+            self.send(encode(reply_type, CREATED, reply_mid, msg["token"], options))
+            print("Heartbeat - %d queued" % len(self.queue))
+            queue, self.queue = self.queue, []
+            for generated, payload in queue:
+                self.deliver(generated, payload)
+        elif msg["code"] == GET and path == "/v1/Commands" and option(msg, OPT_OBSERVE) is not None:
+            options = []
+            if decode_uint(option(msg, OPT_OBSERVE)) == 0 and not self.args.no_observe:
+                self.observer = msg["token"]
+                options.append((OPT_OBSERVE, encode_uint(self.sequence)))
+                print("Observe registration accepted")
+            else:
+                self.observer = None
+                print("Observe registration removed or refused")
+            self.send(encode(reply_type, CONTENT, reply_mid, msg["token"], options))
+            if self.observer is not None:
+                queue, self.queue = self.queue, []
+                for generated, payload in queue:
+                    self.push(generated, payload)
+        elif msg["code"] == POST and path == "/v1/Commands":
+            block1 = option(msg, OPT_BLOCK1)
+            batched = decode_uint(option(msg, OPT_CONTENT_FORMAT) or b"") == CONTENT_FORMAT_CBOR
+            if block1 is None:
+                if batched:
+                    print("From-SIM batch of Commands %r" % decode_cbor_batch(msg["payload"]))
+                else:
+                    print("From-SIM Command %r" % msg["payload"])
+                if msg["type"] == CON:
+                    # Piggyback the Queued-Command-Count, for the device to drain them right away
+                    options = [(OPT_QUEUED_COMMAND_COUNT, encode_uint(len(self.queue)))]
+                    self.send(encode(ACK, CHANGED, msg["mid"], msg["token"], options))
+                return
+            value = decode_uint(block1)
+            if value >> 4 == 0:
+                self.blocks = b""
+            self.blocks += msg["payload"]
+            if value & 0x08:
+                self.send(encode(reply_type, CONTINUE, reply_mid, msg["token"], [(OPT_BLOCK1, block1)]))
+            else:
+                if batched:
+                    print("From-SIM block-wise batch of Commands %r" % decode_cbor_batch(self.blocks))
+                else:
+                    print("From-SIM block-wise Command of %d bytes %r" % (len(self.blocks), self.blocks))
+                options = [(OPT_BLOCK1, block1), (OPT_QUEUED_COMMAND_COUNT, encode_uint(len(self.queue)))]
+                self.send(encode(reply_type, CHANGED, reply_mid, msg["token"], options))
+        elif msg["type"] == CON:
+            self.send(encode(RST, 0, msg["mid"]))
+
+    def retransmit(self):
+        now = time.time()
+        for mid, entry in list(self.outstanding.items()):
+            if entry[4] > now:
+                continue
+            if entry[3] == 0:
+                print("Timeout on message_id %d" % mid)
+                del self.outstanding[mid]
+                continue
+            entry[3] -= 1
+            entry[4] = now + ACK_TIMEOUT * (2 ** (MAX_RETRANSMIT - entry[3]))
+            self.send(entry[0])
+
+    def report(self):
+        for mode, values in self.latencies.items():
+            if values:
+                print("%s: %d Commands - latency min %d ms, avg %d ms, max %d ms" %
+                      (mode, len(values), min(values), sum(values) / len(values), max(values)))
+
+    def run(self):
+        print("Listening on UDP port %d" % self.args.port)
+        next_command = time.time() + self.args.interval
+        try:
+            while True:
+                ready, _, _ = select.select([self.sock], [], [], 0.1)
+                if ready:
+                    data, addr = self.sock.recvfrom(2048)
+                    self.handle(data, addr)
+                if time.time() >= next_command:
+                    self.generate()
+                    next_command += self.args.interval
+                self.retransmit()
+        except KeyboardInterrupt:
+            self.report()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=5683, help="UDP port to listen on")
+    parser.add_argument("--interval", type=float, default=30, help="seconds between generated Commands")
+    parser.add_argument("--no-observe", action="store_true", help="refuse Observe registrations, to measure polling")
+    StandIn(parser.parse_args()).run()
@@ -0,0 +1,715 @@
+/*
+ * SaraSimulator.cpp
+ * Twilio Breakout SDK
+ *
+ * Copyright (c) 2018 Twilio, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * \file SaraSimulator.cpp - Scripted u-blox SARA-R4 behind a host HardwareSerial
+ *
+ * Only what the SDK uses is simulated: the basic configuration, the registration, the information queries and the UDP
+ * sockets, which are bridged to real UDP sockets of the host. The DTLS of the secure sockets (+USECPRF/+USOSEC) is
+ * checked for its configuration, but not done: the datagrams go out in plaintext, after a handshake delay of two round
+ * trips. Anything else is answered with ERROR, unless scripted.
+ */
+
+#include "SaraSimulator.h"
+
+#include <BreakoutSDK/modem/enums.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+SaraSimulator SerialSara;
+HardwareSerial &Serial1 = SerialSara;
+
+
+
+static uint64_t sim_now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static unsigned int loss_seed = 1;
+
+/* As str_equalcase_char() and str_equalcase_prefix_char(), but for the tables and the script, which are not literals */
+static int command_is(str command, const char *c) {
+  return command.len == (int)strlen(c) && strncasecmp(command.s, c, command.len) == 0;
+}
+
+static int command_starts_with(str command, const char *p) {
+  int len = strlen(p);
+  return command.len >= len && strncasecmp(command.s, p, len) == 0;
+}
+
+static void strip_quotes(str *x) {
+  if (x->len >= 2 && x->s[0] == '"' && x->s[x->len - 1] == '"') {
+    x->s += 1;
+    x->len -= 2;
+  }
+}
+
+/** Splits the parameters of a command on commas, outside of quotes */
+static int split_params(str params, str *out, int max) {
+  int cnt = 0, quoted = 0, start = 0;
+  for (int i = 0; i <= params.len && cnt < max; i++) {
+    if (i < params.len && params.s[i] == '"') quoted = !quoted;
+    if (i == params.len || (params.s[i] == ',' && !quoted)) {
+      out[cnt].s   = params.s + start;
+      out[cnt].len = i - start;
+      strip_quotes(&out[cnt]);
+      cnt++;
+      start = i + 1;
+    }
+  }
+  return params.len ? cnt : 0;
+}
+
+
+
+/**
+ * Constant answers, for the commands whose state does not matter here
+ */
+static struct {
+  const char *command;
+  const char *response;
+} fixed_responses[] = {
+    {.command = "AT", .response = "OK"},
+    {.command = "ATV1", .response = "OK"},
+    {.command = "ATQ0", .response = "OK"},
+    {.command = "AT+CMEE=2", .response = "OK"},
+    {.command = "ATS3=13", .response = "OK"},
+    {.command = "ATS4=10", .response = "OK"},
+    {.command = "AT+CSCS=\"GSM\"", .response = "OK"},
+    {.command = "AT+CFUN?", .response = "+CFUN: 1|OK"},
+    {.command = "AT+UMNOPROF?", .response = "+UMNOPROF: 5|OK"},
+    {.command = "AT+CPIN?", .response = "+CPIN: READY|OK"},
+    {.command = "AT+CGMI", .response = "u-blox|OK"},
+    {.command = "AT+CGMR", .response = "L0.0.00.00.05.06 [Feb 03 2018 13:00:41]|OK"},
+    {.command = "AT+CGSN", .response = "357520070000000|OK"},
+    {.command = "AT+CIMI", .response = "310260000000000|OK"},
+    {.command = "AT+CSQ", .response = "+CSQ: 20,99|OK"},
+    {.command = "AT+COPS?", .response = "+COPS: 0,0,\"T-Mobile\",7|OK"},
+    {.command = "AT+CGPADDR=1", .response = "+CGPADDR: 1,10.0.0.2|OK"},
+    {.command = "AT+CBC", .response = "+CBC: 0,80|OK"},
+    {.command = "AT+USOER", .response = "+USOER: 0|OK"},
+
+    {.command = 0, .response = 0},
+};
+
+/**
+ * Commands only acknowledged
+ */
+static const char *ok_prefixes[] = {"AT+CFUN=", "AT+UMNOPROF=", "AT+UGPIOC=", "AT+CREG=", "AT+CGREG=", "AT+UDCONF=",
+                              "AT+UHOSTDEV=", "AT+URAT=", "AT+UBANDMASK=", "AT+CGDCONT=", 0};
+
+
+
+SaraSimulator::SaraSimulator() {
+  config.command_latency_us    = 2000;
+  config.network_latency_us    = 50000;
+  config.registration_delay_ms = 0;
+  config.iccid                 = "8988307000000000001";
+  config.model                 = "SARA-R410M-02B";
+  for (int i = 0; i < SARA_MAX_SOCKETS; i++) {
+    memset(&sockets[i], 0, sizeof(sara_socket_t));
+    sockets[i].fd               = -1;
+    sockets[i].security_profile = -1;
+  }
+  memset(profiles, 0, sizeof(profiles));
+  memset(uplink, 0, sizeof(uplink));
+  memset(downlink, 0, sizeof(downlink));
+}
+
+SaraSimulator::~SaraSimulator() {
+  for (uint8_t i = 0; i < SARA_MAX_SOCKETS; i++)
+    closeSocket(i);
+}
+
+void SaraSimulator::configure(const sara_simulator_config_t *config) {
+  this->config = *config;
+  if (!this->config.iccid) this->config.iccid = "8988307000000000001";
+  if (!this->config.model) this->config.model = "SARA-R410M-02B";
+  if (this->config.baud_rate) baud_rate = this->config.baud_rate;
+}
+
+int SaraSimulator::addResponse(const char *command, const char *response) {
+  if (script_cnt >= SARA_MAX_SCRIPT_ENTRIES) return 0;
+  sara_script_entry_t *e = &script[script_cnt];
+  memset(e, 0, sizeof(sara_script_entry_t));
+  if (snprintf(e->command, sizeof(e->command), "%s", command) >= (int)sizeof(e->command) ||
+      snprintf(e->response, sizeof(e->response), "%s", response) >= (int)sizeof(e->response))
+    return 0;
+  script_cnt++;
+  return 1;
+}
+
+int SaraSimulator::addURC(uint32_t at_ms, const char *urc) {
+  if (script_cnt >= SARA_MAX_SCRIPT_ENTRIES) return 0;
+  sara_script_entry_t *e = &script[script_cnt];
+  memset(e, 0, sizeof(sara_script_entry_t));
+  if (snprintf(e->response, sizeof(e->response), "%s", urc) >= (int)sizeof(e->response)) return 0;
+  e->at_ms  = at_ms;
+  e->is_urc = 1;
+  script_cnt++;
+  return 1;
+}
+
+int SaraSimulator::loadScript(const char *filename) {
+  char line[512];
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    fprintf(stderr, "Error opening script %s: %s\n", filename, strerror(errno));
+    return 0;
+  }
+  int line_no = 0, ok = 1;
+  while (ok && fgets(line, sizeof(line), f)) {
+    line_no++;
+    line[strcspn(line, "\r\n")] = 0;
+    if (!line[0] || line[0] == '#') continue;
+    char *arrow = strstr(line, " => ");
+    if (!arrow) {
+      fprintf(stderr, "%s:%d: missing \" => \"\n", filename, line_no);
+      ok = 0;
+      break;
+    }
+    *arrow = 0;
+    if (line[0] == '@')
+      ok = addURC(strtoul(line + 1, 0, 10), arrow + 4);
+    else
+      ok = addResponse(line, arrow + 4);
+    if (!ok) fprintf(stderr, "%s:%d: too many script entries, or entry too long\n", filename, line_no);
+  }
+  fclose(f);
+  return ok;
+}
+
+void SaraSimulator::getStats(sara_simulator_stats_t *out_stats) {
+  if (out_stats) *out_stats = stats;
+}
+
+void SaraSimulator::resetStats() {
+  memset(&stats, 0, sizeof(stats));
+}
+
+
+
+uint64_t SaraSimulator::byteTime() {
+  /* start bit, 8 data bits, stop bit */
+  return 10000000ULL / baud_rate;
+}
+
+void SaraSimulator::begin(unsigned long baud) {
+  if (!config.baud_rate && baud) baud_rate = baud;
+  if (!powered_on_us) powered_on_us = sim_now_us();
+}
+
+void SaraSimulator::end() {
+}
+
+void SaraSimulator::emit(uint64_t at_us, const char *line) {
+  int len = strlen(line) + 4;
+  if (tx_end + len > SARA_TX_BUFFER_SIZE) {
+    /* compact */
+    memmove(tx_buffer, tx_buffer + tx_start, tx_end - tx_start);
+    memmove(tx_ready_us, tx_ready_us + tx_start, (tx_end - tx_start) * sizeof(uint64_t));
+    tx_end -= tx_start;
+    tx_start = 0;
+    if (tx_end + len > SARA_TX_BUFFER_SIZE) {
+      fprintf(stderr, "SARA - MCU not reading - dropping [%s]\n", line);
+      return;
+    }
+  }
+  if (config.verbose) printf("SARA -> %s\n", line);
+  uint64_t t = tx_end > tx_start && tx_ready_us[tx_end - 1] > at_us ? tx_ready_us[tx_end - 1] : at_us;
+  for (int i = 0; i < len; i++) {
+    char c;
+    if (i < 2)
+      c = i == 0 ? '\r' : '\n';
+    else if (i < len - 2)
+      c = line[i - 2];
+    else
+      c = i == len - 2 ? '\r' : '\n';
+    t += byteTime();
+    tx_buffer[tx_end]   = c;
+    tx_ready_us[tx_end] = t;
+    tx_end++;
+  }
+  stats.bytes_from_modem += len;
+  stats.line_busy_us += len * byteTime();
+}
+
+void SaraSimulator::emitf(uint64_t at_us, const char *format, ...) {
+  char line[SARA_RX_LINE_SIZE];
+  va_list ap;
+  va_start(ap, format);
+  vsnprintf(line, sizeof(line), format, ap);
+  va_end(ap);
+  emit(at_us, line);
+}
+
+
+
+int SaraSimulator::available() {
+  pump();
+  uint64_t now = sim_now_us();
+  int cnt      = 0;
+  while (tx_start + cnt < tx_end && tx_ready_us[tx_start + cnt] <= now)
+    cnt++;
+  return cnt;
+}
+
+int SaraSimulator::read() {
+  if (!available()) return -1;
+  return tx_buffer[tx_start++];
+}
+
+int SaraSimulator::peek() {
+  if (!available()) return -1;
+  return tx_buffer[tx_start];
+}
+
+size_t SaraSimulator::readBytes(uint8_t *buf, size_t len) {
+  size_t cnt = available();
+  if (cnt > len) cnt = len;
+  memcpy(buf, tx_buffer + tx_start, cnt);
+  tx_start += cnt;
+  if (tx_start == tx_end) tx_start = tx_end = 0;
+  return cnt;
+}
+
+size_t SaraSimulator::write(const uint8_t *buf, size_t len) {
+  uint64_t now = sim_now_us();
+  for (size_t i = 0; i < len; i++) {
+    rx_done_us = (rx_done_us > now ? rx_done_us : now) + byteTime();
+    stats.bytes_to_modem++;
+    stats.line_busy_us += byteTime();
+    char c = buf[i];
+    if (c == '\n' && rx_line_len == 0) continue;
+    if (c != '\r') {
+      if (rx_line_len < SARA_RX_LINE_SIZE - 1) rx_line[rx_line_len++] = c;
+      continue;
+    }
+    rx_line[rx_line_len] = 0;
+    str command          = {.s = rx_line, .len = rx_line_len};
+    if (command.len) {
+      if (config.verbose) printf("SARA <- %.*s\n", command.len, command.s);
+      if (echo) emit(rx_done_us, rx_line);
+      handleCommand(command, rx_done_us + config.command_latency_us);
+    }
+    rx_line_len = 0;
+  }
+  return len;
+}
+
+
+
+void SaraSimulator::handleCommand(str command, uint64_t at_us) {
+  stats.commands++;
+
+  if (handleScripted(command, at_us)) return;
+
+  for (int i = 0; fixed_responses[i].command; i++) {
+    if (!command_is(command, fixed_responses[i].command)) continue;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", fixed_responses[i].response);
+    for (char *line = strtok(buf, "|"); line; line = strtok(0, "|"))
+      emit(at_us, line);
+    return;
+  }
+  for (int i = 0; ok_prefixes[i]; i++)
+    if (command_starts_with(command, ok_prefixes[i])) {
+      emit(at_us, "OK");
+      return;
+    }
+
+  int k       = str_find_char(command, (char *)"=");
+  str name    = {.s = command.s, .len = k < 0 ? command.len : k};
+  str params  = {.s = command.s + name.len + 1, .len = k < 0 ? 0 : command.len - k - 1};
+  uint64_t ms = (at_us - powered_on_us) / 1000;
+
+  if (str_equalcase_char(command, "ATE0") || str_equalcase_char(command, "ATE1")) {
+    echo = command.s[3] == '1';
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(name, "AT+CEREG") && params.len) {
+    cereg_urc = str_to_uint32_t(params, 10);
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(command, "AT+CEREG?")) {
+    if (registered)
+      emitf(at_us, "+CEREG: %u,1,\"1A2B\",\"01ABCDEF\",7", cereg_urc);
+    else
+      emitf(at_us, "+CEREG: %u,2", cereg_urc);
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(command, "AT+CCID")) {
+    emitf(at_us, "+CCID: %s", config.iccid);
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(command, "AT+CGMM")) {
+    emit(at_us, config.model);
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(command, "ATI")) {
+    emit(at_us, "Manufacturer: u-blox");
+    emitf(at_us, "Model: %s", config.model);
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(command, "AT+CCLK?")) {
+    time_t t = time(0);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    emitf(at_us, "+CCLK: \"%02d/%02d/%02d,%02d:%02d:%02d+00\"", tm.tm_year % 100, tm.tm_mon + 1, tm.tm_mday,
+          tm.tm_hour, tm.tm_min, tm.tm_sec);
+    emit(at_us, "OK");
+  } else if (handleSocketCommand(name, params, at_us)) {
+  } else if (handleSecurityCommand(name, params, at_us)) {
+  } else {
+    if (config.verbose) printf("SARA - not simulated at %" PRIu64 " ms [%.*s]\n", ms, command.len, command.s);
+    stats.unknown_commands++;
+    emit(at_us, "ERROR");
+  }
+}
+
+int SaraSimulator::handleScripted(str command, uint64_t at_us) {
+  for (int i = 0; i < script_cnt; i++) {
+    if (script[i].is_urc || !command_starts_with(command, script[i].command)) continue;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", script[i].response);
+    for (char *line = strtok(buf, "|"); line; line = strtok(0, "|"))
+      emit(at_us, line);
+    return 1;
+  }
+  return 0;
+}
+
+
+
+int SaraSimulator::handleSocketCommand(str name, str params, uint64_t at_us) {
+  str p[6];
+  int cnt          = split_params(params, p, 6);
+  uint8_t socket   = cnt > 0 ? str_to_uint32_t(p[0], 10) : 255;
+  sara_socket_t *s = socket < SARA_MAX_SOCKETS ? &sockets[socket] : 0;
+
+  if (str_equalcase_char(name, "AT+USOCR")) {
+    if (cnt < 1 || str_to_uint32_t(p[0], 10) != 17) {
+      emit(at_us, "+CME ERROR: Operation not supported");
+      return 1;
+    }
+    for (socket = 0; socket < SARA_MAX_SOCKETS; socket++)
+      if (!sockets[socket].is_opened) break;
+    if (socket >= SARA_MAX_SOCKETS) {
+      emit(at_us, "+CME ERROR: Operation not allowed");
+      return 1;
+    }
+    s     = &sockets[socket];
+    s->fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (s->fd < 0) {
+      emit(at_us, "ERROR");
+      return 1;
+    }
+    fcntl(s->fd, F_SETFL, O_NONBLOCK);
+    uint16_t port = cnt > 1 ? str_to_uint32_t(p[1], 10) : 0;
+    if (port) {
+      struct sockaddr_in addr = {0};
+      addr.sin_family         = AF_INET;
+      addr.sin_port           = htons(port);
+      if (bind(s->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        closeSocket(socket);
+        emit(at_us, "+CME ERROR: Operation not allowed");
+        return 1;
+      }
+    }
+    s->is_opened        = 1;
+    s->is_connected     = 0;
+    s->is_listening     = 0;
+    s->security_profile = -1;
+    s->queued           = 0;
+    emitf(at_us, "+USOCR: %u", socket);
+    emit(at_us, "OK");
+    return 1;
+  }
+
+  if (!str_equalcase_char(name, "AT+USOCL") && !str_equalcase_char(name, "AT+USOLI") &&
+      !str_equalcase_char(name, "AT+USOCO") && !str_equalcase_char(name, "AT+USOWR") &&
+      !str_equalcase_char(name, "AT+USOST") && !str_equalcase_char(name, "AT+USORD") &&
+      !str_equalcase_char(name, "AT+USORF"))
+    return 0;
+  if (!s || !s->is_opened) {
+    emit(at_us, "+CME ERROR: Bad file descriptor");
+    return 1;
+  }
+
+  if (str_equalcase_char(name, "AT+USOCL")) {
+    closeSocket(socket);
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(name, "AT+USOLI")) {
+    uint16_t port = cnt > 1 ? str_to_uint32_t(p[1], 10) : 0;
+    if (port) {
+      struct sockaddr_in addr = {0};
+      addr.sin_family         = AF_INET;
+      addr.sin_port           = htons(port);
+      if (bind(s->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINVAL) {
+        emit(at_us, "+CME ERROR: Operation not allowed");
+        return 1;
+      }
+    }
+    s->is_listening = 1;
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(name, "AT+USOCO")) {
+    if (cnt < 3) {
+      emit(at_us, "ERROR");
+      return 1;
+    }
+    snprintf(s->remote_ip, sizeof(s->remote_ip), "%.*s", p[1].len, p[1].s);
+    s->remote_port  = str_to_uint32_t(p[2], 10);
+    s->is_connected = 1;
+    /* the modem does the DTLS handshake before answering */
+    if (s->security_profile >= 0) at_us += 4 * (uint64_t)config.network_latency_us;
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(name, "AT+USOWR")) {
+    uint8_t data[SARA_MAX_DATAGRAM];
+    str bin = {.s = (char *)data, .len = 0};
+    if (!s->is_connected || cnt < 3) {
+      emit(at_us, "+CME ERROR: Operation not allowed");
+      return 1;
+    }
+    bin.len = hex_to_str(bin.s, SARA_MAX_DATAGRAM, p[2]);
+    str ip  = {.s = s->remote_ip, .len = (int)strlen(s->remote_ip)};
+    sendDatagram(socket, ip, s->remote_port, bin, at_us);
+    emitf(at_us, "+USOWR: %u,%d", socket, bin.len);
+    emit(at_us, "OK");
+  } else if (str_equalcase_char(name, "AT+USOST")) {
+    uint8_t data[SARA_MAX_DATAGRAM];
+    str bin = {.s = (char *)data, .len = 0};
+    if (cnt < 5) {
+      emit(at_us, "ERROR");
+      return 1;
+    }
+    bin.len = hex_to_str(bin.s, SARA_MAX_DATAGRAM, p[4]);
+    sendDatagram(socket, p[1], str_to_uint32_t(p[2], 10), bin, at_us);
+    emitf(at_us, "+USOST: %u,%d", socket, bin.len);
+    emit(at_us, "OK");
+  } else {
+    /* +USORD / +USORF */
+    int from        = str_equalcase_char(name, "AT+USORF");
+    uint32_t wanted = cnt > 1 ? str_to_uint32_t(p[1], 10) : 0;
+    if (!s->queued) {
+      emitf(at_us, from ? "+USORF: %u,0" : "+USORD: %u,0", socket);
+    } else if (!wanted) {
+      emitf(at_us, from ? "+USORF: %u,%d" : "+USORD: %u,%d", socket, s->queue[0].len);
+    } else {
+      char hex[2 * SARA_MAX_DATAGRAM + 1];
+      str bin = {.s = (char *)s->queue[0].data, .len = s->queue[0].len};
+      if (bin.len > (int)wanted) bin.len = wanted;
+      int hex_len = str_to_hex(hex, sizeof(hex), bin);
+      if (from)
+        emitf(at_us, "+USORF: %u,\"%s\",%u,%d,\"%.*s\"", socket, s->queue[0].ip, s->queue[0].port, bin.len, hex_len,
+              hex);
+      else
+        emitf(at_us, "+USORD: %u,%d,\"%.*s\"", socket, bin.len, hex_len, hex);
+      /* UDP - the rest of a partially read datagram is dropped */
+      s->queued--;
+      memmove(&s->queue[0], &s->queue[1], s->queued * sizeof(s->queue[0]));
+    }
+    emit(at_us, "OK");
+    if (s->queued) emitf(at_us, "%s: %u,%d", from ? "+UUSORF" : "+UUSORD", socket, s->queue[0].len);
+  }
+  return 1;
+}
+
+int SaraSimulator::handleSecurityCommand(str name, str params, uint64_t at_us) {
+  str p[4];
+  int cnt = split_params(params, p, 4);
+
+  if (str_equalcase_char(name, "AT+USECPRF")) {
+    uint32_t profile = cnt > 0 ? str_to_uint32_t(p[0], 10) : SARA_MAX_SECURITY_PROFILES;
+    if (profile >= SARA_MAX_SECURITY_PROFILES) {
+      emit(at_us, "+CME ERROR: Operation not allowed");
+      return 1;
+    }
+    if (cnt == 1) {
+      /* reset to the factory-programmed values */
+      memset(&profiles[profile], 0, sizeof(sara_security_profile_t));
+    } else if (cnt >= 3) {
+      switch (str_to_uint32_t(p[1], 10)) {
+        case AT_USECPRF_Op__Pre_Shared_Key:
+          profiles[profile].has_psk = p[2].len > 0;
+          break;
+        case AT_USECPRF_Op__Pre_Shared_Key_Identity:
+          profiles[profile].has_psk_identity = p[2].len > 0;
+          break;
+        default:
+          break;
+      }
+    }
+    emit(at_us, "OK");
+    return 1;
+  }
+
+  if (str_equalcase_char(name, "AT+USOSEC")) {
+    uint8_t socket = cnt > 0 ? str_to_uint32_t(p[0], 10) : 255;
+    if (socket >= SARA_MAX_SOCKETS || !sockets[socket].is_opened || cnt < 2) {
+      emit(at_us, "+CME ERROR: Bad file descriptor");
+      return 1;
+    }
+    if (str_to_uint32_t(p[1], 10) == 0) {
+      sockets[socket].security_profile = -1;
+      emit(at_us, "OK");
+      return 1;
+    }
+    uint32_t profile = cnt > 2 ? str_to_uint32_t(p[2], 10) : 0;
+    if (profile >= SARA_MAX_SECURITY_PROFILES || !profiles[profile].has_psk || !profiles[profile].has_psk_identity) {
+      emit(at_us, "+CME ERROR: Operation not allowed");
+      return 1;
+    }
+    sockets[socket].security_profile = profile;
+    emit(at_us, "OK");
+    return 1;
+  }
+  return 0;
+}
+
+
+
+void SaraSimulator::sendDatagram(uint8_t socket, str ip, uint16_t port, str data, uint64_t at_us) {
+  if ((uint32_t)(rand_r(&loss_seed) % 100) < config.loss_percent) {
+    stats.datagrams_dropped++;
+    return;
+  }
+  for (int i = 0; i < SARA_MAX_IN_FLIGHT; i++) {
+    sara_datagram_t *d = &uplink[i];
+    if (d->is_used) continue;
+    d->is_used = 1;
+    d->socket  = socket;
+    d->due_us  = at_us + config.network_latency_us;
+    snprintf(d->ip, sizeof(d->ip), "%.*s", ip.len, ip.s);
+    d->port = port;
+    d->len  = data.len > SARA_MAX_DATAGRAM ? SARA_MAX_DATAGRAM : data.len;
+    memcpy(d->data, data.s, d->len);
+    return;
+  }
+  stats.datagrams_dropped++;
+}
+
+void SaraSimulator::closeSocket(uint8_t socket) {
+  sara_socket_t *s = &sockets[socket];
+  if (s->fd >= 0) ::close(s->fd);
+  s->fd               = -1;
+  s->is_opened        = 0;
+  s->is_connected     = 0;
+  s->is_listening     = 0;
+  s->security_profile = -1;
+  s->queued           = 0;
+  for (int i = 0; i < SARA_MAX_IN_FLIGHT; i++) {
+    if (uplink[i].socket == socket) uplink[i].is_used = 0;
+    if (downlink[i].socket == socket) downlink[i].is_used = 0;
+  }
+}
+
+void SaraSimulator::pump() {
+  uint64_t now = sim_now_us();
+
+  /* Registration, as configured */
+  if (!registered && powered_on_us && now >= powered_on_us + (uint64_t)config.registration_delay_ms * 1000) {
+    registered = 1;
+    if (cereg_urc == 1) emit(now, "+CEREG: 1");
+    if (cereg_urc >= 2) emit(now, "+CEREG: 1,\"1A2B\",\"01ABCDEF\",7");
+  }
+
+  /* Scripted URCs */
+  for (int i = 0; i < script_cnt; i++) {
+    if (!script[i].is_urc || script[i].is_done || !powered_on_us) continue;
+    if (now < powered_on_us + (uint64_t)script[i].at_ms * 1000) continue;
+    script[i].is_done = 1;
+    emit(now, script[i].response);
+  }
+
+  /* Uplink - out to the real sockets */
+  for (int i = 0; i < SARA_MAX_IN_FLIGHT; i++) {
+    sara_datagram_t *d = &uplink[i];
+    if (!d->is_used || d->due_us > now) continue;
+    d->is_used              = 0;
+    struct sockaddr_in addr = {0};
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(d->port);
+    if (inet_pton(AF_INET, d->ip, &addr.sin_addr) != 1 || sockets[d->socket].fd < 0 ||
+        sendto(sockets[d->socket].fd, d->data, d->len, 0, (struct sockaddr *)&addr, sizeof(addr)) != d->len) {
+      stats.datagrams_dropped++;
+      continue;
+    }
+    stats.datagrams_sent++;
+  }
+
+  /* Downlink - in from the real sockets, delayed by the network latency */
+  for (uint8_t socket = 0; socket < SARA_MAX_SOCKETS; socket++) {
+    sara_socket_t *s = &sockets[socket];
+    if (s->fd < 0) continue;
+    while (true) {
+      uint8_t data[SARA_MAX_DATAGRAM];
+      struct sockaddr_in addr;
+      socklen_t addr_len = sizeof(addr);
+      ssize_t len        = recvfrom(s->fd, data, sizeof(data), 0, (struct sockaddr *)&addr, &addr_len);
+      if (len < 0) break;
+      if ((uint32_t)(rand_r(&loss_seed) % 100) < config.loss_percent) {
+        stats.datagrams_dropped++;
+        continue;
+      }
+      int i;
+      for (i = 0; i < SARA_MAX_IN_FLIGHT && downlink[i].is_used; i++)
+        ;
+      if (i >= SARA_MAX_IN_FLIGHT) {
+        stats.datagrams_dropped++;
+        continue;
+      }
+      sara_datagram_t *d = &downlink[i];
+      d->is_used         = 1;
+      d->socket          = socket;
+      d->due_us          = now + config.network_latency_us;
+      inet_ntop(AF_INET, &addr.sin_addr, d->ip, sizeof(d->ip));
+      d->port = ntohs(addr.sin_port);
+      d->len  = len;
+      memcpy(d->data, data, len);
+    }
+  }
+  for (int i = 0; i < SARA_MAX_IN_FLIGHT; i++) {
+    sara_datagram_t *d = &downlink[i];
+    if (!d->is_used || d->due_us > now) continue;
+    d->is_used       = 0;
+    sara_socket_t *s = &sockets[d->socket];
+    if (!s->is_connected && !s->is_listening) {
+      stats.datagrams_dropped++;
+      continue;
+    }
+    if (s->queued >= SARA_MAX_QUEUED_DATAGRAMS) {
+      stats.datagrams_dropped++;
+      continue;
+    }
+    snprintf(s->queue[s->queued].ip, sizeof(s->queue[0].ip), "%s", d->ip);
+    s->queue[s->queued].port = d->port;
+    s->queue[s->queued].len  = d->len;
+    memcpy(s->queue[s->queued].data, d->data, d->len);
+    s->queued++;
+    stats.datagrams_received++;
+    /* one URC for the head of the queue - the next one comes after it was read */
+    if (s->queued == 1) emitf(d->due_us, "%s: %u,%d", s->is_connected ? "+UUSORD" : "+UUSORF", d->socket, d->len);
+  }
+}
@@ -0,0 +1,212 @@
+/*
+ * SaraSimulator.h
+ * Twilio Breakout SDK
+ *
+ * Copyright (c) 2018 Twilio, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * \file SaraSimulator.h - Scripted u-blox SARA-R4 behind a host HardwareSerial, for running the SDK off-device
+ */
+
+#ifndef __SARA_SIMULATOR_H__
+#define __SARA_SIMULATOR_H__
+
+#include <Arduino.h>
+
+#include <BreakoutSDK/utils/str.h>
+
+
+
+#define SARA_MAX_SOCKETS 7
+#define SARA_MAX_SECURITY_PROFILES 5
+#define SARA_MAX_SCRIPT_ENTRIES 32
+/** Datagrams waiting to be read with +USORD/+USORF, per socket */
+#define SARA_MAX_QUEUED_DATAGRAMS 8
+/** Datagrams in flight on the modelled network, each direction */
+#define SARA_MAX_IN_FLIGHT 32
+#define SARA_MAX_DATAGRAM 1024
+/** Bytes on their way from the modem to the MCU */
+#define SARA_TX_BUFFER_SIZE 16384
+#define SARA_RX_LINE_SIZE 2400
+
+
+
+/**
+ * The latency model. The serial line carries 10 bits per byte at the baud rate, in both directions. A command is
+ * answered command_latency_us after its last byte reached the modem. Datagrams take network_latency_us each way,
+ * between the modem and the real UDP socket behind it, and a fraction of them can be dropped.
+ */
+typedef struct {
+  uint32_t baud_rate;             /**< 0 to take the rate set by HardwareSerial::begin() */
+  uint32_t command_latency_us;    /**< processing time of the modem, for each command */
+  uint32_t network_latency_us;    /**< one-way radio and core network latency */
+  uint32_t loss_percent;          /**< datagrams dropped, each direction */
+  uint32_t registration_delay_ms; /**< after begin(), before +CEREG reports the registration */
+  const char *iccid;              /**< returned by AT+CCID, which is also the DTLS PSK identity */
+  const char *model;              /**< returned by AT+CGMM */
+  int verbose;                    /**< print the AT traffic on stdout */
+} sara_simulator_config_t;
+
+/**
+ * Counters, since the start or the last resetStats()
+ */
+typedef struct {
+  uint32_t commands;           /**< AT commands answered */
+  uint32_t unknown_commands;   /**< of which answered with ERROR, for not being simulated nor scripted */
+  uint32_t bytes_to_modem;     /**< serial bytes from the MCU */
+  uint32_t bytes_from_modem;   /**< serial bytes to the MCU - responses and URCs */
+  uint32_t datagrams_sent;     /**< to the network */
+  uint32_t datagrams_received; /**< from the network */
+  uint32_t datagrams_dropped;  /**< by the loss model, or for lack of room */
+  uint64_t line_busy_us;       /**< time the serial line was busy, both directions together */
+} sara_simulator_stats_t;
+
+
+
+typedef struct {
+  uint8_t is_opened;
+  uint8_t is_connected;
+  uint8_t is_listening;
+  int8_t security_profile; /**< -1 if not secured with +USOSEC */
+  int fd;                  /**< the real UDP socket */
+  char remote_ip[64];
+  uint16_t remote_port;
+  int queued;              /**< datagrams in the receive queue */
+  struct {
+    char ip[64];
+    uint16_t port;
+    int len;
+    uint8_t data[SARA_MAX_DATAGRAM];
+  } queue[SARA_MAX_QUEUED_DATAGRAMS];
+} sara_socket_t;
+
+typedef struct {
+  uint8_t has_psk;
+  uint8_t has_psk_identity;
+} sara_security_profile_t;
+
+typedef struct {
+  uint8_t is_used;
+  uint8_t socket;
+  uint64_t due_us;
+  char ip[64];
+  uint16_t port;
+  int len;
+  uint8_t data[SARA_MAX_DATAGRAM];
+} sara_datagram_t;
+
+typedef struct {
+  char command[64];   /**< prefix of the command */
+  char response[256]; /**< lines, separated by | */
+  uint32_t at_ms;              /**< for URCs - time after begin() */
+  uint8_t is_urc;
+  uint8_t is_done;
+} sara_script_entry_t;
+
+
+
+class SaraSimulator : public HardwareSerial {
+ public:
+  SaraSimulator();
+  ~SaraSimulator();
+
+  /**
+   * Set the latency model and the identity of the modem - call before the SDK opens the port
+   * @param config - the configuration, copied
+   */
+  void configure(const sara_simulator_config_t *config);
+
+  /**
+   * Load a script of responses and URCs, which take precedence over the simulated behavior. One entry per line:
+   *   AT+CSQ => +CSQ: 5,99|OK                   - answer commands starting with AT+CSQ with these lines
+   *   @60000 => +CEREG: 0                       - emit this URC 60 seconds after begin()
+   * Empty lines and lines starting with # are skipped.
+   * @param filename - script file
+   * @return 1 on success, 0 on failure
+   */
+  int loadScript(const char *filename);
+
+  /**
+   * Add a scripted response, as in loadScript()
+   * @param command - prefix of the commands to answer
+   * @param response - lines, separated by |, usually ending with OK or ERROR
+   * @return 1 on success, 0 if the script is full or the entry too long
+   */
+  int addResponse(const char *command, const char *response);
+
+  /**
+   * Add a scripted URC, as in loadScript()
+   * @param at_ms - time after begin()
+   * @param urc - the line
+   * @return 1 on success, 0 if the script is full or the line too long
+   */
+  int addURC(uint32_t at_ms, const char *urc);
+
+  void getStats(sara_simulator_stats_t *out_stats);
+  void resetStats();
+
+  /* HardwareSerial */
+  void begin(unsigned long baud);
+  void end();
+  int available();
+  int read();
+  int peek();
+  size_t readBytes(uint8_t *buf, size_t len);
+  size_t write(const uint8_t *buf, size_t len);
+  using Stream::readBytes;
+  using Stream::write;
+
+ private:
+  sara_simulator_config_t config = {0};
+  sara_simulator_stats_t stats   = {0};
+  uint32_t baud_rate             = 115200;
+  uint64_t powered_on_us         = 0;
+  uint8_t echo                   = 1;
+  uint8_t cereg_urc              = 0;
+  uint8_t registered             = 0;
+
+  /* MCU -> modem */
+  char rx_line[SARA_RX_LINE_SIZE];
+  int rx_line_len     = 0;
+  uint64_t rx_done_us = 0; /**< when the last byte written reaches the modem */
+
+  /* modem -> MCU - each byte with the time it is fully received by the MCU */
+  uint8_t tx_buffer[SARA_TX_BUFFER_SIZE];
+  uint64_t tx_ready_us[SARA_TX_BUFFER_SIZE];
+  int tx_start = 0;
+  int tx_end   = 0;
+
+  sara_socket_t sockets[SARA_MAX_SOCKETS];
+  sara_security_profile_t profiles[SARA_MAX_SECURITY_PROFILES];
+  sara_datagram_t uplink[SARA_MAX_IN_FLIGHT];
+  sara_datagram_t downlink[SARA_MAX_IN_FLIGHT];
+
+  sara_script_entry_t script[SARA_MAX_SCRIPT_ENTRIES];
+  int script_cnt = 0;
+
+  uint64_t byteTime();
+  void pump();
+  void emit(uint64_t at_us, const char *line);
+  void emitf(uint64_t at_us, const char *format, ...);
+  void handleCommand(str command, uint64_t at_us);
+  int handleScripted(str command, uint64_t at_us);
+  int handleSocketCommand(str command, str params, uint64_t at_us);
+  int handleSecurityCommand(str command, str params, uint64_t at_us);
+  void sendDatagram(uint8_t socket, str ip, uint16_t port, str data, uint64_t at_us);
+  void closeSocket(uint8_t socket);
+};
+
+#endif
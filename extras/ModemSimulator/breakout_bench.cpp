@@ -0,0 +1,529 @@
+/*
+ * breakout_bench.cpp
+ * Twilio Breakout SDK
+ *
+ * Copyright (c) 2018 Twilio, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * \file breakout_bench.cpp - Full-stack benchmark of the Breakout SDK, over the simulated modem
+ *
+ * The SDK runs unmodified on the host, with Serial1 being the SaraSimulator. A forked responder stands in for the
+ * Twilio Commands server on 127.0.0.1, in plaintext or with DTLS over tinydtls as configured by TESTING_WITH_DTLS. It
+ * acknowledges the Heartbeats and the From-SIM Commands, refuses the Observe registration and, when asked with a
+ * "push <count> <interval_ms>" From-SIM Command, delivers timestamped To-SIM Commands.
+ *
+ * Measured: the start-up until connected, the From-SIM receipt latency and throughput, the To-SIM latency and the cost
+ * of an idle spin(). With -t, it checks instead that everything went through, as a regression test.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* tinydtls on Arduino has its own socklen_t, for session_t - kept apart from the host's */
+#define socklen_t dtls_socklen_t
+#include <Arduino.h>
+
+#include <BreakoutSDK/Breakout.h>
+#include <BreakoutSDK/CoAP/CoAPMessage.h>
+#include <tinydtls/dtls.h>
+extern "C" {
+#include <tinydtls/dtls_drbg.h>
+}
+
+#include "SaraSimulator.h"
+#undef socklen_t
+
+
+
+extern SaraSimulator SerialSara;
+
+#define BENCH_ICCID "8988307000000000001"
+#define BENCH_PSK_KEY "00112233445566778899aabbccddeeff"
+#define BENCH_MAX_COMMANDS 1000
+#define BENCH_ACK_TIMEOUT_US 2000000
+#define BENCH_MAX_RETRANSMIT 4
+
+
+
+static uint64_t now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+  int cnt;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+} bench_timing_t;
+
+static void timing_add(bench_timing_t *t, uint64_t value) {
+  if (!t->cnt || value < t->min) t->min = value;
+  if (value > t->max) t->max = value;
+  t->sum += value;
+  t->cnt++;
+}
+
+static void timing_print(const char *what, bench_timing_t *t, const char *unit, double divider) {
+  if (!t->cnt) {
+    printf("  %-28s -\n", what);
+    return;
+  }
+  printf("  %-28s %6d x  min %9.3f  avg %9.3f  max %9.3f %s\n", what, t->cnt, t->min / divider,
+         t->sum / divider / t->cnt, t->max / divider, unit);
+}
+
+
+
+/*
+ * The responder - a minimal Commands server, in its own process
+ */
+
+static int responder_fd = -1;
+static struct sockaddr_in device_addr;
+static int device_known               = 0;
+static dtls_context_t *responder_dtls = 0;
+static session_t responder_session;
+static coap_message_id_t responder_mid = 0x1000;
+
+static struct {
+  coap_message_id_t message_id;
+  uint8_t data[256];
+  int len;
+  int retransmissions;
+  uint64_t next_us;
+} outstanding[16];
+
+static int push_remaining     = 0;
+static uint32_t push_seq      = 0;
+static uint32_t push_interval = 0;
+static uint64_t push_next_us  = 0;
+
+static void responder_send(uint8_t *data, int len) {
+  if (!device_known) return;
+  if (responder_dtls)
+    dtls_write(responder_dtls, &responder_session, data, len);
+  else
+    sendto(responder_fd, data, len, 0, (struct sockaddr *)&device_addr, sizeof(device_addr));
+}
+
+static void responder_send_message(CoAPMessage *msg) {
+  uint8_t buf[512];
+  bin_t b = {.s = buf, .idx = 0, .max = sizeof(buf)};
+  if (!msg->encode(&b)) {
+    fprintf(stderr, "Responder - error encoding\n");
+    return;
+  }
+  responder_send(buf, b.idx);
+  if (msg->type != CoAP_Type__Confirmable) return;
+  for (int i = 0; i < 16; i++) {
+    if (outstanding[i].len) continue;
+    outstanding[i].message_id      = msg->message_id;
+    outstanding[i].len             = b.idx;
+    outstanding[i].retransmissions = 0;
+    outstanding[i].next_us         = now_us() + BENCH_ACK_TIMEOUT_US;
+    memcpy(outstanding[i].data, buf, b.idx);
+    break;
+  }
+}
+
+static void responder_push() {
+  char payload[64];
+  CoAPMessage msg(CoAP_Type__Confirmable, CoAP_Code_Class__Request, CoAP_Code_Detail__Request__POST, responder_mid++);
+  msg.addOptionUriPath((char *)"Commands");
+  msg.addOptionContentFormat(CoAP_Content_Format__text_plain_charset_utf8);
+  msg.payload.s   = payload;
+  msg.payload.len = snprintf(payload, sizeof(payload), "to-sim %u %llu", ++push_seq, (unsigned long long)now_us());
+  responder_send_message(&msg);
+}
+
+static void responder_handle_coap(uint8_t *data, int len) {
+  CoAPMessage request;
+  bin_t b = {.s = data, .idx = 0, .max = len};
+  if (!request.decode(&b)) return;
+
+  if (request.type == CoAP_Type__Acknowledgement || request.type == CoAP_Type__Reset) {
+    for (int i = 0; i < 16; i++)
+      if (outstanding[i].len && outstanding[i].message_id == request.message_id) outstanding[i].len = 0;
+    return;
+  }
+  if (request.type != CoAP_Type__Confirmable && request.type != CoAP_Type__Non_Confirmable) return;
+
+  char path[64];
+  int path_len = 0;
+  path[0]      = 0;
+  for (CoAPOption *opt = request.options; opt && path_len < (int)sizeof(path); opt = opt->next)
+    if (opt->number == CoAP_Option__Uri_Path)
+      path_len += snprintf(path + path_len, sizeof(path) - path_len, "/%.*s", opt->value.string.len,
+                           opt->value.string.s);
+
+  coap_type_e reply_type = request.type == CoAP_Type__Confirmable ? CoAP_Type__Acknowledgement
+                                                                  : CoAP_Type__Non_Confirmable;
+  if (request.code_detail == CoAP_Code_Detail__Request__POST && !strcmp(path, "/v1/Heartbeats")) {
+    CoAPMessage response(&request, reply_type, CoAP_Code_Class__Response, CoAP_Code_Detail__Response__Created);
+    response.addOptionTwilioQueuedCommandCount(0);
+    responder_send_message(&response);
+  } else if (request.code_detail == CoAP_Code_Detail__Request__GET && !strcmp(path, "/v1/Commands")) {
+    /* Without Observe - the registration is refused and the SDK keeps polling */
+    CoAPMessage response(&request, reply_type, CoAP_Code_Class__Response, CoAP_Code_Detail__Response__Content);
+    responder_send_message(&response);
+  } else if (request.code_detail == CoAP_Code_Detail__Request__POST && !strcmp(path, "/v1/Commands")) {
+    CoAPMessage response(&request, reply_type, CoAP_Code_Class__Response, CoAP_Code_Detail__Response__Changed);
+    response.addOptionTwilioQueuedCommandCount(0);
+    responder_send_message(&response);
+    unsigned int count = 0, interval = 0;
+    char text[64];
+    snprintf(text, sizeof(text), "%.*s", request.payload.len, request.payload.s);
+    if (sscanf(text, "push %u %u", &count, &interval) == 2) {
+      push_remaining = count;
+      push_interval  = interval;
+      push_next_us   = now_us();
+    }
+  } else if (request.type == CoAP_Type__Confirmable) {
+    CoAPMessage response(&request, CoAP_Type__Acknowledgement, CoAP_Code_Class__Error,
+                         CoAP_Code_Detail__Error__Not_Found);
+    responder_send_message(&response);
+  }
+}
+
+static int responder_dtls_write(struct dtls_context_t *ctx, session_t *session, uint8 *buf, size_t len) {
+  return sendto(responder_fd, buf, len, 0, (struct sockaddr *)&device_addr, sizeof(device_addr));
+}
+
+static int responder_dtls_read(struct dtls_context_t *ctx, session_t *session, uint8 *buf, size_t len) {
+  responder_handle_coap(buf, len);
+  return 0;
+}
+
+static int responder_dtls_psk_info(struct dtls_context_t *ctx, const session_t *session, dtls_credentials_type_t type,
+                                   const unsigned char *desc, size_t desc_len, unsigned char *result,
+                                   size_t result_length) {
+  if (type == DTLS_PSK_HINT) return 0;
+  if (type != DTLS_PSK_KEY) return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
+  if (desc_len != strlen(BENCH_ICCID) || memcmp(desc, BENCH_ICCID, desc_len) != 0) {
+    fprintf(stderr, "Responder - unknown PSK identity [%.*s]\n", (int)desc_len, desc);
+    return dtls_alert_fatal_create(DTLS_ALERT_ILLEGAL_PARAMETER);
+  }
+  str hex = STRDECL((char *)BENCH_PSK_KEY);
+  return hex_to_str((char *)result, result_length, hex);
+}
+
+static dtls_handler_t responder_dtls_callbacks = {
+    .write        = responder_dtls_write,
+    .read         = responder_dtls_read,
+    .event        = 0,
+    .get_psk_info = responder_dtls_psk_info,
+};
+
+/**
+ * Serve until the parent closes the control pipe
+ * @param port - UDP port on 127.0.0.1
+ * @param use_dtls - 1 for DTLS with PSK, 0 for plaintext
+ * @param control_fd - read end of the pipe from the parent
+ */
+static void responder_run(uint16_t port, int use_dtls, int control_fd) {
+  responder_fd            = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr = {0};
+  addr.sin_family         = AF_INET;
+  addr.sin_port           = htons(port);
+  addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+  if (responder_fd < 0 || bind(responder_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    fprintf(stderr, "Responder - error binding UDP port %u: %s\n", port, strerror(errno));
+    exit(1);
+  }
+  if (use_dtls) {
+    uint64_t seed = now_us();
+    dtls_drbg_add_entropy((const unsigned char *)&seed, sizeof(seed));
+    responder_dtls = dtls_new_context(0);
+    dtls_set_handler(responder_dtls, &responder_dtls_callbacks);
+  }
+
+  while (1) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(responder_fd, &fds);
+    FD_SET(control_fd, &fds);
+    struct timeval tv = {.tv_sec = 0, .tv_usec = 5000};
+    if (select((responder_fd > control_fd ? responder_fd : control_fd) + 1, &fds, 0, 0, &tv) < 0) break;
+    if (FD_ISSET(control_fd, &fds)) break;
+
+    if (FD_ISSET(responder_fd, &fds)) {
+      uint8_t buf[2048];
+      socklen_t addr_len = sizeof(device_addr);
+      ssize_t len        = recvfrom(responder_fd, buf, sizeof(buf), 0, (struct sockaddr *)&device_addr, &addr_len);
+      if (len > 0) {
+        device_known = 1;
+        if (responder_dtls) {
+          memset(&responder_session, 0, sizeof(responder_session));
+          responder_session.size = IP_Address__IPv4;
+          memcpy(responder_session.addr.ipv4, &device_addr.sin_addr, 4);
+          responder_session.port = ntohs(device_addr.sin_port);
+          dtls_handle_message(responder_dtls, &responder_session, buf, len);
+        } else {
+          responder_handle_coap(buf, len);
+        }
+      }
+    }
+
+    uint64_t now = now_us();
+    if (push_remaining && now >= push_next_us) {
+      responder_push();
+      push_remaining--;
+      push_next_us = now + (uint64_t)push_interval * 1000;
+    }
+    for (int i = 0; i < 16; i++) {
+      if (!outstanding[i].len || outstanding[i].next_us > now) continue;
+      if (outstanding[i].retransmissions++ >= BENCH_MAX_RETRANSMIT) {
+        outstanding[i].len = 0;
+        continue;
+      }
+      responder_send(outstanding[i].data, outstanding[i].len);
+      outstanding[i].next_us = now + ((uint64_t)BENCH_ACK_TIMEOUT_US << outstanding[i].retransmissions);
+    }
+    if (responder_dtls) {
+      clock_time_t next = 0;
+      dtls_check_retransmit(responder_dtls, &next);
+    }
+  }
+  exit(0);
+}
+
+
+
+/*
+ * The device side
+ */
+
+static uint64_t from_sim_sent_us[BENCH_MAX_COMMANDS];
+static bench_timing_t from_sim_latency = {0};
+static int from_sim_confirmed          = 0;
+static int from_sim_failed             = 0;
+
+static bench_timing_t to_sim_latency = {0};
+static int to_sim_received           = 0;
+static int to_sim_corrupted          = 0;
+
+static void callback_receipt(command_receipt_code_e receipt_code, void *cb_parameter) {
+  int idx = (intptr_t)cb_parameter;
+  if (receipt_code != COMMAND_RECEIPT_CONFIRMED_DELIVERY) {
+    from_sim_failed++;
+    return;
+  }
+  from_sim_confirmed++;
+  if (idx >= 0 && idx < BENCH_MAX_COMMANDS) timing_add(&from_sim_latency, now_us() - from_sim_sent_us[idx]);
+}
+
+static void handler_command(const char *buf, size_t bufSize, bool isBinary) {
+  char text[64];
+  unsigned int seq            = 0;
+  unsigned long long stamp_us = 0;
+  snprintf(text, sizeof(text), "%.*s", (int)bufSize, buf);
+  if (isBinary || sscanf(text, "to-sim %u %llu", &seq, &stamp_us) != 2) {
+    to_sim_corrupted++;
+    return;
+  }
+  to_sim_received++;
+  timing_add(&to_sim_latency, now_us() - stamp_us);
+}
+
+static int spin_until(int *counter, int target, uint32_t timeout_ms) {
+  uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000;
+  while (*counter < target && now_us() < deadline)
+    Breakout::getInstance().spin();
+  return *counter >= target;
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s [options]\n", name);
+  printf("  -b, --baud <rate>              serial baud rate (default: from the SDK, 115200)\n");
+  printf("  -c, --command-latency-us <us>  modem processing time per AT command (default 2000)\n");
+  printf("  -n, --network-latency-ms <ms>  one-way network latency (default 50)\n");
+  printf("  -l, --loss <percent>           datagram loss, each direction (default 0)\n");
+  printf("  -N, --commands <count>         From-SIM and To-SIM Commands to exchange (default 20)\n");
+  printf("  -s, --script <file>            scripted responses and URCs, see SaraSimulator.h\n");
+  printf("  -t, --test                     check the results and exit non-zero on failure\n");
+  printf("  -v, --verbose                  print the AT traffic and the SDK debug log\n");
+}
+
+int main(int argc, char **argv) {
+  sara_simulator_config_t config = {0};
+  config.command_latency_us      = 2000;
+  config.network_latency_us      = 50000;
+  config.iccid                   = BENCH_ICCID;
+  const char *script             = 0;
+  int commands = 20, test = 0;
+
+  static struct option long_options[] = {
+      {"baud", required_argument, 0, 'b'},     {"command-latency-us", required_argument, 0, 'c'},
+      {"network-latency-ms", required_argument, 0, 'n'}, {"loss", required_argument, 0, 'l'},
+      {"commands", required_argument, 0, 'N'}, {"script", required_argument, 0, 's'},
+      {"test", no_argument, 0, 't'},           {"verbose", no_argument, 0, 'v'},
+      {"help", no_argument, 0, 'h'},           {0, 0, 0, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "b:c:n:l:N:s:tvh", long_options, 0)) != -1) {
+    switch (opt) {
+      case 'b':
+        config.baud_rate = atoi(optarg);
+        break;
+      case 'c':
+        config.command_latency_us = atoi(optarg);
+        break;
+      case 'n':
+        config.network_latency_us = atoi(optarg) * 1000;
+        break;
+      case 'l':
+        config.loss_percent = atoi(optarg);
+        break;
+      case 'N':
+        commands = atoi(optarg);
+        break;
+      case 's':
+        script = optarg;
+        break;
+      case 't':
+        test = 1;
+        break;
+      case 'v':
+        config.verbose = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 2;
+    }
+  }
+  if (commands < 1 || commands > BENCH_MAX_COMMANDS) commands = commands < 1 ? 1 : BENCH_MAX_COMMANDS;
+
+  setvbuf(stdout, 0, _IOLBF, 0);
+
+  owl_log_set_level(config.verbose ? L_DBG : L_ISSUE);
+
+  /* The responder, forked before the SDK touches any global state */
+  int control[2];
+  if (pipe(control) < 0) return 1;
+  pid_t responder = fork();
+  if (responder < 0) return 1;
+  if (responder == 0) {
+    close(control[1]);
+    responder_run(TESTING_WITH_DTLS == 0 ? 5683 : 5684, TESTING_WITH_DTLS == 1, control[0]);
+  }
+  close(control[0]);
+
+  SerialSara.configure(&config);
+  if (script && !SerialSara.loadScript(script)) return 1;
+
+  const char *transports[] = {"plaintext", "DTLS with tinydtls", "DTLS in the modem"};
+  printf("Breakout SDK over the simulated SARA - %s, network latency %u ms, loss %u%%, modem latency %u us\n",
+         transports[TESTING_WITH_DTLS], config.network_latency_us / 1000, config.loss_percent,
+         config.command_latency_us);
+
+  Breakout *breakout = &Breakout::getInstance();
+  breakout->setPSKKey(BENCH_PSK_KEY);
+  breakout->setCommandHandler(handler_command);
+
+  int failures     = 0;
+  uint64_t start   = now_us();
+  bool powered     = breakout->powerModuleOn();
+  uint64_t startup = now_us() - start;
+  sara_simulator_stats_t stats;
+  SerialSara.getStats(&stats);
+  printf("Start-up: %s in %.3f s - %u AT commands, %u unknown\n", powered ? "connected" : "FAILED", startup / 1e6,
+         stats.commands, stats.unknown_commands);
+  if (!powered) {
+    failures++;
+    goto done;
+  }
+  if (stats.unknown_commands) failures++;
+
+  {
+    /* From-SIM - as fast as the SDK takes them, with a receipt each */
+    char cmd[32];
+    SerialSara.resetStats();
+    start = now_us();
+    for (int i = 0; i < commands; i++) {
+      snprintf(cmd, sizeof(cmd), "from-sim %d", i);
+      command_status_code_e status;
+      while ((status = breakout->sendTextCommandWithReceiptRequest(cmd, callback_receipt, (void *)(intptr_t)i)) ==
+             COMMAND_STATUS_BUSY)
+        breakout->spin();
+      from_sim_sent_us[i] = now_us();
+      if (status != COMMAND_STATUS_OK) from_sim_failed++;
+    }
+    int done = from_sim_confirmed + from_sim_failed;
+    while (done < commands && now_us() - start < 60000000ULL) {
+      breakout->spin();
+      done = from_sim_confirmed + from_sim_failed;
+    }
+    uint64_t elapsed = now_us() - start;
+    SerialSara.getStats(&stats);
+    printf("From-SIM: %d/%d confirmed in %.3f s - %.2f Commands/s, %.1f AT commands and %.0f serial bytes each\n",
+           from_sim_confirmed, commands, elapsed / 1e6, from_sim_confirmed * 1e6 / elapsed,
+           (double)stats.commands / commands, (double)(stats.bytes_to_modem + stats.bytes_from_modem) / commands);
+    if (from_sim_confirmed != commands) failures++;
+
+    /* To-SIM - the responder pushes them, spaced by twice the round trip */
+    uint32_t interval_ms = 4 * config.network_latency_us / 1000 + 50;
+    snprintf(cmd, sizeof(cmd), "push %d %u", commands, interval_ms);
+    int before = from_sim_confirmed;
+    breakout->sendTextCommandWithReceiptRequest(cmd, callback_receipt, (void *)(intptr_t)-1);
+    spin_until(&from_sim_confirmed, before + 1, 30000);
+    SerialSara.resetStats();
+    start = now_us();
+    spin_until(&to_sim_received, commands, 30000 + commands * interval_ms);
+    elapsed = now_us() - start;
+    SerialSara.getStats(&stats);
+    printf("To-SIM:   %d/%d received in %.3f s, %d corrupted, pushed every %u ms - %.1f AT commands each\n",
+           to_sim_received, commands, elapsed / 1e6, to_sim_corrupted, interval_ms,
+           to_sim_received ? (double)stats.commands / to_sim_received : 0.0);
+    if (to_sim_received != commands || to_sim_corrupted) failures++;
+
+    printf("Latency:\n");
+    timing_print("From-SIM send to receipt", &from_sim_latency, "ms", 1000.0);
+    timing_print("To-SIM push to handler", &to_sim_latency, "ms", 1000.0);
+
+    /* Idle - the cost of a spin() with nothing to do, as in a loop() with a short delay */
+    bench_timing_t idle = {0};
+    SerialSara.resetStats();
+    start = now_us();
+    while (now_us() - start < 2000000) {
+      uint64_t t = now_us();
+      breakout->spin();
+      timing_add(&idle, now_us() - t);
+      delay(10);
+    }
+    elapsed = now_us() - start;
+    SerialSara.getStats(&stats);
+    timing_print("idle spin()", &idle, "us", 1.0);
+    printf("Idle: %.1f AT commands/s, serial line busy %.2f%%\n", stats.commands * 1e6 / elapsed,
+           stats.line_busy_us * 100.0 / elapsed);
+  }
+
+done:
+  printf("Errors:   %u logged by the SDK\n", SerialUSB.errors);
+  if (SerialUSB.errors) failures++;
+  close(control[1]);
+  waitpid(responder, 0, 0);
+  if (test) printf("%s\n", failures ? "FAILED" : "PASSED");
+  return test && failures ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * HardwareSerial.h
+ * Twilio Breakout SDK
+ *
+ * Copyright (c) 2018 Twilio, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * \file HardwareSerial.h - Host stand-in for the Arduino serial ports
+ *
+ * The ports are unconnected by default: nothing to read, writes are dropped. Serial1, which the SDK uses for the modem
+ * (SerialModule in board.h), is bound to the SARA simulator by whoever links it in.
+ */
+
+#ifndef __HOST_HARDWARE_SERIAL_H__
+#define __HOST_HARDWARE_SERIAL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class Stream {
+ public:
+  virtual ~Stream() {
+  }
+
+  virtual int available() {
+    return 0;
+  }
+  virtual int read() {
+    return -1;
+  }
+  virtual int peek() {
+    return -1;
+  }
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    return len;
+  }
+  virtual size_t readBytes(uint8_t *buf, size_t len) {
+    size_t cnt = 0;
+    int c;
+    while (cnt < len && (c = read()) >= 0)
+      buf[cnt++] = c;
+    return cnt;
+  }
+
+  size_t write(uint8_t c) {
+    return write(&c, 1);
+  }
+  size_t write(const char *buf, size_t len) {
+    return write((const uint8_t *)buf, len);
+  }
+  size_t readBytes(char *buf, size_t len) {
+    return readBytes((uint8_t *)buf, len);
+  }
+  size_t print(const char *s) {
+    return write(s, strlen(s));
+  }
+  size_t println(const char *s) {
+    return print(s) + write("\r\n", 2);
+  }
+  int availableForWrite() {
+    return 256;
+  }
+  void flush() {
+  }
+};
+
+class HardwareSerial : public Stream {
+ public:
+  virtual void begin(unsigned long baud) {
+  }
+  virtual void end() {
+  }
+  void enableBlockingTx() {
+  }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial &Serial1;
+extern HardwareSerial Serial2;
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * host_core.cpp
+ * Twilio Breakout SDK
+ *
+ * Copyright (c) 2018 Twilio, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * \file host_core.cpp - Host implementation of the Arduino core functions used by the Breakout SDK
+ */
+
+#include "Arduino.h"
+
+#include <time.h>
+#include <unistd.h>
+
+
+
+static uint64_t start_us = 0;
+
+static uint64_t now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  if (!start_us) start_us = us - 1;
+  return us - start_us;
+}
+
+extern "C" uint32_t millis(void) {
+  return now_us() / 1000;
+}
+
+extern "C" uint32_t micros(void) {
+  return (uint32_t)now_us();
+}
+
+extern "C" void delay(uint32_t ms) {
+  usleep(ms * 1000);
+}
+
+extern "C" void delayMicroseconds(uint32_t us) {
+  usleep(us);
+}
+
+
+
+extern "C" void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+extern "C" void digitalWrite(uint8_t pin, uint8_t value) {
+}
+
+extern "C" int digitalRead(uint8_t pin) {
+  return LOW;
+}
+
+extern "C" int analogRead(uint8_t pin) {
+  return rand() & 0x3FF;
+}
+
+
+
+long random(long max) {
+  return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  srand(seed);
+}
+
+
+
+HardwareSerial Serial;
+HardwareSerial Serial2;
+
+USBSerial SerialUSB;
+
+size_t USBSerial::write(const uint8_t *buf, size_t len) {
+  /* owl_log() writes the color reset, the time and the level name of each line first, in a write of their own */
+  static const char prefix[] = "\033[00;49m";
+  if (len < 48 && len > sizeof(prefix) - 1 && !memcmp(buf, prefix, sizeof(prefix) - 1) &&
+      (memmem(buf, len, "ERR ", 4) || memmem(buf, len, "CRIT", 4) || memmem(buf, len, "ALRT", 4)))
+    errors++;
+  return fwrite(buf, 1, len, stdout);
+}
@@ -0,0 +1,42 @@
+/*
+ * usb_serial.h
+ * Twilio Breakout SDK
+ *
+ * Copyright (c) 2018 Twilio, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * \file usb_serial.h - Host stand-in for the USB serial port, which carries the log
+ *
+ * Writes go to stdout. There is no input, so the CLI stays idle. The log lines of level ERR and above are counted, for
+ * the regression checks.
+ */
+
+#ifndef __HOST_USB_SERIAL_H__
+#define __HOST_USB_SERIAL_H__
+
+#include "HardwareSerial.h"
+
+class USBSerial : public HardwareSerial {
+ public:
+  size_t write(const uint8_t *buf, size_t len);
+  using Stream::write;
+
+  unsigned int errors = 0; /**< log lines of level ERR, CRIT or ALRT written so far */
+};
+
+extern USBSerial SerialUSB;
+
+#endif
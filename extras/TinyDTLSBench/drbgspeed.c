@@ -0,0 +1,133 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2011, 2012, 2013, 2014, 2015 Olaf Bergmann (TZI) and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v. 1.0 which accompanies this distribution.
+ *
+ * The Eclipse Public License is available at http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+/*
+ * Host benchmark and self test for the random generator in dtls_drbg.c.
+ *
+ * Checks the output under a test seed against a known answer, computed
+ * with an independent CTR_DRBG (SHA-256 of the seed as seed material,
+ * OpenSSL AES-128), checks that the test seed makes it repeatable and
+ * then times reads of handshake random, token and message ID sizes
+ * against the previous dtls_prng(), which called rand() per byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tinydtls.h"
+#include "dtls_drbg.h"
+
+static int failures = 0;
+
+static void
+check(int ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static void
+hex(const char *in, unsigned char *out) {
+  unsigned int b;
+
+  while (*in && sscanf(in, "%2x", &b) == 1) {
+    *out++ = b;
+    in += 2;
+  }
+}
+
+static const char test_seed[] = "tinydtls test seed";
+
+static void
+test_known_answer(void) {
+  static const size_t pieces[] = { 1, 7, 32, 60 };
+  unsigned char expected[100], out[100];
+  size_t i, offset = 0;
+
+  hex("35707f1b9108b5757c1323713a6f774cf6fe4f8150b2cb909b73f301d77efcd3"
+      "6fd4b37d7aaac1e5eb258ad85cdcc06d99ff64fe339e44e9cac2935096041cf6"
+      "727af5e35cccbfd87e3cd425cab113e8ea5e0ff8211a9468302138c6cf86dd4b"
+      "82f85cbb", expected);
+
+  dtls_drbg_set_test_seed((const unsigned char *)test_seed, strlen(test_seed));
+  for (i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+    dtls_drbg_generate(out + offset, pieces[i]);
+    offset += pieces[i];
+  }
+  check(memcmp(out, expected, sizeof(out)) == 0, "CTR_DRBG known answer");
+
+  /* entropy is ignored under a test seed, the run repeats */
+  dtls_drbg_set_test_seed((const unsigned char *)test_seed, strlen(test_seed));
+  dtls_drbg_add_entropy((const unsigned char *)"noise", 5);
+  dtls_drbg_generate(out, sizeof(out));
+  check(memcmp(out, expected, sizeof(out)) == 0, "repeatable under a test seed");
+}
+
+/* The previous dtls_prng() */
+static int
+ref_prng(unsigned char *buf, size_t len) {
+  while (len--)
+    *buf++ = rand() & 0xFF;
+  return 1;
+}
+
+typedef int (*prng_func)(unsigned char *buf, size_t len);
+
+static double
+nsec(prng_func f, size_t len) {
+  unsigned char buf[32];
+  clock_t start;
+  int i, rounds = 1000000;
+
+  start = clock();
+  for (i = 0; i < rounds; i++)
+    f(buf, len);
+  return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / rounds;
+}
+
+static void
+speed(void) {
+  static const struct {
+    const char *what;
+    size_t len;
+  } reads[] = {
+    { "random", 28 },		/* ClientHello.random after the time */
+    { "ECC key", 32 },
+    { "token", 4 },
+    { "message ID", 2 },
+  };
+  size_t i;
+
+  srand(1);
+  printf("%-12s %6s %10s %10s\n", "dtls_prng()", "bytes", "ns", "before ns");
+  for (i = 0; i < sizeof(reads) / sizeof(reads[0]); i++)
+    printf("%-12s %6u %10.1f %10.1f\n", reads[i].what, (unsigned int)reads[i].len,
+	   nsec(dtls_drbg_generate, reads[i].len), nsec(ref_prng, reads[i].len));
+}
+
+int
+main(int argc, char **argv) {
+  test_known_answer();
+  if (failures) {
+    printf("%d checks FAILED\n", failures);
+    return 1;
+  }
+  printf("CTR_DRBG known answer and test seed checks passed\n");
+
+  if (argc < 2 || strcmp(argv[1], "-t") != 0)
+    speed();
+  return 0;
+}
@@ -0,0 +1,272 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2011, 2012, 2013, 2014, 2015 Olaf Bergmann (TZI) and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v. 1.0 which accompanies this distribution.
+ *
+ * The Eclipse Public License is available at http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+/*
+ * Host benchmark and self test for HMAC-SHA256 and the TLS 1.2 PRF.
+ *
+ * Checks dtls_hmac_*() against RFC 4231 and dtls_prf() against the
+ * published P_SHA256 test vector, then times dtls_prf() for the
+ * derivations of a PSK handshake against the previous P_hash, which
+ * allocated its contexts and hashed the ipad and opad blocks again
+ * for every HMAC (kept below as ref_*).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tinydtls.h"
+#include "crypto.h"
+#include "hmac.h"
+
+/* The previous HMAC and P_hash */
+
+typedef struct {
+  unsigned char pad[DTLS_HMAC_BLOCKSIZE];
+  dtls_hash_ctx data;
+} ref_hmac_context_t;
+
+static void
+ref_hmac_init(ref_hmac_context_t *ctx, const unsigned char *key, size_t klen) {
+  int i;
+
+  memset(ctx, 0, sizeof(ref_hmac_context_t));
+  if (klen > DTLS_HMAC_BLOCKSIZE) {
+    dtls_hash_init(&ctx->data);
+    dtls_hash_update(&ctx->data, key, klen);
+    dtls_hash_finalize(ctx->pad, &ctx->data);
+  } else
+    memcpy(ctx->pad, key, klen);
+  for (i=0; i < DTLS_HMAC_BLOCKSIZE; ++i)
+    ctx->pad[i] ^= 0x36;
+  dtls_hash_init(&ctx->data);
+  dtls_hash_update(&ctx->data, ctx->pad, DTLS_HMAC_BLOCKSIZE);
+  for (i=0; i < DTLS_HMAC_BLOCKSIZE; ++i)
+    ctx->pad[i] ^= 0x6A;
+}
+
+static size_t
+ref_hmac_finalize(ref_hmac_context_t *ctx, unsigned char *result) {
+  unsigned char buf[DTLS_HMAC_DIGEST_SIZE];
+  size_t len;
+
+  len = dtls_hash_finalize(buf, &ctx->data);
+  dtls_hash_init(&ctx->data);
+  dtls_hash_update(&ctx->data, ctx->pad, DTLS_HMAC_BLOCKSIZE);
+  dtls_hash_update(&ctx->data, buf, len);
+  return dtls_hash_finalize(result, &ctx->data);
+}
+
+#define REF_UPDATE_SEED(Context,Seed,Length)		\
+  if (Seed) dtls_hash_update(&(Context)->data, (Seed), (Length))
+
+static size_t
+ref_prf(const unsigned char *key, size_t keylen,
+	const unsigned char *label, size_t labellen,
+	const unsigned char *random1, size_t random1len,
+	const unsigned char *random2, size_t random2len,
+	unsigned char *buf, size_t buflen) {
+  ref_hmac_context_t *hmac_a, *hmac_p;
+  unsigned char A[DTLS_HMAC_DIGEST_SIZE];
+  unsigned char tmp[DTLS_HMAC_DIGEST_SIZE];
+  size_t dlen;
+  size_t len = 0;
+
+  memset(buf, 0, buflen);
+  hmac_a = malloc(sizeof(ref_hmac_context_t));
+  hmac_p = malloc(sizeof(ref_hmac_context_t));
+
+  ref_hmac_init(hmac_a, key, keylen);
+  REF_UPDATE_SEED(hmac_a, label, labellen);
+  REF_UPDATE_SEED(hmac_a, random1, random1len);
+  REF_UPDATE_SEED(hmac_a, random2, random2len);
+  dlen = ref_hmac_finalize(hmac_a, A);
+
+  while (len + dlen < buflen) {
+    ref_hmac_init(hmac_p, key, keylen);
+    dtls_hash_update(&hmac_p->data, A, dlen);
+    REF_UPDATE_SEED(hmac_p, label, labellen);
+    REF_UPDATE_SEED(hmac_p, random1, random1len);
+    REF_UPDATE_SEED(hmac_p, random2, random2len);
+    len += ref_hmac_finalize(hmac_p, tmp);
+    memcpy(buf, tmp, dlen);
+    buf += dlen;
+
+    ref_hmac_init(hmac_a, key, keylen);
+    dtls_hash_update(&hmac_a->data, A, dlen);
+    ref_hmac_finalize(hmac_a, A);
+  }
+
+  ref_hmac_init(hmac_p, key, keylen);
+  dtls_hash_update(&hmac_p->data, A, dlen);
+  REF_UPDATE_SEED(hmac_p, label, labellen);
+  REF_UPDATE_SEED(hmac_p, random1, random1len);
+  REF_UPDATE_SEED(hmac_p, random2, random2len);
+  ref_hmac_finalize(hmac_p, tmp);
+  memcpy(buf, tmp, buflen - len);
+
+  free(hmac_a);
+  free(hmac_p);
+  return buflen;
+}
+
+static int failures = 0;
+
+static void
+check(int ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static void
+hex(const char *in, unsigned char *out) {
+  unsigned int b;
+
+  while (*in && sscanf(in, "%2x", &b) == 1) {
+    *out++ = b;
+    in += 2;
+  }
+}
+
+/* RFC 4231, test cases 1, 2 and 6 (key longer than a block) */
+static void
+test_hmac(void) {
+  static const struct {
+    const char *key, *data, *mac;
+  } cases[] = {
+    { "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b", "Hi There",
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { "4a656665", "what do ya want for nothing?",
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+    { NULL, "Test Using Larger Than Block-Size Key - Hash Key First",
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+  };
+  dtls_hmac_context_t ctx;
+  unsigned char key[131], mac[DTLS_HMAC_DIGEST_SIZE], result[DTLS_HMAC_MAX];
+  size_t i, keylen;
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    if (cases[i].key) {
+      keylen = strlen(cases[i].key) / 2;
+      hex(cases[i].key, key);
+    } else {
+      keylen = sizeof(key);
+      memset(key, 0xaa, keylen);
+    }
+    hex(cases[i].mac, mac);
+
+    dtls_hmac_init(&ctx, key, keylen);
+    dtls_hmac_update(&ctx, (const unsigned char *)cases[i].data, strlen(cases[i].data));
+    check(dtls_hmac_finalize(&ctx, result) == DTLS_HMAC_DIGEST_SIZE
+	  && memcmp(result, mac, sizeof(mac)) == 0, "RFC 4231 HMAC");
+
+    /* the same key again, from the cached state */
+    dtls_hmac_reset(&ctx);
+    dtls_hmac_update(&ctx, (const unsigned char *)cases[i].data, 4);
+    dtls_hmac_update(&ctx, (const unsigned char *)cases[i].data + 4, strlen(cases[i].data) - 4);
+    dtls_hmac_finalize(&ctx, result);
+    check(memcmp(result, mac, sizeof(mac)) == 0, "HMAC after dtls_hmac_reset()");
+  }
+}
+
+static void
+test_prf(void) {
+  static const char label[] = "test label";
+  unsigned char secret[16], seed[16], expected[100], out[100], ref[100];
+  size_t len;
+
+  hex("9bbe436ba940f017b17652849a71db35", secret);
+  hex("a0ba9f936cda311827a6f796ffd5198c", seed);
+  hex("e3f229ba727be17b8d122620557cd453c2aab21d07c3d495329b52d4e61edb5a"
+      "6b301791e90d35c9c9a46b4e14baf9af0fa022f7077def17abfd3797c0564bab"
+      "4fbc91666e9def9b97fce34f796789baa48082d122ee42c5a72e5a5110fff701"
+      "87347b66", expected);
+
+  dtls_prf(secret, sizeof(secret), (const unsigned char *)label, strlen(label),
+	   seed, sizeof(seed), NULL, 0, out, sizeof(out));
+  check(memcmp(out, expected, sizeof(out)) == 0, "P_SHA256 test vector");
+
+  /* every length, against the previous implementation */
+  for (len = 1; len <= sizeof(out); len++) {
+    dtls_prf(secret, sizeof(secret), (const unsigned char *)label, strlen(label),
+	     seed, sizeof(seed), seed, 8, out, len);
+    ref_prf(secret, sizeof(secret), (const unsigned char *)label, strlen(label),
+	    seed, sizeof(seed), seed, 8, ref, len);
+    check(memcmp(out, ref, len) == 0, "PRF differs from the previous implementation");
+  }
+}
+
+typedef size_t (*prf_func)(const unsigned char *key, size_t keylen,
+			   const unsigned char *label, size_t labellen,
+			   const unsigned char *random1, size_t random1len,
+			   const unsigned char *random2, size_t random2len,
+			   unsigned char *buf, size_t buflen);
+
+static double
+usec(prf_func f, size_t keylen, const char *label,
+     size_t random1len, size_t random2len, size_t buflen) {
+  unsigned char key[48], random[64], buf[128];
+  clock_t start;
+  int i, rounds = 100000;
+
+  memset(key, 0x42, sizeof(key));
+  memset(random, 0x17, sizeof(random));
+
+  start = clock();
+  for (i = 0; i < rounds; i++)
+    f(key, keylen, (const unsigned char *)label, strlen(label),
+      random, random1len, random2len ? random + 32 : NULL, random2len,
+      buf, buflen);
+  return (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / rounds;
+}
+
+static void
+speed(void) {
+  static const struct {
+    const char *what, *label;
+    size_t keylen, random1len, random2len, buflen;
+  } derivations[] = {
+    /* PSK pre-master secret of a 16 byte key: 2 + 16 + 2 + 16 */
+    { "master secret", "master secret", 36, 32, 32, 48 },
+    /* TLS_PSK_WITH_AES_128_CCM_8: 2 * (16 byte key + 4 byte IV) */
+    { "key block", "key expansion", 48, 32, 32, 40 },
+    { "Finished", "client finished", 48, 32, 0, 12 },
+  };
+  size_t i;
+
+  printf("%-14s %10s %10s\n", "dtls_prf()", "us", "before us");
+  for (i = 0; i < sizeof(derivations) / sizeof(derivations[0]); i++)
+    printf("%-14s %10.2f %10.2f\n", derivations[i].what,
+	   usec(dtls_prf, derivations[i].keylen, derivations[i].label,
+		derivations[i].random1len, derivations[i].random2len, derivations[i].buflen),
+	   usec(ref_prf, derivations[i].keylen, derivations[i].label,
+		derivations[i].random1len, derivations[i].random2len, derivations[i].buflen));
+}
+
+int
+main(int argc, char **argv) {
+  test_hmac();
+  test_prf();
+  if (failures) {
+    printf("%d checks FAILED\n", failures);
+    return 1;
+  }
+  printf("RFC 4231, P_SHA256 and reference cross-checks passed\n");
+
+  if (argc < 2 || strcmp(argv[1], "-t") != 0)
+    speed();
+  return 0;
+}
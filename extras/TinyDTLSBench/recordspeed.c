@@ -0,0 +1,273 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2011, 2012, 2013, 2014, 2015 Olaf Bergmann (TZI) and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v. 1.0 which accompanies this distribution.
+ *
+ * The Eclipse Public License is available at http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+/*
+ * Host benchmark for inbound application data records.
+ *
+ * Runs a PSK handshake between two contexts in memory, then feeds
+ * records captured from the client's dtls_write() to the server's
+ * dtls_handle_message(), which is the tinydtls half of
+ * OwlDTLSClient::handleRawData(). Every record must arrive exactly
+ * once. Records per second are reported with the cached last peer
+ * and, for comparison, with the cache cleared before every record,
+ * which is the previous full lookup; both with the one real peer and
+ * with decoy peers in front of it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tinydtls.h"
+#include "dtls.h"
+#include "dtls_debug.h"
+
+#define PAYLOAD_LENGTH 64	/* a small CoAP message */
+#define RECORDS 20000		/* per measurement */
+#define DECOYS 16
+
+typedef struct {
+  size_t length;
+  uint8 data[PAYLOAD_LENGTH + 64];
+} record_t;
+
+static dtls_context_t *client, *server;
+static session_t client_session, server_session;
+
+/* handshake flights in transit, or the records captured from client */
+static record_t *captured;
+static size_t captured_count, captured_max;
+static int capturing;
+
+typedef struct {
+  dtls_context_t *to;
+  record_t record;
+} packet_t;
+
+static packet_t queue[32];
+static int queue_head, queue_tail;
+
+static unsigned long received;
+
+static int
+send_to_peer(dtls_context_t *ctx, session_t *session, uint8 *data, size_t len) {
+  packet_t *p;
+
+  if (len > sizeof(p->record.data))
+    return -1;
+  if (capturing && ctx == client) {
+    if (captured_count < captured_max) {
+      captured[captured_count].length = len;
+      memcpy(captured[captured_count].data, data, len);
+      captured_count++;
+    }
+    return len;
+  }
+  p = &queue[queue_tail];
+  queue_tail = (queue_tail + 1) % (sizeof(queue) / sizeof(queue[0]));
+  p->to = ctx == client ? server : client;
+  p->record.length = len;
+  memcpy(p->record.data, data, len);
+  return len;
+}
+
+static int
+read_from_peer(dtls_context_t *ctx, session_t *session, uint8 *data, size_t len) {
+  if (ctx == server && len == PAYLOAD_LENGTH)
+    received++;
+  return 0;
+}
+
+static int
+get_psk_info(dtls_context_t *ctx, const session_t *session,
+	     dtls_credentials_type_t type,
+	     const unsigned char *id, size_t id_len,
+	     unsigned char *result, size_t result_length) {
+  static const unsigned char identity[] = "recordspeed";
+  static const unsigned char key[] = "0123456789abcdef";
+
+  switch (type) {
+  case DTLS_PSK_HINT:
+    return 0;
+  case DTLS_PSK_IDENTITY:
+    memcpy(result, identity, sizeof(identity) - 1);
+    return sizeof(identity) - 1;
+  case DTLS_PSK_KEY:
+    memcpy(result, key, sizeof(key) - 1);
+    return sizeof(key) - 1;
+  default:
+    return 0;
+  }
+}
+
+static dtls_handler_t handlers = {
+  .write = send_to_peer,
+  .read  = read_from_peer,
+  .get_psk_info = get_psk_info,
+};
+
+static void
+deliver(void) {
+  while (queue_head != queue_tail) {
+    packet_t *p = &queue[queue_head];
+
+    queue_head = (queue_head + 1) % (sizeof(queue) / sizeof(queue[0]));
+    dtls_handle_message(p->to, p->to == server ? &client_session : &server_session,
+			p->record.data, p->record.length);
+  }
+}
+
+static void
+make_session(session_t *session, unsigned short port) {
+  memset(session, 0, sizeof(session_t));
+  session->size = sizeof(session->addr.sin);
+  session->addr.sin.sin_family = AF_INET;
+  session->addr.sin.sin_addr.s_addr = htonl(0x0a000001);
+  session->addr.sin.sin_port = htons(port);
+}
+
+static int
+handshake(void) {
+  dtls_peer_t *peer;
+
+  make_session(&client_session, 20000);
+  make_session(&server_session, 5684);
+  client = dtls_new_context(NULL);
+  server = dtls_new_context(NULL);
+  if (!client || !server)
+    return 0;
+  dtls_set_handler(client, &handlers);
+  dtls_set_handler(server, &handlers);
+
+  dtls_connect(client, &server_session);
+  deliver();
+  peer = dtls_get_peer(server, &client_session);
+  return peer && peer->state == DTLS_STATE_CONNECTED;
+}
+
+/* Client state on the server for sessions that never answer. Each one
+ * is put in front of the real peer in the peer list. */
+static void
+add_decoys(int count) {
+  session_t decoy;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    make_session(&decoy, 30000 + i);
+    dtls_connect(server, &decoy);
+  }
+  queue_head = queue_tail;
+}
+
+static void
+capture(size_t count) {
+  uint8 payload[PAYLOAD_LENGTH];
+  size_t i;
+
+  captured_max = count;
+  captured_count = 0;
+  captured = malloc(count * sizeof(record_t));
+  memset(payload, 0x42, sizeof(payload));
+  capturing = 1;
+  for (i = 0; i < count && captured; i++)
+    dtls_write(client, &server_session, payload, sizeof(payload));
+  capturing = 0;
+}
+
+/* Hands the next count captured records to the server, returns the
+ * records per second. */
+static double
+rate(size_t *next, size_t count, int cached) {
+  clock_t start;
+  size_t i;
+
+  start = clock();
+  for (i = *next; i < *next + count; i++) {
+    if (!cached)
+      server->last_peer = NULL;
+    dtls_handle_message(server, &client_session,
+			captured[i].data, captured[i].length);
+  }
+  *next += count;
+  return count * (double)CLOCKS_PER_SEC / (double)(clock() - start + 1);
+}
+
+/* The lookup alone, in nanoseconds */
+static double
+lookup(int cached) {
+  clock_t start;
+  int i, rounds = 1000000;
+  volatile dtls_peer_t *peer = NULL;
+
+  start = clock();
+  for (i = 0; i < rounds; i++) {
+    if (!cached)
+      server->last_peer = NULL;
+    peer = dtls_get_peer(server, &client_session);
+  }
+  (void)peer;
+  return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / rounds;
+}
+
+int
+main(int argc, char **argv) {
+  int check_only = argc > 1 && strcmp(argv[1], "-t") == 0;
+  size_t records = check_only ? 100 : RECORDS;
+  size_t next = 0;
+  double r[4], l[4];
+  int decoys;
+
+  dtls_init();
+  dtls_set_log_level(DTLS_LOG_WARN);
+
+  if (!handshake()) {
+    printf("FAILED: handshake\n");
+    return 1;
+  }
+  capture(4 * records);
+  if (captured_count != 4 * records) {
+    printf("FAILED: captured %lu of %lu records\n",
+	   (unsigned long)captured_count, (unsigned long)(4 * records));
+    return 1;
+  }
+
+  for (decoys = 0; decoys < 2; decoys++) {
+    if (decoys)
+      add_decoys(DECOYS);
+    r[2 * decoys] = rate(&next, records, 1);
+    r[2 * decoys + 1] = rate(&next, records, 0);
+    l[2 * decoys] = lookup(1);
+    l[2 * decoys + 1] = lookup(0);
+  }
+
+  if (received != 4 * records) {
+    printf("FAILED: %lu of %lu records delivered\n",
+	   received, (unsigned long)(4 * records));
+    return 1;
+  }
+  printf("%lu records of %d bytes delivered once each\n",
+	 received, PAYLOAD_LENGTH);
+
+  if (!check_only) {
+    printf("%-10s %12s %12s %10s %10s\n", "peers",
+	   "records/s", "before", "lookup ns", "before");
+    printf("%-10d %12.0f %12.0f %10.1f %10.1f\n", 1, r[0], r[1], l[0], l[1]);
+    printf("%-10d %12.0f %12.0f %10.1f %10.1f\n", 1 + DECOYS, r[2], r[3], l[2], l[3]);
+  }
+
+  free(captured);
+  dtls_free_context(client);
+  dtls_free_context(server);
+  return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * FILE:	sha2speed.c
+ * AUTHOR:	Aaron D. Gifford - http://www.aarongifford.com/
+ * 
+ * Copyright (c) 2000-2001, Aaron D. Gifford
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTOR(S) ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTOR(S) BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id: sha2speed.c,v 1.1 2001/11/08 00:02:23 adg Exp adg $
+ */
+
+/*
+ * Host benchmark for the SHA-256 transform selected in sha2.h.  It
+ * first hashes every testvectors/vectorNNN.dat, whole and in odd-sized
+ * pieces, against the SHA256 digest in the matching .info file, then
+ * times messages of the sizes DTLS hashes.  Run as
+ * "sha2speed [-t] [<testvector-dir>]"; -t only checks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sha2.h"
+
+#define MAXVECTOR	(512 * 1024)
+
+static const char *transform_name(void) {
+	switch (SHA2_SHA256_TRANSFORM) {
+	case SHA2_TRANSFORM_ROLLED:	return "rolled";
+	case SHA2_TRANSFORM_UNROLLED:	return "unrolled";
+	case SHA2_TRANSFORM_WINDOWED:	return "windowed";
+	}
+	return "unknown";
+}
+
+/* Reads the hex digest on the line after "SHA256:" */
+static int read_digest(const char *path, char *digest) {
+	FILE	*f;
+	char	line[256];
+	int	found = 0;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		return 0;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "SHA256:", 7) == 0) {
+			found = fgets(line, sizeof(line), f) != NULL
+				&& sscanf(line, " %64s", digest) == 1
+				&& strlen(digest) == 64;
+			break;
+		}
+	}
+	fclose(f);
+	return found;
+}
+
+static void hash_pieces(const unsigned char *data, size_t len, size_t piece, char *md) {
+	dtls_sha256_ctx	ctx;
+	size_t		n;
+
+	dtls_sha256_init(&ctx);
+	while (len > 0) {
+		n = len < piece ? len : piece;
+		dtls_sha256_update(&ctx, data, n);
+		data += n;
+		len -= n;
+	}
+	dtls_sha256_end(&ctx, md);
+}
+
+/* Returns the number of failures, or -1 if no vector was found */
+static int check_vectors(const char *dir) {
+	static const size_t pieces[] = { MAXVECTOR, 1, 7, 55, 63, 64, 65, 1000 };
+	static unsigned char data[MAXVECTOR];
+	char		path[1024], expected[65], md[DTLS_SHA256_DIGEST_STRING_LENGTH];
+	FILE		*f;
+	size_t		len, i;
+	int		n, failures = 0;
+
+	for (n = 1; ; n++) {
+		snprintf(path, sizeof(path), "%s/vector%03d.info", dir, n);
+		if (!read_digest(path, expected)) {
+			break;
+		}
+		snprintf(path, sizeof(path), "%s/vector%03d.dat", dir, n);
+		if ((f = fopen(path, "rb")) == NULL) {
+			break;
+		}
+		len = fread(data, 1, sizeof(data), f);
+		fclose(f);
+
+		for (i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+			hash_pieces(data, len, pieces[i], md);
+			if (strcmp(md, expected) != 0) {
+				printf("FAILED: vector%03d (%lu bytes, %lu byte updates)\n",
+				       n, (unsigned long)len, (unsigned long)pieces[i]);
+				failures++;
+				break;
+			}
+		}
+	}
+	if (n == 1) {
+		fprintf(stderr, "no test vectors found in %s\n", dir);
+		return -1;
+	}
+	printf("SHA-256 (%s transform): %d test vectors %s\n", transform_name(),
+	       n - 1, failures ? "FAILED" : "passed");
+	return failures;
+}
+
+/*
+ * Times whole digests: 64 bytes is one DTLS record MAC or PRF block,
+ * a few hundred bytes a handshake message, 16K bulk throughput.
+ */
+static void speed(void) {
+	static const size_t sizes[] = { 16, 64, 256, 1024, 16384 };
+	static unsigned char buf[16384];
+	uint8_t		digest[DTLS_SHA256_DIGEST_LENGTH];
+	dtls_sha256_ctx	ctx;
+	clock_t		start;
+	double		t;
+	size_t		i;
+	long		rounds, r;
+
+	memset(buf, 0xb7, sizeof(buf));
+	printf("%8s %12s %12s %10s\n", "bytes", "us/digest", "ns/byte", "MB/s");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		rounds = (64L * 1024 * 1024) / (long)(sizes[i] + 64);
+		start = clock();
+		for (r = 0; r < rounds; r++) {
+			dtls_sha256_init(&ctx);
+			dtls_sha256_update(&ctx, buf, sizes[i]);
+			dtls_sha256_final(digest, &ctx);
+		}
+		t = (double)(clock() - start) / CLOCKS_PER_SEC;
+		printf("%8lu %12.3f %12.3f %10.1f\n", (unsigned long)sizes[i],
+		       t * 1e6 / rounds, t * 1e9 / rounds / sizes[i],
+		       (double)sizes[i] * rounds / 1048576 / t);
+	}
+}
+
+int main(int argc, char **argv) {
+	const char	*dir = "testvectors";
+	int		check_only = 0, i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0) {
+			check_only = 1;
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "Usage:\t%s [-t] [<testvector-dir>]\n", argv[0]);
+			return 2;
+		} else {
+			dir = argv[i];
+		}
+	}
+
+	if (check_vectors(dir) != 0) {
+		return 1;
+	}
+	if (!check_only) {
+		speed();
+	}
+	return 0;
+}
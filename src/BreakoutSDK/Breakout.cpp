@@ -49,7 +49,14 @@ Breakout::~Breakout() {
   owlModemCLI = 0;
 #endif
 
-  WL_FREE_ALL(&commands, breakout_command_list_t);
+  breakout_batch_t_free(batch);
+
+  breakout_journal_entry_t *entry = 0, *next_entry = 0;
+  WL_FOREACH_SAFE(&journal, entry, next_entry) {
+    if (entry->callback) (entry->callback)(COMMAND_RECEIPT_CANCELED, entry->callback_parameter);
+    WL_DELETE(&journal, entry);
+    WL_FREE(entry, breakout_journal_list_t);
+  }
 }
 
 
@@ -84,6 +91,11 @@ void Breakout::setPollingInterval(uint32_t interval_seconds) {
     polling_interval = BREAKOUT_POLLING_INTERVAL_MINIMUM;
   }
 
+  if (!polling_min_interval)
+    setCurrentPollingInterval(polling_interval, POLLING_INTERVAL_REASON_CONFIGURED);
+  else
+    setAdaptivePolling(true, polling_min_interval);
+
   if (polling_interval == 0) {
     // Cancel polling timer
     next_polling = 0;
@@ -93,11 +105,111 @@ void Breakout::setPollingInterval(uint32_t interval_seconds) {
       // First time - do it soon
       next_polling = 1;  // 0 means disabled
     } else {
-      next_polling = last_polling + polling_interval * 1000;
+      next_polling = last_polling + polling_current_interval * 1000;
     }
   }
 }
 
+void Breakout::setAdaptivePolling(bool enabled, uint32_t min_interval_seconds) {
+  if (!enabled) {
+    polling_min_interval = 0;
+    polling_back_to_back = 0;
+    setCurrentPollingInterval(polling_interval, POLLING_INTERVAL_REASON_CONFIGURED);
+    return;
+  }
+  if (min_interval_seconds < BREAKOUT_POLLING_INTERVAL_MINIMUM) {
+    LOG(L_WARN, "Minimum interval %u seconds less than minimum of %u. Using minimum polling interval.\r\n",
+        min_interval_seconds, BREAKOUT_POLLING_INTERVAL_MINIMUM);
+    min_interval_seconds = BREAKOUT_POLLING_INTERVAL_MINIMUM;
+  }
+  if (polling_interval && min_interval_seconds > polling_interval) min_interval_seconds = polling_interval;
+  polling_min_interval = min_interval_seconds;
+  // Start tight, then back off if idle
+  setCurrentPollingInterval(polling_interval ? polling_min_interval : 0, POLLING_INTERVAL_REASON_COMMAND_RECEIVED);
+}
+
+void Breakout::setPollingIntervalHandler(BreakoutPollingIntervalHandler_f handler) {
+  polling_interval_handler = handler;
+}
+
+uint32_t Breakout::getPollingInterval() {
+  return polling_interval ? polling_current_interval : 0;
+}
+
+polling_interval_reason_e Breakout::getPollingIntervalReason() {
+  return polling_reason;
+}
+
+static const char *polling_interval_reason_text(polling_interval_reason_e reason) {
+  switch (reason) {
+    case POLLING_INTERVAL_REASON_CONFIGURED:
+      return "configured";
+    case POLLING_INTERVAL_REASON_QUEUED_COMMANDS:
+      return "server reported queued Commands";
+    case POLLING_INTERVAL_REASON_COMMAND_RECEIVED:
+      return "Commands received";
+    case POLLING_INTERVAL_REASON_IDLE_BACKOFF:
+      return "idle back-off";
+    default:
+      return "<unknown>";
+  }
+}
+
+/**
+ * Change the interval in use, re-arming the polling timer relative to the last poll.
+ * @param interval_seconds - new interval
+ * @param reason - why it changed
+ */
+void Breakout::setCurrentPollingInterval(uint32_t interval_seconds, polling_interval_reason_e reason) {
+  if (interval_seconds == polling_current_interval && reason == polling_reason) return;
+  LOG(L_INFO, "Polling interval %u -> %u seconds - %s\r\n", polling_current_interval, interval_seconds,
+      polling_interval_reason_text(reason));
+  polling_current_interval = interval_seconds;
+  polling_reason           = reason;
+  if (next_polling > 1 && last_polling != 0) next_polling = last_polling + polling_current_interval * 1000;
+  if (polling_interval_handler) (polling_interval_handler)(interval_seconds, reason);
+}
+
+/**
+ * Adaptive polling policy, applied on each Heartbeats Response:
+ *  - back-to-back polls while the server reports queued Commands, to drain them quickly
+ *  - min interval after Commands were received, as more are likely to follow
+ *  - otherwise double the interval, up to the configured one
+ */
+void Breakout::adaptPollingInterval() {
+  uint32_t interval = 0;
+  if (!polling_min_interval || !polling_interval) return;
+  if (queued_command_count > 0 && polling_back_to_back < BREAKOUT_POLLING_BACK_TO_BACK_MAX) {
+    polling_back_to_back++;
+    setCurrentPollingInterval(BREAKOUT_POLLING_BACK_TO_BACK_INTERVAL, POLLING_INTERVAL_REASON_QUEUED_COMMANDS);
+  } else if (queued_command_count > 0 || polling_commands_received > 0) {
+    polling_back_to_back = 0;
+    setCurrentPollingInterval(polling_min_interval, POLLING_INTERVAL_REASON_COMMAND_RECEIVED);
+  } else {
+    polling_back_to_back = 0;
+    interval             = polling_current_interval * 2;
+    if (interval < polling_min_interval) interval = polling_min_interval;
+    if (interval > polling_interval) interval = polling_interval;
+    setCurrentPollingInterval(interval, POLLING_INTERVAL_REASON_IDLE_BACKOFF);
+  }
+  polling_commands_received = 0;
+}
+
+void Breakout::setCommandPushEnabled(bool enabled) {
+  if (enabled == observe_enabled) return;
+  observe_enabled = enabled;
+  if (enabled) {
+    // Register soon - will be triggered in spin()
+    observe_next_registration = 1;
+  } else {
+    if (observe_active && !registerCommandPush(true)) LOG(L_WARN, "Error de-registering from pushed Commands\r\n");
+    // Later notifications will get a RST, as the token is forgotten
+    observe_active            = false;
+    observe_token_length      = 0;
+    observe_next_registration = 0;
+  }
+}
+
 bool Breakout::setPSKKey(char const *hex_key) {
   if (owlModem != 0) {
     LOG(L_ERR, "Can only set PSK-Key before initialization\r\n");
@@ -202,6 +314,8 @@ bool Breakout::initCoAPPeer() {
 
 #if TESTING_WITH_DTLS == 0
   coapPeer = owl_new CoAPPeer(owlModem, 0, remote_ip, 5683);
+#elif TESTING_WITH_DTLS == 2
+  coapPeer = owl_new CoAPPeer(owlModem, CoAP_Transport__Modem_DTLS_PSK, psk_id, psk_key, 0, remote_ip, 5684);
 #else
   coapPeer = owl_new CoAPPeer(owlModem, psk_id, psk_key, 0, remote_ip, 5684);
 #endif
@@ -209,7 +323,8 @@ bool Breakout::initCoAPPeer() {
 
   coapPeer->setHandlers(Breakout::handler_CoAPStatelessMessage, Breakout::handler_CoAPDTLSEvent,
                         Breakout::handler_CoAPRequest, Breakout::handler_CoAPResponse);
-  if (!coapPeer->reinitialize()) GOTOERR(error);
+  coapPeer->setFastRequestHandler(Breakout::handler_CoAPFastRequest);
+  if (!startTransport()) GOTOERR(error);
 
   LOG(L_NOTICE, ".. CoAPPeer - waiting for transport to be ready (DTLS handshake)\r\n");
   timeout = owl_time() + BREAKOUT_INIT_CONNECTION_TIMEOUT * 1000;
@@ -248,6 +363,9 @@ bool Breakout::initCoAPPeer() {
     coap_status = true;
     notifyConnectionStatusChanged();
   }
+  // The Commands push registration is tied to the old session, so register again
+  observe_active = false;
+  if (observe_enabled) observe_next_registration = 1;
   return true;
 error:
   LOG(L_ERR, "... CoAP Peer was not initialized correctly.\r\n");
@@ -288,13 +406,77 @@ bool Breakout::powerModuleOff(void) {
   if (!isPowered()) return true;
 
   eps_registration_status = AT_CEREG__Stat__Not_Registered;
-  // Should we not keep the CoAP peer up?
-  //  coapPeer->close();
-  //  delete coapPeer;
-  //  coapPeer = 0;
+  // Keep the DTLS session, to restore it at power on, instead of a new handshake
+  if (coapPeer && coapPeer->transportIsReady()) {
+    transport_session_len = coapPeer->saveTransportSession(transport_session, DTLS_SESSION_STATE_MAX_LENGTH);
+    if (transport_session_len) LOG(L_INFO, "Saved the DTLS session, to restore at power on\r\n");
+  }
   return owlModem->powerOff() != 0;
 }
 
+int Breakout::saveTransportSession(uint8_t *buf, int buf_len) {
+  int len = transport_session_len;
+  if (!len) {
+    LOG(L_WARN, "No DTLS session saved - call this after powerModuleOff()\r\n");
+    return 0;
+  }
+  if (buf_len < len) {
+    LOG(L_ERR, "Buffer too small for the saved DTLS session %d < %d\r\n", buf_len, len);
+    return 0;
+  }
+  // Hand it over, such that it is not restored twice
+  memcpy(buf, transport_session, len);
+  memset(transport_session, 0, sizeof(transport_session));
+  transport_session_len = 0;
+  return len;
+}
+
+void Breakout::setTransportSessionStoreHandler(BreakoutTransportSessionStoreHandler_f handler) {
+  transport_session_store_handler = handler;
+}
+
+bool Breakout::restoreTransportSession(const uint8_t *state, int state_len) {
+  if (state_len <= 0 || state_len > DTLS_SESSION_STATE_MAX_LENGTH) {
+    LOG(L_ERR, "Bad saved DTLS session length %d\r\n", state_len);
+    return false;
+  }
+  if (!transport_session_store_handler) {
+    LOG(L_ERR, "No handler to store the saved DTLS session - see setTransportSessionStoreHandler()\r\n");
+    return false;
+  }
+  // Reserved, then stored in place of the given one, before it can be restored - never the other way around
+  memcpy(transport_session, state, state_len);
+  if (!OwlDTLSClient::reserveSession(transport_session, state_len)) {
+    LOG(L_ERR, "Saved DTLS session not valid\r\n");
+    goto error;
+  }
+  if (!(transport_session_store_handler)(transport_session, state_len)) {
+    LOG(L_WARN, "Saved DTLS session with the reserved record sequence numbers not stored - not restoring it\r\n");
+    goto error;
+  }
+  transport_session_len = state_len;
+  return true;
+error:
+  memset(transport_session, 0, sizeof(transport_session));
+  transport_session_len = 0;
+  return false;
+}
+
+/**
+ * Start the transport, by restoring the saved session if any, otherwise with a new DTLS handshake
+ * @return true on success, false on failure
+ */
+bool Breakout::startTransport() {
+  int len = transport_session_len;
+  if (!len) return coapPeer->reinitialize() != 0;
+
+  // Restore only once - the record sequence numbers must never be reused
+  transport_session_len = 0;
+  int res = coapPeer->restoreTransportSession(transport_session, len);
+  memset(transport_session, 0, sizeof(transport_session));
+  return res != 0;
+}
+
 connection_status_e Breakout::getConnectionStatus() {
   connection_status_e status = CONNECTION_STATUS_OFFLINE;
   switch (eps_registration_status) {
@@ -326,7 +508,7 @@ bool Breakout::reinitializeTransport() {
   owl_time_t timeout = 0;
   int retries        = BREAKOUT_INIT_CONNECTION_RETRIES;
 
-  if (!coapPeer->reinitialize()) GOTOERR(error);
+  if (!startTransport()) GOTOERR(error);
 
   LOG(L_NOTICE, ".. CoAPPeer - waiting for transport to be ready (DTLS handshake)\r\n");
   timeout = owl_time() + BREAKOUT_INIT_CONNECTION_TIMEOUT * 1000;
@@ -365,6 +547,9 @@ bool Breakout::reinitializeTransport() {
     coap_status = true;
     notifyConnectionStatusChanged();
   }
+  // The Commands push registration is tied to the old session, so register again
+  observe_active = false;
+  if (observe_enabled) observe_next_registration = 1;
   return true;
 error:
   LOG(L_ERR, "... CoAP Peer was not re-initialized correctly.\r\n");
@@ -380,8 +565,29 @@ error:
 /*                      Main Functionality Loop                                */
 
 void Breakout::spin() {
+  /* Packing the CoAP messages of this iteration (ACKs, receipts, requests) into as few datagrams as possible */
+  if (coapPeer) coapPeer->beginTransportBatch();
+
   /* Triggering polling on interval expiration */
-  if (next_polling != 0 && next_polling <= owl_time()) checkForCommands();
+  if (next_polling != 0 && next_polling <= owl_time()) checkForCommands(false, true);
+
+  /* Draining the queued Commands reported on responses to sent Commands - not more often than back-to-back polls */
+  if (polling_drain_requested && owl_time() >= last_polling + BREAKOUT_POLLING_BACK_TO_BACK_INTERVAL * 1000) {
+    polling_drain_requested = false;
+    checkForCommands(false, true, true);
+  }
+
+  /* Sending Commands from the journal, on reconnection, in bursts */
+  drainCommandJournal();
+  if (journal_dirty) storeCommandJournal();
+
+  /* Sending the batch of Commands on deadline */
+  if (batch && batch->deadline <= owl_time()) flushCommands();
+
+  /* Triggering the (re-)registration for pushed Commands */
+  if (observe_enabled && observe_next_registration != 0 && observe_next_registration <= owl_time() &&
+      getConnectionStatus() == CONNECTION_STATUS_REGISTERED_AND_CONNECTED && coapPeer->transportIsReady())
+    registerCommandPush(false);
 
   /* Take care of async modem events */
   owlModem->handleRxOnTimer();
@@ -392,6 +598,9 @@ void Breakout::spin() {
   /* Take care of CoAP (and also tinydtls) retransmissions */
   CoAPPeer::triggerPeriodicRetransmit();
 
+  /* Sending out what was collected in this iteration */
+  if (coapPeer) coapPeer->flushTransportBatch();
+
 #if TESTING_WITH_CLI == 1
   /* Enable also CLI, for intermediary testing */
   if (!owlModemCLI) owlModemCLI = owl_new OwlModemCLI(owlModem, &SerialDebugPort);
@@ -411,41 +620,69 @@ command_status_code_e Breakout::sendBinaryCommand(const char *buf, size_t bufSiz
   return sendCommand(payload, true);
 }
 
+bool Breakout::addCommandRequestOptions(CoAPMessage *request, uint64_t content_format) {
+  if (!request->addOptionUriPath((char *)"v1")) {
+    LOG(L_ERR, "Error adding UriPath\r\n");
+    return false;
+  }
+  if (!request->addOptionUriPath((char *)"Commands")) {
+    LOG(L_ERR, "Error adding UriPath\r\n");
+    return false;
+  }
+  if (!request->addOptionUriQuery(iccid)) {
+    LOG(L_ERR, "Error adding UriQuery\r\n");
+    return false;
+  }
+  if (!request->addOptionContentFormat(content_format)) {
+    LOG(L_ERR, "Error adding ContentFormat\r\n");
+    return false;
+  }
+  if (!request->addOptionTwilioHostDeviceInformation(owlModem->getShortHostDeviceInformation())) {
+    LOG(L_ERR, "Error adding Twilio-HostDevice-Information\r\n");
+    return false;
+  }
+  return true;
+}
+
 command_status_code_e Breakout::sendCommand(str cmd, bool isBinary) {
+  command_status_code_e status;
+  if (useCommandJournal(cmd)) return addCommandToJournal(cmd, isBinary, false, 0, 0);
+  status = sendCommandNow(cmd, isBinary);
+  if (status == COMMAND_STATUS_BUSY && fitsInCommandJournal(cmd))
+    return addCommandToJournal(cmd, isBinary, false, 0, 0);
+  return status;
+}
+
+command_status_code_e Breakout::sendCommandNow(str cmd, bool isBinary) {
   if (getConnectionStatus() != CONNECTION_STATUS_REGISTERED_AND_CONNECTED) {
     LOG(L_ERR, "Current Connection-Status is offline - please try again later\r\n");
     return COMMAND_STATUS_ERROR;
   }
-  if (cmd.len > 140) {
-    LOG(L_ERR, "Command of %d bytes longer than maximum acceptable of 140 bytes\r\n", cmd.len);
+  if (batch_max_delay && fitsInBatch(cmd)) return addCommandToBatch(cmd, isBinary, 0, 0);
+  if (cmd.len > BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE) {
+    LOG(L_ERR, "Command of %d bytes longer than maximum acceptable of %d bytes\r\n", cmd.len,
+        BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE);
     return COMMAND_STATUS_COMMAND_TOO_LONG;
   }
+  if (cmd.len > BREAKOUT_COMMAND_MAX_SIZE && (coapPeer->isBlockwiseTxFull() || coapPeer->isSendQueueFull())) {
+    LOG(L_WARN, "Too many Commands waiting for delivery - please spin() and try again\r\n");
+    return COMMAND_STATUS_BUSY;
+  }
 
   CoAPMessage request = CoAPMessage(CoAP_Type__Non_Confirmable, CoAP_Code_Class__Request,
                                     CoAP_Code_Detail__Request__POST, coapPeer->getNextMessageId());
-  if (!request.addOptionUriPath("v1")) {
-    LOG(L_ERR, "Error adding UriPath\r\n");
-    goto error;
-  }
-  if (!request.addOptionUriPath("Commands")) {
-    LOG(L_ERR, "Error adding UriPath\r\n");
+  if (!addCommandRequestOptions(&request, isBinary ? CoAP_Content_Format__application_octet_stream :
+                                                     CoAP_Content_Format__text_plain_charset_utf8))
     goto error;
-  }
-  if (!request.addOptionUriQuery(iccid)) {
-    LOG(L_ERR, "Error adding UriQuery\r\n");
-    goto error;
-  }
-  if (!request.addOptionContentFormat(isBinary ? CoAP_Content_Format__application_octet_stream :
-                                                 CoAP_Content_Format__text_plain_charset_utf8)) {
-    LOG(L_ERR, "Error adding ContentFormat\r\n");
-    goto error;
-  }
-  if (!request.addOptionTwilioHostDeviceInformation(owlModem->getShortHostDeviceInformation())) {
-    LOG(L_ERR, "Error adding Twilio-HostDevice-Information\r\n");
-    goto error;
-  }
   request.payload = cmd;
-  if (!coapPeer->sendUnreliably(&request)) {
+  if (cmd.len > BREAKOUT_COMMAND_MAX_SIZE) {
+    /* Blocks are always sent reliably, as the server needs all of them to reassemble the Command */
+    request.type = CoAP_Type__Confirmable;
+    if (!coapPeer->sendReliablyBlockwise(&request, 0, 0, 0, BREAKOUT_COMMAND_BLOCK_SZX)) {
+      LOG(L_ERR, "Error sending request block-wise\r\n");
+      goto error;
+    }
+  } else if (!coapPeer->sendUnreliably(&request)) {
     LOG(L_ERR, "Error sending request unreliably\r\n");
     goto error;
   }
@@ -477,65 +714,62 @@ typedef struct {
   void *callback_parameter;
 } receipt_t;
 
-void Breakout::callback_commandReceipt(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
-                                       coap_client_transaction_event_e event, CoAPMessage *message) {
-  if (!cb_param) return;
-  receipt_t *receipt = (receipt_t *)cb_param;
-  command_receipt_code_e receipt_code;
+static command_receipt_code_e receiptCodeFromEvent(coap_client_transaction_event_e event) {
   switch (event) {
     case CoAP_Client_Transaction_Event__ACK:
-      receipt_code = COMMAND_RECEIPT_CONFIRMED_DELIVERY;
-      break;
+      return COMMAND_RECEIPT_CONFIRMED_DELIVERY;
     case CoAP_Client_Transaction_Event__Canceled:
-      receipt_code = COMMAND_RECEIPT_CANCELED;
-      break;
+      return COMMAND_RECEIPT_CANCELED;
     case CoAP_Client_Transaction_Event__Timeout:
-      receipt_code = COMMAND_RECEIPT_TIMEOUT;
-      break;
+      return COMMAND_RECEIPT_TIMEOUT;
     case CoAP_Client_Transaction_Event__RST:
     default:
-      receipt_code = COMMAND_RECEIPT_SERVER_ERROR;
-      break;
+      return COMMAND_RECEIPT_SERVER_ERROR;
   }
+}
+
+void Breakout::callback_commandReceipt(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
+                                       coap_client_transaction_event_e event, CoAPMessage *message) {
+  if (!cb_param) return;
+  receipt_t *receipt                  = (receipt_t *)cb_param;
+  command_receipt_code_e receipt_code = receiptCodeFromEvent(event);
   if (receipt->callback) (receipt->callback)(receipt_code, receipt->callback_parameter);
   owl_free(receipt);
 }
 
 command_status_code_e Breakout::sendCommandWithReceiptRequest(str cmd, BreakoutCommandReceiptCallback_f callback,
                                                               void *callback_parameter, bool isBinary) {
+  command_status_code_e status;
+  if (useCommandJournal(cmd)) return addCommandToJournal(cmd, isBinary, true, callback, callback_parameter);
+  status = sendCommandWithReceiptRequestNow(cmd, callback, callback_parameter, isBinary);
+  if (status == COMMAND_STATUS_BUSY && fitsInCommandJournal(cmd))
+    return addCommandToJournal(cmd, isBinary, true, callback, callback_parameter);
+  return status;
+}
+
+command_status_code_e Breakout::sendCommandWithReceiptRequestNow(str cmd, BreakoutCommandReceiptCallback_f callback,
+                                                                 void *callback_parameter, bool isBinary) {
   receipt_t *receipt = 0;
   if (getConnectionStatus() != CONNECTION_STATUS_REGISTERED_AND_CONNECTED) {
     LOG(L_ERR, "Current Connection-Status is offline - please try again later\r\n");
     return COMMAND_STATUS_ERROR;
   }
-  if (cmd.len > 140) {
-    LOG(L_ERR, "Command of %d bytes longer than maximum acceptable of 140 bytes\r\n", cmd.len);
+  if (batch_max_delay && fitsInBatch(cmd)) return addCommandToBatch(cmd, isBinary, callback, callback_parameter);
+  if (cmd.len > BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE) {
+    LOG(L_ERR, "Command of %d bytes longer than maximum acceptable of %d bytes\r\n", cmd.len,
+        BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE);
     return COMMAND_STATUS_COMMAND_TOO_LONG;
   }
+  if (coapPeer->isSendQueueFull() || (cmd.len > BREAKOUT_COMMAND_MAX_SIZE && coapPeer->isBlockwiseTxFull())) {
+    LOG(L_WARN, "Too many Commands waiting for delivery - please spin() and try again\r\n");
+    return COMMAND_STATUS_BUSY;
+  }
 
   CoAPMessage request = CoAPMessage(CoAP_Type__Confirmable, CoAP_Code_Class__Request, CoAP_Code_Detail__Request__POST,
                                     coapPeer->getNextMessageId());
-  if (!request.addOptionUriPath("v1")) {
-    LOG(L_ERR, "Error adding UriPath\r\n");
-    goto error;
-  }
-  if (!request.addOptionUriPath("Commands")) {
-    LOG(L_ERR, "Error adding UriPath\r\n");
-    goto error;
-  }
-  if (!request.addOptionUriQuery(iccid)) {
-    LOG(L_ERR, "Error adding UriQuery\r\n");
-    goto error;
-  }
-  if (!request.addOptionContentFormat(isBinary ? CoAP_Content_Format__application_octet_stream :
-                                                 CoAP_Content_Format__text_plain_charset_utf8)) {
-    LOG(L_ERR, "Error adding ContentFormat\r\n");
-    goto error;
-  }
-  if (!request.addOptionTwilioHostDeviceInformation(owlModem->getShortHostDeviceInformation())) {
-    LOG(L_ERR, "Error adding Twilio-HostDevice-Information\r\n");
+  if (!addCommandRequestOptions(&request, isBinary ? CoAP_Content_Format__application_octet_stream :
+                                                     CoAP_Content_Format__text_plain_charset_utf8))
     goto error;
-  }
   request.payload = cmd;
 
   if (callback) {
@@ -544,7 +778,12 @@ command_status_code_e Breakout::sendCommandWithReceiptRequest(str cmd, BreakoutC
     receipt->callback           = callback;
     receipt->callback_parameter = callback_parameter;
   }
-  if (!coapPeer->sendReliably(&request, callback_commandReceipt, receipt)) {
+  if (cmd.len > BREAKOUT_COMMAND_MAX_SIZE) {
+    if (!coapPeer->sendReliablyBlockwise(&request, callback_commandReceipt, receipt, 0, BREAKOUT_COMMAND_BLOCK_SZX)) {
+      LOG(L_ERR, "Error sending request block-wise\r\n");
+      goto error;
+    }
+  } else if (!coapPeer->sendReliably(&request, callback_commandReceipt, receipt)) {
     LOG(L_ERR, "Error sending request unreliably\r\n");
     goto error;
   }
@@ -558,6 +797,377 @@ error:
   return COMMAND_STATUS_ERROR;
 }
 
+/*                      Batching of sent Commands                                */
+
+/**
+ * CBOR (RFC7049) header for a text or byte string of the given length
+ * @param dst - buffer of at least 3 bytes
+ * @param major_type - 2 for byte string, 3 for text string
+ * @param len - length of the string - max 65535
+ * @return the number of bytes written
+ */
+static int cborStringHeader(uint8_t *dst, uint8_t major_type, uint32_t len) {
+  if (len < 24) {
+    dst[0] = (major_type << 5) | len;
+    return 1;
+  }
+  if (len <= 0xFFu) {
+    dst[0] = (major_type << 5) | 24;
+    dst[1] = len;
+    return 2;
+  }
+  dst[0] = (major_type << 5) | 25;
+  dst[1] = (len >> 8) & 0xFFu;
+  dst[2] = len & 0xFFu;
+  return 3;
+}
+
+#define CBOR_ARRAY_INDEFINITE 0x9F
+#define CBOR_BREAK 0xFF
+
+void Breakout::setCommandBatching(uint32_t max_delay_ms, size_t max_bytes) {
+  // A batch still pending keeps its own capacity, so the new size applies from the next batch on
+  if (batch) flushCommands();
+  if (max_bytes > BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE) {
+    LOG(L_WARN, "Batch size %u larger than maximum %u - using the maximum\r\n", max_bytes,
+        BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE);
+    max_bytes = BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE;
+  }
+  batch_max_delay = max_delay_ms;
+  batch_max_bytes = max_bytes;
+}
+
+bool Breakout::fitsInBatch(str cmd) {
+  // array header + string header + Command + break
+  return (size_t)(1 + 3 + cmd.len + 1) <= batch_max_bytes;
+}
+
+command_status_code_e Breakout::addCommandToBatch(str cmd, bool isBinary, BreakoutCommandReceiptCallback_f callback,
+                                                  void *callback_parameter) {
+  uint8_t header[3];
+  int header_len = cborStringHeader(header, isBinary ? 2 : 3, cmd.len);
+  command_status_code_e status;
+
+  /* No room left - send out the current one first */
+  if (batch && (batch->payload.len + header_len + cmd.len + 1 > batch->capacity ||
+                batch->count >= BREAKOUT_BATCH_MAX_COMMANDS ||
+                (callback && batch->receipts_count >= BREAKOUT_BATCH_MAX_COMMANDS))) {
+    status = flushCommands();
+    if (status != COMMAND_STATUS_OK) return status;
+  }
+
+  if (!batch) {
+    batch = (breakout_batch_t *)owl_malloc(sizeof(breakout_batch_t));
+    if (!batch) goto out_of_memory;
+    bzero(batch, sizeof(breakout_batch_t));
+    batch->payload.s = (char *)owl_malloc(batch_max_bytes);
+    if (!batch->payload.s) goto out_of_memory;
+    batch->capacity                        = (int)batch_max_bytes;
+    batch->payload.s[batch->payload.len++] = CBOR_ARRAY_INDEFINITE;
+    batch->deadline                        = owl_time() + batch_max_delay;
+  }
+
+  memcpy(batch->payload.s + batch->payload.len, header, header_len);
+  batch->payload.len += header_len;
+  memcpy(batch->payload.s + batch->payload.len, cmd.s, cmd.len);
+  batch->payload.len += cmd.len;
+  batch->count++;
+  if (callback) {
+    batch->receipts[batch->receipts_count].callback           = callback;
+    batch->receipts[batch->receipts_count].callback_parameter = callback_parameter;
+    batch->receipts_count++;
+  }
+  LOG(L_DBG, "Command of %d bytes added to batch - now %d Commands in %d bytes\r\n", cmd.len, batch->count,
+      batch->payload.len);
+
+  /* Full - no need to wait for the deadline */
+  if (batch->payload.len + 1 + 1 >= batch->capacity) {
+    status = flushCommands();
+    // The Command is in the batch, which is retried later, so this is not a failure of this Command
+    if (status == COMMAND_STATUS_BUSY) return COMMAND_STATUS_OK;
+    return status;
+  }
+  return COMMAND_STATUS_OK;
+out_of_memory:
+  LOG(L_ERR, "Error allocating the batch\r\n");
+  breakout_batch_t_free(batch);
+  return COMMAND_STATUS_ERROR;
+}
+
+void Breakout::callback_batchReceipt(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
+                                     coap_client_transaction_event_e event, CoAPMessage *message) {
+  if (!cb_param) return;
+  breakout_batch_t *sent              = (breakout_batch_t *)cb_param;
+  command_receipt_code_e receipt_code = receiptCodeFromEvent(event);
+  LOG(L_INFO, "Batch of %d Commands - receipt %d\r\n", sent->count, receipt_code);
+  for (int i = 0; i < sent->receipts_count; i++)
+    if (sent->receipts[i].callback) (sent->receipts[i].callback)(receipt_code, sent->receipts[i].callback_parameter);
+  breakout_batch_t_free(sent);
+}
+
+command_status_code_e Breakout::flushCommands() {
+  CoAPMessage request;
+  int sent = 0;
+  if (!batch) return COMMAND_STATUS_OK;
+  if (getConnectionStatus() != CONNECTION_STATUS_REGISTERED_AND_CONNECTED) {
+    LOG(L_WARN, "Current Connection-Status is offline - keeping the batch of %d Commands for later\r\n", batch->count);
+    batch->deadline = owl_time() + 5 * 1000;
+    return COMMAND_STATUS_ERROR;
+  }
+  if ((batch->receipts_count && coapPeer->isSendQueueFull()) ||
+      (batch->payload.len + 1 > BREAKOUT_COMMAND_MAX_SIZE && coapPeer->isBlockwiseTxFull())) {
+    LOG(L_WARN, "Too many Commands waiting for delivery - keeping the batch of %d Commands for later\r\n", batch->count);
+    /* Give the pending ones a chance to be acknowledged, instead of retrying on each spin() */
+    batch->deadline = owl_time() + 1000;
+    return COMMAND_STATUS_BUSY;
+  }
+
+  /* Without receipts, the batch goes out as NON, like a single Command would */
+  request = CoAPMessage(batch->receipts_count ? CoAP_Type__Confirmable : CoAP_Type__Non_Confirmable,
+                        CoAP_Code_Class__Request, CoAP_Code_Detail__Request__POST, coapPeer->getNextMessageId());
+  if (!addCommandRequestOptions(&request, CoAP_Content_Format__application_cbor)) goto error;
+  batch->payload.s[batch->payload.len++] = CBOR_BREAK;
+  request.payload                        = batch->payload;
+
+  if (request.payload.len > BREAKOUT_COMMAND_MAX_SIZE) {
+    request.type = CoAP_Type__Confirmable;
+    sent         = coapPeer->sendReliablyBlockwise(&request, batch->receipts_count ? callback_batchReceipt : 0,
+                                           batch->receipts_count ? batch : 0, 0, BREAKOUT_COMMAND_BLOCK_SZX);
+  } else if (batch->receipts_count) {
+    sent = coapPeer->sendReliably(&request, callback_batchReceipt, batch);
+  } else {
+    sent = coapPeer->sendUnreliably(&request);
+  }
+  if (!sent) {
+    LOG(L_ERR, "Error sending the batch of %d Commands\r\n", batch->count);
+    batch->payload.len--;  // re-open the array
+    goto error;
+  }
+  LOG(L_INFO, "Sent a batch of %d Commands in %d bytes\r\n", batch->count, request.payload.len);
+
+  /* The payload was copied by the CoAPPeer, the receipts are owned by the callback from now on */
+  str_free(batch->payload);
+  if (!batch->receipts_count) breakout_batch_t_free(batch);
+  batch = 0;
+  request.destroy();
+  return COMMAND_STATUS_OK;
+error:
+  /* Keep the batch and retry later - to avoid hammering this on errors */
+  batch->deadline = owl_time() + 5 * 1000;
+  request.destroy();
+  return COMMAND_STATUS_ERROR;
+}
+
+
+
+/*                      Journal of Commands waiting to be sent                                */
+
+void Breakout::setCommandJournal(int max_commands, size_t max_bytes, int burst_size, uint32_t burst_interval_ms) {
+  if (max_commands < 0) max_commands = 0;
+  if (burst_size < 1) burst_size = 1;
+  journal.space_left += max_commands - journal_max_commands;
+  journal_max_commands   = max_commands;
+  journal_max_bytes      = max_bytes;
+  journal_burst_size     = burst_size;
+  journal_burst_interval = burst_interval_ms;
+}
+
+void Breakout::setCommandJournalStoreHandler(BreakoutJournalStoreHandler_f handler) {
+  journal_store_handler = handler;
+  journal_dirty         = true;
+}
+
+void Breakout::getCommandJournalStats(breakout_journal_stats_t *out_stats) {
+  breakout_journal_entry_t *entry = 0;
+  if (!out_stats) return;
+  *out_stats            = journal_stats;
+  out_stats->depth      = 0;
+  out_stats->bytes      = journal.bytes;
+  out_stats->oldest_age = journal.head ? owl_time() - journal.head->accepted : 0;
+  WL_FOREACH(&journal, entry) {
+    out_stats->depth++;
+  }
+}
+
+bool Breakout::fitsInCommandJournal(str cmd) {
+  if (!journal_max_commands) return false;
+  /* Larger than the whole journal - it would only evict everything else, and still not fit */
+  return cmd.len <= BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE && (size_t)cmd.len <= journal_max_bytes;
+}
+
+bool Breakout::useCommandJournal(str cmd) {
+  if (!fitsInCommandJournal(cmd)) return false;
+  /* Keep the order - once something is waiting, everything new waits behind it */
+  return !WL_EMPTY(&journal) || getConnectionStatus() != CONNECTION_STATUS_REGISTERED_AND_CONNECTED;
+}
+
+command_status_code_e Breakout::addCommandToJournal(str cmd, bool isBinary, bool withReceipt,
+                                                    BreakoutCommandReceiptCallback_f callback,
+                                                    void *callback_parameter) {
+  breakout_journal_entry_t *entry = 0;
+  int depth                       = 0;
+
+  /* Full - drop the oldest, to make room for the newest, like for received Commands */
+  while (journal.head && (journal.space_left <= 0 || journal.bytes + cmd.len > journal_max_bytes)) {
+    entry = journal.head;
+    LOG(L_WARN, "Journal full - dropping the oldest Command of %d bytes, waiting for %u ms\r\n", entry->command.len,
+        (uint32_t)(owl_time() - entry->accepted));
+    WL_DELETE(&journal, entry);
+    journal.space_left++;
+    journal.bytes -= entry->command.len;
+    journal_stats.dropped_count++;
+    journal_dirty = true;
+    if (entry->callback) (entry->callback)(COMMAND_RECEIPT_CANCELED, entry->callback_parameter);
+    WL_FREE(entry, breakout_journal_list_t);
+  }
+
+  WL_NEW(entry, breakout_journal_list_t);
+  str_dup(entry->command, cmd);
+  entry->isBinary           = isBinary;
+  entry->withReceipt        = withReceipt;
+  entry->callback           = callback;
+  entry->callback_parameter = callback_parameter;
+  entry->accepted           = owl_time();
+  WL_APPEND(&journal, entry);
+  journal.space_left--;
+  journal.bytes += cmd.len;
+  journal_dirty = true;
+
+  journal_stats.accepted_count++;
+  depth = journal_max_commands - journal.space_left;
+  if (depth > journal_stats.max_depth) journal_stats.max_depth = depth;
+  LOG(L_INFO, "Command of %d bytes accepted in the journal - %d Commands waiting\r\n", cmd.len, depth);
+  return COMMAND_STATUS_OK;
+out_of_memory:
+  WL_FREE(entry, breakout_journal_list_t);
+  return COMMAND_STATUS_ERROR;
+}
+
+void Breakout::drainCommandJournal() {
+  breakout_journal_entry_t *entry = 0;
+  command_status_code_e status;
+  owl_time_t now = owl_time();
+  if (WL_EMPTY(&journal) || journal_next_burst > now) return;
+  if (getConnectionStatus() != CONNECTION_STATUS_REGISTERED_AND_CONNECTED) return;
+  journal_next_burst = now + journal_burst_interval;
+
+  for (int i = 0; i < journal_burst_size && journal.head; i++) {
+    entry = journal.head;
+    if (entry->withReceipt)
+      status = sendCommandWithReceiptRequestNow(entry->command, entry->callback, entry->callback_parameter,
+                                                entry->isBinary);
+    else
+      status = sendCommandNow(entry->command, entry->isBinary);
+    if (status == COMMAND_STATUS_BUSY) {
+      LOG(L_DBG, "Congestion window full - continuing the journal drain on the next burst\r\n");
+      break;
+    }
+    if (status == COMMAND_STATUS_ERROR && ++entry->attempts < BREAKOUT_JOURNAL_MAX_ATTEMPTS) {
+      LOG(L_WARN, "Error sending Command from the journal - retrying on the next burst\r\n");
+      break;
+    }
+    WL_DELETE(&journal, entry);
+    journal.space_left++;
+    journal.bytes -= entry->command.len;
+    journal_dirty = true;
+    if (status == COMMAND_STATUS_OK) {
+      journal_stats.sent_count++;
+      if (now - entry->accepted > journal_stats.max_delay) journal_stats.max_delay = now - entry->accepted;
+    } else {
+      /* Permanent error, or too many attempts - dropped, else it would hold back all the others */
+      LOG(L_ERR, "Error %d sending Command of %d bytes from the journal - dropping it\r\n", status,
+          entry->command.len);
+      journal_stats.dropped_count++;
+      if (entry->callback) (entry->callback)(COMMAND_RECEIPT_CANCELED, entry->callback_parameter);
+    }
+    WL_FREE(entry, breakout_journal_list_t);
+  }
+}
+
+/*
+ * Journal image: 'B' 'J' version count[2], then for each Command: flags[1] length[2] Command[length] - network order
+ */
+#define BREAKOUT_JOURNAL_IMAGE_HEADER_SIZE 5
+#define BREAKOUT_JOURNAL_IMAGE_FLAG_BINARY 0x01
+#define BREAKOUT_JOURNAL_IMAGE_FLAG_RECEIPT 0x02
+
+void Breakout::storeCommandJournal() {
+  breakout_journal_entry_t *entry = 0;
+  uint8_t *image                  = 0;
+  size_t len                      = BREAKOUT_JOURNAL_IMAGE_HEADER_SIZE;
+  int count                       = 0;
+  journal_dirty                   = false;
+  if (!journal_store_handler) return;
+
+  WL_FOREACH(&journal, entry) {
+    len += 3 + entry->command.len;
+    count++;
+  }
+  image = (uint8_t *)owl_malloc(len);
+  if (!image) {
+    LOG(L_ERR, "Error allocating %d bytes for the journal image - retrying later\r\n", len);
+    journal_dirty = true;
+    return;
+  }
+  image[0] = 'B';
+  image[1] = 'J';
+  image[2] = BREAKOUT_JOURNAL_IMAGE_VERSION;
+  image[3] = (count >> 8) & 0xFFu;
+  image[4] = count & 0xFFu;
+  len      = BREAKOUT_JOURNAL_IMAGE_HEADER_SIZE;
+  WL_FOREACH(&journal, entry) {
+    image[len++] = (entry->isBinary ? BREAKOUT_JOURNAL_IMAGE_FLAG_BINARY : 0) |
+                   (entry->withReceipt ? BREAKOUT_JOURNAL_IMAGE_FLAG_RECEIPT : 0);
+    image[len++] = (entry->command.len >> 8) & 0xFFu;
+    image[len++] = entry->command.len & 0xFFu;
+    memcpy(image + len, entry->command.s, entry->command.len);
+    len += entry->command.len;
+  }
+
+  (journal_store_handler)(image, len);
+  owl_free(image);
+}
+
+bool Breakout::restoreCommandJournal(const uint8_t *image, size_t imageSize) {
+  size_t i = BREAKOUT_JOURNAL_IMAGE_HEADER_SIZE;
+  int count, k;
+  str cmd;
+  if (!journal_max_commands) {
+    LOG(L_ERR, "The journal is not enabled - call setCommandJournal() first\r\n");
+    return false;
+  }
+  if (!image || imageSize < BREAKOUT_JOURNAL_IMAGE_HEADER_SIZE || image[0] != 'B' || image[1] != 'J' ||
+      image[2] != BREAKOUT_JOURNAL_IMAGE_VERSION) {
+    LOG(L_ERR, "Invalid journal image\r\n");
+    return false;
+  }
+  count = (image[3] << 8) | image[4];
+
+  /* Validate first, to not restore only half of a corrupted image */
+  for (k = 0; k < count; k++) {
+    if (i + 3 > imageSize) goto invalid;
+    i += 3 + ((image[i + 1] << 8) | image[i + 2]);
+    if (i > imageSize) goto invalid;
+  }
+
+  i = BREAKOUT_JOURNAL_IMAGE_HEADER_SIZE;
+  for (k = 0; k < count; k++) {
+    cmd.len = (image[i + 1] << 8) | image[i + 2];
+    cmd.s   = (char *)image + i + 3;
+    if (addCommandToJournal(cmd, image[i] & BREAKOUT_JOURNAL_IMAGE_FLAG_BINARY,
+                            image[i] & BREAKOUT_JOURNAL_IMAGE_FLAG_RECEIPT, 0, 0) != COMMAND_STATUS_OK)
+      return false;
+    i += 3 + cmd.len;
+  }
+  LOG(L_INFO, "Restored %d Commands in the journal\r\n", count);
+  return true;
+invalid:
+  LOG(L_ERR, "Truncated journal image - %d bytes\r\n", imageSize);
+  return false;
+}
+
+
+
 void Breakout::callback_checkForCommands(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
                                          coap_client_transaction_event_e event, CoAPMessage *message) {
   int isRetry        = (int)cb_param;
@@ -596,7 +1206,7 @@ bool Breakout::checkForCommands() {
   return this->checkForCommands(false);
 }
 
-bool Breakout::checkForCommands(bool isRetry) {
+bool Breakout::checkForCommands(bool isRetry, bool onTimer, bool isDrain) {
   owl_time_t now = owl_time();
   if (getConnectionStatus() != CONNECTION_STATUS_REGISTERED_AND_CONNECTED) {
     // If the connection was dead for too long, try to automatically reinitialize it
@@ -619,9 +1229,14 @@ bool Breakout::checkForCommands(bool isRetry) {
     return false;
   }
 recovered_connection:
-  if (last_polling != 0 && now - last_polling < BREAKOUT_POLLING_INTERVAL_MINIMUM * 1000) {
+  // The adaptive polling timer may go below the minimum, for back-to-back polls - the fixed one may not. Drain polls
+  // may too, as they are limited to one per BREAKOUT_POLLING_BACK_TO_BACK_INTERVAL and only follow queued Commands.
+  if ((!onTimer || !polling_min_interval) && !isDrain && last_polling != 0 &&
+      now - last_polling < BREAKOUT_POLLING_INTERVAL_MINIMUM * 1000) {
     LOG(L_WARN, "Polling to often! Last was just %d seconds ago, which is less than %d.\r\n",
         (int)(now - last_polling) / 1000, (int)BREAKOUT_POLLING_INTERVAL_MINIMUM);
+    // e.g. a back-to-back poll scheduled before adaptive polling was disabled - wait for the minimum instead
+    if (onTimer) next_polling = last_polling + BREAKOUT_POLLING_INTERVAL_MINIMUM * 1000;
     return false;
   }
 
@@ -644,8 +1259,14 @@ recovered_connection:
     LOG(L_ERR, "Error adding Twilio-HostDevice-Information\r\n");
     goto error;
   }
+  // The Response might be piggybacked or separate, and overlap with the ones to other Heartbeats - match it by token
+  if (!coapPeer->addPendingRequest(&request, callback_heartbeatResponse, 0)) {
+    LOG(L_ERR, "Error adding pending request\r\n");
+    goto error;
+  }
   if (!coapPeer->sendReliably(&request, callback_checkForCommands, (void *)(isRetry ? 1 : 0))) {
     LOG(L_ERR, "Error sending request unreliably\r\n");
+    coapPeer->dropPendingRequest(request.token, request.token_length);
     goto error;
   }
 
@@ -653,7 +1274,7 @@ recovered_connection:
    * - after error label, to avoid hammering this on errors */
   last_polling = now;
   if (next_polling != 0) {
-    next_polling = now + polling_interval * 1000;
+    next_polling = now + polling_current_interval * 1000;
     LOG(L_INFO, "Sent a POST /v1/Heartbeats - next one is in %d seconds\r\n", (next_polling - now) / 1000);
   } else {
     LOG(L_INFO, "Sent a POST /v1/Heartbeats\r\n");
@@ -666,14 +1287,223 @@ error:
   /* Reset the polling interval - doesn't matter if this was called manually or on interval
    * - after error label, to avoid hammering this on errors */
   last_polling                        = now;
-  if (next_polling != 0) next_polling = now + polling_interval * 1000;
+  if (next_polling != 0) next_polling = now + polling_current_interval * 1000;
 
   request.destroy();
   return false;
 }
 
+/**
+ * Handle the Response to a POST /v1/Heartbeats - routed here by the CoAPPeer, by the token of the request.
+ * @param response - the response, or 0 if none was received
+ * @return the follow-up for the CoAPPeer
+ */
+coap_handler_follow_up_e Breakout::callback_heartbeatResponse(CoAPPeer *peer, coap_token_t token, void *cb_param,
+                                                              CoAPMessage *response) {
+  Breakout *breakout = &Breakout::getInstance();
+  if (!response) {
+    LOG(L_INFO, "No Response received for /v1/Heartbeats token=%llu\r\n", token);
+    return CoAP__Handler_Followup__Do_Nothing;
+  }
+  if (response->code_class != CoAP_Code_Class__Response ||
+      response->code_detail != CoAP_Code_Detail__Response__Created) {
+    LOG(L_WARN, "Received %d.%02d - %s for /v1/Heartbeats\r\n", response->code_class, response->code_detail,
+        coap_code_text(response->code_class, response->code_detail));
+    return CoAP__Handler_Followup__Send_Acknowledgement;
+  }
+  response->getNextOptionTwilioQueuedCommandCount(&breakout->queued_command_count, 0);
+  LOG(L_INFO, "Received 2.01 Response Created for /v1/Heartbeats - Queued-Command-Count=%llu\r\n",
+      breakout->queued_command_count);
+  breakout->adaptPollingInterval();
+  return CoAP__Handler_Followup__Send_Acknowledgement;
+}
+
+void Breakout::callback_registerCommandPush(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
+                                            coap_client_transaction_event_e event, CoAPMessage *message) {
+  Breakout *breakout = &Breakout::getInstance();
+  switch (event) {
+    case CoAP_Client_Transaction_Event__ACK:
+      // The piggybacked response, if any, is handled in handler_CoAPResponse()
+      LOG(L_INFO, "Received ACK for the Commands push registration\r\n");
+      break;
+    case CoAP_Client_Transaction_Event__RST:
+    case CoAP_Client_Transaction_Event__Timeout:
+      LOG(L_NOTICE, "Commands push registration failed with event %d - relying on polling, retrying in %d seconds\r\n",
+          event, BREAKOUT_OBSERVE_RETRY_INTERVAL);
+      breakout->observe_active = false;
+      if (breakout->observe_enabled)
+        breakout->observe_next_registration = owl_time() + BREAKOUT_OBSERVE_RETRY_INTERVAL * 1000;
+      break;
+    case CoAP_Client_Transaction_Event__Canceled:
+      // ignore
+      break;
+    default:
+      LOG(L_ERR, "Not handled event %d\r\n", event);
+  }
+}
+
+/**
+ * Send the GET /v1/Commands with the Observe option, to (de-)register for pushed Commands
+ * @param deregister - true to de-register the current registration, false to register anew
+ * @return true on success, false on failure
+ */
+bool Breakout::registerCommandPush(bool deregister) {
+  owl_time_t now      = owl_time();
+  CoAPMessage request = CoAPMessage(CoAP_Type__Confirmable, CoAP_Code_Class__Request, CoAP_Code_Detail__Request__GET,
+                                    coapPeer->getNextMessageId());
+  if (deregister) {
+    // The same token identifies the registration to remove
+    request.token        = observe_token;
+    request.token_length = observe_token_length;
+  } else {
+    request.token = coapPeer->getNextToken(&request.token_length);
+  }
+  if (!request.addOptionObserve(deregister ? 1 : 0)) {
+    LOG(L_ERR, "Error adding Observe\r\n");
+    goto error;
+  }
+  if (!request.addOptionUriPath((char *)"v1")) {
+    LOG(L_ERR, "Error adding UriPath\r\n");
+    goto error;
+  }
+  if (!request.addOptionUriPath((char *)"Commands")) {
+    LOG(L_ERR, "Error adding UriPath\r\n");
+    goto error;
+  }
+  if (!request.addOptionUriQuery(iccid)) {
+    LOG(L_ERR, "Error adding UriQuery\r\n");
+    goto error;
+  }
+  if (!coapPeer->sendReliably(&request, deregister ? 0 : callback_registerCommandPush, 0)) {
+    LOG(L_ERR, "Error sending request reliably\r\n");
+    goto error;
+  }
+
+  if (!deregister) {
+    // Notifications on the previous token, if any, will get a RST
+    observe_token             = request.token;
+    observe_token_length      = request.token_length;
+    observe_sequence          = 0;
+    observe_next_registration = now + BREAKOUT_OBSERVE_REFRESH_INTERVAL * 1000;
+    LOG(L_INFO, "Sent a GET /v1/Commands with Observe - token 0x%.*llx\r\n", request.token_length * 2, request.token);
+  } else {
+    LOG(L_INFO, "Sent a GET /v1/Commands with Observe de-registration\r\n");
+  }
+
+  request.destroy();
+  return true;
+error:
+  /* Retry later - to avoid hammering this on errors */
+  if (!deregister) observe_next_registration = now + BREAKOUT_OBSERVE_RETRY_INTERVAL * 1000;
+  request.destroy();
+  return false;
+}
+
+/**
+ * Handle a response on the Commands push registration - either the first one, or a later notification.
+ * @param notification - the response
+ * @return the follow-up for the CoAPPeer
+ */
+coap_handler_follow_up_e Breakout::handleCommandPush(CoAPMessage *notification) {
+  uint64_t sequence       = 0;
+  uint64_t content_format = CoAP_Content_Format__text_plain_charset_utf8;
+  owl_time_t now          = owl_time();
+  bool fresh              = true;
+
+  if (notification->code_class != CoAP_Code_Class__Response ||
+      notification->code_detail != CoAP_Code_Detail__Response__Content) {
+    LOG(L_NOTICE, "Commands push registration rejected with %d.%02d - %s - relying on polling\r\n",
+        notification->code_class, notification->code_detail,
+        coap_code_text(notification->code_class, notification->code_detail));
+    // The server said no - asking again on the same session would only get the same answer
+    observe_active            = false;
+    observe_token_length      = 0;
+    observe_next_registration = 0;
+    return CoAP__Handler_Followup__Send_Acknowledgement;
+  }
+
+  if (!notification->getNextOptionObserve(&sequence, 0)) {
+    // RFC7641 - a response without Observe means the server did not add us to the list of observers
+    LOG(L_NOTICE, "Commands push not supported by the server - relying on polling until reconnected\r\n");
+    observe_active            = false;
+    observe_token_length      = 0;
+    observe_next_registration = 0;
+  } else {
+    // RFC7641 Section 3.4 - 24-bit sequence numbers, with a 128 seconds limit for the re-ordering
+    if (observe_active && observe_last_notification != 0) {
+      fresh = (observe_sequence < sequence && sequence - observe_sequence < (1UL << 23)) ||
+              (observe_sequence > sequence && observe_sequence - sequence > (1UL << 23)) ||
+              now > observe_last_notification + 128 * 1000;
+    }
+    if (!observe_active) LOG(L_INFO, "Commands push registration active\r\n");
+    observe_active = true;
+    observe_notification_count++;
+    if (fresh) {
+      observe_sequence          = (uint32_t)sequence;
+      observe_last_notification = now;
+      notification->getNextOptionTwilioQueuedCommandCount(&queued_command_count, 0);
+    } else {
+      LOG(L_INFO, "Re-ordered notification %llu older than %u - not updating the Queued-Command-Count\r\n", sequence,
+          observe_sequence);
+    }
+  }
+
+  if (notification->payload.len) {
+    // Each notification carries a distinct Command, so deliver also the re-ordered ones
+    LOG(L_INFO, "Handling notification identified as To-SIM Command - pushed at %llu ms\r\n", now);
+    notification->getNextOptionContentFormat(&content_format, 0);
+    if (!receivedCommandInternal(notification->payload,
+                                 content_format == CoAP_Content_Format__application_octet_stream))
+      return CoAP__Handler_Followup__Do_Nothing;
+  }
+  return CoAP__Handler_Followup__Send_Acknowledgement;
+}
+
+bool Breakout::isCommandPushActive() {
+  return observe_active;
+}
+
+uint32_t Breakout::getCommandPushCount() {
+  return observe_notification_count;
+}
+
+owl_time_t Breakout::getLastCommandPushTime() {
+  return observe_last_notification;
+}
+
 bool Breakout::hasWaitingCommand() {
-  return (commands.head != 0);
+  return (inbox.count != 0);
+}
+
+#define BREAKOUT_INBOX_RECORD_HEADER 3
+
+command_status_code_e Breakout::peekCommand(const char **buf, size_t *bufSize, bool *isBinary) {
+  if (!hasWaitingCommand()) return COMMAND_STATUS_NO_COMMAND_WAITING;
+  if (!buf || !bufSize) {
+    LOG(L_ERR, "Must provide non-null buf and bufSize parameters\r\n");
+    return COMMAND_STATUS_ERROR;
+  }
+  uint8_t *record = inbox.buf + inbox.head;
+  *bufSize        = (record[0] << 8) | record[1];
+  *buf            = (const char *)record + BREAKOUT_INBOX_RECORD_HEADER;
+  if (isBinary) *isBinary = record[2];
+  return COMMAND_STATUS_OK;
+}
+
+command_status_code_e Breakout::consumeCommand() {
+  if (!hasWaitingCommand()) return COMMAND_STATUS_NO_COMMAND_WAITING;
+  uint8_t *record = inbox.buf + inbox.head;
+  inbox.head += BREAKOUT_INBOX_RECORD_HEADER + ((record[0] << 8) | record[1]);
+  inbox.count--;
+  if (inbox.count == 0) {
+    inbox.head = 0;
+    inbox.tail = 0;
+    inbox.wrap = 0;
+  } else if (inbox.wrap && inbox.head == inbox.wrap) {
+    inbox.head = 0;
+    inbox.wrap = 0;
+  }
+  return COMMAND_STATUS_OK;
 }
 
 command_status_code_e Breakout::receiveCommand(const size_t maxBufSize, char *buf, size_t *bufSize, bool *isBinary) {
@@ -687,24 +1517,30 @@ command_status_code_e Breakout::receiveCommand(const size_t maxBufSize, char *bu
     return COMMAND_STATUS_ERROR;
   }
 
-  breakout_command_t *command = commands.head;
-  if (command->command.len > maxBufSize) {
+  const char *command = 0;
+  size_t command_len  = 0;
+  peekCommand(&command, &command_len, isBinary);
+  if (command_len > maxBufSize) {
     return COMMAND_STATUS_BUFFER_TOO_SMALL;
   }
 
   if (buf) {
-    memcpy(buf, command->command.s, command->command.len);
-    *bufSize = command->command.len;
+    memcpy(buf, command, command_len);
+    *bufSize = command_len;
     // Padding with zero, just in case the users are not careful
     if (*bufSize < maxBufSize) buf[*bufSize] = 0;
   }
-  if (isBinary) *isBinary = command->isBinary;
 
-  WL_DELETE(&commands, command);
-  commands.space_left++;
-  WL_FREE(command, breakout_command_list_t);
+  return consumeCommand();
+}
 
-  return COMMAND_STATUS_OK;
+void Breakout::getCommandDispatchStats(coap_fast_path_stats_t *out_stats) {
+  if (!out_stats) return;
+  if (!coapPeer) {
+    bzero(out_stats, sizeof(coap_fast_path_stats_t));
+    return;
+  }
+  coapPeer->getFastPathStats(out_stats);
 }
 
 bool Breakout::getGNSSData(gnss_data_t *out_gnss_data) {
@@ -843,7 +1679,13 @@ void Breakout::handler_CoAPDTLSEvent(CoAPPeer *peer, dtls_alert_level_e level, d
  * @return true if to ACK it, or false if not (e.g. error occured, so maybe try again on retransmission)
  */
 bool Breakout::receivedCommandInternal(str data, bool isBinary) {
-  breakout_command_t *cmd = 0;
+  int record_len = BREAKOUT_INBOX_RECORD_HEADER + data.len;
+  int offset     = -1;
+
+  // Commands tend to come in bursts - tighten the polling
+  polling_commands_received++;
+  if (polling_min_interval && polling_current_interval > polling_min_interval)
+    setCurrentPollingInterval(polling_min_interval, POLLING_INTERVAL_REASON_COMMAND_RECEIVED);
 
   if (command_handler) {
     // If a handler is set, then skip the queue of commands and deliver directly
@@ -852,24 +1694,39 @@ bool Breakout::receivedCommandInternal(str data, bool isBinary) {
   }
 
   // Otherwise queue the command
-  if (commands.space_left <= 0) {
+  if (record_len > BREAKOUT_INBOX_SIZE || data.len > 0xFFFF) {
+    LOG(L_ERR, "Command of %d bytes larger than the inbox of %d bytes - dropped\r\n", data.len, BREAKOUT_INBOX_SIZE);
+    return false;
+  }
+  while (offset < 0) {
+    if (inbox.count >= MAX_PENDING_COMMANDS) {
+      offset = -1;
+    } else if (!inbox.wrap) {
+      // Free space is after the tail, and before the head
+      if (inbox.tail + record_len <= BREAKOUT_INBOX_SIZE) {
+        offset = inbox.tail;
+      } else if (record_len <= inbox.head) {
+        inbox.wrap = inbox.tail;
+        offset     = 0;
+      }
+    } else {
+      // Free space is only between the tail and the head
+      if (inbox.tail + record_len <= inbox.head) offset = inbox.tail;
+    }
+    if (offset >= 0) break;
     LOG(L_WARN, "Maximum commands queued - will drop the oldest one, to make room for a newly received one\r\n");
-    cmd = commands.head;
-    WL_DELETE(&commands, cmd);
-    commands.space_left++;
-    WL_FREE(cmd, breakout_command_list_t);
+    consumeCommand();
   }
 
-  WL_NEW(cmd, breakout_command_list_t);
-  str_dup(cmd->command, data);
-  cmd->isBinary = isBinary;
-  WL_APPEND(&commands, cmd);
-  commands.space_left--;
+  uint8_t *record = inbox.buf + offset;
+  record[0]       = (data.len >> 8) & 0xFFu;
+  record[1]       = data.len & 0xFFu;
+  record[2]       = isBinary ? 1 : 0;
+  memcpy(record + BREAKOUT_INBOX_RECORD_HEADER, data.s, data.len);
+  inbox.tail = offset + record_len;
+  inbox.count++;
 
   return true;
-out_of_memory:
-  WL_FREE(cmd, breakout_command_list_t);
-  return false;
 }
 
 coap_handler_follow_up_e Breakout::handler_CoAPRequest(CoAPPeer *peer, CoAPMessage *request) {
@@ -921,20 +1778,81 @@ coap_handler_follow_up_e Breakout::handler_CoAPRequest(CoAPPeer *peer, CoAPMessa
   }
 }
 
+/**
+ * Fast path for To-SIM Commands - called with a view into the received data, before any other decoding and without
+ * allocations. Anything else goes on to handler_CoAPRequest()/handler_CoAPResponse().
+ */
+coap_handler_follow_up_e Breakout::handler_CoAPFastRequest(CoAPPeer *peer, coap_message_view_t *request) {
+  Breakout *instance = &Breakout::getInstance();
+
+  if (request->code_detail != CoAP_Code_Detail__Request__POST || !request->has_content_format ||
+      (request->content_format != CoAP_Content_Format__text_plain_charset_utf8 &&
+       request->content_format != CoAP_Content_Format__application_octet_stream) ||
+      !str_equalcase_char(request->uri_path, "Commands"))
+    return CoAP__Handler_Followup__Not_Handled;
+
+  LOG(L_INFO, "Handling POST identified as To-SIM Command - fast path\r\n");
+  if (instance->receivedCommandInternal(request->payload,
+                                        request->content_format == CoAP_Content_Format__application_octet_stream))
+    return CoAP__Handler_Followup__Send_Acknowledgement;
+  else
+    return CoAP__Handler_Followup__Do_Nothing;
+}
+
+/**
+ * Responses piggybacked on the ACKs to sent Commands might carry the Queued-Command-Count too - if non-zero, trigger a
+ * poll right away, so that the queued Commands come down without waiting for the next Heartbeat.
+ * @param response - the piggybacked response
+ */
+void Breakout::handlePiggybackedQueuedCommandCount(CoAPMessage *response) {
+  uint64_t count = 0;
+  if (!response->getNextOptionTwilioQueuedCommandCount(&count, 0)) return;
+  queued_command_count = count;
+  if (!count) return;
+  LOG(L_INFO, "Response to a sent Command reported Queued-Command-Count=%llu - draining\r\n", count);
+  polling_drain_requested = true;
+}
+
 coap_handler_follow_up_e Breakout::handler_CoAPResponse(CoAPPeer *peer, CoAPMessage *response) {
   Breakout *instance = &Breakout::getInstance();
+  if (instance->observe_token_length != 0 && response->token_length == instance->observe_token_length &&
+      response->token == instance->observe_token)
+    return instance->handleCommandPush(response);
+
+  // Responses to Heartbeats go to callback_heartbeatResponse() - the rest here are mostly for the sent Commands
+  if (response->type == CoAP_Type__Acknowledgement) instance->handlePiggybackedQueuedCommandCount(response);
+
   switch (response->code_detail) {
+    case CoAP_Code_Detail__Response__Changed:
+      if (response->type == CoAP_Type__Acknowledgement && response->code_class == CoAP_Code_Class__Response) {
+        // Piggybacked response to a sent Command - the receipt was already handled on the ACK
+        LOG(L_DBG, "Received 2.04 Changed for a sent Command\r\n");
+        return CoAP__Handler_Followup__Do_Nothing;
+      }
+      LOG(L_WARN, "Not handled CoAP Response %d.%02d - %s\r\n", response->code_class, response->code_detail,
+          coap_code_text(response->code_class, response->code_detail));
+      return CoAP__Handler_Followup__Send_Reset;
+
     case CoAP_Code_Detail__Response__Created:
-      if (response->token == instance->last_polling_token) {
-        response->getNextOptionTwilioQueuedCommandCount(&instance->queued_command_count, 0);
-        LOG(L_INFO, "Received 2.01 Response Created for /v1/Heartbeats - Queued-Command-Count=%llu\r\n",
-            instance->queued_command_count);
-        return CoAP__Handler_Followup__Send_Acknowledgement;
+      if (response->type == CoAP_Type__Acknowledgement) {
+        // Piggybacked response to a sent Command - the receipt was already handled on the ACK
+        LOG(L_DBG, "Received 2.01 Created for a sent Command\r\n");
+        return CoAP__Handler_Followup__Do_Nothing;
       }
       LOG(L_WARN, "Received 2.01 Response Created for unknown Request\r\n");
       response->log(L_WARN);
       return CoAP__Handler_Followup__Send_Reset;
 
+    case CoAP_Code_Detail__Response__Continue:
+      if (response->code_class == CoAP_Code_Class__Response) {
+        // Intermediary block of a block-wise Command - the transfer is driven by the CoAPPeer
+        LOG(L_DBG, "Received 2.31 Continue for a block-wise Command\r\n");
+        return CoAP__Handler_Followup__Do_Nothing;
+      }
+      LOG(L_WARN, "Not handled CoAP Response %d.%02d - %s\r\n", response->code_class, response->code_detail,
+          coap_code_text(response->code_class, response->code_detail));
+      return CoAP__Handler_Followup__Send_Reset;
+
     default:
       LOG(L_WARN, "Not handled CoAP Response %d.%02d - %s\r\n", response->code_class, response->code_detail,
           coap_code_text(response->code_class, response->code_detail));
@@ -28,17 +28,47 @@
 
 
 
+/** 0 - plaintext CoAP, 1 - DTLS with tinydtls on the MCU, 2 - DTLS done by the modem's secure sockets */
+#ifndef TESTING_WITH_DTLS
 #define TESTING_WITH_DTLS 1
+#endif
 
+#ifndef TESTING_WITH_CLI
 #define TESTING_WITH_CLI 1
+#endif
 
 
 
 #define MAX_PENDING_COMMANDS 100
+/** Size of the ring keeping received Commands until retrieved - must hold at least one Command of max size */
+#define BREAKOUT_INBOX_SIZE 2048
 #define BREAKOUT_POLLING_INTERVAL_MINIMUM 60 // Temporary minimum interval; expect this to be 10 minutes in the future.
+#define BREAKOUT_POLLING_BACK_TO_BACK_INTERVAL 2 // Adaptive polling - interval while the server reports queued Commands
+#define BREAKOUT_POLLING_BACK_TO_BACK_MAX 10 // Adaptive polling - max consecutive back-to-back polls
 #define BREAKOUT_INIT_CONNECTION_TIMEOUT 60
 #define BREAKOUT_INIT_CONNECTION_RETRIES 2
 #define BREAKOUT_REINIT_CONNECTION_INTERVAL 600
+#define BREAKOUT_OBSERVE_RETRY_INTERVAL 300 // Interval to retry the Commands push registration, if it failed
+#define BREAKOUT_OBSERVE_REFRESH_INTERVAL 3600 // Interval to refresh the Commands push registration, while active
+
+/** Commands up to this size are sent in a single CoAP message */
+#define BREAKOUT_COMMAND_MAX_SIZE 140
+/** Longer Commands, up to this size, are sent with CoAP block-wise transfer */
+#define BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE COAP_BLOCKWISE_MAX_SIZE
+/** Block size exponent for longer Commands - 128 byte blocks, each not larger than a single message Command */
+#define BREAKOUT_COMMAND_BLOCK_SZX 3
+/** Max number of Commands sent together in one batch */
+#define BREAKOUT_BATCH_MAX_COMMANDS 16
+/** Default limits of the journal of Commands waiting to be sent, see setCommandJournal() */
+#define BREAKOUT_JOURNAL_MAX_COMMANDS 32
+#define BREAKOUT_JOURNAL_MAX_BYTES 4096
+/** Default drain rate of the journal, once back online - Commands per burst and milliseconds between bursts */
+#define BREAKOUT_JOURNAL_BURST_SIZE 4
+#define BREAKOUT_JOURNAL_BURST_INTERVAL 1000
+/** Bursts in which sending a Command from the journal may fail, before it is dropped */
+#define BREAKOUT_JOURNAL_MAX_ATTEMPTS 3
+/** Format version of the journal image passed to the BreakoutJournalStoreHandler_f */
+#define BREAKOUT_JOURNAL_IMAGE_VERSION 1
 
 
 /**
@@ -50,6 +80,7 @@ typedef enum {
   COMMAND_STATUS_BUFFER_TOO_SMALL,   /**< Returned if provided buffer is too small for requested data. */
   COMMAND_STATUS_NO_COMMAND_WAITING, /**< Returned if no Command is available for reading. */
   COMMAND_STATUS_COMMAND_TOO_LONG,   /**< Returned if provided Command is too long. */
+  COMMAND_STATUS_BUSY,               /**< Returned if too many Commands are waiting for delivery - spin() and retry. */
 } command_status_code_e;
 
 /**
@@ -78,12 +109,29 @@ typedef enum {
   CONNECTION_STATUS_REGISTERED_AND_CONNECTED = 0x03,
 } connection_status_e;
 
+/**
+ * Enumeration for the reasons of polling interval changes - see setAdaptivePolling().
+ */
+typedef enum {
+  POLLING_INTERVAL_REASON_CONFIGURED       = 0, /**< fixed interval set with setPollingInterval() */
+  POLLING_INTERVAL_REASON_QUEUED_COMMANDS  = 1, /**< the server reported queued Commands - polling back-to-back */
+  POLLING_INTERVAL_REASON_COMMAND_RECEIVED = 2, /**< Commands were received - back to the minimum interval */
+  POLLING_INTERVAL_REASON_IDLE_BACKOFF     = 3, /**< no Commands - interval doubled, up to the configured one */
+} polling_interval_reason_e;
+
 /**
  * Handler function signature for connection status updates
  * @param connection_status - the new connection status
  */
 typedef void (*BreakoutConnectionStatusHandler_f)(const connection_status_e connection_status);
 
+/**
+ * Handler function signature for polling interval changes
+ * @param interval_seconds - the new interval until the next poll
+ * @param reason - why the interval changed
+ */
+typedef void (*BreakoutPollingIntervalHandler_f)(uint32_t interval_seconds, polling_interval_reason_e reason);
+
 /**
  * Handler function signature for To-SIM Commands (receiving Commands)
  * @param buf - a buffer containing the Command - duplicate data if you need to use it later
@@ -105,21 +153,73 @@ typedef void (*BreakoutCommandHandler_f)(const char *buf, size_t bufSize, bool i
  */
 typedef void (*BreakoutCommandReceiptCallback_f)(command_receipt_code_e receipt_code, void *cb_parameter);
 
+/**
+ * Handler function signature for storing the journal of Commands waiting to be sent, e.g. in flash
+ * @param image - serialized journal, to be passed back to restoreCommandJournal() after a restart - an image with no
+ * Commands means that the storage can be cleared
+ * @param imageSize - the length of the image
+ */
+typedef void (*BreakoutJournalStoreHandler_f)(const uint8_t *image, size_t imageSize);
 
+/**
+ * Handler function signature for storing a saved DTLS session, e.g. in backup RAM or flash, in place of the one which
+ * is being restored
+ * @param state - the saved session, with the record sequence numbers of this restore reserved
+ * @param stateSize - the length of the saved session
+ * @return true if stored, false to not restore the session
+ */
+typedef bool (*BreakoutTransportSessionStoreHandler_f)(const uint8_t *state, size_t stateSize);
 
-typedef struct _breakout_command_list_t_slot {
+/**
+ * Statistics of the journal of Commands waiting to be sent
+ */
+typedef struct {
+  int depth;               /**< Commands currently waiting */
+  size_t bytes;            /**< bytes currently waiting */
+  owl_time_t oldest_age;   /**< milliseconds since the oldest waiting Command was accepted, or 0 if none */
+  int max_depth;           /**< highest depth seen */
+  owl_time_t max_delay;    /**< highest time a Command waited before it was sent, in milliseconds */
+  uint32_t accepted_count; /**< Commands accepted in the journal */
+  uint32_t sent_count;     /**< Commands sent out from the journal */
+  uint32_t dropped_count;  /**< Commands dropped - the oldest to make room for newer ones, or failing to be sent */
+} breakout_journal_stats_t;
+
+
+
+/**
+ * Ring of received Commands, each stored as a variable-length record: length (2 bytes, network order), isBinary
+ * (1 byte), then the Command. Records are never split across the end of the ring, so that they can be handed out in
+ * place. When one does not fit at the end, it goes at the start and wrap marks where the valid data ends.
+ */
+typedef struct {
+  uint8_t buf[BREAKOUT_INBOX_SIZE];
+  uint16_t head; /**< offset of the oldest record */
+  uint16_t tail; /**< offset where the next record is written */
+  uint16_t wrap; /**< end of the records before the start of the ring is reused, or 0 if not wrapped */
+  int count;     /**< number of records */
+} breakout_inbox_t;
+
+
+
+typedef struct _breakout_journal_list_t_slot {
   str command;
   bool isBinary;
+  bool withReceipt;
+  BreakoutCommandReceiptCallback_f callback;
+  void *callback_parameter;
+  owl_time_t accepted; /**< time when it was accepted in the journal */
+  int attempts;        /**< bursts in which sending it failed */
 
-  struct _breakout_command_list_t_slot *prev, *next;
-} breakout_command_t;
+  struct _breakout_journal_list_t_slot *prev, *next;
+} breakout_journal_entry_t;
 
 typedef struct {
   int space_left;
-  breakout_command_t *head, *tail;
-} breakout_command_list_t;
+  size_t bytes;
+  breakout_journal_entry_t *head, *tail;
+} breakout_journal_list_t;
 
-#define breakout_command_list_t_free(x)                                                                                \
+#define breakout_journal_list_t_free(x)                                                                                \
   do {                                                                                                                 \
     if (x) {                                                                                                           \
       str_free((x)->command);                                                                                          \
@@ -130,6 +230,31 @@ typedef struct {
 
 
 
+typedef struct {
+  BreakoutCommandReceiptCallback_f callback;
+  void *callback_parameter;
+} breakout_batch_receipt_t;
+
+typedef struct {
+  str payload;         /**< CBOR indefinite-length array of the Commands, closed only when sent */
+  int capacity;        /**< bytes allocated for payload - batch_max_bytes might have changed since */
+  int count;           /**< number of Commands in the batch */
+  int receipts_count;  /**< number of Commands which requested a receipt */
+  owl_time_t deadline; /**< time at which the batch is sent, at the latest */
+  breakout_batch_receipt_t receipts[BREAKOUT_BATCH_MAX_COMMANDS];
+} breakout_batch_t;
+
+#define breakout_batch_t_free(x)                                                                                       \
+  do {                                                                                                                 \
+    if (x) {                                                                                                           \
+      str_free((x)->payload);                                                                                          \
+      owl_free(x);                                                                                                     \
+      (x) = 0;                                                                                                         \
+    }                                                                                                                  \
+  } while (0)
+
+
+
 /**
  * Breakout SDK for Arduino main class.
  *
@@ -170,6 +295,99 @@ class Breakout {
    */
   void setPollingInterval(uint32_t interval_seconds);
 
+  /**
+   * Enables adaptive polling, between min_interval_seconds and the interval set with setPollingInterval(), which
+   * becomes the maximum. While the server reports queued Commands in its Heartbeat responses, polls are sent
+   * back-to-back, every BREAKOUT_POLLING_BACK_TO_BACK_INTERVAL seconds. When idle, the interval is doubled after each
+   * poll, up to the maximum. Receiving Commands brings it back to min_interval_seconds. Disabled by default.
+   * @param enabled - true to enable, false to go back to the fixed interval
+   * @param min_interval_seconds - the interval after Commands were received - at least
+   * BREAKOUT_POLLING_INTERVAL_MINIMUM
+   */
+  void setAdaptivePolling(bool enabled, uint32_t min_interval_seconds = BREAKOUT_POLLING_INTERVAL_MINIMUM);
+
+  /**
+   * Sets the handler for polling interval changes, e.g. to monitor the adaptive polling.
+   * @param handler - the handler, of type `void handler(uint32_t interval_seconds, polling_interval_reason_e reason)`
+   */
+  void setPollingIntervalHandler(BreakoutPollingIntervalHandler_f handler);
+
+  /**
+   * Gets the polling interval currently in use - with adaptive polling, this changes on its own.
+   * @return the interval in seconds, or 0 if polling is disabled
+   */
+  uint32_t getPollingInterval();
+
+  /**
+   * Gets the reason of the last polling interval change.
+   * @return the reason
+   */
+  polling_interval_reason_e getPollingIntervalReason();
+
+  /**
+   * Enables or disables Commands being pushed by the server, through a CoAP Observe registration on /v1/Commands. While
+   * the registration is active, Commands are delivered as soon as the server has them, while the polling configured with
+   * setPollingInterval() is still done, but only as a keep-alive. If the registration is lost, it is retried every
+   * BREAKOUT_OBSERVE_RETRY_INTERVAL seconds. If the server answers without Observe, or rejects it, it is not retried
+   * until the next reconnection, and polling remains the way to learn about waiting Commands.
+   * Disabled by default.
+   * @param enabled - true to register for pushed Commands, false to de-register
+   */
+  void setCommandPushEnabled(bool enabled);
+
+  /**
+   * Enables batching of the sent Commands. Instead of one CoAP message per Command, Commands are collected for up to
+   * max_delay_ms milliseconds, or until max_bytes are collected, then sent together in a single request. The payload is
+   * a CBOR array of text and byte strings, with Content-Format application/cbor. Receipts requested for Commands in a
+   * batch are reported, each to its own callback, when the whole batch is confirmed or fails. Commands which would not
+   * fit in a batch by themselves are sent right away, as before.
+   * @param max_delay_ms - max time to hold a Command in the batch - 0 to disable batching (default)
+   * @param max_bytes - max size of a batch payload, up to BREAKOUT_COMMAND_MAX_SIZE_BLOCKWISE - batches larger than
+   * BREAKOUT_COMMAND_MAX_SIZE are sent in blocks
+   */
+  void setCommandBatching(uint32_t max_delay_ms, size_t max_bytes = BREAKOUT_COMMAND_MAX_SIZE);
+
+  /**
+   * Enables the journal of Commands waiting to be sent. While offline, or while older Commands are still waiting, sent
+   * Commands are accepted in this journal instead of being refused. Once connected, they are sent in order, in bursts of
+   * burst_size Commands every burst_interval_ms milliseconds, each burst pipelined within the CoAP congestion window.
+   * Receipt callbacks are kept and called once the Command was actually sent and confirmed. When full, the oldest
+   * Command is dropped to make room, with its receipt callback called with COMMAND_RECEIPT_CANCELED. So is a Command
+   * which is too long, or which failed to be sent in BREAKOUT_JOURNAL_MAX_ATTEMPTS bursts.
+   * @param max_commands - max number of Commands kept - 0 to disable the journal (default)
+   * @param max_bytes - max number of bytes kept, for all Commands together - a larger Command is never journaled, it
+   * is sent right away or refused
+   * @param burst_size - max number of Commands sent in one burst
+   * @param burst_interval_ms - time between bursts
+   */
+  void setCommandJournal(int max_commands, size_t max_bytes = BREAKOUT_JOURNAL_MAX_BYTES,
+                         int burst_size = BREAKOUT_JOURNAL_BURST_SIZE,
+                         uint32_t burst_interval_ms = BREAKOUT_JOURNAL_BURST_INTERVAL);
+
+  /**
+   * Sets the handler to back the journal with persistent storage, e.g. flash. The handler is called from spin(), with a
+   * serialized image of the journal, whenever the journal changed. Pass that image to restoreCommandJournal() after a
+   * restart to recover the Commands which were not sent yet.
+   * @param handler - the handler, of type `void handler(const uint8_t *image, size_t imageSize)`, or 0 to disable
+   */
+  void setCommandJournalStoreHandler(BreakoutJournalStoreHandler_f handler);
+
+  /**
+   * Restores Commands from a journal image previously passed to the BreakoutJournalStoreHandler_f. The Commands are
+   * appended to the journal, which must be enabled with setCommandJournal() first. Receipt callbacks can not be
+   * persisted, so Commands which requested a receipt are still sent reliably, but without a callback.
+   * @param image - the journal image
+   * @param imageSize - the length of the image
+   * @return true on success, false if the image is invalid or the journal is not enabled
+   */
+  bool restoreCommandJournal(const uint8_t *image, size_t imageSize);
+
+  /**
+   * Retrieves the statistics of the journal, e.g. to monitor the backlog while offline.
+   * @param out_stats - structure to fill in
+   */
+  void getCommandJournalStats(breakout_journal_stats_t *out_stats);
+
   /**
    * Set the PSK-Key
    * Must be set before powering on the module or this call will return an error.
@@ -226,6 +444,34 @@ class Breakout {
    */
   bool reinitializeTransport();
 
+  /**
+   * Save the DTLS session with Twilio, to keep it in backup RAM or flash while the board sleeps, so that the first
+   * Command after wake-up needs no handshake. Call this after powerModuleOff(), which already saved it for the next
+   * powerModuleOn() and hands it over here, such that it is restored only once.
+   * @param buf - buffer to write to, of DTLS_SESSION_STATE_MAX_LENGTH bytes to be sure - contains the session keys
+   * @param buf_len - size of buf
+   * @return the length of the saved session, or 0 if none (e.g. not connected at powerModuleOff())
+   */
+  int saveTransportSession(uint8_t *buf, int buf_len);
+
+  /**
+   * Set the handler which stores the saved DTLS session on each restoreTransportSession(), required for the restore.
+   * @param handler - the handler, of type `bool handler(const uint8_t *state, size_t stateSize)`, or 0 to disable
+   */
+  void setTransportSessionStoreHandler(BreakoutTransportSessionStoreHandler_f handler);
+
+  /**
+   * Restore a DTLS session saved with saveTransportSession(), at the next powerModuleOn() or reinitializeTransport().
+   * The record sequence numbers which the restored session may use are reserved first, in a new saved session passed
+   * to the BreakoutTransportSessionStoreHandler_f, which must replace this one in the storage. As the restore happens
+   * only if that was stored, the same record sequence numbers are never used twice. If the server has dropped the
+   * session, a handshake follows, abbreviated if the server can still resume it.
+   * @param state - the saved session
+   * @param state_len - length of the saved session
+   * @return true if accepted, false if invalid, or not stored by the handler
+   */
+  bool restoreTransportSession(const uint8_t *state, int state_len);
+
 
   /*                      Main Functionality Loop                                */
 
@@ -238,54 +484,71 @@ class Breakout {
 
   /**
    * Send a text Command to Twilio - without Receipt Request
-   * @param buf - the text Command to send to Twilio - max 140 characters.
+   * @param buf - the text Command to send to Twilio - max 1024 characters. Commands longer than 140 characters are sent
+   * reliably, in blocks.
    * @return
-   *    COMMAND_STATUS_SUCCESS on success
-   *    COMMAND_STATUS_ERROR on error
-   *    COMMAND_STATUS_COMMAND_TOO_LONG if strlen(buf) > 140
+   *    COMMAND_STATUS_SUCCESS on success, or if accepted in the journal - see setCommandJournal()
+   *    COMMAND_STATUS_ERROR on error, or if offline while the journal is disabled
+   *    COMMAND_STATUS_COMMAND_TOO_LONG if strlen(buf) > 1024
+   *    COMMAND_STATUS_BUSY if strlen(buf) > 140 and too many Commands are already being sent in blocks
    */
   command_status_code_e sendTextCommand(const char *buf);
 
   /**
    * Send a binary Command to Twilio - without Receipt Request
-   * @param buf - buffer containing the binary Command to send to Twilio - max 140 characters.
+   * @param buf - buffer containing the binary Command to send to Twilio - max 1024 bytes. Commands longer than 140
+   * bytes are sent reliably, in blocks.
    * @param bufSize - number of bytes of the binary Command
    * @return
-   *    COMMAND_STATUS_SUCCESS on success
-   *    COMMAND_STATUS_ERROR on error
-   *    COMMAND_STATUS_COMMAND_TOO_LONG if bufSize > 140
+   *    COMMAND_STATUS_SUCCESS on success, or if accepted in the journal - see setCommandJournal()
+   *    COMMAND_STATUS_ERROR on error, or if offline while the journal is disabled
+   *    COMMAND_STATUS_COMMAND_TOO_LONG if bufSize > 1024
+   *    COMMAND_STATUS_BUSY if bufSize > 140 and too many Commands are already being sent in blocks
    */
   command_status_code_e sendBinaryCommand(const char *buf, size_t bufSize);
 
   /**
    * Send a text Command to Twilio - with Receipt Request
-   * @param buf - the text Command to send to Twilio - max 140 characters.
+   * @param buf - the text Command to send to Twilio - max 1024 characters. Commands longer than 140 characters are sent
+   * in blocks, with the receipt confirming the whole Command.
    * @param callback - Command receipt callback.
    * @param callback_parameter - a generic pointer to application data.
    * @return
-   *    COMMAND_STATUS_SUCCESS on success
-   *    COMMAND_STATUS_ERROR on error
-   *    COMMAND_STATUS_COMMAND_TOO_LONG if strlen(buf) > 140
+   *    COMMAND_STATUS_SUCCESS on success, or if accepted in the journal - see setCommandJournal()
+   *    COMMAND_STATUS_ERROR on error, or if offline while the journal is disabled
+   *    COMMAND_STATUS_COMMAND_TOO_LONG if strlen(buf) > 1024
+   *    COMMAND_STATUS_BUSY if too many Commands are already waiting for the congestion window to open
    */
   command_status_code_e sendTextCommandWithReceiptRequest(const char *buf, BreakoutCommandReceiptCallback_f callback,
                                                           void *callback_parameter);
 
   /**
    * Send a binary Command to Twilio - with Receipt Request
-   * @param buf - buffer containing the binary Command to send to Twilio - max 140 characters.
+   * @param buf - buffer containing the binary Command to send to Twilio - max 1024 bytes. Commands longer than 140
+   * bytes are sent in blocks, with the receipt confirming the whole Command.
    * @param bufSize - number of bytes of the binary Command
    * @param callback - Command receipt callback.
    * @param callback_parameter - a generic pointer to application data.
    * @returns
-   *    COMMAND_STATUS_SUCCESS on success
-   *    COMMAND_STATUS_ERROR on error
-   *    COMMAND_STATUS_COMMAND_TOO_LONG if bufSize > 140
+   *    COMMAND_STATUS_SUCCESS on success, or if accepted in the journal - see setCommandJournal()
+   *    COMMAND_STATUS_ERROR on error, or if offline while the journal is disabled
+   *    COMMAND_STATUS_COMMAND_TOO_LONG if bufSize > 1024
+   *    COMMAND_STATUS_BUSY if too many Commands are already waiting for the congestion window to open
    */
   command_status_code_e sendBinaryCommandWithReceiptRequest(const char *buf, size_t bufSize,
                                                             BreakoutCommandReceiptCallback_f callback,
                                                             void *callback_parameter);
 
 
+  /**
+   * Send right away the Commands collected so far in the current batch. See setCommandBatching().
+   * @return
+   *    COMMAND_STATUS_SUCCESS on success, or if there was nothing to send
+   *    COMMAND_STATUS_ERROR on error - the batch is kept and retried later
+   *    COMMAND_STATUS_BUSY if too many Commands are already waiting for the congestion window to open
+   */
+  command_status_code_e flushCommands();
+
   /**
    * Manually initiate a check for waiting Commands.
    * If setPollingInterval() is set to a valid interval, this is automatically called at an interval.
@@ -294,6 +557,25 @@ class Breakout {
    */
   bool checkForCommands();
 
+  /**
+   * Checks if the server accepted the registration for pushed Commands. See setCommandPushEnabled().
+   * @return - true if Commands are currently pushed by the server, false if only polling is available
+   */
+  bool isCommandPushActive();
+
+  /**
+   * Number of notifications received on the Commands push registration, since the device started. Together with
+   * getLastCommandPushTime(), this allows for measuring the delivery latency against a server with known send times.
+   * @return - the number of notifications received
+   */
+  uint32_t getCommandPushCount();
+
+  /**
+   * Time of the last in-order notification received on the Commands push registration.
+   * @return - owl_time() in milliseconds at the reception of that notification, or 0 if none was received yet
+   */
+  owl_time_t getLastCommandPushTime();
+
   /**
    * Indicates the presence of at least one waiting Command. This is an alternative to setting a handler for Breakout
    * Commands, in case polling is the preferred option. Use with receiveCommand() to retrieve the Breakout Commands one
@@ -308,7 +590,7 @@ class Breakout {
    * called with Commands when they arrive, without having to poll.
    * @param maxBufSize - Size of buffer being passed in
    * @param buf - Buffer to receive Command into
-   * @param bufSize - Output size of returned Command in buf, will not exceed 141 bytes.
+   * @param bufSize - Output size of returned Command in buf, will not exceed 1024 bytes.
    * @param isBinary - Output indicator if the Command was received with Content-Format indicating text or binary
    * @return
    *    COMMAND_STATUS_OK on success
@@ -318,6 +600,37 @@ class Breakout {
    */
   command_status_code_e receiveCommand(const size_t maxBufSize, char *buf, size_t *bufSize, bool *isBinary);
 
+  /**
+   * Zero-copy alternative to receiveCommand(). Points to the oldest received Command, in place, in the internal ring,
+   * without removing it. Call consumeCommand() when done with it. The Command is not null-terminated.
+   * The pointer is valid until consumeCommand() or the next spin(), whichever comes first - receiving new Commands
+   * while the ring is full drops the oldest ones.
+   * @param buf - Output pointer to the Command
+   * @param bufSize - Output size of the Command, will not exceed 1024 bytes.
+   * @param isBinary - Output indicator if the Command was received with Content-Format indicating text or binary
+   * @return
+   *    COMMAND_STATUS_OK on success
+   *    COMMAND_STATUS_NO_COMMAND_WAITING if no Commands are waiting
+   *    COMMAND_STATUS_ERROR in case the parameters were bad
+   */
+  command_status_code_e peekCommand(const char **buf, size_t *bufSize, bool *isBinary);
+
+  /**
+   * Removes the oldest received Command, as previously returned by peekCommand().
+   * @return
+   *    COMMAND_STATUS_OK on success
+   *    COMMAND_STATUS_NO_COMMAND_WAITING if no Commands are waiting
+   */
+  command_status_code_e consumeCommand();
+
+  /**
+   * Retrieves the statistics of the To-SIM Commands dispatched on the fast path - straight from the received data to
+   * the handler set with setCommandHandler(), or to the ring read by peekCommand(). These include the latency from the
+   * reception of the data from the modem until the Command is delivered, in microseconds.
+   * @param out_stats - structure to fill in
+   */
+  void getCommandDispatchStats(coap_fast_path_stats_t *out_stats);
+
   /**
    * Query the GNSS module for position information.
    * @param out_gnss_data - gnss_data_t structure to receive current GNSS data.
@@ -351,6 +664,10 @@ class Breakout {
   OwlModem *owlModem = 0;
   CoAPPeer *coapPeer = 0;
 
+  uint8_t transport_session[DTLS_SESSION_STATE_MAX_LENGTH]; /**< saved DTLS session, to restore at the next start */
+  int transport_session_len = 0;                             /**< 0 if none saved */
+  BreakoutTransportSessionStoreHandler_f transport_session_store_handler = 0; /**< required to restore a session */
+
 #ifdef TESTING_WITH_CLI == 1
   OwlModemCLI *owlModemCLI = 0;
   int cli_resume           = 0;
@@ -362,7 +679,13 @@ class Breakout {
 
   bool initModem();
   bool initCoAPPeer();
-  bool checkForCommands(bool isRetry);
+  bool startTransport();
+  bool checkForCommands(bool isRetry, bool onTimer = false, bool isDrain = false);
+  void setCurrentPollingInterval(uint32_t interval_seconds, polling_interval_reason_e reason);
+  void adaptPollingInterval();
+  void handlePiggybackedQueuedCommandCount(CoAPMessage *response);
+  bool registerCommandPush(bool deregister);
+  coap_handler_follow_up_e handleCommandPush(CoAPMessage *notification);
 
   at_cereg_stat_e eps_registration_status = AT_CEREG__Stat__Not_Registered;
   bool coap_status                        = false;
@@ -372,6 +695,44 @@ class Breakout {
   command_status_code_e sendCommand(str cmd, bool isBinary = false);
   command_status_code_e sendCommandWithReceiptRequest(str cmd, BreakoutCommandReceiptCallback_f callback,
                                                       void *callback_parameter, bool isBinary = false);
+  command_status_code_e sendCommandNow(str cmd, bool isBinary);
+  command_status_code_e sendCommandWithReceiptRequestNow(str cmd, BreakoutCommandReceiptCallback_f callback,
+                                                         void *callback_parameter, bool isBinary);
+  bool addCommandRequestOptions(CoAPMessage *request, uint64_t content_format);
+
+
+
+  /*                     Batching of sent Commands                 */
+
+  uint32_t batch_max_delay = 0;                         /**< in milliseconds, 0 if batching is disabled */
+  size_t batch_max_bytes   = BREAKOUT_COMMAND_MAX_SIZE; /**< max size of the batch payload */
+  breakout_batch_t *batch  = 0;                         /**< the batch being collected, if any */
+
+  bool fitsInBatch(str cmd);
+  command_status_code_e addCommandToBatch(str cmd, bool isBinary, BreakoutCommandReceiptCallback_f callback,
+                                          void *callback_parameter);
+
+
+
+  /*                     Journal of Commands waiting to be sent                 */
+
+  int journal_max_commands                            = 0; /**< 0 if the journal is disabled */
+  size_t journal_max_bytes                            = BREAKOUT_JOURNAL_MAX_BYTES;
+  int journal_burst_size                              = BREAKOUT_JOURNAL_BURST_SIZE;
+  uint32_t journal_burst_interval                     = BREAKOUT_JOURNAL_BURST_INTERVAL; /**< in milliseconds */
+  owl_time_t journal_next_burst                       = 0;     /**< time of the next drain burst */
+  bool journal_dirty                                  = false; /**< changed since last passed to the store handler */
+  BreakoutJournalStoreHandler_f journal_store_handler = 0;
+  breakout_journal_stats_t journal_stats              = {0};
+
+  breakout_journal_list_t journal = {.space_left = 0, .bytes = 0, .head = 0, .tail = 0}; /**< ordered by acceptance */
+
+  bool fitsInCommandJournal(str cmd);
+  bool useCommandJournal(str cmd);
+  command_status_code_e addCommandToJournal(str cmd, bool isBinary, bool withReceipt,
+                                            BreakoutCommandReceiptCallback_f callback, void *callback_parameter);
+  void drainCommandJournal();
+  void storeCommandJournal();
 
 
 
@@ -381,14 +742,34 @@ class Breakout {
   owl_time_t last_polling   = 0;       /**< Time of last polling - will warn if manually triggering it more often */
   owl_time_t next_polling   = 1;       /**< Time of next automatic polling, or 0 if disabled. Initialize to 0 if to
                                          * disable it, or 1 if to enable it by default, without setting the poll. */
-  coap_token_t last_polling_token = 0; /**< Token sent in the last Heartbeats request, to match the Response */
-  uint64_t queued_command_count   = 0; /**< Last received Queued-Command-Count, as a Response to Heartbeats */
+  uint64_t queued_command_count = 0; /**< Last received Queued-Command-Count, as a Response to Heartbeats */
+
+  uint32_t polling_current_interval        = 10 * 60; /**< Interval in use, in seconds - adapted between the two below */
+  uint32_t polling_min_interval            = 0;       /**< Adaptive polling lower bound in seconds, 0 if disabled */
+  polling_interval_reason_e polling_reason = POLLING_INTERVAL_REASON_CONFIGURED;
+  int polling_back_to_back                 = 0;       /**< Consecutive back-to-back polls */
+  uint32_t polling_commands_received       = 0;       /**< Commands received since the last Heartbeats Response */
+  bool polling_drain_requested             = false;   /**< Poll right away, queued Commands were reported */
+
+  BreakoutPollingIntervalHandler_f polling_interval_handler = 0;
+
+
+
+  /*                     Observe aka Commands push                 */
+
+  bool observe_enabled                     = false; /**< Registration for pushed Commands wanted */
+  bool observe_active                      = false; /**< Registration accepted by the server */
+  owl_time_t observe_next_registration     = 0;     /**< Time of the next (re-)registration, or 0 if none is due */
+  coap_token_t observe_token               = 0;     /**< Token of the registration, to match the notifications */
+  coap_token_lenght_t observe_token_length = 0;     /**< 0 if no registration was sent */
+  uint32_t observe_sequence                = 0;     /**< Last Observe sequence number, for re-ordering detection */
+  owl_time_t observe_last_notification     = 0;     /**< Time of the last notification */
+  uint32_t observe_notification_count      = 0;     /**< Number of notifications received */
 
   BreakoutConnectionStatusHandler_f connection_handler = 0;
   BreakoutCommandHandler_f command_handler             = 0;
 
-  breakout_command_list_t commands = {
-      .space_left = MAX_PENDING_COMMANDS, .head = 0, .tail = 0};  //**< ordered by receipt */
+  breakout_inbox_t inbox = {.buf = {0}, .head = 0, .tail = 0, .wrap = 0, .count = 0}; /**< ordered by receipt */
 
 
 
@@ -412,6 +793,7 @@ class Breakout {
   static void handler_CoAPDTLSEvent(CoAPPeer *peer, dtls_alert_level_e level, dtls_alert_description_e code);
   static coap_handler_follow_up_e handler_CoAPRequest(CoAPPeer *peer, CoAPMessage *request);
   static coap_handler_follow_up_e handler_CoAPResponse(CoAPPeer *peer, CoAPMessage *response);
+  static coap_handler_follow_up_e handler_CoAPFastRequest(CoAPPeer *peer, coap_message_view_t *request);
 
 
 
@@ -421,6 +803,12 @@ class Breakout {
                                         coap_client_transaction_event_e event, CoAPMessage *message);
   static void callback_commandReceipt(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
                                       coap_client_transaction_event_e event, CoAPMessage *message);
+  static void callback_batchReceipt(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
+                                    coap_client_transaction_event_e event, CoAPMessage *message);
+  static void callback_registerCommandPush(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
+                                           coap_client_transaction_event_e event, CoAPMessage *message);
+  static coap_handler_follow_up_e callback_heartbeatResponse(CoAPPeer *peer, coap_token_t token, void *cb_param,
+                                                             CoAPMessage *response);
 
   friend class BreakoutSendCommand;
   friend class BreakoutSendCommandWithReceiptRequest;
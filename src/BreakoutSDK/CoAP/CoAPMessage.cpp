@@ -289,6 +289,83 @@ error:
   return 0;
 }
 
+int CoAPMessage::decodeView(str data, coap_message_view_t *view) {
+  bin_t b                 = str_to_bin(data);
+  bin_t *src              = &b;
+  uint8_t u8              = 0;
+  int number              = 0;
+  int delta               = 0;
+  int len                 = 0;
+  uint64_t content_format = 0;
+
+  bzero(view, sizeof(coap_message_view_t));
+
+  /* Header */
+  u8 = bin_t_decode_uint8(src);
+  if (((u8 >> 6) & 0x03) != CoAP_Version__1) return 0;
+  view->type         = (coap_type_e)((u8 >> 4) & 0x03);
+  view->token_length = u8 & 0x0f;
+  if (view->token_length > 8) return 0;
+  u8                = bin_t_decode_uint8(src);
+  view->code_class  = (coap_code_class_e)((u8 >> 5) & 0x07);
+  view->code_detail = (coap_code_detail_e)(u8 & 0x1f);
+  view->message_id  = bin_t_decode_uint16(src);
+
+  /* Token */
+  if (view->token_length) view->token = bin_t_decode_varuint(src, view->token_length);
+
+  /* Options - same format as in CoAPOption::decode(), just without keeping them */
+  while (src->idx < src->max && src->s[src->idx] != 0xff) {
+    u8    = bin_t_decode_uint8(src);
+    delta = u8 >> 4;
+    len   = u8 & 0x0f;
+    if (delta == 15 || len == 15) return 0;
+    if (delta == 13)
+      delta = bin_t_decode_uint8(src) + 13;
+    else if (delta == 14)
+      delta = bin_t_decode_uint16(src) + 269;
+    if (len == 13)
+      len = bin_t_decode_uint8(src) + 13;
+    else if (len == 14)
+      len = bin_t_decode_uint16(src) + 269;
+    number += delta;
+    bin_t_check_len(src, len);
+    switch (number) {
+      case CoAP_Option__Uri_Path:
+        if (!view->uri_path.s) {
+          view->uri_path.s   = (char *)src->s + src->idx;
+          view->uri_path.len = len;
+        }
+        src->idx += len;
+        break;
+      case CoAP_Option__Uri_Query:
+        src->idx += len;
+        break;
+      case CoAP_Option__Content_Format:
+        content_format           = bin_t_decode_varuint(src, len);
+        view->content_format     = content_format;
+        view->has_content_format = 1;
+        break;
+      default:
+        view->has_other_options = 1;
+        src->idx += len;
+        break;
+    }
+  }
+
+  /* Payload */
+  if (src->idx < src->max) {
+    src->idx++;
+    if (src->idx >= src->max) return 0;
+    view->payload.s   = (char *)src->s + src->idx;
+    view->payload.len = src->max - src->idx;
+  }
+  return 1;
+bad_length:
+error:
+  return 0;
+}
+
 int CoAPMessage::testCodec(CoAPMessage &msg, uint8_t *buffer, int len) {
   bin_t src = {.s = buffer, .idx = 0, .max = len};
   uint8_t buf[256];
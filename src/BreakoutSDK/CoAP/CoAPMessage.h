@@ -54,6 +54,43 @@ typedef uint8_t coap_token_lenght_t; /**< 4-bit Token length - values 9-15 are c
 typedef uint64_t coap_token_t;
 
 
+/*
+ * Block1/Block2 option value helpers - https://tools.ietf.org/html/rfc7959#section-2.2
+ *    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |                 NUM                   |M| SZX |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ */
+#define COAP_BLOCK_VALUE(num, more, szx) ((((uint64_t)(num)) << 4) | ((more) ? 0x08u : 0) | ((szx)&0x07u))
+#define COAP_BLOCK_NUM(value) ((uint32_t)((value) >> 4))
+#define COAP_BLOCK_MORE(value) ((int)(((value) >> 3) & 0x01u))
+#define COAP_BLOCK_SZX(value) ((uint8_t)((value)&0x07u))
+#define COAP_BLOCK_SIZE(szx) (16u << (szx)) /**< SZX 7 is reserved */
+#define COAP_BLOCK_SZX_MAX 6
+
+
+
+/**
+ * Allocation-free view of a received message, for the fast path of simple requests - see CoAPMessage::decodeView().
+ * The strings point into the received buffer, so this is valid only while that is.
+ */
+typedef struct {
+  coap_type_e type;
+  coap_code_class_e code_class;
+  coap_code_detail_e code_detail;
+  coap_message_id_t message_id;
+  coap_token_lenght_t token_length;
+  coap_token_t token;
+  str uri_path;           /**< first Uri-Path segment, or empty */
+  int has_content_format; /**< 1 if content_format is set */
+  uint64_t content_format;
+  /** 1 if there are options other than Uri-Path, Uri-Query and Content-Format, e.g. Block1 or Observe - such messages
+   * need the full decode() */
+  int has_other_options;
+  str payload;
+} coap_message_view_t;
+
+
 class CoAPMessage {
  public:
   coap_version_e version = CoAP_Version__1;
@@ -85,6 +122,15 @@ class CoAPMessage {
   int encode(bin_t *dst);
   int decode(bin_t *src);
 
+  /**
+   * Shallow decoding of a message, without allocating the options, for the fast path of simple requests. Only the
+   * header, the token, the first Uri-Path, the Content-Format and the payload are retrieved.
+   * @param data - the received message
+   * @param view - output view, pointing into data
+   * @return 1 on success, 0 on format error
+   */
+  static int decodeView(str data, coap_message_view_t *view);
+
   static int testCodec(CoAPMessage &msg, uint8_t *buffer, int len);
 
 
@@ -25,6 +25,28 @@
 
 #include "../utils/lists.h"
 
+extern "C" {
+#include "../../tinydtls/dtls_drbg.h"
+}
+
+
+#if defined(DTLS_SINGLE_PEER_CLIENT) && DTLS_MAX_BUF >= MODEM_UDP_BUFFER_SIZE
+/* Encode outgoing messages right into the DTLS scratch buffer, where dtls_write() encrypts them in place, instead of
+ * in one more MTU-sized buffer on the stack. The encoded message is only valid until the next send. Only tinydtls
+ * needs room for its record header and MAC - the other transports, which do not touch the scratch buffer, get all of
+ * it, as much as the modem sockets carry. */
+#define COAP_ENCODE_BUFFER(b)                                                                                          \
+  bin_t b = transport_type == CoAP_Transport__DTLS_PSK ?                                                               \
+                (bin_t){.s = dtls_get_scratch_payload(), .idx = 0, .max = DTLS_SCRATCH_PAYLOAD_MAX} :                  \
+                (bin_t){.s   = dtls_get_scratch_payload() - DTLS_SCRATCH_PAYLOAD_OFFSET,                               \
+                        .idx = 0,                                                                                      \
+                        .max = MODEM_UDP_BUFFER_SIZE}
+#else
+#define COAP_ENCODE_BUFFER(b)                                                                                          \
+  uint8_t b##_buf[MODEM_UDP_BUFFER_SIZE];                                                                              \
+  bin_t b = {.s = b##_buf, .idx = 0, .max = MODEM_UDP_BUFFER_SIZE}
+#endif
+
 
 CoAPPeer **CoAPPeer::instances = 0;
 int CoAPPeer::instances_cnt    = 0;
@@ -32,10 +54,10 @@ int CoAPPeer::instances_cnt    = 0;
 
 
 CoAPPeer::CoAPPeer(OwlModem *modem, uint16_t local_port, str remote_ip, uint16_t remote_port)
-    : transport_type(CoAP_Transport__plaintext), owlModem(modem), local_port(local_port), remote_port(remote_port) {
-  randomSeed(random(0xffffff) + millis());  // randomizing again, just in case the ANALOG_RND_PIN was connected
-  last_message_id = random(0xFFFFu);
-  last_token      = random(0xFFFFFF);
+    : owlModem(modem), transport_type(CoAP_Transport__plaintext), local_port(local_port), remote_port(remote_port) {
+  last_message_id = dtls_drbg_uint32() & 0xFFFFu;
+  last_token      = dtls_drbg_uint32() & 0xFFFFFFu;
+  initServerTransactions();
   str_dup(this->remote_ip, remote_ip);
   if (!CoAPPeer::addInstance(this)) {
     LOG(L_ERR, "Error adding instance in list\r\n");
@@ -48,14 +70,37 @@ out_of_memory:
 }
 
 CoAPPeer::CoAPPeer(OwlModem *modem, str psk_id, str psk_key, uint16_t local_port, str remote_ip, uint16_t remote_port)
-    : transport_type(CoAP_Transport__DTLS_PSK),
-      owlModem(modem),
+    : owlModem(modem),
+      transport_type(CoAP_Transport__DTLS_PSK),
       local_port(local_port),
       remote_ip(remote_ip),
       remote_port(remote_port) {
-  randomSeed(random(0xffffff) + millis());  // randomizing again, just in case the ANALOG_RND_PIN was connected
-  last_message_id = random(0xFFFFu);
-  last_token      = random(0xFFFFFF);
+  last_message_id = dtls_drbg_uint32() & 0xFFFFu;
+  last_token      = dtls_drbg_uint32() & 0xFFFFFFu;
+  initServerTransactions();
+  str_dup(this->remote_ip, remote_ip);
+  str_dup(this->psk_id, psk_id);
+  str_dup(this->psk_key, psk_key);
+  if (!CoAPPeer::addInstance(this)) {
+    LOG(L_ERR, "Error adding instance in list\r\n");
+    goto out_of_memory;
+  }
+  return;
+out_of_memory:
+  LOG(L_ERR, "Reached maximum number of supported concurrent CoAP clients.\r\n");
+  return;
+}
+
+CoAPPeer::CoAPPeer(OwlModem *modem, coap_transport_type_e transport_type, str psk_id, str psk_key, uint16_t local_port,
+                   str remote_ip, uint16_t remote_port)
+    : owlModem(modem), transport_type(transport_type), local_port(local_port), remote_port(remote_port) {
+  if (transport_type != CoAP_Transport__DTLS_PSK && transport_type != CoAP_Transport__Modem_DTLS_PSK) {
+    LOG(L_ERR, "Not a DTLS with PSK transport_type %d - using CoAP_Transport__DTLS_PSK\r\n", transport_type);
+    this->transport_type = CoAP_Transport__DTLS_PSK;
+  }
+  last_message_id = dtls_drbg_uint32() & 0xFFFFu;
+  last_token      = dtls_drbg_uint32() & 0xFFFFFFu;
+  initServerTransactions();
   str_dup(this->remote_ip, remote_ip);
   str_dup(this->psk_id, psk_id);
   str_dup(this->psk_key, psk_key);
@@ -75,8 +120,12 @@ CoAPPeer::~CoAPPeer() {
   str_free(this->remote_ip);
   str_free(this->psk_id);
   str_free(this->psk_key);
+  cancelClientTransactions();
   WL_FREE_ALL(&client_transactions, coap_client_transaction_list_t);
-  WL_FREE_ALL(&server_transactions, coap_server_transaction_list_t);
+  WL_FREE_ALL(&send_queue, coap_client_transaction_list_t);
+  WL_FREE_ALL(&blockwise_tx, coap_blockwise_tx_list_t);
+  str_free(this->blockwise_rx);
+  freeServerTransactions();
   if (owlDTLSClient) {
     delete owlDTLSClient;
     owlDTLSClient = 0;
@@ -86,29 +135,38 @@ CoAPPeer::~CoAPPeer() {
 
 
 int CoAPPeer::initDTLSClient() {
-  if (owlDTLSClient) {
-    owlDTLSClient->close();
-    delete owlDTLSClient;
-    owlDTLSClient = 0;
-  }
-  owlDTLSClient = owl_new OwlDTLSClient(psk_id, psk_key);
+  OwlDTLSClient *previous = owlDTLSClient;
+  owlDTLSClient           = owl_new OwlDTLSClient(psk_id, psk_key);
   if (!owlDTLSClient) {
     LOG(L_ERR, "Error creating DTLS instance\r\n");
-    return 0;
+    goto error;
   }
   if (!owlDTLSClient->init(owlModem)) {
     LOG(L_CLI, "ERROR - internal\r\n");
-    return 0;
+    goto error;
+  }
+  /* Keep the session which the server could resume with an abbreviated handshake */
+  owlDTLSClient->takeResumableSession(previous);
+  if (previous) {
+    previous->close();
+    delete previous;
   }
   owlDTLSClient->setDataHandler(CoAPPeer::handlerDTLSData);
   owlDTLSClient->setEventHandler(CoAPPeer::handlerDTLSEvent);
   return 1;
+error:
+  if (previous) {
+    previous->close();
+    delete previous;
+  }
+  return 0;
 }
 
 
 CoAPPeer *CoAPPeer::socketMappings[] = {0};
 
 void CoAPPeer::handlePlaintextData(uint8_t socket, str remote_ip, uint16_t remote_port, str data) {
+  uint32_t rx_time = owl_time_us();
   if (socket < 0 || socket >= MODEM_MAX_SOCKETS) {
     LOG(L_ERR, "Bad socket_id %d returned\r\n", socket);
     return;
@@ -134,6 +192,7 @@ void CoAPPeer::handlePlaintextData(uint8_t socket, str remote_ip, uint16_t remot
     LOG(L_ERR, "CoAP-Rx Ignoring data coming from %.*s:%u, instead of expected %.*s:%u\r\n", remote_ip.len, remote_ip.s,
         remote_port, peer->remote_ip.len, peer->remote_ip.s, peer->remote_port);
   }
+  peer->rx_time = rx_time;
   if (!peer->handleRx(data)) {
     LOG(L_WARN, "CoAP-Rx Failure - err handling Rx message\r\n");
   } else {
@@ -153,6 +212,7 @@ void CoAPPeer::handlerDTLSData(OwlDTLSClient *owlDTLSClient, session_t *session,
         "Instances mapping for owlDTLSClient not initialized correctly, or old DTLSClient instance sending this\r\n");
     return;
   }
+  peer->rx_time = owlDTLSClient->getLastRxTime();
   if (!peer->handleRx(plaintext)) {
     LOG(L_WARN, "CoAP-Rx Failure - err handling Rx message\r\n");
   } else {
@@ -201,6 +261,24 @@ int CoAPPeer::reinitialize() {
       return 1;
       break;
 
+    case CoAP_Transport__Modem_DTLS_PSK:
+      if (socket_id != 255) owlModem->socket.close(socket_id);
+      socket_id = 255;
+      if (!owlModem->socket.setSecurityProfilePSK(COAP_MODEM_SECURITY_PROFILE, psk_id, psk_key)) {
+        LOG(L_ERR, "remote_ip=%.*s:%u - modem security profile setup failed\r\n", remote_ip.len, remote_ip.s,
+            remote_port);
+        return 0;
+      }
+      /* The modem does the DTLS handshake in the connect */
+      if (!owlModem->socket.openConnectSecureUDP(COAP_MODEM_SECURITY_PROFILE, remote_ip, remote_port,
+                                                 CoAPPeer::handlePlaintextData, &socket_id)) {
+        LOG(L_ERR, "Error opening modem DTLS socket towards %.*s:%u\r\n", remote_ip.len, remote_ip.s, remote_port);
+        return 0;
+      }
+      CoAPPeer::socketMappings[socket_id] = this;
+      return 1;
+      break;
+
     case CoAP_Transport__DTLS_PSK:
       if (!owlDTLSClient) {
         if (!initDTLSClient()) {
@@ -266,9 +344,47 @@ int CoAPPeer::reinitialize() {
   }
 }
 
+int CoAPPeer::saveTransportSession(uint8_t *buf, int buf_len) {
+  int len = 0;
+  switch (this->transport_type) {
+    case CoAP_Transport__DTLS_PSK:
+      if (!owlDTLSClient || !this->transportIsReady()) {
+        LOG(L_WARN, "remote_ip=%.*s:%u - no DTLS session to save\r\n", remote_ip.len, remote_ip.s, remote_port);
+        return 0;
+      }
+      len = owlDTLSClient->saveSession(buf, buf_len);
+      // The keys left with the state - using them further here would reuse the record sequence numbers
+      this->close();
+      return len;
+      break;
+    default:
+      return 0;
+  }
+}
+
+int CoAPPeer::restoreTransportSession(const uint8_t *state, int state_len) {
+  switch (this->transport_type) {
+    case CoAP_Transport__DTLS_PSK:
+      if (!initDTLSClient()) {
+        LOG(L_ERR, "remote_ip=%.*s:%u - owlDTLSClient initialization failed\r\n", remote_ip.len, remote_ip.s,
+            remote_port);
+        return 0;
+      }
+      if (!owlDTLSClient->restoreSession(local_port, remote_ip, remote_port, state, state_len)) {
+        LOG(L_ERR, "Error restoring DTLS connection towards %.*s:%u\r\n", remote_ip.len, remote_ip.s, remote_port);
+        return 0;
+      }
+      return 1;
+      break;
+    default:
+      return this->reinitialize();
+  }
+}
+
 int CoAPPeer::close() {
   switch (this->transport_type) {
     case CoAP_Transport__plaintext:
+    case CoAP_Transport__Modem_DTLS_PSK:
       if (socket_id != 255 && !owlModem->socket.close(socket_id)) {
         LOG(L_ERR, "Error closing local socket towards %.*s:%u\r\n", remote_ip.len, remote_ip.s, remote_port);
         return 0;
@@ -297,6 +413,7 @@ int CoAPPeer::close() {
 int CoAPPeer::transportIsReady() {
   switch (this->transport_type) {
     case CoAP_Transport__plaintext:
+    case CoAP_Transport__Modem_DTLS_PSK:
       return (this->socket_id != 255);
       break;
     case CoAP_Transport__DTLS_PSK:
@@ -314,6 +431,34 @@ int CoAPPeer::transportIsReady() {
   }
 }
 
+void CoAPPeer::beginTransportBatch() {
+  switch (this->transport_type) {
+    case CoAP_Transport__plaintext:
+    case CoAP_Transport__Modem_DTLS_PSK:
+      // nothing here
+      break;
+    case CoAP_Transport__DTLS_PSK:
+      if (owlDTLSClient) owlDTLSClient->beginBatch();
+      break;
+    default:
+      LOG(L_ERR, "Not implemented for transport_type %d\r\n", this->transport_type);
+  }
+}
+
+int CoAPPeer::flushTransportBatch() {
+  switch (this->transport_type) {
+    case CoAP_Transport__plaintext:
+    case CoAP_Transport__Modem_DTLS_PSK:
+      return 1;
+    case CoAP_Transport__DTLS_PSK:
+      if (!owlDTLSClient) return 1;
+      return owlDTLSClient->flushBatch();
+    default:
+      LOG(L_ERR, "Not implemented for transport_type %d\r\n", this->transport_type);
+      return 0;
+  }
+}
+
 void CoAPPeer::setHandlers(CoAPPeer_MessageHandler_f handler_message, CoAPPeer_DTLSEventHandler_f handler_dtls_event,
                            CoAPPeer_RequestHandler_f handler_request, CoAPPeer_ResponseHandler_f handler_response) {
   this->handler_message    = handler_message;
@@ -322,9 +467,16 @@ void CoAPPeer::setHandlers(CoAPPeer_MessageHandler_f handler_message, CoAPPeer_D
   this->handler_response   = handler_response;
 }
 
+void CoAPPeer::setFastRequestHandler(CoAPPeer_FastRequestHandler_f handler_fast_request) {
+  this->handler_fast_request = handler_fast_request;
+}
+
+void CoAPPeer::getFastPathStats(coap_fast_path_stats_t *out_stats) {
+  if (out_stats) *out_stats = fast_path_stats;
+}
+
 int CoAPPeer::sendUnreliably(CoAPMessage *message, int probing_rate, int max_transmit_span) {
-  uint8_t buf[MODEM_UDP_BUFFER_SIZE];
-  bin_t b = {.s = buf, .idx = 0, .max = MODEM_UDP_BUFFER_SIZE};
+  COAP_ENCODE_BUFFER(b);
   int is_ackrst = 0;
   if (!message) {
     LOG(L_ERR, "Null parameter\r\n");
@@ -382,8 +534,7 @@ error:
 
 int CoAPPeer::sendReliably(CoAPMessage *message, CoAPPeer_ClientTransactionCallback_f cb, void *cb_param,
                            int max_retransmit, int max_transmit_span) {
-  uint8_t buf[MODEM_UDP_BUFFER_SIZE];
-  bin_t b = {.s = buf, .idx = 0, .max = MODEM_UDP_BUFFER_SIZE};
+  COAP_ENCODE_BUFFER(b);
   coap_client_transaction_t *t = 0;
   if (!message) {
     LOG(L_ERR, "Null parameter\r\n");
@@ -414,20 +565,107 @@ int CoAPPeer::sendReliably(CoAPMessage *message, CoAPPeer_ClientTransactionCallb
   }
   str data = bin_to_str(b);
 
+  /* Queued first, such that the order is kept, then sent out right away if the congestion window allows it */
   if (!putClientTransactionCON(message->message_id, data, cb, cb_param, max_retransmit, max_transmit_span)) {
     LOG(L_ERR, "remote=%.*s:%u message_id=%d - error creating client transaction\r\n", remote_ip.len, remote_ip.s,
         remote_port, message->message_id);
-    goto error;
+    return 0;
   }
+  flushSendQueue();
+  return 1;
+}
 
-  if (!this->handleTx(data)) {
-    LOG(L_ERR, "Error sending data of %d bytes\r\n", data.len);
+int CoAPPeer::sendReliablyBlockwise(CoAPMessage *message, CoAPPeer_ClientTransactionCallback_f cb, void *cb_param,
+                                    int window, int szx) {
+  COAP_ENCODE_BUFFER(b);
+  coap_blockwise_tx_t *t = 0;
+  str payload            = {0};
+  uint16_t transfer_id   = 0;
+  int encoded            = 0;
+  if (!message) {
+    LOG(L_ERR, "Null parameter\r\n");
+    return 0;
+  }
+  if (szx < 0) szx = COAP_BLOCKWISE_SZX;
+  if (szx > COAP_BLOCK_SZX_MAX) {
+    LOG(L_ERR, "Invalid block size exponent %d\r\n", szx);
+    return 0;
+  }
+  if (window <= 0) window = COAP_BLOCKWISE_WINDOW;
+  if (window > NSTART) window = NSTART;
+
+  /* Fits in one block - no need for the Block1 option */
+  if (message->payload.len <= (int)COAP_BLOCK_SIZE(szx)) return sendReliably(message, cb, cb_param);
+
+  if (message->payload.len > COAP_BLOCKWISE_MAX_SIZE) {
+    LOG(L_ERR, "Payload of %d bytes longer than maximum acceptable of %d bytes\r\n", message->payload.len,
+        COAP_BLOCKWISE_MAX_SIZE);
+    return 0;
+  }
+  if (!transportIsReady()) {
+    LOG(L_ERR, "Transport is not ready\r\n");
+    return 0;
+  }
+  if (blockwise_tx.space_left <= 0) {
+    LOG(L_WARN, "No space left for another block-wise transfer (too many in parallel)\r\n");
+    return 0;
+  }
+  switch (message->type) {
+    case CoAP_Type__Confirmable:
+      break;
+    case CoAP_Type__Non_Confirmable:
+      LOG(L_WARN, "Changing message type from NON to CON\r\n");
+      message->type = CoAP_Type__Confirmable;
+      break;
+    case CoAP_Type__Acknowledgement:
+    case CoAP_Type__Reset:
+      LOG(L_WARN, "ACK and RST can not be sent reliably\r\n");
+      return 0;
+      break;
+    default:
+      break;
+  }
+
+  /* The template for each block is the request without payload */
+  payload          = message->payload;
+  message->payload = (str){0};
+  encoded          = message->encode(&b);
+  message->payload = payload;
+  if (!encoded) {
+    LOG(L_ERR, "Error encoding message\r\n");
+    return 0;
+  }
+
+  WL_NEW(t, coap_blockwise_tx_list_t);
+  t->transfer_id = ++last_blockwise_transfer_id;
+  t->szx         = szx;
+  t->window      = window;
+  t->blocks      = (payload.len + COAP_BLOCK_SIZE(szx) - 1) / COAP_BLOCK_SIZE(szx);
+  t->expires     = owl_time() + EXCHANGE_LIFETIME * 1000;
+  t->cb          = cb;
+  t->cb_param    = cb_param;
+  str_dup(t->header, bin_to_str(b));
+  str_dup(t->payload, payload);
+  WL_APPEND(&blockwise_tx, t);
+  blockwise_tx.space_left--;
+  transfer_id = t->transfer_id;
+
+  LOG(L_INFO, "remote=%.*s:%u transfer_id=%u - sending %d bytes in %d blocks of %d bytes\r\n", remote_ip.len,
+      remote_ip.s, remote_port, transfer_id, payload.len, t->blocks, COAP_BLOCK_SIZE(szx));
+
+  if (!sendBlockwiseNext(transfer_id)) {
+    /* Nothing went out, so no callback will come - drop it silently */
+    t = getBlockwiseTx(transfer_id);
+    if (t) {
+      WL_DELETE(&blockwise_tx, t);
+      WL_FREE(t, coap_blockwise_tx_list_t);
+      blockwise_tx.space_left++;
+    }
     return 0;
   }
-  LOG(L_INFO, "remote=%.*s:%u - sent %d bytes\r\n", remote_ip.len, remote_ip.s, remote_port, data.len);
   return 1;
-error:
-  dropClientTransaction(message->message_id);
+out_of_memory:
+  WL_FREE(t, coap_blockwise_tx_list_t);
   return 0;
 }
 
@@ -436,14 +674,45 @@ int CoAPPeer::stopRetransmissions(coap_message_id_t message_id) {
 
   coap_client_transaction_t *t = getClientTransaction(message_id);
   if (!t) {
-    LOG(L_ERR, "message_id=%u - not found client transaction\r\n", message_id);
-    return 0;
+    /* Maybe it did not get out yet */
+    WL_FOREACH (&send_queue, t)
+      if (t->message_id == message_id) break;
+    if (!t) {
+      LOG(L_ERR, "message_id=%u - not found client transaction\r\n", message_id);
+      return 0;
+    }
+    WL_DELETE(&send_queue, t);
+    send_queue.space_left++;
+    /* Event: Canceled */
+    if (t->cb) (t->cb)(this, t->message_id, t->cb_param, CoAP_Client_Transaction_Event__Canceled, 0);
+    failPendingRequest(message_id);
+    WL_FREE(t, coap_client_transaction_list_t);
+    return 1;
   }
 
   /* Event: Canceled */
   if (t->cb) (t->cb)(this, t->message_id, t->cb_param, CoAP_Client_Transaction_Event__Canceled, 0);
+  failPendingRequest(message_id);
+
+  if (!dropClientTransaction(&t)) return 0;
+  flushSendQueue();
+  return 1;
+}
+
+int CoAPPeer::isBlockwiseTxFull() {
+  return blockwise_tx.space_left <= 0;
+}
+
+int CoAPPeer::isSendQueueFull() {
+  return send_queue.space_left <= SEND_QUEUE_RESERVED;
+}
+
+int CoAPPeer::getSendQueueLength() {
+  return SEND_QUEUE_MAX - send_queue.space_left;
+}
 
-  return dropClientTransaction(&t);
+int CoAPPeer::getCongestionWindow() {
+  return congestion_window;
 }
 
 int CoAPPeer::addInstance(CoAPPeer *x) {
@@ -487,6 +756,7 @@ int CoAPPeer::triggerPeriodicRetransmit() {
 int CoAPPeer::handleTx(str data) {
   switch (this->transport_type) {
     case CoAP_Transport__plaintext:
+    case CoAP_Transport__Modem_DTLS_PSK:
       return owlModem->socket.sendUDP(this->socket_id, data, 0);
       break;
     case CoAP_Transport__DTLS_PSK:
@@ -510,8 +780,14 @@ int CoAPPeer::handleRx(str data) {
   coap_handler_follow_up_e follow_up = CoAP__Handler_Followup__Do_Nothing;
   coap_client_transaction_t *tc      = 0;
   coap_server_transaction_t *ts      = 0;
+  int block1_reassembled             = 0;
+  uint64_t block1                    = 0;
   CoAPMessage message                = CoAPMessage();
   bin_t b                            = str_to_bin(data);
+
+  /* Step -1 - zero-copy and allocation-free fast path for simple requests */
+  if (handler_fast_request && handleRxFast(data)) return 1;
+
   if (!message.decode(&b)) {
     LOG(L_ERR, "Error decoding message\r\n");
     LOGBIN(L_ERR, b);
@@ -566,23 +842,13 @@ int CoAPPeer::handleRx(str data) {
     case CoAP_Type__Non_Confirmable:
       ts = getServerTransaction(message.message_id);
       if (ts) {
-        if (ts->ack_rst.len) {
-          if (handleTx(ts->ack_rst))
-            LOG(L_DBG, "remote=%.*s:%u message_id=%u old ACK/RST of bytes=%d resent\r\n", remote_ip.len, remote_ip.s,
-                remote_port, ts->message_id, ts->ack_rst.len);
-          else
-            LOG(L_ERR, "remote=%.*s:%u message_id=%u old ACK/RST of bytes=%d failure to re-send\r\n", remote_ip.len,
-                remote_ip.s, remote_port, ts->message_id, ts->ack_rst.len);
-        } else {
-          LOG(L_INFO, "remote=%.*s:%u message_id=%u - silently ignoring retransmission\r\n", remote_ip.len, remote_ip.s,
-              remote_port, ts->message_id);
-        }
+        replayServerTransaction(ts);
         // Skip further handlers
         goto done;
       } else {
         if (!putServerTransaction(message.message_id, message.type)) {
           LOG(L_ERR, "remote=%.*s:%u message_id=%u - error saving server transactions\r\n", remote_ip.len, remote_ip.s,
-              remote_port, ts->message_id);
+              remote_port, message.message_id);
         }
       }
       break;
@@ -592,7 +858,9 @@ int CoAPPeer::handleRx(str data) {
         LOG(L_DBG, "message_id=%u - received ACK\r\n", message.message_id);
         /* Event: ACK */
         if (tc->cb) (tc->cb)(this, tc->message_id, tc->cb_param, CoAP_Client_Transaction_Event__ACK, &message);
+        if (tc->type == CoAP_Type__Confirmable) congestionWindowOnACK();
         dropClientTransaction(&tc);
+        flushSendQueue();
       } else {
         LOG(L_WARN, "message_id=%u - received unexpected ACK\r\n", message.message_id);
       }
@@ -608,6 +876,8 @@ int CoAPPeer::handleRx(str data) {
         /* Event: RST */
         if (tc->cb) (tc->cb)(this, tc->message_id, tc->cb_param, CoAP_Client_Transaction_Event__RST, &message);
         dropClientTransaction(&tc);
+        failPendingRequest(message.message_id);
+        flushSendQueue();
       } else {
         LOG(L_WARN, "message_id=%u - received unexpected RST\r\n", message.message_id);
       }
@@ -619,7 +889,12 @@ int CoAPPeer::handleRx(str data) {
   }
 
 
-  /* Step 3 - Call Request/Response handlers */
+  /* Step 3 - Reassemble Block1 requests, such that the handlers get the full payload */
+  if (message.type == CoAP_Type__Confirmable || message.type == CoAP_Type__Non_Confirmable) {
+    if (!handleRxBlock1(&message, &block1_reassembled, &block1)) goto done;
+  }
+
+  /* Step 4 - Call Request/Response handlers - responses to pending requests go to their own callbacks instead */
   switch (message.type) {
     case CoAP_Type__Confirmable:
       switch (message.code_class) {
@@ -629,7 +904,8 @@ int CoAPPeer::handleRx(str data) {
         case CoAP_Code_Class__Response:
         case CoAP_Code_Class__Error:
         case CoAP_Code_Class__Server_Error:
-          if (this->handler_response) follow_up = (this->handler_response)(this, &message);
+          if (!handlePendingRequestResponse(&message, &follow_up) && this->handler_response)
+            follow_up = (this->handler_response)(this, &message);
           break;
         default:
           break;
@@ -643,7 +919,8 @@ int CoAPPeer::handleRx(str data) {
         case CoAP_Code_Class__Response:
         case CoAP_Code_Class__Error:
         case CoAP_Code_Class__Server_Error:
-          if (this->handler_response) (this->handler_response)(this, &message);
+          if (!handlePendingRequestResponse(&message, 0) && this->handler_response)
+            (this->handler_response)(this, &message);
           break;
         default:
           break;
@@ -654,7 +931,8 @@ int CoAPPeer::handleRx(str data) {
         case CoAP_Code_Class__Response:
         case CoAP_Code_Class__Error:
         case CoAP_Code_Class__Server_Error:
-          if (this->handler_response) (this->handler_response)(this, &message);
+          if (!handlePendingRequestResponse(&message, 0) && this->handler_response)
+            (this->handler_response)(this, &message);
           break;
         default:
           break;
@@ -669,6 +947,14 @@ int CoAPPeer::handleRx(str data) {
     case CoAP__Handler_Followup__Do_Nothing:
       break;
     case CoAP__Handler_Followup__Send_Acknowledgement: {
+      if (block1_reassembled) {
+        /* The final response to a Block1 transfer echoes the option of the last block */
+        CoAPMessage ack = CoAPMessage(&message, CoAP_Type__Acknowledgement, CoAP_Code_Class__Response,
+                                      CoAP_Code_Detail__Response__Changed);
+        ack.addOptionBlock1(block1);
+        this->sendUnreliably(&ack);
+        break;
+      }
       CoAPMessage ack = CoAPMessage(&message, CoAP_Type__Acknowledgement);
       this->sendUnreliably(&ack);
       break;
@@ -684,13 +970,201 @@ int CoAPPeer::handleRx(str data) {
   }
 
 done:
+  if (block1_reassembled) str_free(blockwise_rx);
   message.destroy();
   return 1;
 error:
+  if (block1_reassembled) str_free(blockwise_rx);
   message.destroy();
   return 0;
 }
 
+/**
+ * Fast path of handleRx(), for the CON/NON requests which the handler_fast_request can handle from a shallow view.
+ * No heap is used - de-duplication is done with the server transactions cache and the replies, being empty ACK or
+ * RST, are encoded on the stack and kept in the cache just as their type, to be re-encoded for retransmissions.
+ * @param data - the received message
+ * @return 1 if the message was handled here, 0 if it should go through the full handleRx()
+ */
+int CoAPPeer::handleRxFast(str data) {
+  coap_message_view_t view;
+  coap_handler_follow_up_e follow_up = CoAP__Handler_Followup__Do_Nothing;
+  coap_server_transaction_t *ts      = 0;
+  uint32_t latency                   = 0;
+  uint8_t buf[4];
+  str reply = {.s = (char *)buf, .len = 4};
+
+  if (!CoAPMessage::decodeView(data, &view)) return 0;
+  if (view.type != CoAP_Type__Confirmable && view.type != CoAP_Type__Non_Confirmable) return 0;
+  if (view.code_class != CoAP_Code_Class__Request || view.has_other_options) return 0;
+
+  ts = getServerTransaction(view.message_id);
+  if (ts) {
+    LOG(L_INFO, "remote=%.*s:%u message_id=%u - retransmission of request, on the fast path\r\n", remote_ip.len,
+        remote_ip.s, remote_port, view.message_id);
+    replayServerTransaction(ts);
+    return 1;
+  }
+
+  follow_up = (handler_fast_request)(this, &view);
+  if (follow_up == CoAP__Handler_Followup__Not_Handled) {
+    fast_path_stats.fallback_count++;
+    return 0;
+  }
+  latency = owl_time_us() - rx_time;
+  if (!fast_path_stats.count || latency < fast_path_stats.latency_min) fast_path_stats.latency_min = latency;
+  if (latency > fast_path_stats.latency_max) fast_path_stats.latency_max = latency;
+  fast_path_stats.latency_last = latency;
+  fast_path_stats.latency_total += latency;
+  fast_path_stats.count++;
+
+  if (!putServerTransaction(view.message_id, view.type))
+    LOG(L_ERR, "remote=%.*s:%u message_id=%u - error saving server transactions\r\n", remote_ip.len, remote_ip.s,
+        remote_port, view.message_id);
+
+  /* Empty ACK or RST - just the header, https://tools.ietf.org/html/rfc7252#section-4.2 */
+  switch (follow_up) {
+    case CoAP__Handler_Followup__Do_Nothing:
+      return 1;
+    case CoAP__Handler_Followup__Send_Acknowledgement:
+      if (view.type != CoAP_Type__Confirmable) return 1;
+      buf[0] = (CoAP_Version__1 << 6) | (CoAP_Type__Acknowledgement << 4);
+      break;
+    case CoAP__Handler_Followup__Send_Reset:
+      buf[0] = (CoAP_Version__1 << 6) | (CoAP_Type__Reset << 4);
+      break;
+    default:
+      LOG(L_ERR, "Not implemented for follow_up %d\r\n", follow_up);
+      return 1;
+  }
+  buf[1] = (CoAP_Code_Class__Empty_Message << 5) | CoAP_Code_Detail__Empty_Message;
+  buf[2] = view.message_id >> 8;
+  buf[3] = view.message_id & 0xFFu;
+  setServerTransactionReply(view.message_id, reply);
+  if (!handleTx(reply)) LOG(L_ERR, "Error sending fast path reply for message_id=%u\r\n", view.message_id);
+  return 1;
+}
+
+/**
+ * Reassemble incoming Block1 requests. Intermediary blocks are acknowledged here with 2.31 Continue, while the last
+ * one has its payload replaced with the full reassembled one, to be passed on to the handlers.
+ * @param message - the received request
+ * @param out_reassembled - set to 1 if the payload was replaced with the reassembled one
+ * @param out_block1 - the Block1 option value of the last block, to be echoed in the final response
+ * @return 1 if the message should be passed on to the handlers, 0 if it was consumed here
+ */
+int CoAPPeer::handleRxBlock1(CoAPMessage *message, int *out_reassembled, uint64_t *out_block1) {
+  uint64_t block1  = 0;
+  uint64_t size1   = 0;
+  uint32_t num     = 0;
+  uint32_t offset  = 0;
+  uint8_t szx      = 0;
+  int more         = 0;
+  char *new_buffer = 0;
+  owl_time_t now   = owl_time();
+  *out_reassembled = 0;
+
+  if (message->code_class != CoAP_Code_Class__Request || message->code_detail == CoAP_Code_Detail__Empty_Message)
+    return 1;
+  if (!message->getNextOptionBlock1(&block1, 0)) return 1;
+
+  num  = COAP_BLOCK_NUM(block1);
+  more = COAP_BLOCK_MORE(block1);
+  szx  = COAP_BLOCK_SZX(block1);
+  if (szx > COAP_BLOCK_SZX_MAX) {
+    LOG(L_WARN, "message_id=%u - Block1 with reserved SZX=7\r\n", message->message_id);
+    replyRxBlock1(message, CoAP_Code_Class__Error, CoAP_Code_Detail__Error__Bad_Request, block1, 0);
+    goto drop;
+  }
+  offset = num * COAP_BLOCK_SIZE(szx);
+
+  if (blockwise_rx_expires && blockwise_rx_expires <= now) {
+    LOG(L_INFO, "remote=%.*s:%u - dropping expired incomplete Block1 transfer of %d bytes\r\n", remote_ip.len,
+        remote_ip.s, remote_port, blockwise_rx.len);
+    str_free(blockwise_rx);
+    blockwise_rx_expires = 0;
+  }
+
+  if (num == 0) {
+    /* A new transfer replaces any older incomplete one */
+    str_free(blockwise_rx);
+    if (message->getNextOptionSize1(&size1, 0) && size1 > COAP_BLOCKWISE_MAX_SIZE) {
+      LOG(L_WARN, "message_id=%u - Block1 transfer of %llu bytes too large\r\n", message->message_id, size1);
+      replyRxBlock1(message, CoAP_Code_Class__Error, CoAP_Code_Detail__Error__Request_Entity_Too_Large, block1, 1);
+      goto drop;
+    }
+  } else if (!blockwise_rx_expires) {
+    LOG(L_WARN, "message_id=%u - Block1 NUM=%u without a transfer in progress\r\n", message->message_id, num);
+    replyRxBlock1(message, CoAP_Code_Class__Error, CoAP_Code_Detail__Error__Request_Entity_Incomplete, block1, 0);
+    goto drop;
+  }
+
+  if (offset < (uint32_t)blockwise_rx.len) {
+    /* Already appended, re-sent with a new message_id - acknowledge again, as the previous reply was lost */
+    if (more) replyRxBlock1(message, CoAP_Code_Class__Response, CoAP_Code_Detail__Response__Continue, block1, 0);
+    return 0;
+  }
+  if (offset > (uint32_t)blockwise_rx.len) {
+    LOG(L_WARN, "message_id=%u - Block1 NUM=%u at offset %u, but only %d bytes received so far\r\n",
+        message->message_id, num, offset, blockwise_rx.len);
+    replyRxBlock1(message, CoAP_Code_Class__Error, CoAP_Code_Detail__Error__Request_Entity_Incomplete, block1, 0);
+    goto drop;
+  }
+  if (offset + message->payload.len > COAP_BLOCKWISE_MAX_SIZE) {
+    LOG(L_WARN, "message_id=%u - Block1 transfer exceeding %d bytes\r\n", message->message_id,
+        COAP_BLOCKWISE_MAX_SIZE);
+    replyRxBlock1(message, CoAP_Code_Class__Error, CoAP_Code_Detail__Error__Request_Entity_Too_Large, block1, 1);
+    goto drop;
+  }
+
+  if (message->payload.len) {
+    new_buffer = (char *)owl_realloc(blockwise_rx.s, blockwise_rx.len + message->payload.len);
+    if (!new_buffer) {
+      LOG(L_ERR, "Error allocating %d bytes\r\n", blockwise_rx.len + message->payload.len);
+      replyRxBlock1(message, CoAP_Code_Class__Server_Error, CoAP_Code_Detail__Server_Error__Internal_Server_Error,
+                    block1, 0);
+      goto drop;
+    }
+    blockwise_rx.s = new_buffer;
+    memcpy(blockwise_rx.s + blockwise_rx.len, message->payload.s, message->payload.len);
+    blockwise_rx.len += message->payload.len;
+  }
+  blockwise_rx_expires = now + EXCHANGE_LIFETIME * 1000;
+
+  if (more) {
+    replyRxBlock1(message, CoAP_Code_Class__Response, CoAP_Code_Detail__Response__Continue, block1, 0);
+    return 0;
+  }
+
+  LOG(L_INFO, "remote=%.*s:%u - Block1 transfer of %d bytes in %u blocks complete\r\n", remote_ip.len, remote_ip.s,
+      remote_port, blockwise_rx.len, num + 1);
+  message->payload     = blockwise_rx;
+  blockwise_rx_expires = 0;
+  *out_reassembled     = 1;
+  *out_block1          = block1;
+  return 1;
+
+drop:
+  str_free(blockwise_rx);
+  blockwise_rx_expires = 0;
+  return 0;
+}
+
+void CoAPPeer::replyRxBlock1(CoAPMessage *message, coap_code_class_e code_class, coap_code_detail_e code_detail,
+                             uint64_t block1, int with_size1) {
+  if (message->type == CoAP_Type__Non_Confirmable && code_class == CoAP_Code_Class__Response) {
+    /* No need to Continue on NON - the sender does not wait for it */
+    return;
+  }
+  CoAPMessage reply = CoAPMessage(
+      message, message->type == CoAP_Type__Confirmable ? CoAP_Type__Acknowledgement : CoAP_Type__Non_Confirmable,
+      code_class, code_detail);
+  if (reply.type == CoAP_Type__Non_Confirmable) reply.message_id = getNextMessageId();
+  reply.addOptionBlock1(block1);
+  if (with_size1) reply.addOptionSize1(COAP_BLOCKWISE_MAX_SIZE);
+  this->sendUnreliably(&reply);
+}
+
 
 
 /*
@@ -708,19 +1182,76 @@ int CoAPPeer::dropExpiredClientTransactions() {
 
     WL_DELETE(&client_transactions, t);
 
+    if (t->type == CoAP_Type__Confirmable) congestionWindowOnTimeout();
+
     /* Event: Timeout */
     if (t->cb) (t->cb)(this, t->message_id, t->cb_param, CoAP_Client_Transaction_Event__Timeout, 0);
+    failPendingRequest(t->message_id);
 
     WL_FREE(t, coap_client_transaction_list_t);
     client_transactions.space_left++;
+    cnt++;
+  }
+
+  /* Drop the queued ones which could not go out in time, e.g. because the transport stayed down - one at a time, as
+   * the callbacks might queue others */
+  while (1) {
+    WL_FOREACH (&send_queue, t)
+      if (t->expires <= now) break;
+    if (!t) break;
+
+    WL_DELETE(&send_queue, t);
+    send_queue.space_left++;
+
+    /* Event: Timeout */
+    if (t->cb) (t->cb)(this, t->message_id, t->cb_param, CoAP_Client_Transaction_Event__Timeout, 0);
+    failPendingRequest(t->message_id);
+
+    WL_FREE(t, coap_client_transaction_list_t);
+    cnt++;
   }
 
   return cnt;
 }
 
+/**
+ * End all the client transactions and block-wise transfers, queued or in flight, with the Canceled event - their
+ * callbacks are owed a final event.
+ * @return the number of client transactions canceled
+ */
+int CoAPPeer::cancelClientTransactions() {
+  coap_client_transaction_t *t = 0;
+  coap_blockwise_tx_t *bt      = 0;
+  int cnt                      = 0;
+
+  /* One at a time from the heads, as the callbacks might change the lists */
+  while ((t = send_queue.head) != 0 || (t = client_transactions.head) != 0) {
+    if (t == send_queue.head) {
+      WL_DELETE(&send_queue, t);
+      send_queue.space_left++;
+    } else {
+      WL_DELETE(&client_transactions, t);
+      client_transactions.space_left++;
+    }
+
+    /* Event: Canceled */
+    if (t->cb) (t->cb)(this, t->message_id, t->cb_param, CoAP_Client_Transaction_Event__Canceled, 0);
+    failPendingRequest(t->message_id);
+
+    WL_FREE(t, coap_client_transaction_list_t);
+    cnt++;
+  }
+
+  while ((bt = blockwise_tx.head) != 0)
+    finishBlockwiseTx(&bt, 0, CoAP_Client_Transaction_Event__Canceled, 0);
+
+  return cnt;
+}
+
 int CoAPPeer::triggerClientTransactionRetransmissions() {
   switch (transport_type) {
     case CoAP_Transport__plaintext:
+    case CoAP_Transport__Modem_DTLS_PSK:
       // nothing here
       break;
     case CoAP_Transport__DTLS_PSK:
@@ -734,6 +1265,7 @@ int CoAPPeer::triggerClientTransactionRetransmissions() {
   }
 
   dropExpiredClientTransactions();
+  dropExpiredPendingRequests();
 
   coap_client_transaction_t *t = 0, *nt = 0;
   owl_time_t now = owl_time();
@@ -749,11 +1281,20 @@ int CoAPPeer::triggerClientTransactionRetransmissions() {
       LOG(L_ERR, "message_id=%u failed to re-transmit bytes=%d\r\n", t->message_id, t->message.len);
     }
 
-    if (t->type == CoAP_Type__Confirmable) t->retransmission_interval *= 2;
+    if (t->type == CoAP_Type__Confirmable) {
+      /* The first retransmission is the loss signal - back off, without collapsing on each further one */
+      if (t->retransmissions_left == MAX_RETRANSMIT) congestionWindowOnTimeout();
+      t->retransmission_interval *= 2;
+    }
     t->expires = now + t->retransmission_interval;
     t->retransmissions_left--;
   }
 
+  /* Expired transactions might have opened the congestion window */
+  flushSendQueue();
+
+  triggerBlockwiseTx();
+
   return cnt;
 }
 
@@ -769,24 +1310,30 @@ int CoAPPeer::putClientTransactionCON(coap_message_id_t message_id, str message,
       LOG(L_ERR, "message_id=%u - Transaction already saved\r\n", message_id);
       return 0;
     }
+  WL_FOREACH (&send_queue, t)
+    if (t->message_id == message_id) {
+      LOG(L_ERR, "message_id=%u - Transaction already queued\r\n", message_id);
+      return 0;
+    }
 
-  if (client_transactions.space_left == 0) {
-    LOG(L_ERR, "message_id=%u - No space left for client transaction (too many in parallel)\r\n", message_id);
+  if (send_queue.space_left <= 0) {
+    LOG(L_WARN, "message_id=%u - No space left in the send queue (too many waiting for the congestion window)\r\n",
+        message_id);
     return 0;
   }
 
+  /* Timers are started by flushSendQueue(), when actually sent out - until then, expires bounds the wait in the queue */
   WL_NEW(t, coap_client_transaction_list_t);
-  t->message_id              = message_id;
-  t->type                    = CoAP_Type__Confirmable;
-  t->retransmission_interval = ACK_TIMEOUT * 1000 + random((float)ACK_TIMEOUT * 1000.0 * ACK_RANDOM_FACTOR);
-  t->expires                 = owl_time() + t->retransmission_interval;
-  t->retransmissions_left    = MAX_RETRANSMIT;
+  t->message_id           = message_id;
+  t->type                 = CoAP_Type__Confirmable;
+  t->expires              = owl_time() + MAX_TRANSMIT_WAIT * 1000;
+  t->retransmissions_left = MAX_RETRANSMIT;
   str_dup(t->message, message);
   t->cb       = cb;
   t->cb_param = cb_param;
 
-  WL_APPEND(&client_transactions, t);
-  client_transactions.space_left--;
+  WL_APPEND(&send_queue, t);
+  send_queue.space_left--;
   //  logClientTransactions(L_NOTICE);
 
   return 1;
@@ -866,6 +1413,216 @@ int CoAPPeer::dropClientTransaction(coap_message_id_t message_id) {
   return cnt;
 }
 
+int CoAPPeer::flushSendQueue() {
+  coap_client_transaction_t *t = 0;
+  int cnt                      = 0;
+
+  if (!send_queue.head) return 0;
+  if (!transportIsReady()) {
+    LOG(L_DBG, "remote_ip=%.*s:%u - transport not ready - keeping %d messages queued\r\n", remote_ip.len, remote_ip.s,
+        remote_port, getSendQueueLength());
+    return 0;
+  }
+
+  while ((t = send_queue.head) != 0 && client_transactions.space_left > 0 &&
+         countClientTransactionsCON() < congestion_window) {
+    WL_DELETE(&send_queue, t);
+    send_queue.space_left++;
+
+    t->retransmission_interval =
+        ACK_TIMEOUT * 1000 + dtls_drbg_uint32() % (uint32_t)((float)ACK_TIMEOUT * 1000.0 * ACK_RANDOM_FACTOR);
+    t->expires                 = owl_time() + t->retransmission_interval;
+    WL_APPEND(&client_transactions, t);
+    client_transactions.space_left--;
+
+    /* On failure, this is still in flight and it will be retransmitted on the timer */
+    if (!handleTx(t->message)) {
+      LOG(L_ERR, "message_id=%u - error sending data of %d bytes\r\n", t->message_id, t->message.len);
+    } else {
+      LOG(L_INFO, "remote=%.*s:%u message_id=%u - sent %d bytes\r\n", remote_ip.len, remote_ip.s, remote_port,
+          t->message_id, t->message.len);
+    }
+    cnt++;
+  }
+
+  return cnt;
+}
+
+int CoAPPeer::countClientTransactionsCON() {
+  coap_client_transaction_t *t = 0;
+  int cnt                      = 0;
+  WL_FOREACH (&client_transactions, t)
+    if (t->type == CoAP_Type__Confirmable) cnt++;
+  return cnt;
+}
+
+void CoAPPeer::congestionWindowOnACK() {
+  /* Additive increase - one more slot after a full window was acknowledged */
+  if (congestion_window >= NSTART) return;
+  if (++congestion_window_acks < congestion_window) return;
+  congestion_window++;
+  congestion_window_acks = 0;
+  LOG(L_DBG, "remote_ip=%.*s:%u - congestion window increased to %d\r\n", remote_ip.len, remote_ip.s, remote_port,
+      congestion_window);
+}
+
+void CoAPPeer::congestionWindowOnTimeout() {
+  /* Multiplicative decrease */
+  congestion_window_acks = 0;
+  if (congestion_window <= 1) return;
+  congestion_window /= 2;
+  LOG(L_INFO, "remote_ip=%.*s:%u - congestion window decreased to %d\r\n", remote_ip.len, remote_ip.s, remote_port,
+      congestion_window);
+}
+
+/*
+ * Block-wise transfers
+ */
+
+coap_blockwise_tx_t *CoAPPeer::getBlockwiseTx(uint16_t transfer_id) {
+  coap_blockwise_tx_t *t = 0;
+  WL_FOREACH (&blockwise_tx, t)
+    if (t->transfer_id == transfer_id) return t;
+  return 0;
+}
+
+int CoAPPeer::sendBlock(coap_blockwise_tx_t *t, int num) {
+  CoAPMessage block = CoAPMessage();
+  bin_t b           = str_to_bin(t->header);
+  uint32_t size     = COAP_BLOCK_SIZE(t->szx);
+  uint32_t offset   = num * size;
+  int more          = offset + size < (uint32_t)t->payload.len;
+  void *cb_param    = (void *)(uintptr_t)(((uint32_t)t->transfer_id << 16) | (uint32_t)num);
+  int result        = 0;
+
+  if (!block.decode(&b)) {
+    LOG(L_ERR, "transfer_id=%u - Error decoding template\r\n", t->transfer_id);
+    goto done;
+  }
+  block.message_id = getNextMessageId();
+  if (!block.addOptionBlock1(COAP_BLOCK_VALUE(num, more, t->szx))) {
+    LOG(L_ERR, "Error adding Block1\r\n");
+    goto done;
+  }
+  if (num == 0 && !block.addOptionSize1(t->payload.len)) {
+    LOG(L_ERR, "Error adding Size1\r\n");
+    goto done;
+  }
+  block.payload.s   = t->payload.s + offset;
+  block.payload.len = more ? size : t->payload.len - offset;
+
+  LOG(L_DBG, "transfer_id=%u message_id=%u - sending block %d/%d of %d bytes\r\n", t->transfer_id, block.message_id,
+      num + 1, t->blocks, block.payload.len);
+  /* The cb_param carries ids instead of a pointer, as the transfer might be gone by the time the callback comes */
+  result = sendReliably(&block, CoAPPeer::callback_blockwiseTx, cb_param);
+done:
+  block.destroy();
+  return result;
+}
+
+/**
+ * Send the next blocks of a transfer, as far as its window allows. The transfer is looked-up by id after each block,
+ * because sending might trigger timeouts, which end the transfer.
+ * @param transfer_id
+ * @return the number of blocks sent
+ */
+int CoAPPeer::sendBlockwiseNext(uint16_t transfer_id) {
+  coap_blockwise_tx_t *t = 0;
+  int cnt                = 0;
+  int num                = 0;
+  int sent               = 0;
+  /* The reserved slots of the send queue are not for blocks - the transfer goes on as the ACKs come in */
+  while ((t = getBlockwiseTx(transfer_id)) != 0 && t->in_flight < t->window && t->next_num < t->blocks &&
+         !isSendQueueFull()) {
+    /* The last block completes the request on the server side, so it waits for all the others to be acknowledged */
+    if (t->next_num == t->blocks - 1 && t->acked < t->blocks - 1) break;
+    num  = t->next_num;
+    sent = sendBlock(t, num);
+    if (!(t = getBlockwiseTx(transfer_id))) break;
+    if (!sent) break;
+    t->next_num++;
+    t->in_flight++;
+    t->expires = owl_time() + EXCHANGE_LIFETIME * 1000;
+    cnt++;
+  }
+  return cnt;
+}
+
+void CoAPPeer::finishBlockwiseTx(coap_blockwise_tx_t **t, coap_message_id_t message_id,
+                                 coap_client_transaction_event_e event, CoAPMessage *message) {
+  if (!t || !*t) return;
+  WL_DELETE(&blockwise_tx, *t);
+  blockwise_tx.space_left++;
+  LOG(L_INFO, "remote=%.*s:%u transfer_id=%u - finished with event %d after %d/%d blocks acknowledged\r\n",
+      remote_ip.len, remote_ip.s, remote_port, (*t)->transfer_id, event, (*t)->acked, (*t)->blocks);
+  if ((*t)->cb) ((*t)->cb)(this, message_id, (*t)->cb_param, event, message);
+  WL_FREE(*t, coap_blockwise_tx_list_t);
+  *t = 0;
+}
+
+/**
+ * Periodic processing of the block-wise transfers - expire the stuck ones and restart the ones which could not send
+ * the next block earlier (e.g. full send queue, or transport not ready).
+ * @return number of blocks sent
+ */
+int CoAPPeer::triggerBlockwiseTx() {
+  coap_blockwise_tx_t *t = 0, *nt = 0;
+  uint16_t transfer_ids[COAP_BLOCKWISE_TX_MAX];
+  int cnt        = 0, n = 0;
+  owl_time_t now = owl_time();
+
+  WL_FOREACH_SAFE (&blockwise_tx, t, nt) {
+    if (t->in_flight > 0 || t->expires > now) continue;
+    /* Event: Timeout */
+    finishBlockwiseTx(&t, 0, CoAP_Client_Transaction_Event__Timeout, 0);
+  }
+
+  WL_FOREACH (&blockwise_tx, t)
+    if (t->in_flight == 0 && n < COAP_BLOCKWISE_TX_MAX) transfer_ids[n++] = t->transfer_id;
+  for (int i = 0; i < n; i++)
+    cnt += sendBlockwiseNext(transfer_ids[i]);
+  return cnt;
+}
+
+void CoAPPeer::handleBlockwiseTxEvent(uint16_t transfer_id, int num, coap_message_id_t message_id,
+                                      coap_client_transaction_event_e event, CoAPMessage *message) {
+  coap_blockwise_tx_t *t = getBlockwiseTx(transfer_id);
+  if (!t) {
+    LOG(L_DBG, "transfer_id=%u message_id=%u - transfer already finished - ignoring event %d\r\n", transfer_id,
+        message_id, event);
+    return;
+  }
+  t->in_flight--;
+  switch (event) {
+    case CoAP_Client_Transaction_Event__ACK:
+      if (message && message->code_class != CoAP_Code_Class__Empty_Message &&
+          message->code_class != CoAP_Code_Class__Response) {
+        LOG(L_WARN, "transfer_id=%u message_id=%u - block %d rejected with %d.%02d - %s\r\n", transfer_id,
+            message_id, num, message->code_class, message->code_detail,
+            coap_code_text(message->code_class, message->code_detail));
+        finishBlockwiseTx(&t, message_id, CoAP_Client_Transaction_Event__RST, message);
+        return;
+      }
+      t->acked++;
+      if (num == t->blocks - 1) {
+        /* Event: ACK - of the last block */
+        finishBlockwiseTx(&t, message_id, CoAP_Client_Transaction_Event__ACK, message);
+        return;
+      }
+      sendBlockwiseNext(transfer_id);
+      return;
+    default:
+      finishBlockwiseTx(&t, message_id, event, message);
+      return;
+  }
+}
+
+void CoAPPeer::callback_blockwiseTx(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
+                                    coap_client_transaction_event_e event, CoAPMessage *message) {
+  uint32_t ids = (uint32_t)(uintptr_t)cb_param;
+  peer->handleBlockwiseTxEvent((uint16_t)(ids >> 16), (int)(ids & 0xFFFFu), message_id, event, message);
+}
+
 void CoAPPeer::logClientTransactions(log_level_t level) {
   dropExpiredClientTransactions();
 
@@ -874,7 +1631,7 @@ void CoAPPeer::logClientTransactions(log_level_t level) {
   coap_client_transaction_t *t;
   owl_time_t now = owl_time();
   float seconds;
-  LOGF(level, "--- CoAP Client Transactions ---\r\n");
+  LOGF(level, "--- CoAP Client Transactions --- window=%d queued=%d\r\n", congestion_window, getSendQueueLength());
   WL_FOREACH (&client_transactions, t) {
     if (t->expires > now)
       seconds = (float)(t->expires - now) / 1000.0;
@@ -895,23 +1652,77 @@ void CoAPPeer::logClientTransactions(log_level_t level) {
  * Server Transactions
  */
 
-int CoAPPeer::dropExpiredServerTransactions() {
-  owl_time_t now               = owl_time();
-  coap_server_transaction_t *t = 0;
-  int cnt                      = 0;
-  while (server_transactions.head && server_transactions.head->expires <= now) {
-    t = server_transactions.head;
-    WL_DELETE(&this->server_transactions, t);
-    WL_FREE(t, coap_server_transaction_list_t);
-    server_transactions.space_left++;
-    cnt++;
+#define SERVER_TRANSACTION_BUCKET(message_id)                                                                          \
+  (((message_id) ^ ((message_id) >> 8)) & (COAP_SERVER_TRANSACTION_BUCKETS - 1))
+#define SERVER_TRANSACTION_QUEUE(type) ((type) == CoAP_Type__Confirmable ? 0 : 1)
+
+void CoAPPeer::initServerTransactions() {
+  coap_server_transaction_cache_t *c = &server_transactions;
+  for (int i = 0; i < COAP_SERVER_TRANSACTION_BUCKETS; i++)
+    c->buckets[i] = -1;
+  for (int i = 0; i < NSYNC; i++) {
+    c->slots[i].ack_rst     = {0};
+    c->slots[i].reply       = CoAP_Server_Transaction_Reply__None;
+    c->slots[i].hash_next   = -1;
+    c->slots[i].expiry_next = i + 1 < NSYNC ? i + 1 : -1;
   }
+  c->free_head                   = 0;
+  c->expiry_head[0]              = c->expiry_head[1] = -1;
+  c->expiry_tail[0]              = c->expiry_tail[1] = -1;
+  server_transaction_stats.count = 0;
+}
+
+void CoAPPeer::freeServerTransactions() {
+  for (int i = 0; i < NSYNC; i++)
+    str_free(server_transactions.slots[i].ack_rst);
+  initServerTransactions();
+}
+
+/**
+ * Remove the oldest server transaction of its expiry queue - only ever called for the heads of those queues.
+ * @param idx - index of the slot, which must be the head of its expiry queue
+ */
+void CoAPPeer::dropServerTransaction(int16_t idx) {
+  coap_server_transaction_cache_t *c = &server_transactions;
+  coap_server_transaction_t *t       = &c->slots[idx];
+  int16_t *prev                      = &c->buckets[SERVER_TRANSACTION_BUCKET(t->message_id)];
+  int q                              = SERVER_TRANSACTION_QUEUE(t->type);
+
+  while (*prev != -1 && *prev != idx)
+    prev = &c->slots[*prev].hash_next;
+  if (*prev == idx) *prev = t->hash_next;
+
+  c->expiry_head[q] = t->expiry_next;
+  if (c->expiry_head[q] == -1) c->expiry_tail[q] = -1;
+
+  str_free(t->ack_rst);
+  t->reply       = CoAP_Server_Transaction_Reply__None;
+  t->hash_next   = -1;
+  t->expiry_next = c->free_head;
+  c->free_head   = idx;
+  server_transaction_stats.count--;
+}
+
+int CoAPPeer::dropExpiredServerTransactions() {
+  coap_server_transaction_cache_t *c = &server_transactions;
+  owl_time_t now                     = owl_time();
+  int cnt                            = 0;
+  for (int q = 0; q < 2; q++)
+    while (c->expiry_head[q] != -1 && c->slots[c->expiry_head[q]].expires <= now) {
+      dropServerTransaction(c->expiry_head[q]);
+      server_transaction_stats.expired_count++;
+      cnt++;
+    }
   return cnt;
 }
 
 int CoAPPeer::putServerTransaction(coap_message_id_t message_id, coap_type_e type) {
-  coap_server_transaction_t *t = 0;
+  coap_server_transaction_cache_t *c = &server_transactions;
+  coap_server_transaction_t *t       = 0;
   owl_time_t expires;
+  int16_t idx = -1;
+  int bucket  = SERVER_TRANSACTION_BUCKET(message_id);
+  int q       = SERVER_TRANSACTION_QUEUE(type);
   switch (type) {
     case CoAP_Type__Confirmable:
       expires = owl_time() + EXCHANGE_LIFETIME * 1000;
@@ -924,65 +1735,125 @@ int CoAPPeer::putServerTransaction(coap_message_id_t message_id, coap_type_e typ
       return 0;
   }
 
-  dropExpiredServerTransactions();
-
-  WL_FOREACH (&server_transactions, t)
-    if (t->message_id == message_id) {
-      LOG(L_ERR, "Transaction for message_id=%u already saved\r\n", message_id);
-      return 0;
-    }
+  if (getServerTransaction(message_id)) {
+    LOG(L_ERR, "Transaction for message_id=%u already saved\r\n", message_id);
+    return 0;
+  }
 
-  if (server_transactions.space_left == 0) {
-    // drop the oldest
-    if (server_transactions.head) {
-      t = server_transactions.head;
-      WL_DELETE(&server_transactions, t);
-      WL_FREE(t, coap_server_transaction_list_t);
-      server_transactions.space_left++;
-    } else {
-      LOG(L_ERR, "Server transactions list empty - badly configured or bug\r\n");
+  if (c->free_head == -1) {
+    // drop the one closest to expiry
+    if (c->expiry_head[0] == -1 && c->expiry_head[1] == -1) {
+      LOG(L_ERR, "Server transactions cache empty, yet full - badly configured or bug\r\n");
       return 0;
     }
+    if (c->expiry_head[1] == -1 ||
+        (c->expiry_head[0] != -1 && c->slots[c->expiry_head[0]].expires <= c->slots[c->expiry_head[1]].expires))
+      dropServerTransaction(c->expiry_head[0]);
+    else
+      dropServerTransaction(c->expiry_head[1]);
+    server_transaction_stats.eviction_count++;
   }
 
-  WL_NEW(t, coap_server_transaction_list_t);
-  WL_INSERT_SORT(&server_transactions, coap_server_transaction_list_t, t);
-  t->message_id = message_id;
-  t->expires    = expires;
-  t->type       = type;
-  server_transactions.space_left--;
+  idx          = c->free_head;
+  t            = &c->slots[idx];
+  c->free_head = t->expiry_next;
+
+  t->message_id  = message_id;
+  t->type        = type;
+  t->expires     = expires;
+  t->reply       = CoAP_Server_Transaction_Reply__None;
+  t->hash_next   = c->buckets[bucket];
+  t->expiry_next = -1;
+
+  c->buckets[bucket] = idx;
+
+  if (c->expiry_tail[q] == -1)
+    c->expiry_head[q] = idx;
+  else
+    c->slots[c->expiry_tail[q]].expiry_next = idx;
+  c->expiry_tail[q] = idx;
+  server_transaction_stats.count++;
 
   return 1;
-out_of_memory:
-  WL_FREE(t, coap_server_transaction_list_t);
-  return 0;
 }
 
 int CoAPPeer::setServerTransactionReply(coap_message_id_t message_id, str ack_rst) {
-  coap_server_transaction_t *t = 0;
-
-  dropExpiredServerTransactions();
-
-  WL_FOREACH (&server_transactions, t)
-    if (t->message_id == message_id) {
-      str_dup_safe(t->ack_rst, ack_rst);
-      return 1;
+  coap_server_transaction_t *t = getServerTransaction(message_id);
+  if (!t) return 0;
+
+  str_free(t->ack_rst);
+  /* Empty ACK/RST, without token - kept just as the type, to not use the heap for the most common case */
+  if (ack_rst.len == 4 && (ack_rst.s[0] & 0x0F) == 0 && ack_rst.s[1] == 0) {
+    switch ((ack_rst.s[0] >> 4) & 0x03) {
+      case CoAP_Type__Acknowledgement:
+        t->reply = CoAP_Server_Transaction_Reply__Empty_ACK;
+        return 1;
+      case CoAP_Type__Reset:
+        t->reply = CoAP_Server_Transaction_Reply__Empty_RST;
+        return 1;
+      default:
+        break;
     }
+  }
+  t->reply = CoAP_Server_Transaction_Reply__None;
+  str_dup(t->ack_rst, ack_rst);
+  t->reply = CoAP_Server_Transaction_Reply__Stored;
+  return 1;
 out_of_memory:
   return 0;
 }
 
 coap_server_transaction_t *CoAPPeer::getServerTransaction(coap_message_id_t message_id) {
-  coap_server_transaction_t *t = 0;
+  coap_server_transaction_cache_t *c = &server_transactions;
+  int16_t idx;
 
   dropExpiredServerTransactions();
 
-  WL_FOREACH (&server_transactions, t)
-    if (t->message_id == message_id) return t;
+  for (idx = c->buckets[SERVER_TRANSACTION_BUCKET(message_id)]; idx != -1; idx = c->slots[idx].hash_next)
+    if (c->slots[idx].message_id == message_id) return &c->slots[idx];
 
   return 0;
 }
 
+/**
+ * Handle a duplicate of an incoming CON/NON - the ACK/RST sent for the original one, if any, is sent again.
+ * @param t - the server transaction found for the duplicate
+ * @return 1 on success, 0 on failure to re-send
+ */
+int CoAPPeer::replayServerTransaction(coap_server_transaction_t *t) {
+  uint8_t buf[4];
+  str ack_rst = {.s = (char *)buf, .len = 4};
+
+  server_transaction_stats.hit_count++;
+  switch (t->reply) {
+    case CoAP_Server_Transaction_Reply__Stored:
+      ack_rst = t->ack_rst;
+      break;
+    case CoAP_Server_Transaction_Reply__Empty_ACK:
+    case CoAP_Server_Transaction_Reply__Empty_RST:
+      buf[0] = (CoAP_Version__1 << 6) |
+               ((t->reply == CoAP_Server_Transaction_Reply__Empty_ACK ? CoAP_Type__Acknowledgement : CoAP_Type__Reset)
+                << 4);
+      buf[1] = (CoAP_Code_Class__Empty_Message << 5) | CoAP_Code_Detail__Empty_Message;
+      buf[2] = t->message_id >> 8;
+      buf[3] = t->message_id & 0xFFu;
+      break;
+    default:
+      LOG(L_INFO, "remote=%.*s:%u message_id=%u - silently ignoring retransmission\r\n", remote_ip.len, remote_ip.s,
+          remote_port, t->message_id);
+      return 1;
+  }
+  if (!handleTx(ack_rst)) {
+    LOG(L_ERR, "remote=%.*s:%u message_id=%u old ACK/RST of bytes=%d failure to re-send\r\n", remote_ip.len,
+        remote_ip.s, remote_port, t->message_id, ack_rst.len);
+    return 0;
+  }
+  LOG(L_DBG, "remote=%.*s:%u message_id=%u old ACK/RST of bytes=%d resent\r\n", remote_ip.len, remote_ip.s,
+      remote_port, t->message_id, ack_rst.len);
+  server_transaction_stats.replay_count++;
+  return 1;
+}
+
 void CoAPPeer::logServerTransactions(log_level_t level) {
   dropExpiredServerTransactions();
 
@@ -992,19 +1863,184 @@ void CoAPPeer::logServerTransactions(log_level_t level) {
   owl_time_t now = owl_time();
   float seconds;
   LOGF(level, "--- CoAP Server Transactions ---\r\n");
-  WL_FOREACH (&server_transactions, t) {
-    if (t->expires > now)
-      seconds = (float)(t->expires - now) / 1000.0;
-    else if (t->expires < now)
-      seconds = -(float)(now - t->expires) / 1000.0;
-    else
-      seconds = 0;
-    LOGF(level, "message_id=%05d type=%s expires=%5.3f sec ack_rst=%02d bytes\r\n", t->message_id,
-         coap_type_text(t->type), seconds, t->ack_rst.len);
-  }
+  for (int q = 0; q < 2; q++)
+    for (int16_t idx = server_transactions.expiry_head[q]; idx != -1; idx = t->expiry_next) {
+      t = &server_transactions.slots[idx];
+      if (t->expires > now)
+        seconds = (float)(t->expires - now) / 1000.0;
+      else if (t->expires < now)
+        seconds = -(float)(now - t->expires) / 1000.0;
+      else
+        seconds = 0;
+      LOGF(level, "message_id=%05d type=%s expires=%5.3f sec ack_rst=%02d bytes\r\n", t->message_id,
+           coap_type_text((coap_type_e)t->type), seconds,
+           t->reply == CoAP_Server_Transaction_Reply__Stored ? t->ack_rst.len : (t->reply ? 4 : 0));
+    }
+  LOGF(level, "count=%u/%d hits=%u replays=%u evictions=%u expired=%u\r\n", server_transaction_stats.count, NSYNC,
+       server_transaction_stats.hit_count, server_transaction_stats.replay_count,
+       server_transaction_stats.eviction_count, server_transaction_stats.expired_count);
   LOGF(level, "--------------------------------\r\n");
 }
 
+void CoAPPeer::getServerTransactionStats(coap_server_transaction_stats_t *out_stats) {
+  if (out_stats) *out_stats = server_transaction_stats;
+}
+
+
+
+/*
+ * Pending requests
+ */
+
+#define PENDING_REQUEST_MASK (COAP_PENDING_REQUESTS_MAX - 1)
+#define PENDING_REQUEST_HOME(token) ((int)((token)&PENDING_REQUEST_MASK))
+
+int CoAPPeer::addPendingRequest(CoAPMessage *request, CoAPPeer_PendingRequestCallback_f cb, void *cb_param,
+                                int lifetime) {
+  coap_pending_request_t *p = 0;
+  int idx                   = -1;
+  if (!request || !cb) {
+    LOG(L_ERR, "Null parameter\r\n");
+    return 0;
+  }
+  if (!request->token_length) {
+    LOG(L_ERR, "message_id=%u - pending requests need a token, to match the response\r\n", request->message_id);
+    return 0;
+  }
+  if (findPendingRequest(request->token, request->token_length) >= 0) {
+    LOG(L_ERR, "token=%llu - already pending\r\n", request->token);
+    return 0;
+  }
+
+  if (pending_requests_count >= COAP_PENDING_REQUESTS_MAX) {
+    // end the one closest to expiry
+    for (int i = 0; i < COAP_PENDING_REQUESTS_MAX; i++)
+      if (idx < 0 || pending_requests[i].expires < pending_requests[idx].expires) idx = i;
+    LOG(L_WARN, "token=%llu - pending requests full, ending the one closest to expiry\r\n",
+        pending_requests[idx].token);
+    endPendingRequest(idx, 0);
+    /* The callback might have added another one */
+    if (pending_requests_count >= COAP_PENDING_REQUESTS_MAX) return 0;
+  }
+
+  idx = PENDING_REQUEST_HOME(request->token);
+  while (pending_requests[idx].expires)
+    idx = (idx + 1) & PENDING_REQUEST_MASK;
+  p               = &pending_requests[idx];
+  p->expires      = owl_time() + (lifetime > 0 ? lifetime : EXCHANGE_LIFETIME) * 1000;
+  p->token        = request->token;
+  p->token_length = request->token_length;
+  p->message_id   = request->message_id;
+  p->cb           = cb;
+  p->cb_param     = cb_param;
+  pending_requests_count++;
+  return 1;
+}
+
+int CoAPPeer::dropPendingRequest(coap_token_t token, coap_token_lenght_t token_length) {
+  int idx = findPendingRequest(token, token_length);
+  if (idx < 0) return 0;
+  removePendingRequest(idx);
+  return 1;
+}
+
+int CoAPPeer::getPendingRequestsCount() {
+  return pending_requests_count;
+}
+
+/**
+ * Look-up a pending request - starting from its home slot, until found or until a free slot ends the probing.
+ * @param token - token of the request
+ * @param token_length - length of the token
+ * @return index of the slot, or -1 if not found
+ */
+int CoAPPeer::findPendingRequest(coap_token_t token, coap_token_lenght_t token_length) {
+  int idx = PENDING_REQUEST_HOME(token);
+  for (int i = 0; i < COAP_PENDING_REQUESTS_MAX; i++, idx = (idx + 1) & PENDING_REQUEST_MASK) {
+    if (!pending_requests[idx].expires) return -1;
+    if (pending_requests[idx].token == token && pending_requests[idx].token_length == token_length) return idx;
+  }
+  return -1;
+}
+
+/**
+ * Free a slot, shifting back the following ones which would not be found anymore across the new free slot.
+ * @param idx - index of the slot
+ */
+void CoAPPeer::removePendingRequest(int idx) {
+  int next = idx;
+  int home = 0;
+  for (int i = 1; i < COAP_PENDING_REQUESTS_MAX; i++) {
+    next = (next + 1) & PENDING_REQUEST_MASK;
+    if (!pending_requests[next].expires) break;
+    home = PENDING_REQUEST_HOME(pending_requests[next].token);
+    /* Can move back only if the free slot is not before its home slot */
+    if (((next - home) & PENDING_REQUEST_MASK) < ((next - idx) & PENDING_REQUEST_MASK)) continue;
+    pending_requests[idx] = pending_requests[next];
+    idx                   = next;
+  }
+  pending_requests[idx] = {0};
+  pending_requests_count--;
+}
+
+/**
+ * End a pending request - the slot is freed first, such that the callback can add new pending requests.
+ * @param idx - index of the slot
+ * @param response - the response, or 0 if ended without one
+ * @return the follow-up from the callback
+ */
+coap_handler_follow_up_e CoAPPeer::endPendingRequest(int idx, CoAPMessage *response) {
+  coap_pending_request_t p = pending_requests[idx];
+  removePendingRequest(idx);
+  return (p.cb)(this, p.token, p.cb_param, response);
+}
+
+int CoAPPeer::dropExpiredPendingRequests() {
+  owl_time_t now = owl_time();
+  int cnt        = 0;
+  for (int idx = 0; idx < COAP_PENDING_REQUESTS_MAX;) {
+    if (!pending_requests[idx].expires || pending_requests[idx].expires > now) {
+      idx++;
+      continue;
+    }
+    LOG(L_INFO, "token=%llu - no response received before expiry\r\n", pending_requests[idx].token);
+    /* Another one might shift in this slot, so check it again */
+    endPendingRequest(idx, 0);
+    cnt++;
+  }
+  return cnt;
+}
+
+/**
+ * End the pending request with this message_id, if any, without response - on RST, timeout or cancelation.
+ * @param message_id - the message_id of the request
+ */
+void CoAPPeer::failPendingRequest(coap_message_id_t message_id) {
+  if (!pending_requests_count) return;
+  for (int idx = 0; idx < COAP_PENDING_REQUESTS_MAX; idx++)
+    if (pending_requests[idx].expires && pending_requests[idx].message_id == message_id) {
+      endPendingRequest(idx, 0);
+      return;
+    }
+}
+
+/**
+ * Route a response to the callback of its pending request, if any.
+ * @param response - the response
+ * @param out_follow_up - if not 0, set to the follow-up from the callback
+ * @return 1 if the response was for a pending request, 0 if it should go to the handler_response
+ */
+int CoAPPeer::handlePendingRequestResponse(CoAPMessage *response, coap_handler_follow_up_e *out_follow_up) {
+  coap_handler_follow_up_e follow_up = CoAP__Handler_Followup__Do_Nothing;
+  int idx                            = -1;
+  if (!pending_requests_count || !response->token_length) return 0;
+  idx = findPendingRequest(response->token, response->token_length);
+  if (idx < 0) return 0;
+  follow_up = endPendingRequest(idx, response);
+  if (out_follow_up) *out_follow_up = follow_up;
+  return 1;
+}
+
 
 
 coap_message_id_t CoAPPeer::getNextMessageId() {
@@ -32,16 +32,32 @@
 
 typedef enum {
   CoAP_Transport__plaintext = 0,
-  CoAP_Transport__DTLS_PSK  = 1,
+  CoAP_Transport__DTLS_PSK       = 1,
+  CoAP_Transport__Modem_DTLS_PSK = 2, /**< DTLS with PSK done by the modem, plaintext CoAP over the socket */
 } coap_transport_type_e;
 
+#ifndef COAP_MODEM_SECURITY_PROFILE
+/** Modem security profile used by CoAP_Transport__Modem_DTLS_PSK */
+#define COAP_MODEM_SECURITY_PROFILE 1
+#endif
+
 
 /*
  * Retransmit Parameters
  */
 
-/** Client Side - max number of CON and Requests outstanding at one time. Default: 1 */
-#define NSTART 5
+/** Client Side - max number of CON and Requests outstanding at one time. Default: 1. This is the upper limit for the
+ * congestion window below. */
+#define NSTART 8
+
+/** Client Side - initial congestion window - CON messages in flight before any ACK was received */
+#define NSTART_INITIAL 2
+
+/** Client Side - max number of CON messages waiting in the send queue for the congestion window to open */
+#define SEND_QUEUE_MAX 16
+
+/** Client Side - send queue slots which isSendQueueFull() keeps for the SDK's own requests, e.g. the Heartbeats */
+#define SEND_QUEUE_RESERVED 2
 
 /** Client Side - Default: 2 s */
 #define ACK_TIMEOUT 5
@@ -79,6 +95,42 @@ typedef enum {
 #define EXCHANGE_LIFETIME (MAX_TRANSMIT_SPAN + (2 * MAX_LATENCY) + PROCESSING_DELAY)
 
 
+/*
+ * Block-wise Transfer Parameters - https://tools.ietf.org/html/rfc7959
+ */
+
+/** Max size of a payload transferred block-wise - applies both to sending and to the reassembly of received ones */
+#define COAP_BLOCKWISE_MAX_SIZE 1024
+
+/** Default block size exponent - blocks are 2^(4+SZX) bytes. 4 means 256 bytes, which leaves room for the DTLS and
+ * CoAP overhead within MODEM_UDP_BUFFER_SIZE */
+#define COAP_BLOCKWISE_SZX 4
+
+/** Default number of blocks of one transfer in flight at one time - the congestion window still applies on top */
+#define COAP_BLOCKWISE_WINDOW 2
+
+/** Max number of concurrent outgoing block-wise transfers */
+#define COAP_BLOCKWISE_TX_MAX 2
+
+
+
+/*
+ * Pending requests - responses matched by token to per-request callbacks - see addPendingRequest()
+ */
+
+/** Max number of requests waiting for their response at one time - must be a power of 2 */
+#define COAP_PENDING_REQUESTS_MAX 8
+
+
+
+/*
+ * Server transactions cache - de-duplication of incoming CON/NON messages
+ */
+
+/** Number of hash buckets for the server transactions, on message_id - must be a power of 2 */
+#define COAP_SERVER_TRANSACTION_BUCKETS 64
+
+
 
 class CoAPPeer;
 
@@ -102,10 +154,44 @@ typedef enum {
   CoAP__Handler_Followup__Do_Nothing           = 0,
   CoAP__Handler_Followup__Send_Acknowledgement = 1,
   CoAP__Handler_Followup__Send_Reset           = 2,
+  CoAP__Handler_Followup__Not_Handled          = 3, /**< only from fast request handlers - fall back to full decoding */
 } coap_handler_follow_up_e;
 
 typedef coap_handler_follow_up_e (*CoAPPeer_RequestHandler_f)(CoAPPeer *peer, CoAPMessage *request);
 typedef coap_handler_follow_up_e (*CoAPPeer_ResponseHandler_f)(CoAPPeer *peer, CoAPMessage *response);
+typedef coap_handler_follow_up_e (*CoAPPeer_FastRequestHandler_f)(CoAPPeer *peer, coap_message_view_t *request);
+
+/**
+ * Callback for the response to a pending request - see CoAPPeer::addPendingRequest()
+ * @param response - the response, or 0 if the request ended without one - on RST, timeout, cancelation or expiry
+ * @return follow-up for the response, as for the response handler - ignored when response is 0
+ */
+typedef coap_handler_follow_up_e (*CoAPPeer_PendingRequestCallback_f)(CoAPPeer *peer, coap_token_t token,
+                                                                      void *cb_param, CoAPMessage *response);
+
+/**
+ * Statistics of the requests dispatched on the fast path
+ */
+typedef struct {
+  uint32_t count;          /**< requests dispatched on the fast path */
+  uint32_t fallback_count; /**< requests passed on to the full decoding, as the fast handler did not handle them */
+  uint32_t latency_last;   /**< microseconds from the reception of the datagram to the handler call, for the last one */
+  uint32_t latency_min;    /**< min of the above */
+  uint32_t latency_max;    /**< max of the above */
+  uint64_t latency_total;  /**< sum of the above, to compute the average */
+} coap_fast_path_stats_t;
+
+
+
+
+typedef struct {
+  owl_time_t expires; /**< 0 if the slot is free */
+  coap_token_t token;
+  coap_token_lenght_t token_length;
+  coap_message_id_t message_id; /**< of the request - a RST, timeout or cancelation on it ends the pending request */
+  CoAPPeer_PendingRequestCallback_f cb;
+  void *cb_param;
+} coap_pending_request_t;
 
 
 
@@ -140,31 +226,80 @@ typedef struct {
 
 
 
-typedef struct _coap_server_transaction_list_t_slot {
+typedef enum {
+  CoAP_Server_Transaction_Reply__None      = 0, /**< nothing sent yet - duplicates are silently ignored */
+  CoAP_Server_Transaction_Reply__Stored    = 1, /**< the ACK/RST is stored in ack_rst */
+  CoAP_Server_Transaction_Reply__Empty_ACK = 2, /**< an empty ACK, re-encoded from the message_id on duplicates */
+  CoAP_Server_Transaction_Reply__Empty_RST = 3, /**< an empty RST, re-encoded from the message_id on duplicates */
+} coap_server_transaction_reply_e;
+
+typedef struct {
+  owl_time_t expires;
+  str ack_rst; /**< only for CoAP_Server_Transaction_Reply__Stored */
   coap_message_id_t message_id;
-  coap_type_e type;
+  int16_t hash_next;   /**< next slot in the same hash bucket, -1 at the end */
+  int16_t expiry_next; /**< next slot in the same expiry queue (or in the free list), -1 at the end */
+  uint8_t type;        /**< coap_type_e - CON or NON */
+  uint8_t reply;       /**< coap_server_transaction_reply_e */
+} coap_server_transaction_t;
+
+/**
+ * Fixed capacity cache of the server transactions. The slots are indexed by a hash on message_id, while the expiry
+ * is tracked with one FIFO queue per type - as each type has a fixed lifetime, every queue is also sorted by expiry.
+ */
+typedef struct {
+  coap_server_transaction_t slots[NSYNC];
+  int16_t buckets[COAP_SERVER_TRANSACTION_BUCKETS]; /**< first slot of each hash bucket, -1 if empty */
+  int16_t expiry_head[2];                           /**< oldest slot - [0] for CON, [1] for NON, -1 if empty */
+  int16_t expiry_tail[2];                           /**< newest slot - [0] for CON, [1] for NON, -1 if empty */
+  int16_t free_head;                                /**< first unused slot, -1 if full */
+} coap_server_transaction_cache_t;
+
+/**
+ * Statistics of the server transactions cache
+ */
+typedef struct {
+  uint32_t count;          /**< server transactions currently in the cache */
+  uint32_t hit_count;      /**< duplicates found in the cache - not passed on to the handlers */
+  uint32_t replay_count;   /**< hits answered with the ACK/RST from the cache */
+  uint32_t eviction_count; /**< server transactions dropped before expiry, to make space - above NSYNC */
+  uint32_t expired_count;  /**< server transactions dropped at expiry */
+} coap_server_transaction_stats_t;
+
+
+
+typedef struct _coap_blockwise_tx_list_t_slot {
+  uint16_t transfer_id;
+  str header;  /**< encoded request without payload - template for each block */
+  str payload; /**< full payload, to be split in blocks */
+  uint8_t szx;
+  int window;
+  int blocks;    /**< total number of blocks */
+  int next_num;  /**< next block to send */
+  int acked;     /**< number of blocks acknowledged */
+  int in_flight; /**< number of blocks sent or queued, not yet acknowledged */
   owl_time_t expires;
-  str ack_rst;
+  CoAPPeer_ClientTransactionCallback_f cb;
+  void *cb_param;
 
-  struct _coap_server_transaction_list_t_slot *prev, *next;
-} coap_server_transaction_t;
+  struct _coap_blockwise_tx_list_t_slot *prev, *next;
+} coap_blockwise_tx_t;
 
 typedef struct {
   int space_left;
-  coap_server_transaction_t *head, *tail;
-} coap_server_transaction_list_t;
+  coap_blockwise_tx_t *head, *tail;
+} coap_blockwise_tx_list_t;
 
-#define coap_server_transaction_list_t_free(x)                                                                         \
+#define coap_blockwise_tx_list_t_free(x)                                                                               \
   do {                                                                                                                 \
     if (x) {                                                                                                           \
-      str_free((x)->ack_rst);                                                                                          \
+      str_free((x)->header);                                                                                           \
+      str_free((x)->payload);                                                                                          \
       owl_free(x);                                                                                                     \
       (x) = 0;                                                                                                         \
     }                                                                                                                  \
   } while (0)
 
-#define coap_server_transaction_list_t_compare(a, b) (a->expires <= b->expires)
-
 
 class CoAPPeer {
  public:
@@ -179,6 +314,14 @@ class CoAPPeer {
   CoAPPeer(OwlModem *owlModem, str psk_id, str psk_key, uint16_t local_port, str remote_ip,
            uint16_t remote_port = 5684);
 
+  /**
+   * Constructor for DTLS with PSK transport, choosing who does the DTLS: CoAP_Transport__DTLS_PSK for tinydtls over
+   * OwlModem/UDP, or CoAP_Transport__Modem_DTLS_PSK for the modem's own secure sockets. The latter needs no
+   * OwlDTLSClient on the MCU, but depends on the modem firmware supporting DTLS in its security profiles.
+   */
+  CoAPPeer(OwlModem *owlModem, coap_transport_type_e transport_type, str psk_id, str psk_key, uint16_t local_port,
+           str remote_ip, uint16_t remote_port = 5684);
+
   ~CoAPPeer();
 
 
@@ -194,6 +337,36 @@ class CoAPPeer {
    */
   int transportIsReady();
 
+  /**
+   * Pack the messages sent from now on into as few datagrams as possible, until flushTransportBatch(). Only the DTLS
+   * transport batches; Breakout::spin() does this around each iteration.
+   */
+  void beginTransportBatch();
+
+  /**
+   * Send the messages collected since beginTransportBatch().
+   * @return 1 on success, 0 on failure
+   */
+  int flushTransportBatch();
+
+  /**
+   * Save the transport session, e.g. the DTLS keys and sequence numbers, to restore it with
+   * restoreTransportSession() after a power cycle. The transport is closed then, as nothing more may be sent with it.
+   * @param buf - buffer to write to, of DTLS_SESSION_STATE_MAX_LENGTH bytes to be sure
+   * @param buf_len - size of buf
+   * @return the length of the saved session, 0 if none (e.g. plain-text transport or not connected)
+   */
+  int saveTransportSession(uint8_t *buf, int buf_len);
+
+  /**
+   * Like reinitialize(), but restoring a session saved with saveTransportSession(), such that the transport is
+   * ready right away, without a DTLS handshake. Reserve it with OwlDTLSClient::reserveSession() first.
+   * @param state - the saved session
+   * @param state_len - length of the saved session
+   * @return 1 on success, 0 on failure
+   */
+  int restoreTransportSession(const uint8_t *state, int state_len);
+
   /**
    * Close the current transport nicely
    * @return 1 on success, 0 on failure
@@ -210,6 +383,22 @@ class CoAPPeer {
   void setHandlers(CoAPPeer_MessageHandler_f handler_message, CoAPPeer_DTLSEventHandler_f handler_dtls_event,
                    CoAPPeer_RequestHandler_f handler_request, CoAPPeer_ResponseHandler_f handler_response);
 
+  /**
+   * Set a handler for simple requests, called before any full decoding or allocation. CON/NON requests with only the
+   * Uri-Path, Uri-Query and Content-Format options are passed to it as a view straight into the receive buffer (e.g.
+   * the DTLS plaintext) and the ACK or RST is sent right after it returns. The handler returns
+   * CoAP__Handler_Followup__Not_Handled to have the request go through the regular path, to the handler_message and
+   * handler_request. Retransmissions of requests handled here are de-duplicated and re-acknowledged.
+   * @param handler_fast_request - the handler, or 0 to disable the fast path
+   */
+  void setFastRequestHandler(CoAPPeer_FastRequestHandler_f handler_fast_request);
+
+  /**
+   * Get the statistics of the fast path, including the latency from datagram reception to handler call.
+   * @param out_stats - structure to fill in
+   */
+  void getFastPathStats(coap_fast_path_stats_t *out_stats);
+
 
   /**
    * Send a message unreliably - CON, if set, would be set to NON.
@@ -223,17 +412,62 @@ class CoAPPeer {
   int sendUnreliably(CoAPMessage *message, int probing_rate = 0, int max_transmit_span = 0);
 
   /**
-   * Send a message reliably - NON, if set, will be set to CON.
+   * Send a message reliably - NON, if set, will be set to CON. If the congestion window is full, the message is placed
+   * in the send queue and it will be sent out as soon as ACKs are received. Once this returns success, the callback
+   * will be called exactly once with the final event.
    * @param message - message to send
    * @param cb - callback function to call on events
    * @param cb_param - generic callback parameter
    * @param max_retransmit - number of retransmissions - 0 to use the default value
    * @param max_transmit_span - max interval to retransmit - 0 to use the default value
-   * @return 1 on success, 0 on failure
+   * @return 1 on success (sent or queued), 0 on failure (including full send queue)
    */
   int sendReliably(CoAPMessage *message, CoAPPeer_ClientTransactionCallback_f cb, void *cb_param,
                    int max_retransmit = 0, int max_transmit_span = 0);
 
+  /**
+   * Send a message reliably, split in blocks with the Block1 option (RFC 7959). Each block is a CON of its own, with up
+   * to window of them in flight at one time. The last block completes the request on the server side, so it is only
+   * sent after all the previous ones were acknowledged. Messages which fit in a single block are passed on to
+   * sendReliably().
+   * @param message - message to send - the payload is copied, so the message can be destroyed after this returns
+   * @param cb - callback function to call on the final event - ACK of the last block, or the event which aborted the
+   * transfer (an error response on any block is reported as RST)
+   * @param cb_param - generic callback parameter
+   * @param window - max number of blocks in flight - 0 to use the default value
+   * @param szx - block size exponent, the block size being 2^(4+szx) - -1 to use the default value
+   * @return 1 on success (first blocks sent or queued), 0 on failure
+   */
+  int sendReliablyBlockwise(CoAPMessage *message, CoAPPeer_ClientTransactionCallback_f cb, void *cb_param,
+                            int window = 0, int szx = -1);
+
+  /**
+   * Check if the maximum number of concurrent block-wise transfers was reached, in which case sendReliablyBlockwise()
+   * would fail for larger messages.
+   * @return 1 if full, 0 if there is space for more transfers
+   */
+  int isBlockwiseTxFull();
+
+  /**
+   * Check if the send queue is full, in which case sendReliably() would fail. Use this for backpressure - spin and let
+   * the ACKs come in, then try again. The last SEND_QUEUE_RESERVED slots are reported as full already, such that
+   * requests which do not check this first, like the Heartbeats, still find room.
+   * @return 1 if full, 0 if there is space for more messages
+   */
+  int isSendQueueFull();
+
+  /**
+   * Get the number of CON messages waiting in the send queue for the congestion window to open.
+   * @return number of queued messages
+   */
+  int getSendQueueLength();
+
+  /**
+   * Get the current congestion window - the number of CON messages which can be in flight at one time.
+   * @return the current window, between 1 and NSTART
+   */
+  int getCongestionWindow();
+
   /**
    * Stop retransmissions of the message with the given message_id - works for both sendUnreliably() (if used with
    * retransmission parameters) and for sendReliably()
@@ -242,6 +476,34 @@ class CoAPPeer {
    */
   int stopRetransmissions(coap_message_id_t message_id);
 
+  /**
+   * Register a request, for its response to be routed to cb instead of to the handler_response. Call this before
+   * sending the request, with its token and message_id already set. Responses are matched on the token, both the
+   * piggybacked and the separate ones, so several requests can wait for their responses at one time. The pending
+   * request ends with the first response, or with a 0 response on RST, timeout or cancelation of its message_id, or
+   * at the end of its lifetime. When full, the pending request closest to expiry is ended to make space.
+   * @param request - the request - only its token and message_id are kept
+   * @param cb - callback for the response
+   * @param cb_param - generic callback parameter
+   * @param lifetime - seconds to wait for a separate response - 0 to use EXCHANGE_LIFETIME
+   * @return 1 on success, 0 on failure
+   */
+  int addPendingRequest(CoAPMessage *request, CoAPPeer_PendingRequestCallback_f cb, void *cb_param, int lifetime = 0);
+
+  /**
+   * Forget a pending request, without calling its callback - e.g. if sending it failed.
+   * @param token - token of the request
+   * @param token_length - length of the token
+   * @return 1 on success, 0 if not found
+   */
+  int dropPendingRequest(coap_token_t token, coap_token_lenght_t token_length);
+
+  /**
+   * Get the number of requests waiting for their response.
+   * @return number of pending requests
+   */
+  int getPendingRequestsCount();
+
   /**
    * Call this regularly, to trigger retransmissions, if requires
    * @return
@@ -261,6 +523,12 @@ class CoAPPeer {
    */
   void logServerTransactions(log_level_t level);
 
+  /**
+   * Get the statistics of the server transactions cache - duplicates found, replies replayed and evictions.
+   * @param out_stats - structure to fill in
+   */
+  void getServerTransactionStats(coap_server_transaction_stats_t *out_stats);
+
   /**
    * Create a new Message-Id for this peer
    * @return the new message_id
@@ -279,12 +547,12 @@ class CoAPPeer {
 
   int initDTLSClient();
 
-  /* CoAP_Transport__plaintext */
+  /* CoAP_Transport__plaintext and CoAP_Transport__Modem_DTLS_PSK */
   uint8_t socket_id = 255;
   static CoAPPeer *socketMappings[MODEM_MAX_SOCKETS];
   static void handlePlaintextData(uint8_t socket, str remote_ip, uint16_t remote_port, str data);
 
-  /* CoAP_Transport__DTLS_PSK */
+  /* CoAP_Transport__DTLS_PSK and CoAP_Transport__Modem_DTLS_PSK */
   str psk_id                   = {0};
   str psk_key                  = {0};
   OwlDTLSClient *owlDTLSClient = 0;
@@ -296,12 +564,18 @@ class CoAPPeer {
   int handleTx(str data);
   /* Internal receive function */
   int handleRx(str data);
+  /* Fast path of the receive function - returns 1 if the message was handled, 0 to continue with handleRx() */
+  int handleRxFast(str data);
 
   CoAPPeer_MessageHandler_f handler_message      = 0;
   CoAPPeer_DTLSEventHandler_f handler_dtls_event = 0;
   CoAPPeer_RequestHandler_f handler_request      = 0;
   CoAPPeer_ResponseHandler_f handler_response    = 0;
 
+  CoAPPeer_FastRequestHandler_f handler_fast_request = 0;
+  uint32_t rx_time                                   = 0; /**< owl_time_us() at reception of the data */
+  coap_fast_path_stats_t fast_path_stats             = {0};
+
   coap_message_id_t last_message_id = 0;
   coap_token_t last_token;
 
@@ -327,6 +601,61 @@ class CoAPPeer {
   coap_client_transaction_t *getClientTransaction(coap_message_id_t message_id);
   int dropClientTransaction(coap_client_transaction_t **t);
   int dropClientTransaction(coap_message_id_t message_id);
+  int cancelClientTransactions();
+
+  /*
+   * Congestion control - CON messages above the congestion window wait in the send queue
+   */
+
+  coap_client_transaction_list_t send_queue = {.space_left = SEND_QUEUE_MAX, .head = 0, .tail = 0}; /**< FIFO */
+  int congestion_window      = NSTART_INITIAL; /**< max CON in flight - between 1 and NSTART */
+  int congestion_window_acks = 0;              /**< ACKs received since the last increase of the window */
+
+  int flushSendQueue();
+  int countClientTransactionsCON();
+  void congestionWindowOnACK();
+  void congestionWindowOnTimeout();
+
+  /*
+   * Block-wise transfers - outgoing ones split with Block1, incoming Block1 ones reassembled before the handlers
+   */
+
+  coap_blockwise_tx_list_t blockwise_tx = {.space_left = COAP_BLOCKWISE_TX_MAX, .head = 0, .tail = 0};
+  uint16_t last_blockwise_transfer_id   = 0;
+
+  coap_blockwise_tx_t *getBlockwiseTx(uint16_t transfer_id);
+  int sendBlock(coap_blockwise_tx_t *t, int num);
+  int sendBlockwiseNext(uint16_t transfer_id);
+  void finishBlockwiseTx(coap_blockwise_tx_t **t, coap_message_id_t message_id, coap_client_transaction_event_e event,
+                         CoAPMessage *message);
+  int triggerBlockwiseTx();
+  void handleBlockwiseTxEvent(uint16_t transfer_id, int num, coap_message_id_t message_id,
+                              coap_client_transaction_event_e event, CoAPMessage *message);
+  static void callback_blockwiseTx(CoAPPeer *peer, coap_message_id_t message_id, void *cb_param,
+                                   coap_client_transaction_event_e event, CoAPMessage *message);
+
+  str blockwise_rx                = {0}; /**< reassembly buffer - one incoming transfer at a time */
+  owl_time_t blockwise_rx_expires = 0;   /**< 0 if no incoming transfer is in progress */
+
+  int handleRxBlock1(CoAPMessage *message, int *out_reassembled, uint64_t *out_block1);
+  void replyRxBlock1(CoAPMessage *message, coap_code_class_e code_class, coap_code_detail_e code_detail,
+                     uint64_t block1, int with_size1);
+
+
+
+  /*
+   * Pending requests - open addressing on the token, with linear probing
+   */
+
+  coap_pending_request_t pending_requests[COAP_PENDING_REQUESTS_MAX] = {};
+  int pending_requests_count                                          = 0;
+
+  int findPendingRequest(coap_token_t token, coap_token_lenght_t token_length);
+  void removePendingRequest(int idx);
+  coap_handler_follow_up_e endPendingRequest(int idx, CoAPMessage *response);
+  int dropExpiredPendingRequests();
+  void failPendingRequest(coap_message_id_t message_id);
+  int handlePendingRequestResponse(CoAPMessage *response, coap_handler_follow_up_e *out_follow_up);
 
 
 
@@ -334,12 +663,17 @@ class CoAPPeer {
    * Server Transactions
    */
 
-  coap_server_transaction_list_t server_transactions = {.space_left = NSYNC, .head = 0, .tail = 0}; /**< sorted */
+  coap_server_transaction_cache_t server_transactions;
+  coap_server_transaction_stats_t server_transaction_stats = {0};
 
+  void initServerTransactions();
+  void freeServerTransactions();
+  void dropServerTransaction(int16_t idx);
   int dropExpiredServerTransactions();
   int putServerTransaction(coap_message_id_t message_id, coap_type_e type);
   int setServerTransactionReply(coap_message_id_t message_id, str ack_rst);
   coap_server_transaction_t *getServerTransaction(coap_message_id_t message_id);
+  int replayServerTransaction(coap_server_transaction_t *t);
 
 
 
@@ -24,6 +24,11 @@
 #include "OwlDTLSClient.h"
 
 
+#if defined(DTLS_SINGLE_PEER_CLIENT) && DTLS_MAX_BUF > MODEM_UDP_BUFFER_SIZE
+#error "DTLS_CONF_MTU should not exceed the MODEM_UDP_BUFFER_SIZE which the modem sockets carry"
+#endif
+
+
 
 OwlDTLSClient::OwlDTLSClient() {
   dtls_init();
@@ -63,7 +68,7 @@ static int sendToPeer(struct dtls_context_t *ctx, session_t *session, uint8 *buf
   OwlDTLSClient *owlDTLS = (OwlDTLSClient *)dtls_get_app_data(ctx);
 
   str data = {.s = (char *)buf, .len = len};
-  int cnt = owlDTLS->sendRawData(data);
+  int cnt = owlDTLS->isBatching() ? owlDTLS->queueRawData(data) : owlDTLS->sendRawData(data);
   if (cnt != len) {
     LOG(L_ERR, "Error on sending data\r\n");
     return 0;
@@ -135,6 +140,17 @@ static int handleEvent(struct dtls_context_t *ctx, session_t *session, dtls_aler
 int OwlDTLSClient::fireHandlerEvent(session_t *session, dtls_alert_level_e level,
                                     dtls_alert_description_e description) {
   this->last_status = description;
+  if (description == DTLS_Alert_Description__tinydtls_event_connected) {
+    const dtls_handshake_stats_t *stats = dtls_get_handshake_stats(this->dtls_context);
+    str cid                             = {0};
+    LOG(L_INFO, "DTLS handshake took %u ms with %u retransmissions - retransmission timeout now %u ms\r\n",
+        (unsigned int)(stats->duration * 1000 / CLOCK_SECOND), stats->retransmissions,
+        (unsigned int)(dtls_get_rto(this->dtls_context)->timeout * 1000 / CLOCK_SECOND));
+    if (this->getConnectionId(&cid))
+      LOG(L_INFO, "DTLS connected - sending Connection ID of %d bytes\r\n", cid.len);
+    else
+      LOG(L_INFO, "DTLS connected - without Connection ID\r\n");
+  }
   if (!this->handler_event) return 0;
   (this->handler_event)(this, session, level, description);
   return 1;
@@ -262,6 +278,10 @@ int OwlDTLSClient::init(OwlModem *owlModem) {
   }
 
   dtls_set_handler(dtls_context, &OwlDTLS_callbacks);
+  if (rto.samples) dtls_set_rto(dtls_context, &rto);
+#if (DTLS_MAX_CID_LENGTH > 0)
+  dtls_set_use_cid(dtls_context, use_connection_id);
+#endif
 
   if (!owlModem) {
     LOG(L_ERR, "Need the OwlModem link for communication purposes\r\n");
@@ -274,12 +294,7 @@ int OwlDTLSClient::init(OwlModem *owlModem) {
 
 
 
-int OwlDTLSClient::connect(uint16_t local_port, str remote_ip, uint16_t remote_port) {
-  if (!this->owlModem) {
-    LOG(L_ERR, "Not initialized correctly - owlModem is null\r\n");
-    return 0;
-  }
-
+int OwlDTLSClient::openSocket(uint16_t local_port, str remote_ip, uint16_t remote_port) {
   str token = {0};
   if (str_find_char(remote_ip, ":") < 0) {
     /* IPv4 */
@@ -308,7 +323,7 @@ int OwlDTLSClient::connect(uint16_t local_port, str remote_ip, uint16_t remote_p
                                              &this->socket_id)) {
     if (!owlModem->socket.openConnectUDP(remote_ip, remote_port, OwlDTLSClient::handleRawData, &this->socket_id)) {
       LOG(L_ERR, "Error opening local socket towards %.*s:%u\r\n", remote_ip.len, remote_ip.s, remote_port);
-      goto error;
+      return 0;
     } else {
       LOG(L_WARN, "Potential error opening local socket towards %.*s:%u - listen failed, model wasn't blacklisted\r\n",
           remote_ip.len, remote_ip.s, remote_port);
@@ -316,9 +331,18 @@ int OwlDTLSClient::connect(uint16_t local_port, str remote_ip, uint16_t remote_p
   }
   if (this->socket_id < 0 || this->socket_id >= MODEM_MAX_SOCKETS) {
     LOG(L_ERR, "Bad socket_id %d returned\r\n", this->socket_id);
-    goto error;
+    return 0;
   }
   OwlDTLSClient::socketMappings[this->socket_id] = this;
+  return 1;
+}
+
+int OwlDTLSClient::connect(uint16_t local_port, str remote_ip, uint16_t remote_port) {
+  if (!this->owlModem) {
+    LOG(L_ERR, "Not initialized correctly - owlModem is null\r\n");
+    return 0;
+  }
+  if (!openSocket(local_port, remote_ip, remote_port)) goto error;
 
   if (dtls_connect(this->dtls_context, &this->dtls_dst) < 0) {
     LOG(L_ERR, "Error on dtls_connect()\r\n");
@@ -331,14 +355,74 @@ error:
   return 0;
 }
 
+int OwlDTLSClient::restoreSession(uint16_t local_port, str remote_ip, uint16_t remote_port, const uint8_t *state,
+                                  int state_len) {
+  if (!this->owlModem) {
+    LOG(L_ERR, "Not initialized correctly - owlModem is null\r\n");
+    return 0;
+  }
+  if (!openSocket(local_port, remote_ip, remote_port)) goto error;
+
+  if (dtls_import_session(this->dtls_context, &this->dtls_dst, state, state_len) < 0) {
+    LOG(L_WARN, "Saved DTLS session of %d bytes not usable - connecting with a new handshake\r\n", state_len);
+    if (dtls_connect(this->dtls_context, &this->dtls_dst) < 0) {
+      LOG(L_ERR, "Error on dtls_connect()\r\n");
+      goto error;
+    }
+    return 1;
+  }
+  LOG(L_INFO, "DTLS session restored - no handshake needed\r\n");
+  this->fireHandlerEvent(&this->dtls_dst, (dtls_alert_level_e)0, DTLS_Alert_Description__tinydtls_event_connected);
+
+  return 1;
+error:
+  this->close();
+  return 0;
+}
+
+int OwlDTLSClient::saveSession(uint8_t *buf, int buf_len) {
+  int len = 0;
+  if (!this->dtls_context) {
+    LOG(L_ERR, "DTLS context not created yet\r\n");
+    return 0;
+  }
+  this->flushBatch();
+  len = dtls_export_session(this->dtls_context, &this->dtls_dst, buf, buf_len);
+  if (len <= 0) {
+    LOG(L_WARN, "No DTLS session to save\r\n");
+    return 0;
+  }
+  return len;
+}
+
+int OwlDTLSClient::reserveSession(uint8_t *state, int state_len) {
+  if (!state || state_len <= 0) return 0;
+  return dtls_reserve_session(state, state_len) == 0;
+}
+
+void OwlDTLSClient::takeResumableSession(OwlDTLSClient *previous) {
+  if (!this->dtls_context || !previous) return;
+  if (!previous->dtls_context) {
+    if (previous->rto.samples) dtls_set_rto(this->dtls_context, &previous->rto);
+    return;
+  }
+  dtls_set_rto(this->dtls_context, dtls_get_rto(previous->dtls_context));
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  this->dtls_context->resumption = previous->dtls_context->resumption;
+#endif
+}
+
 int OwlDTLSClient::close() {
+  this->flushBatch();
   if (!this->dtls_context) {
     LOG(L_DBG, "DTLS context not created yet\r\n");
   } else {
     int err = dtls_close(this->dtls_context, &this->dtls_dst);
     LOG(L_NOTICE, "Close error=%d\r\n", err);
+    this->rto = *dtls_get_rto(this->dtls_context);
     dtls_free_context(this->dtls_context);
     this->dtls_context = 0;
+    this->last_status  = DTLS_Alert_Description__close_notify;
   }
   this->remote_ip.len = 0;
   this->remote_port   = 0;
@@ -388,6 +472,45 @@ int OwlDTLSClient::sendRawData(str data) {
   return out_bytes_sent;
 }
 
+int OwlDTLSClient::queueRawData(str data) {
+  if (this->batch_len + data.len > OWL_DTLS_BATCH_SIZE) {
+    /* Full - send what we have and start a new datagram; a failure was logged and is just like a lost datagram */
+    this->flushBatch();
+    this->batching = true;
+  }
+  if (data.len > OWL_DTLS_BATCH_SIZE) return this->sendRawData(data);
+  memcpy(this->batch_buf + this->batch_len, data.s, data.len);
+  this->batch_len += data.len;
+  this->batch_records++;
+  return data.len;
+}
+
+void OwlDTLSClient::beginBatch() {
+  this->batching = true;
+}
+
+int OwlDTLSClient::flushBatch() {
+  str data = {.s = (char *)this->batch_buf, .len = this->batch_len};
+  int records = this->batch_records;
+  int cnt     = 0;
+  /* Records generated while the modem is busy with this datagram go out on their own */
+  this->batching      = false;
+  this->batch_len     = 0;
+  this->batch_records = 0;
+  if (!data.len) return 1;
+  LOG(L_DBG, "Sending %d records in a datagram of %d bytes\r\n", records, data.len);
+  cnt = this->sendRawData(data);
+  if (cnt != data.len) {
+    LOG(L_ERR, "Error sending batch of %d records\r\n", records);
+    return 0;
+  }
+  return 1;
+}
+
+bool OwlDTLSClient::isBatching() {
+  return this->batching;
+}
+
 
 OwlDTLSClient *OwlDTLSClient::socketMappings[] = {0};
 
@@ -406,14 +529,17 @@ void OwlDTLSClient::handleRawData(uint8_t socket, str remote_ip, uint16_t remote
     return;
   }
   if (remote_ip.len) {
-    /* This was received with receiveFromUDP - check from IP:port */
-    if (!str_equalcase(remote_ip, owlDTLS->remote_ip) || remote_port != owlDTLS->remote_port) {
+    /* This was received with receiveFromUDP - check from IP:port. The modem reports the address as it was
+     * configured, so a binary compare settles it and the case-insensitive one only runs on a mismatch. */
+    if (remote_port != owlDTLS->remote_port ||
+        (!str_equal(remote_ip, owlDTLS->remote_ip) && !str_equalcase(remote_ip, owlDTLS->remote_ip))) {
       LOG(L_WARN, "Received data on socket %d from incorrect remote %.*s:%u, expected %.*s:%u - ignoring (attack?)\r\n",
           socket, remote_ip.len, remote_ip.s, remote_port, owlDTLS->remote_ip.len, owlDTLS->remote_ip.s,
           owlDTLS->remote_port);
       return;
     }
   }
+  owlDTLS->last_rx_time = owl_time_us();
   /* Pass to tinydtls */
   int err = dtls_handle_message(owlDTLS->dtls_context, &owlDTLS->dtls_dst, (uint8 *)data.s, data.len);
   if (err < 0) {
@@ -436,6 +562,10 @@ error:
 
 int OwlDTLSClient::sendData(str plaintext) {
   int res;
+  if (!this->dtls_context) {
+    LOG(L_ERR, "DTLS context not created yet, or closed\r\n");
+    return 0;
+  }
   if (this->last_status != DTLS_Alert_Description__tinydtls_event_connected) {
     LOG(L_WARN, "Will try to send, but last status was %d (%.*s) != connected\r\n", this->last_status,
         dtls_alert_description_text(this->last_status));
@@ -461,3 +591,71 @@ void OwlDTLSClient::setEventHandler(OwlDTLS_EventHandler_f handler) {
 dtls_alert_description_e OwlDTLSClient::getCurrentStatus() {
   return this->last_status;
 }
+
+uint32_t OwlDTLSClient::getLastRxTime() {
+  return last_rx_time;
+}
+
+void OwlDTLSClient::setConnectionIdEnabled(bool enabled) {
+  use_connection_id = enabled;
+#if (DTLS_MAX_CID_LENGTH > 0)
+  if (dtls_context) dtls_set_use_cid(dtls_context, enabled);
+#endif
+}
+
+int OwlDTLSClient::getConnectionId(str *out_cid) {
+#if (DTLS_MAX_CID_LENGTH > 0)
+  const uint8 *cid = 0;
+  int len          = 0;
+  if (!dtls_context) return 0;
+  len = dtls_get_write_cid(dtls_context, &dtls_dst, &cid);
+  if (len <= 0) return 0;
+  if (out_cid) {
+    out_cid->s   = (char *)cid;
+    out_cid->len = len;
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+int OwlDTLSClient::getHandshakeStats(dtls_handshake_stats_t *out_stats, uint32_t *out_timeout_ms) {
+  if (!dtls_context) return 0;
+  if (out_stats) *out_stats = *dtls_get_handshake_stats(dtls_context);
+  if (out_timeout_ms) *out_timeout_ms = dtls_get_rto(dtls_context)->timeout * 1000 / CLOCK_SECOND;
+  return 1;
+}
+
+void OwlDTLSClient::getPoolStats(dtls_pools_stats_t *out_stats) {
+  if (!out_stats) return;
+  dtls_get_pools_stats(out_stats);
+}
+
+void OwlDTLSClient::logRAMUsage(log_level_t level) {
+  dtls_pools_stats_t pools;
+  dtls_pool_t *pool[4]        = {&dtls_peer_pool, &dtls_handshake_pool, &dtls_security_pool, &dtls_netq_pool};
+  dtls_pool_stats_t *stats[4] = {&pools.peer, &pools.handshake, &pools.security, &pools.netq};
+  const char *names[4]        = {"peers", "handshakes", "security", "netq"};
+  unsigned int total          = sizeof(dtls_context_t);
+  unsigned int pool_bytes     = 0;
+  dtls_get_pools_stats(&pools);
+
+  LOGF(level, "DTLS RAM usage - records of up to %u bytes\r\n", (unsigned int)DTLS_MAX_BUF);
+  LOGF(level, "  %-12s %6u bytes per client\r\n", "context", (unsigned int)sizeof(dtls_context_t));
+  LOGF(level, "  %-12s %6u bytes per client\r\n", "batch", (unsigned int)OWL_DTLS_BATCH_SIZE);
+  total += OWL_DTLS_BATCH_SIZE;
+#ifdef DTLS_SINGLE_PEER_CLIENT
+  LOGF(level, "  %-12s %6u bytes, shared with the CoAP encoder\r\n", "scratch", (unsigned int)DTLS_MAX_BUF);
+  total += DTLS_MAX_BUF;
+#else
+  LOGF(level, "  %-12s %6u bytes on the stack, while sending\r\n", "send buffer", (unsigned int)DTLS_MAX_BUF);
+#endif
+  for (int i = 0; i < 4; i++) {
+    pool_bytes = stats[i]->size * pool[i]->block_size;
+    LOGF(level, "  %-12s %6u bytes = %u x %u, used %u, high-water %u, failures %u\r\n", names[i], pool_bytes,
+         stats[i]->size, (unsigned int)pool[i]->block_size, stats[i]->used, stats[i]->high_water, stats[i]->failures);
+    total += pool_bytes;
+  }
+  LOGF(level, "  %-12s %6u bytes\r\n", "total", total);
+}
@@ -29,10 +29,18 @@
 
 extern "C" {
 #include "../../tinydtls/dtls.h"
+#include "../../tinydtls/dtls_pool.h"
 }
 
 
 
+/** Largest datagram to pack records into, between beginBatch() and flushBatch() */
+#ifndef OWL_DTLS_BATCH_SIZE
+#define OWL_DTLS_BATCH_SIZE MODEM_UDP_BUFFER_SIZE
+#endif
+
+
+
 class OwlDTLSClient;
 
 typedef void (*OwlDTLS_DataHandler_f)(OwlDTLSClient *owlDTLSClient, session_t *session, str plaintext);
@@ -63,6 +71,46 @@ class OwlDTLSClient {
    */
   int connect(uint16_t local_port, str remote_ip, uint16_t remote_port);
 
+  /**
+   * Like connect(), but restoring a session saved with saveSession(), e.g. before powering off, instead of starting
+   * with a handshake. If the saved session is not usable, this falls back to connect(). A session reserved with
+   * reserveSession() sends only the records reserved there. One which was not must be restored only once.
+   * @param local_port - local port, 0 if dynamically allocated
+   * @param remote_ip - destination IP
+   * @param remote_port - destination port
+   * @param state - the saved session
+   * @param state_len - length of the saved session
+   * @return 1 on success, 0 on failure
+   */
+  int restoreSession(uint16_t local_port, str remote_ip, uint16_t remote_port, const uint8_t *state, int state_len);
+
+  /**
+   * Serialize the current session (keys, sequence numbers, etc), for restoreSession() after a power cycle. The session
+   * is closed locally then, without notifying the server, so nothing more can be sent with its keys. The state contains
+   * the session keys, so keep it in a protected storage.
+   * @param buf - buffer to write to, of DTLS_SESSION_STATE_MAX_LENGTH bytes to be sure
+   * @param buf_len - size of buf
+   * @return the length of the saved session, or 0 on failure (e.g. not connected)
+   */
+  int saveSession(uint8_t *buf, int buf_len);
+
+  /**
+   * Reserve the record sequence numbers for one restoreSession() of a saved session. The state is updated in place,
+   * and must replace the saved one in the storage before it is restored, such that no sequence number is used twice.
+   * @param state - the saved session, updated in place
+   * @param state_len - length of the saved session
+   * @return 1 on success, 0 if the state is not a valid saved session
+   */
+  static int reserveSession(uint8_t *state, int state_len);
+
+  /**
+   * Take over the session which the previous client could resume with an abbreviated handshake, when replacing it
+   * with this new one, together with the handshake retransmission timeout learned from the previous round-trip
+   * times. Call it after init() and before connect().
+   * @param previous - the client being replaced
+   */
+  void takeResumableSession(OwlDTLSClient *previous);
+
   /* TODO - test */
   int close();
 
@@ -80,6 +128,25 @@ class OwlDTLSClient {
    */
   int sendRawData(str data);
 
+  /**
+   * Start collecting the records to send, instead of sending each in its own datagram. Records are packed into
+   * datagrams of up to OWL_DTLS_BATCH_SIZE bytes, so that e.g. an ACK, a receipt and a new request cost one modem
+   * transaction instead of three. Nothing goes out until the batch fills up or flushBatch() is called - do not wait
+   * for a reply in between.
+   */
+  void beginBatch();
+
+  /**
+   * Send the records collected since beginBatch() and go back to sending each record right away.
+   * @return 1 on success (also if there was nothing to send), 0 on failure
+   */
+  int flushBatch();
+
+  /**
+   * @return if records are being collected since beginBatch()
+   */
+  bool isBatching();
+
   /**
    * Call this every once in a while, to do retransmission and to trigger receive
    * @return 1 on success, 0 on failure
@@ -113,6 +180,53 @@ class OwlDTLSClient {
    */
   dtls_alert_description_e getCurrentStatus();
 
+  /**
+   * Get the time when the datagram currently being deciphered was received from the modem - to measure from the data
+   * handler the delay added by the deciphering and dispatching.
+   * @return owl_time_us() at reception
+   */
+  uint32_t getLastRxTime();
+
+  /**
+   * Enable or disable offering the DTLS Connection ID extension (RFC 9146) in the next handshakes - enabled by
+   * default. With a Connection ID from the server in each record, the session survives the NAT rebinding of our
+   * address, without a new handshake. Servers not supporting it ignore the offer.
+   * @param enabled - true to offer it, false otherwise
+   */
+  void setConnectionIdEnabled(bool enabled);
+
+  /**
+   * Get the Connection ID which the server asked us to send in the records of the current session.
+   * @param out_cid - if not null, set to point to the Connection ID
+   * @return 1 if a Connection ID is in use, 0 otherwise
+   */
+  int getConnectionId(str *out_cid);
+
+  /**
+   * Get the duration and the retransmissions of the handshakes, and the timeout after which the next handshake flight
+   * is retransmitted. The timeout starts at DTLS_FIRST_RETRANSMIT_SECONDS and then follows the round-trip times of
+   * the flights (RFC 6298), also over reconnections - see takeResumableSession().
+   * @param out_stats - if not null, filled with the handshake counters
+   * @param out_timeout_ms - if not null, set to the current retransmission timeout in milliseconds
+   * @return 1 on success, 0 if the DTLS context was not created yet
+   */
+  int getHandshakeStats(dtls_handshake_stats_t *out_stats, uint32_t *out_timeout_ms);
+
+  /**
+   * Get the usage of the static pools from which tinydtls takes peers, handshake and security parameters and
+   * retransmission buffers. These are shared by all the clients; the high-water marks and the failures tell if
+   * DTLS_PEER_MAX, DTLS_HANDSHAKE_MAX and NETQ_MAXCNT fit the application.
+   * @param out_stats - structure to fill in
+   */
+  static void getPoolStats(dtls_pools_stats_t *out_stats);
+
+  /**
+   * Log the RAM taken by tinydtls: one context and batch buffer per client, the record scratch buffer of the
+   * single-peer client profile (DTLS_CONF_SINGLE_PEER_CLIENT) and the static pools, with their usage.
+   * @param level - log level to print at
+   */
+  static void logRAMUsage(log_level_t level);
+
 
  private:
   dtls_context_t *dtls_context = 0;
@@ -131,12 +245,25 @@ class OwlDTLSClient {
 
   clock_time_t next_retransmit_timer = 0;
 
+  bool use_connection_id = true; /**< offer the Connection ID extension in the ClientHello */
+
   dtls_alert_description_e last_status = DTLS_Alert_Description__close_notify;
 
+  uint32_t last_rx_time = 0; /**< owl_time_us() of the last received datagram */
+
+  dtls_rto_t rto = {0}; /**< retransmission timeout estimate, kept from the closed contexts */
+
+  bool batching = false;                  /**< collecting records since beginBatch() */
+  uint8_t batch_buf[OWL_DTLS_BATCH_SIZE]; /**< the records of the datagram being filled */
+  int batch_len     = 0;                  /**< bytes in batch_buf */
+  int batch_records = 0;                  /**< records in batch_buf */
+
   OwlDTLS_DataHandler_f handler_data   = 0;
   OwlDTLS_EventHandler_f handler_event = 0;
 
 
+  int openSocket(uint16_t local_port, str remote_ip, uint16_t remote_port);
+
   static OwlDTLSClient *socketMappings[MODEM_MAX_SOCKETS];
   static void handleRawData(uint8_t socket, str remote_ip, uint16_t remote_port, str data);
 
@@ -145,6 +272,7 @@ class OwlDTLSClient {
   // TODO - can we make these private maybe?
   int getPSKInfo(const session_t *session, dtls_credentials_type_t type, const unsigned char *desc, size_t desc_len,
                  unsigned char *result, size_t result_length);
+  int queueRawData(str data);
   int fireHandlerData(session_t *session, str data);
   int fireHandlerEvent(session_t *session, dtls_alert_level_e level, dtls_alert_description_e description);
 };
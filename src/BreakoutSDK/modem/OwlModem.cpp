@@ -28,14 +28,22 @@
 
 #include "OwlModemSIM.h"
 
+extern "C" {
+#include "../../tinydtls/dtls_drbg.h"
+}
+
 
 
 OwlModem::OwlModem(HardwareSerial *modem_port, USBSerial *debug_port, HardwareSerial *gnss_port)
     : modem_port(modem_port), debug_port(debug_port), gnss_port(gnss_port) {
   if (debug_port) debug_port->enableBlockingTx();  // reliably write to it
-  // Seed the random
+  // Seed the random generator with the noise on the unconnected ANALOG_RND_PIN, sampled at jittery times
+  uint32_t noise[32];
   pinMode(ANALOG_RND_PIN, INPUT);
-  randomSeed(analogRead(ANALOG_RND_PIN));
+  for (int i = 0; i < 32; i++)
+    noise[i] = ((uint32_t)analogRead(ANALOG_RND_PIN) << 16) ^ micros();
+  dtls_drbg_add_entropy((const unsigned char *)noise, sizeof(noise));
+  randomSeed(dtls_drbg_uint32());  // for the application's random()
 }
 
 OwlModem::~OwlModem() {
@@ -335,6 +343,8 @@ int OwlModem::waitForNetworkRegistration(char *purpose, int testing_variant) {
     delay(2000);
   }
 
+  addModemEntropy();
+
   if ((testing_variant & Testing__Skip_Set_Host_Device_Information) != 0) return 1;
 
   if (!setHostDeviceInformation(purpose)) {
@@ -347,6 +357,20 @@ int OwlModem::waitForNetworkRegistration(char *purpose, int testing_variant) {
 
 
 
+void OwlModem::addModemEntropy() {
+  static const char *commands[] = {"AT+CCLK?", "AT+CSQ", "AT+CEREG?"};
+  uint32_t now                  = micros();
+  dtls_drbg_add_entropy((const unsigned char *)&now, sizeof(now));
+  for (int i = 0; i < 3; i++) {
+    if (doCommand((char *)commands[i], 1000, &response, MODEM_RESPONSE_BUFFER_SIZE) != AT_Result_Code__OK) continue;
+    now = micros();
+    dtls_drbg_add_entropy((const unsigned char *)response.s, response.len);
+    dtls_drbg_add_entropy((const unsigned char *)&now, sizeof(now));
+  }
+}
+
+
+
 static str s_exitbypass = {.s = "exitbypass", .len = 10};
 
 void OwlModem::bypassCLI() {
@@ -281,6 +281,12 @@ class OwlModem {
    */
   void computeHostDeviceInformation(str purpose);
 
+  /**
+   * Mix into the random generator what the modem knows and we could not guess: how long the registration took, the
+   * network time, the signal quality and the serving cell.
+   */
+  void addModemEntropy();
+
 public: // These things are not part of the API. TODO - make them private
   int drainGNSSRx(str *gnss_buffer, int gnss_buffer_len);
 };
@@ -443,6 +443,48 @@ int OwlModemSocket::connect(uint8_t socket, str remote_ip, uint16_t remote_port,
   return result;
 }
 
+int OwlModemSocket::setSecurityProfilePSK(uint8_t profile_id, str psk_id, str psk_key) {
+  char buf[160];
+  int len;
+  if (psk_id.len > 64 || psk_key.len > 64) {
+    LOG(L_ERR, "PSK identity %d or key %d too long > max 64 bytes\r\n", psk_id.len, psk_key.len);
+    return 0;
+  }
+  if (str_find_char(psk_id, (char *)"\"") >= 0) {
+    LOG(L_ERR, "PSK identity can not contain a double quote, as it is sent quoted in the AT command\r\n");
+    return 0;
+  }
+  snprintf(buf, 160, "AT+USECPRF=%u", profile_id);
+  if (owlModem->doCommand(buf, 1000, 0, 0) != AT_Result_Code__OK) goto error;
+  snprintf(buf, 160, "AT+USECPRF=%u,%d,0", profile_id, AT_USECPRF_Op__Certificate_Validation_Level);
+  if (owlModem->doCommand(buf, 1000, 0, 0) != AT_Result_Code__OK) goto error;
+  snprintf(buf, 160, "AT+USECPRF=%u,%d,\"%.*s\"", profile_id, AT_USECPRF_Op__Pre_Shared_Key_Identity, psk_id.len,
+           psk_id.s);
+  if (owlModem->doCommand(buf, 1000, 0, 0) != AT_Result_Code__OK) goto error;
+  len = snprintf(buf, 160, "AT+USECPRF=%u,%d,\"", profile_id, AT_USECPRF_Op__Pre_Shared_Key);
+  len += str_to_hex(buf + len, 160 - len, psk_key);
+  snprintf(buf + len, 160 - len, "\",1");
+  if (owlModem->doCommand(buf, 1000, 0, 0) != AT_Result_Code__OK) goto error;
+  return 1;
+error:
+  LOG(L_ERR, "Error setting up security profile %u\r\n", profile_id);
+  return 0;
+}
+
+int OwlModemSocket::enableSecurity(uint8_t socket, uint8_t profile_id) {
+  if (socket >= MODEM_MAX_SOCKETS) {
+    LOG(L_ERR, "Bad socket %d >= %d\r\n", socket, MODEM_MAX_SOCKETS);
+    return 0;
+  }
+  if (!this->status[socket].is_opened) {
+    LOG(L_ERR, "Socket %d is not opened\r\n", socket);
+    return 0;
+  }
+  char buf[64];
+  snprintf(buf, 64, "AT+USOSEC=%u,%d,%u", socket, AT_USOSEC_Status__Enabled, profile_id);
+  return owlModem->doCommand(buf, 1000, 0, 0) == AT_Result_Code__OK;
+}
+
 static str s_usowr = STRDECL("+USOWR: ");
 
 int OwlModemSocket::send(uint8_t socket, str data) {
@@ -920,6 +962,24 @@ error:
   return 0;
 }
 
+int OwlModemSocket::openConnectSecureUDP(uint8_t profile_id, str remote_ip, uint16_t remote_port,
+                                         OwlModem_UDPDataHandler_f handler_data, uint8_t *out_socket) {
+  if (out_socket) *out_socket = 255;
+  uint8_t socket              = 255;
+
+  if (!this->open(AT_USO_Protocol__UDP, 0, &socket)) goto error;
+  if (!this->enableSecurity(socket, profile_id)) goto error;
+  if (!this->connect(socket, remote_ip, remote_port, (OwlModem_SocketClosedHandler_f)0)) goto error;
+
+  this->status[socket].handler_UDPData = handler_data;
+
+  if (out_socket) *out_socket = socket;
+  return 1;
+error:
+  if (socket != 255) this->close(socket);
+  return 0;
+}
+
 int OwlModemSocket::openListenConnectTCP(uint16_t local_port, str remote_ip, uint16_t remote_port,
                                          OwlModem_SocketClosedHandler_f handler_close,
                                          OwlModem_TCPDataHandler_f handler_data, uint8_t *out_socket) {
@@ -157,6 +157,26 @@ class OwlModemSocket {
    */
   int connect(uint8_t socket, str remote_ip, uint16_t remote_port, OwlModem_SocketClosedHandler_f cb);
 
+  /**
+   * Set up a security profile of the modem for DTLS with a pre-shared key. The profile is reset first, then the server
+   * certificate validation is disabled and the PSK identity and key are stored. The handshake and the record layer are
+   * then done by the modem for the sockets which enable this profile with enableSecurity().
+   * @param profile_id - security profile id, 0-4
+   * @param psk_id - PSK identity, without double quotes - sent to the modem quoted
+   * @param psk_key - PSK key, in binary format - sent to the modem hex encoded
+   * @return 1 on success, 0 on failure
+   */
+  int setSecurityProfilePSK(uint8_t profile_id, str psk_id, str psk_key);
+
+  /**
+   * Enable the security profile on a socket. Call this after open() and before connect(), which then does the
+   * handshake. Data sent and received on the socket afterwards is in plaintext.
+   * @param socket - socket id
+   * @param profile_id - security profile id, as set with setSecurityProfilePSK()
+   * @return 1 on success, 0 on failure
+   */
+  int enableSecurity(uint8_t socket, uint8_t profile_id);
+
   /**
    * Send data over UDP
    * @param socket
@@ -294,6 +314,19 @@ class OwlModemSocket {
   int openListenConnectUDP(uint16_t local_port, str remote_ip, uint16_t remote_port,
                            OwlModem_UDPDataHandler_f handler_data, uint8_t *out_socket);
 
+  /**
+   * Open UDP socket, enable the modem's DTLS with the given security profile, connect to the remote IP:port (which
+   * does the handshake) and set the listen callback in one operation.
+   * @param profile_id - security profile id, as set with setSecurityProfilePSK()
+   * @param remote_ip - remote IP
+   * @param remote_port - remote port
+   * @param handler_data - callback for incoming UDP data, already decrypted by the modem
+   * @param out_socket - output socket id
+   * @return 1 on success, 0 on failure
+   */
+  int openConnectSecureUDP(uint8_t profile_id, str remote_ip, uint16_t remote_port,
+                           OwlModem_UDPDataHandler_f handler_data, uint8_t *out_socket);
+
   /**
    * TCP client - Open TCP socket, connect to the remote IP:port and set the listen callback in one operation.
    * @param local_port - local port to listen on
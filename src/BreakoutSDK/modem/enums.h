@@ -312,6 +312,19 @@ typedef enum {
   AT_USO_Protocol__UDP  = 17,
 } at_uso_protocol_e;
 
+typedef enum {
+  AT_USECPRF_Op__Certificate_Validation_Level = 0, /**< 0 - no validation of the server certificate */
+  AT_USECPRF_Op__TLS_Version                  = 1, /**< 0 - any, the modem negotiates */
+  AT_USECPRF_Op__Cipher_Suite                 = 2, /**< 0 - automatic selection */
+  AT_USECPRF_Op__Pre_Shared_Key               = 8, /**< key, hex encoded when followed by ,1 */
+  AT_USECPRF_Op__Pre_Shared_Key_Identity      = 9, /**< identity string */
+} at_usecprf_op_code_e;
+
+typedef enum {
+  AT_USOSEC_Status__Disabled = 0,
+  AT_USOSEC_Status__Enabled  = 1,
+} at_usosec_status_e;
+
 typedef enum {
   AT_USO_Error__Success                = 0,   /**< No Error */
   AT_USO_Error__EPERM                  = 1,   /**< Operation not permitted (internal error) */
@@ -175,7 +175,7 @@ static char *owl_log_level_color(log_level_t level) {
 #endif
 }
 
-extern "C" void owl_log(log_level_t level, char *format, ...) {
+extern "C" void owl_log(log_level_t level, const char *format, ...) {
   if (!IS_PRINTABLE(level)) return;
   char buf[LOG_LINE_MAX_LEN];
   int cnt          = 0;
@@ -218,7 +218,7 @@ extern "C" void owl_log(log_level_t level, char *format, ...) {
 #endif
 }
 
-extern "C" void owl_log_empty(log_level_t level, char *format, ...) {
+extern "C" void owl_log_empty(log_level_t level, const char *format, ...) {
   if (!IS_PRINTABLE(level)) return;
   char buf[LOG_LINE_MAX_LEN];
   int cnt = 0;
@@ -42,6 +42,13 @@ typedef uint64_t owl_time_t;
  */
 owl_time_t owl_time();
 
+/**
+ * Wrapping time in microseconds, for measuring short intervals. Wraps around every ~71 minutes, so use it only for
+ * differences, in uint32_t arithmetic.
+ * @return time since start in microseconds
+ */
+uint32_t owl_time_us();
+
 
 #ifdef __cplusplus
 }
@@ -71,7 +71,9 @@ typedef enum {
 #define TESTING_VARIANT_REG 0
 
 
-#define BREAKOUT_IP "54.145.1.94"
+#ifndef BREAKOUT_IP
+#define BREAKOUT_IP "54.145.1.94"  // Override to point to a local stand-in server, see extras/CoAPStandIn
+#endif
 #define TESTING_APN "nb.iot"
 
 
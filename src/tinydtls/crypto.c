@@ -84,6 +84,45 @@ static void dtls_cipher_context_release(void)
 #endif
 }
 
+/**
+ * Returns the crypto context with the expanded @p key. The keys do
+ * not change within an epoch, so the key schedule is computed once
+ * per epoch and direction, instead of for every record.
+ */
+static aes128_ccm_t *dtls_cipher_context_key(struct dtls_cipher_context_t *ctx,
+					     const unsigned char *key, size_t keylen)
+{
+  int i;
+
+  for (i = 0; i < DTLS_CIPHER_KEY_CACHE_SIZE; i++)
+    if (ctx->key_length[i] == keylen && memcmp(ctx->key[i], key, keylen) == 0)
+      return &ctx->data[i];
+
+  if (keylen > DTLS_KEY_LENGTH)
+    return NULL;
+
+  i = ctx->next;
+  ctx->key_length[i] = 0;
+  if (rijndael_set_key_enc_only(&ctx->data[i].ctx, key, 8 * keylen) < 0)
+    return NULL;
+  memcpy(ctx->key[i], key, keylen);
+  ctx->key_length[i] = keylen;
+  ctx->next = (i + 1) % DTLS_CIPHER_KEY_CACHE_SIZE;
+  return &ctx->data[i];
+}
+
+/**
+ * Wipes the cached keys and their schedules, so that no key stays in
+ * the static cipher context once its security parameters are freed.
+ */
+static void dtls_cipher_context_clear(void)
+{
+  struct dtls_cipher_context_t *ctx = dtls_cipher_context_get();
+
+  memset(ctx, 0, sizeof(*ctx));
+  dtls_cipher_context_release();
+}
+
 #if !(defined (WITH_CONTIKI)) && !(defined (RIOT_VERSION)) && !(defined(WITH_ARDUINO))
 void crypto_init(void)
 {
@@ -154,27 +193,28 @@ static void dtls_handshake_dealloc(dtls_handshake_parameters_t *handshake) {
   memarray_free(&handshake_storage, handshake);
 }
 #elif defined (WITH_ARDUINO)
+#include "dtls_pool.h"
 
+DTLS_POOL(dtls_handshake_pool, dtls_handshake_parameters_t, DTLS_HANDSHAKE_MAX);
+DTLS_POOL(dtls_security_pool, dtls_security_parameters_t, DTLS_SECURITY_MAX);
 
-//TODO - Investigate if this is the non-volatile storage and it is enough to just manage these functions in order
-// to provide persistence of sessions. For now, doing a standard malloc
 void crypto_init(void) {
 }
 
 static dtls_handshake_parameters_t *dtls_handshake_malloc(void) {
-  return owl_malloc(sizeof(dtls_handshake_parameters_t));
+  return dtls_pool_alloc(&dtls_handshake_pool);
 }
 
 static void dtls_handshake_dealloc(dtls_handshake_parameters_t *handshake) {
-  owl_free(handshake);
+  dtls_pool_free(&dtls_handshake_pool, handshake);
 }
 
 static dtls_security_parameters_t *dtls_security_malloc(void) {
-  return owl_malloc(sizeof(dtls_security_parameters_t));
+  return dtls_pool_alloc(&dtls_security_pool);
 }
 
 static void dtls_security_dealloc(dtls_security_parameters_t *security) {
-  owl_free(security);
+  dtls_pool_free(&dtls_security_pool, security);
 }
 
 #endif /* WITH_ARDUINO */
@@ -235,6 +275,7 @@ void dtls_security_free(dtls_security_parameters_t *security)
   if (!security)
     return;
 
+  dtls_cipher_context_clear();
   dtls_security_dealloc(security);
 }
 
@@ -245,7 +286,9 @@ dtls_p_hash(dtls_hashfunc_t h,
 	    const unsigned char *random1, size_t random1len,
 	    const unsigned char *random2, size_t random2len,
 	    unsigned char *buf, size_t buflen) {
-  dtls_hmac_context_t *hmac_a, *hmac_p;
+  /* All HMACs of P_hash share the same key, so the context is keyed
+   * once and then restarted from the cached ipad/opad hash states. */
+  dtls_hmac_context_t hmac;
 
   unsigned char A[DTLS_HMAC_DIGEST_SIZE];
   unsigned char tmp[DTLS_HMAC_DIGEST_SIZE];
@@ -253,57 +296,43 @@ dtls_p_hash(dtls_hashfunc_t h,
   size_t len = 0;			/* result length */
   (void)h;
 
-  hmac_a = dtls_hmac_new(key, keylen);
-  if (!hmac_a)
-    return 0;
+  dtls_hmac_init(&hmac, key, keylen);
 
   /* calculate A(1) from A(0) == seed */
-  HMAC_UPDATE_SEED(hmac_a, label, labellen);
-  HMAC_UPDATE_SEED(hmac_a, random1, random1len);
-  HMAC_UPDATE_SEED(hmac_a, random2, random2len);
+  HMAC_UPDATE_SEED(&hmac, label, labellen);
+  HMAC_UPDATE_SEED(&hmac, random1, random1len);
+  HMAC_UPDATE_SEED(&hmac, random2, random2len);
 
-  dlen = dtls_hmac_finalize(hmac_a, A);
-
-  hmac_p = dtls_hmac_new(key, keylen);
-  if (!hmac_p)
-    goto error;
+  dlen = dtls_hmac_finalize(&hmac, A);
 
   while (len + dlen < buflen) {
+    dtls_hmac_reset(&hmac);
+    dtls_hmac_update(&hmac, A, dlen);
 
-    /* FIXME: rewrite loop to avoid superflous call to dtls_hmac_init() */
-    dtls_hmac_init(hmac_p, key, keylen);
-    dtls_hmac_update(hmac_p, A, dlen);
-
-    HMAC_UPDATE_SEED(hmac_p, label, labellen);
-    HMAC_UPDATE_SEED(hmac_p, random1, random1len);
-    HMAC_UPDATE_SEED(hmac_p, random2, random2len);
+    HMAC_UPDATE_SEED(&hmac, label, labellen);
+    HMAC_UPDATE_SEED(&hmac, random1, random1len);
+    HMAC_UPDATE_SEED(&hmac, random2, random2len);
 
-    len += dtls_hmac_finalize(hmac_p, tmp);
-    memcpy(buf, tmp, dlen);
+    len += dtls_hmac_finalize(&hmac, buf);
     buf += dlen;
 
     /* calculate A(i+1) */
-    dtls_hmac_init(hmac_a, key, keylen);
-    dtls_hmac_update(hmac_a, A, dlen);
-    dtls_hmac_finalize(hmac_a, A);
+    dtls_hmac_reset(&hmac);
+    dtls_hmac_update(&hmac, A, dlen);
+    dtls_hmac_finalize(&hmac, A);
   }
 
-  dtls_hmac_init(hmac_p, key, keylen);
-  dtls_hmac_update(hmac_p, A, dlen);
+  dtls_hmac_reset(&hmac);
+  dtls_hmac_update(&hmac, A, dlen);
 
-  
-  HMAC_UPDATE_SEED(hmac_p, label, labellen);
-  HMAC_UPDATE_SEED(hmac_p, random1, random1len);
-  HMAC_UPDATE_SEED(hmac_p, random2, random2len);
+  HMAC_UPDATE_SEED(&hmac, label, labellen);
+  HMAC_UPDATE_SEED(&hmac, random1, random1len);
+  HMAC_UPDATE_SEED(&hmac, random2, random2len);
 
-  
-  dtls_hmac_finalize(hmac_p, tmp);
+  dtls_hmac_finalize(&hmac, tmp);
   memcpy(buf, tmp, buflen - len);
 
- error:
-  dtls_hmac_free(hmac_a);
-  dtls_hmac_free(hmac_p);
-
+  memset(&hmac, 0, sizeof(hmac));
   return buflen;
 }
 
@@ -592,11 +621,11 @@ dtls_encrypt(const unsigned char *src, size_t length,
 	     unsigned char *key, size_t keylen,
 	     const unsigned char *aad, size_t la)
 {
-  int ret;
+  int ret = -1;
   struct dtls_cipher_context_t *ctx = dtls_cipher_context_get();
+  aes128_ccm_t *ccm_ctx = dtls_cipher_context_key(ctx, key, keylen);
 
-  ret = rijndael_set_key_enc_only(&ctx->data.ctx, key, 8 * keylen);
-  if (ret < 0) {
+  if (!ccm_ctx) {
     /* cleanup everything in case the key has the wrong size */
     dtls_warn("cannot set rijndael key\r\n");
     goto error;
@@ -604,7 +633,7 @@ dtls_encrypt(const unsigned char *src, size_t length,
 
   if (src != buf)
     memmove(buf, src, length);
-  ret = dtls_ccm_encrypt(&ctx->data, src, length, buf, nounce, aad, la);
+  ret = dtls_ccm_encrypt(ccm_ctx, src, length, buf, nounce, aad, la);
 
 error:
   dtls_cipher_context_release();
@@ -618,11 +647,11 @@ dtls_decrypt(const unsigned char *src, size_t length,
 	     unsigned char *key, size_t keylen,
 	     const unsigned char *aad, size_t la)
 {
-  int ret;
+  int ret = -1;
   struct dtls_cipher_context_t *ctx = dtls_cipher_context_get();
+  aes128_ccm_t *ccm_ctx = dtls_cipher_context_key(ctx, key, keylen);
 
-  ret = rijndael_set_key_enc_only(&ctx->data.ctx, key, 8 * keylen);
-  if (ret < 0) {
+  if (!ccm_ctx) {
     /* cleanup everything in case the key has the wrong size */
     dtls_warn("cannot set rijndael key\r\n");
     goto error;
@@ -630,7 +659,7 @@ dtls_decrypt(const unsigned char *src, size_t length,
 
   if (src != buf)
     memmove(buf, src, length);
-  ret = dtls_ccm_decrypt(&ctx->data, src, length, buf, nounce, aad, la);
+  ret = dtls_ccm_decrypt(ccm_ctx, src, length, buf, nounce, aad, la);
 
 error:
   dtls_cipher_context_release();
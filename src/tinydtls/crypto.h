@@ -61,9 +61,17 @@ typedef struct {
   rijndael_ctx ctx;		       /**< AES-128 encryption context */
 } aes128_ccm_t;
 
+#ifndef DTLS_CIPHER_KEY_CACHE_SIZE
+/** Number of expanded keys kept, one for each direction of an epoch. */
+#define DTLS_CIPHER_KEY_CACHE_SIZE 2
+#endif
+
 typedef struct dtls_cipher_context_t {
   /** numeric identifier of this cipher suite in host byte order. */
-  aes128_ccm_t data;		/**< The crypto context */
+  aes128_ccm_t data[DTLS_CIPHER_KEY_CACHE_SIZE]; /**< The crypto contexts, with expanded keys */
+  unsigned char key[DTLS_CIPHER_KEY_CACHE_SIZE][DTLS_KEY_LENGTH]; /**< key of each context */
+  unsigned char key_length[DTLS_CIPHER_KEY_CACHE_SIZE]; /**< 0 for an unused context */
+  unsigned char next;		/**< the context to expand the next key in */
 } dtls_cipher_context_t;
 
 typedef struct {
@@ -97,6 +105,7 @@ typedef struct {
   dtls_cipher_t cipher;		/**< cipher type */
   uint16_t epoch;	     /**< counter for cipher state changes*/
   uint64_t rseq;	     /**< sequence number of last record sent */
+  uint64_t rseq_limit;	     /**< 0, or the first sequence number not reserved for an imported session */
 
   /** 
    * The key block generated from PRF applied to client and server
@@ -107,6 +116,11 @@ typedef struct {
   uint8 key_block[MAX_KEYBLOCK_LENGTH];
   
   seqnum_t cseq;        /**<sequence number of last record received*/
+
+#if (DTLS_MAX_CID_LENGTH > 0)
+  uint8 write_cid[DTLS_MAX_CID_LENGTH]; /**< Connection ID to send in the records of this epoch */
+  uint8 write_cid_length;	     /**< 0 if no Connection ID was negotiated */
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
 } dtls_security_parameters_t;
 
 struct netq_t;
@@ -126,6 +140,16 @@ typedef struct {
   dtls_compression_t compression;		/**< compression method */
   dtls_cipher_t cipher;		/**< cipher type */
   unsigned int do_client_auth:1;
+#if (DTLS_MAX_CID_LENGTH > 0)
+  unsigned int use_cid:1;	/**< the connection_id extension was sent in the ClientHello */
+  uint8 write_cid[DTLS_MAX_CID_LENGTH]; /**< Connection ID received in the ServerHello */
+  uint8 write_cid_length;
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  unsigned int resumed:1;	/**< the server accepted to resume the session, abbreviated handshake */
+  uint8 session_id[DTLS_SESSION_ID_MAX_LENGTH]; /**< session id received in the ServerHello */
+  uint8 session_id_length;
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
   union {
 #ifdef DTLS_ECC
     dtls_handshake_parameters_ecdsa_t ecdsa;
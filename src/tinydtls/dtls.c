@@ -93,6 +93,8 @@ memarray_t dtlscontext_storage;
 #define DEL_PEER(head,delptr)                   \
   if ((head) != NULL && (delptr) != NULL) {	\
     LL_DELETE(head,delptr);                     \
+    if (ctx->last_peer == (delptr))             \
+      ctx->last_peer = NULL;                    \
   }
 #define ADD_PEER(head,sess,add)                 \
   LL_PREPEND(ctx->peers, peer);
@@ -104,6 +106,8 @@ memarray_t dtlscontext_storage;
 #define DEL_PEER(head,delptr)                   \
   if ((head) != NULL && (delptr) != NULL) {	\
     HASH_DELETE(hh,head,delptr);		\
+    if (ctx->last_peer == (delptr))             \
+      ctx->last_peer = NULL;                    \
   }
 #endif /* DTLS_PEERS_NOHASH */
 
@@ -111,7 +115,8 @@ memarray_t dtlscontext_storage;
 #define DTLS_HS_LENGTH sizeof(dtls_handshake_header_t)
 #define DTLS_CH_LENGTH sizeof(dtls_client_hello_t) /* no variable length fields! */
 #define DTLS_COOKIE_LENGTH_MAX 32
-#define DTLS_CH_LENGTH_MAX sizeof(dtls_client_hello_t) + DTLS_COOKIE_LENGTH_MAX + 12 + 26
+#define DTLS_CH_LENGTH_MAX sizeof(dtls_client_hello_t) + DTLS_COOKIE_LENGTH_MAX + 12 + 26 + 5 \
+  + DTLS_SESSION_ID_MAX_LENGTH
 #define DTLS_HV_LENGTH sizeof(dtls_hello_verify_t)
 #define DTLS_SH_LENGTH (2 + DTLS_RANDOM_LENGTH + 1 + 2 + 1)
 #define DTLS_CE_LENGTH (3 + 3 + 27 + DTLS_EC_KEY_SIZE + DTLS_EC_KEY_SIZE)
@@ -276,13 +281,83 @@ dtls_send(dtls_context_t *ctx, dtls_peer_t *peer, unsigned char type,
  */
 static void dtls_stop_retransmission(dtls_context_t *context, dtls_peer_t *peer);
 
+/**
+ * Like dtls_stop_retransmission(), for when the next flight of the
+ * handshake arrived: the round-trip time of the flight we sent, if it
+ * was not retransmitted, updates the retransmission timeout.
+ */
+static void dtls_flight_answered(dtls_context_t *context, dtls_peer_t *peer);
+
 dtls_peer_t *
 dtls_get_peer(const dtls_context_t *ctx, const session_t *session) {
-  dtls_peer_t *p;
+  dtls_peer_t *p = ctx->last_peer;
+
+  /* A client talks to one server, so nearly every record is for the
+   * peer of the previous lookup. Only a miss walks the peer list. */
+  if (p && dtls_session_equals(&p->session, session))
+    return p;
+
   FIND_PEER(ctx->peers, session, p);
+  if (p)
+    ((dtls_context_t *)ctx)->last_peer = p;
   return p;
 }
 
+#if (DTLS_MAX_CID_LENGTH > 0)
+int
+dtls_get_write_cid(dtls_context_t *ctx, const session_t *session,
+		   const uint8 **cid) {
+  dtls_peer_t *peer = dtls_get_peer(ctx, session);
+  dtls_security_parameters_t *security;
+
+  if (!peer || peer->state != DTLS_STATE_CONNECTED)
+    return 0;
+  security = dtls_security_params(peer);
+  if (!security)
+    return 0;
+  if (cid)
+    *cid = security->write_cid;
+  return security->write_cid_length;
+}
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+/**
+ * Returns the session to offer for resumption to @p peer, or @c NULL
+ * if there is none for this server.
+ */
+static dtls_resumption_t *
+dtls_get_resumption(dtls_context_t *ctx, const dtls_peer_t *peer) {
+  if (!ctx->resumption.session_id_length ||
+      !dtls_session_equals(&ctx->resumption.session, &peer->session))
+    return NULL;
+  return &ctx->resumption;
+}
+
+/**
+ * Remembers the session just established with @p peer, to offer its
+ * resumption in the next handshake. Servers which do not cache the
+ * sessions send an empty session id, which clears any previous one.
+ */
+static void
+dtls_update_resumption(dtls_context_t *ctx, dtls_peer_t *peer) {
+  dtls_handshake_parameters_t *handshake = peer->handshake_params;
+  dtls_resumption_t *resumption = &ctx->resumption;
+
+  if (!handshake->session_id_length) {
+    memset(resumption, 0, sizeof(dtls_resumption_t));
+    return;
+  }
+  memcpy(&resumption->session, &peer->session, sizeof(session_t));
+  resumption->cipher = handshake->cipher;
+  memcpy(resumption->session_id, handshake->session_id,
+	 handshake->session_id_length);
+  resumption->session_id_length = handshake->session_id_length;
+  memcpy(resumption->master_secret, handshake->tmp.master_secret,
+	 DTLS_MASTER_SECRET_LENGTH);
+}
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+
 /**
  * Adds @p peer to list of peers in @p ctx. This function returns @c 0
  * on success, or a negative value on error (e.g. due to insufficient
@@ -291,9 +366,22 @@ dtls_get_peer(const dtls_context_t *ctx, const session_t *session) {
 static int
 dtls_add_peer(dtls_context_t *ctx, dtls_peer_t *peer) {
   ADD_PEER(ctx->peers, session, peer);
+  ctx->last_peer = peer;
   return 0;
 }
 
+#ifdef DTLS_SINGLE_PEER_CLIENT
+/* All outgoing records are assembled here. Sending is never nested,
+ * so one buffer serves every context, handshake message and
+ * retransmission. */
+static uint8 dtls_scratch[DTLS_MAX_BUF];
+
+uint8 *
+dtls_get_scratch_payload(void) {
+  return dtls_scratch + DTLS_SCRATCH_PAYLOAD_OFFSET;
+}
+#endif /* DTLS_SINGLE_PEER_CLIENT */
+
 int
 dtls_write(struct dtls_context_t *ctx,
 	   session_t *dst, uint8 *buf, size_t len) {
@@ -495,6 +583,10 @@ dtls_set_record_header(uint8 type, dtls_security_parameters_t *security,
     /* increment record sequence counter by 1 */
     security->rseq++;
   } else {
+    /* stateless HelloVerifyRequest: epoch 0, sequence number 0 */
+    dtls_int_to_uint16(buf, DTLS_VERSION);
+    buf += sizeof(uint16ptr);
+
     memset(buf, 0, sizeof(uint16ptr) + sizeof(uint48ptr));
     buf += sizeof(uint16ptr) + sizeof(uint48ptr);
   }
@@ -721,26 +813,17 @@ static char *dtls_handshake_type_to_name(int type)
 
 /**
  * Calculate the pre master secret and after that calculate the master-secret.
+ * The key_block storage space is used temporarily for the pre master secret.
  */
 static int
-calculate_key_block(dtls_context_t *ctx,
-		    dtls_handshake_parameters_t *handshake,
-		    dtls_peer_t *peer,
-		    session_t *session,
-		    dtls_peer_type role) {
+calculate_master_secret(dtls_context_t *ctx,
+			dtls_handshake_parameters_t *handshake,
+			session_t *session,
+			unsigned char *pre_master_secret,
+			uint8 *master_secret) {
+  int pre_master_len = 0;
   (void) ctx;
   (void) session;
-  unsigned char *pre_master_secret;
-  int pre_master_len = 0;
-  dtls_security_parameters_t *security = dtls_security_params_next(peer);
-  uint8 master_secret[DTLS_MASTER_SECRET_LENGTH];
-  (void)role; /* The macro dtls_kb_size() does not use role. */
-
-  if (!security) {
-    return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
-  }
-
-  pre_master_secret = security->key_block;
 
   switch (handshake->cipher) {
 #ifdef DTLS_PSK
@@ -823,6 +906,42 @@ calculate_key_block(dtls_context_t *ctx,
 
   dtls_debug_dump("master_secret", master_secret, DTLS_MASTER_SECRET_LENGTH);
 
+  return 0;
+}
+
+/**
+ * Calculate the key block, from the master secret of the session being
+ * resumed in an abbreviated handshake, or from a new one otherwise.
+ */
+static int
+calculate_key_block(dtls_context_t *ctx,
+		    dtls_handshake_parameters_t *handshake,
+		    dtls_peer_t *peer,
+		    session_t *session,
+		    dtls_peer_type role) {
+  dtls_security_parameters_t *security = dtls_security_params_next(peer);
+  uint8 master_secret[DTLS_MASTER_SECRET_LENGTH];
+  int err;
+  (void)role; /* The macro dtls_kb_size() does not use role. */
+
+  if (!security) {
+    return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
+  }
+
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  if (handshake->resumed) {
+    memcpy(master_secret, ctx->resumption.master_secret,
+	   DTLS_MASTER_SECRET_LENGTH);
+  } else
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+  {
+    err = calculate_master_secret(ctx, handshake, session,
+				  security->key_block, master_secret);
+    if (err < 0) {
+      return err;
+    }
+  }
+
   /* create key_block from master_secret
    * key_block = PRF(master_secret,
                     "key expansion" + tmp.random.server + tmp.random.client) */
@@ -841,6 +960,10 @@ calculate_key_block(dtls_context_t *ctx,
   security->cipher = handshake->cipher;
   security->compression = handshake->compression;
   security->rseq = 0;
+#if (DTLS_MAX_CID_LENGTH > 0)
+  security->write_cid_length = handshake->write_cid_length;
+  memcpy(security->write_cid, handshake->write_cid, handshake->write_cid_length);
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
 
   return 0;
 }
@@ -1003,6 +1126,27 @@ dtls_check_tls_extension(dtls_peer_t *peer,
 	 */
 	dtls_info("skipped encrypt-then-mac extension\r\n");
 	break;
+#if (DTLS_MAX_CID_LENGTH > 0)
+      case TLS_EXT_CONNECTION_ID:
+	if (client_hello) {
+	  /* Only supported as client, so not echoed in our ServerHello */
+	  dtls_info("skipped connection_id extension\r\n");
+	  break;
+	}
+	if (!handshake->use_cid) {
+	  dtls_warn("connection_id extension not offered in the client hello\r\n");
+	  goto error;
+	}
+	if (j < sizeof(uint8) || dtls_uint8_to_int(data) != j - sizeof(uint8)
+	    || j - sizeof(uint8) > DTLS_MAX_CID_LENGTH) {
+	  dtls_warn("bad connection_id extension\r\n");
+	  goto error;
+	}
+	handshake->write_cid_length = j - sizeof(uint8);
+	memcpy(handshake->write_cid, data + sizeof(uint8), handshake->write_cid_length);
+	dtls_debug_dump("write connection_id", handshake->write_cid, handshake->write_cid_length);
+	break;
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
       default:
         dtls_warn("unsupported tls extension: %i\r\n", i);
         break;
@@ -1337,13 +1481,37 @@ dtls_prepare_record(dtls_peer_t *peer, dtls_security_parameters_t *security,
   uint8 *p, *start;
   int res;
   unsigned int i;
+  size_t cid_length = 0;
+
+#if (DTLS_MAX_CID_LENGTH > 0)
+  if (security && security->cipher != TLS_NULL_WITH_NULL_NULL)
+    cid_length = security->write_cid_length;
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
 
-  if (*rlen < DTLS_RH_LENGTH) {
+  if (*rlen < DTLS_RH_LENGTH + cid_length) {
     dtls_alert("The sendbuf (%zu bytes) is too small\r\n", *rlen);
     return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
   }
 
-  p = dtls_set_record_header(type, security, sendbuf, node);
+  /* an imported session may only use the sequence numbers reserved for it */
+  if (!node && security && security->rseq_limit &&
+      security->rseq >= security->rseq_limit) {
+    dtls_warn("reserved sequence numbers of the imported session used up\r\n");
+    return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
+  }
+
+  p = dtls_set_record_header(cid_length ? DTLS_CT_TLS12_CID : type, security, sendbuf, node);
+#if (DTLS_MAX_CID_LENGTH > 0)
+  if (cid_length) {
+    /* RFC 9146: the connection id goes between the sequence number
+     * and the length, while the real type moves in the ciphertext */
+    p -= sizeof(uint16ptr);
+    memcpy(p, security->write_cid, cid_length);
+    p += cid_length;
+    memset(p, 0, sizeof(uint16ptr));
+    p += sizeof(uint16ptr);
+  }
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
   start = p;
 
   if (!security || security->cipher == TLS_NULL_WITH_NULL_NULL) {
@@ -1357,7 +1525,8 @@ dtls_prepare_record(dtls_peer_t *peer, dtls_security_parameters_t *security,
         return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
       }
 
-      memcpy(p, data_array[i], data_len_array[i]);
+      /* the data may already be in sendbuf, from dtls_get_scratch_payload() */
+      memmove(p, data_array[i], data_len_array[i]);
       p += data_len_array[i];
       res += data_len_array[i];
     }
@@ -1367,8 +1536,15 @@ dtls_prepare_record(dtls_peer_t *peer, dtls_security_parameters_t *security,
      * seq_num(2+6) + type(1) + version(2) + length(2)
      */
 #define A_DATA_LEN 13
+    /**
+     * with a connection id, seq_num_placeholder(8) + tls12_cid(1) +
+     * cid_length(1) + tls12_cid(1) + version(2) + epoch(2) + seq_num(6)
+     * + cid + length(2)
+     */
+#define A_DATA_CID_LEN(Cid_Length) (23 + (Cid_Length))
     unsigned char nonce[DTLS_CCM_BLOCKSIZE];
-    unsigned char A_DATA[A_DATA_LEN];
+    unsigned char A_DATA[A_DATA_CID_LEN(DTLS_MAX_CID_LENGTH)];
+    size_t a_data_len = A_DATA_LEN;
 
     if (is_tls_psk_with_aes_128_ccm_8(security->cipher)) {
       dtls_debug("dtls_prepare_record(): encrypt using TLS_PSK_WITH_AES_128_CCM_8\r\n");
@@ -1424,16 +1600,29 @@ dtls_prepare_record(dtls_peer_t *peer, dtls_security_parameters_t *security,
 
     for (i = 0; i < data_array_len; i++) {
       /* check the minimum that we need for packets that are not encrypted */
-      if (*rlen < res + DTLS_RH_LENGTH + data_len_array[i]) {
+      if (*rlen < res + DTLS_RH_LENGTH + cid_length + data_len_array[i]) {
         dtls_debug("dtls_prepare_record: send buffer too small\r\n");
         return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
       }
 
-      memcpy(p, data_array[i], data_len_array[i]);
+      /* the data may already be in sendbuf, from dtls_get_scratch_payload() */
+      memmove(p, data_array[i], data_len_array[i]);
       p += data_len_array[i];
       res += data_len_array[i];
     }
 
+    if (cid_length) {
+      /* DTLSInnerPlaintext - the content is followed by the real type,
+       * without any padding */
+      if (*rlen < res + DTLS_RH_LENGTH + cid_length + sizeof(uint8)) {
+        dtls_debug("dtls_prepare_record: send buffer too small\r\n");
+        return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
+      }
+      dtls_int_to_uint8(p, type);
+      p += sizeof(uint8);
+      res += sizeof(uint8);
+    }
+
     memset(nonce, 0, DTLS_CCM_BLOCKSIZE);
     memcpy(nonce, dtls_kb_local_iv(security, peer->role),
 	   dtls_kb_iv_size(security, peer->role));
@@ -1448,14 +1637,35 @@ dtls_prepare_record(dtls_peer_t *peer, dtls_security_parameters_t *security,
      * additional_data = seq_num + TLSCompressed.type +
      *                   TLSCompressed.version + TLSCompressed.length;
      */
-    memcpy(A_DATA, &DTLS_RECORD_HEADER(sendbuf)->epoch, 8); /* epoch and seq_num */
-    memcpy(A_DATA + 8,  &DTLS_RECORD_HEADER(sendbuf)->content_type, 3); /* type and version */
-    dtls_int_to_uint16(A_DATA + 11, res - 8); /* length */
+#if (DTLS_MAX_CID_LENGTH > 0)
+    if (cid_length) {
+      /* or according to RFC 9146, Section 5, with a connection id:
+       *
+       * additional_data = seq_num_placeholder + tls12_cid + cid_length +
+       *                   tls12_cid + DTLSCiphertext.version + epoch +
+       *                   sequence_number + cid +
+       *                   length_of_DTLSInnerPlaintext;
+       */
+      memset(A_DATA, 0xff, 8);
+      dtls_int_to_uint8(A_DATA + 8, DTLS_CT_TLS12_CID);
+      dtls_int_to_uint8(A_DATA + 9, cid_length);
+      dtls_int_to_uint8(A_DATA + 10, DTLS_CT_TLS12_CID);
+      memcpy(A_DATA + 11, &DTLS_RECORD_HEADER(sendbuf)->version, 10); /* version, epoch and seq_num */
+      memcpy(A_DATA + 21, security->write_cid, cid_length);
+      dtls_int_to_uint16(A_DATA + 21 + cid_length, res - 8); /* length */
+      a_data_len = A_DATA_CID_LEN(cid_length);
+    } else
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+    {
+      memcpy(A_DATA, &DTLS_RECORD_HEADER(sendbuf)->epoch, 8); /* epoch and seq_num */
+      memcpy(A_DATA + 8,  &DTLS_RECORD_HEADER(sendbuf)->content_type, 3); /* type and version */
+      dtls_int_to_uint16(A_DATA + 11, res - 8); /* length */
+    }
 
     res = dtls_encrypt(start + 8, res - 8, start + 8, nonce,
 		       dtls_kb_local_write_key(security, peer->role),
 		       dtls_kb_key_size(security, peer->role),
-		       A_DATA, A_DATA_LEN);
+		       A_DATA, a_data_len);
 
     if (res < 0)
       return res;
@@ -1465,9 +1675,9 @@ dtls_prepare_record(dtls_peer_t *peer, dtls_security_parameters_t *security,
   }
 
   /* fix length of fragment in sendbuf */
-  dtls_int_to_uint16(sendbuf + 11, res);
+  dtls_int_to_uint16(sendbuf + 11 + cid_length, res);
 
-  *rlen = DTLS_RH_LENGTH + res;
+  *rlen = DTLS_RH_LENGTH + cid_length + res;
   return 0;
 }
 
@@ -1567,8 +1777,13 @@ dtls_send_multi(dtls_context_t *ctx, dtls_peer_t *peer,
    * TODO: check if we can use the receive buf here. This would mean
    * that we might not be able to handle multiple records stuffed in
    * one UDP datagram */
+#ifdef DTLS_SINGLE_PEER_CLIENT
+  unsigned char *sendbuf = dtls_scratch;
+  size_t len = sizeof(dtls_scratch);
+#else /* DTLS_SINGLE_PEER_CLIENT */
   unsigned char sendbuf[DTLS_MAX_BUF];
   size_t len = sizeof(sendbuf);
+#endif /* DTLS_SINGLE_PEER_CLIENT */
   int res;
   unsigned int i;
   size_t overall_len = 0;
@@ -1607,9 +1822,9 @@ dtls_send_multi(dtls_context_t *ctx, dtls_peer_t *peer,
     if (n) {
       dtls_tick_t now;
       dtls_ticks(&now);
-      n->t = now + DTLS_FIRST_RETRANSMIT_SECONDS * CLOCK_SECOND;
+      n->t = now + ctx->rto.timeout;
       n->retransmit_cnt = 0;
-      n->timeout = DTLS_FIRST_RETRANSMIT_SECONDS * CLOCK_SECOND;
+      n->timeout = ctx->rto.timeout;
       n->peer = peer;
       n->version = dtls_uint16_to_int(DTLS_RECORD_HEADER(sendbuf)->version);
       n->epoch = dtls_uint16_to_int(DTLS_RECORD_HEADER(sendbuf)->epoch);
@@ -1664,6 +1879,10 @@ dtls_close(dtls_context_t *ctx, const session_t *remote) {
 
   peer = dtls_get_peer(ctx, remote);
 
+  /* an exported session stays silent - it goes on after the import */
+  if (peer && peer->state == DTLS_STATE_CLOSED)
+    return 0;
+
   if (peer) {
     res = dtls_send_alert(ctx, peer, DTLS_ALERT_LEVEL_FATAL, DTLS_ALERT_CLOSE_NOTIFY);
     /* indicate tear down */
@@ -2501,12 +2720,23 @@ dtls_send_client_hello(dtls_context_t *ctx, dtls_peer_t *peer,
   int ecdsa;
   dtls_handshake_parameters_t *handshake = peer->handshake_params;
   dtls_tick_t now;
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  dtls_resumption_t *resumption = dtls_get_resumption(ctx, peer);
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
 
   psk = is_psk_supported(ctx);
   ecdsa = is_ecdsa_supported(ctx, 1);
 
   cipher_size = 2 + ((ecdsa) ? 2 : 0) + ((psk) ? 2 : 0);
-  extension_size = (ecdsa) ? 2 + 6 + 6 + 8 + 6: 0;
+  extension_size = (ecdsa) ? 6 + 6 + 8 + 6 : 0;
+#if (DTLS_MAX_CID_LENGTH > 0)
+  handshake->use_cid = ctx->use_cid ? 1 : 0;
+  handshake->write_cid_length = 0;
+  if (handshake->use_cid)
+    extension_size += 5;
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+  if (extension_size)
+    extension_size += 2;
 
   if (cipher_size == 0) {
     dtls_crit("no cipher callbacks implemented\r\n");
@@ -2532,9 +2762,21 @@ dtls_send_client_hello(dtls_context_t *ctx, dtls_peer_t *peer,
   memcpy(p, handshake->tmp.random.client, DTLS_RANDOM_LENGTH);
   p += DTLS_RANDOM_LENGTH;
 
-  /* session id (length 0) */
-  dtls_int_to_uint8(p, 0);
-  p += sizeof(uint8);
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  /* session id of the session to resume, if any */
+  handshake->resumed = 0;
+  if (resumption) {
+    dtls_int_to_uint8(p, resumption->session_id_length);
+    p += sizeof(uint8);
+    memcpy(p, resumption->session_id, resumption->session_id_length);
+    p += resumption->session_id_length;
+  } else
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+  {
+    /* session id (length 0) */
+    dtls_int_to_uint8(p, 0);
+    p += sizeof(uint8);
+  }
 
   /* cookie */
   dtls_int_to_uint8(p, cookie_length);
@@ -2632,6 +2874,22 @@ dtls_send_client_hello(dtls_context_t *ctx, dtls_peer_t *peer,
     p += sizeof(uint8);
   }
 
+#if (DTLS_MAX_CID_LENGTH > 0)
+  if (handshake->use_cid) {
+    /* connection_id */
+    dtls_int_to_uint16(p, TLS_EXT_CONNECTION_ID);
+    p += sizeof(uint16ptr);
+
+    /* length of this extension type */
+    dtls_int_to_uint16(p, 1);
+    p += sizeof(uint16ptr);
+
+    /* empty connection id - the server sends to us without one */
+    dtls_int_to_uint8(p, 0);
+    p += sizeof(uint8);
+  }
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+
   assert((buf <= p) && ((unsigned int)(p - buf) <= sizeof(buf)));
 
   if (cookie_length != 0)
@@ -2648,6 +2906,9 @@ check_server_hello(dtls_context_t *ctx,
 		      uint8 *data, size_t data_length)
 {
   dtls_handshake_parameters_t *handshake = peer->handshake_params;
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  dtls_resumption_t *resumption;
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
 
   /* This function is called when we expect a ServerHello (i.e. we
    * have sent a ClientHello).  We might instead receive a HelloVerify
@@ -2684,6 +2945,19 @@ check_server_hello(dtls_context_t *ctx,
   data += DTLS_RANDOM_LENGTH;
   data_length -= DTLS_RANDOM_LENGTH;
 
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  /* store the session id, to resume this session later */
+  if (data_length < sizeof(uint8) + dtls_uint8_to_int(data))
+    goto error;
+  if (dtls_uint8_to_int(data) > DTLS_SESSION_ID_MAX_LENGTH) {
+    dtls_warn("session id too long, this session can not be resumed\r\n");
+    handshake->session_id_length = 0;
+  } else {
+    handshake->session_id_length = dtls_uint8_to_int(data);
+    memcpy(handshake->session_id, data + sizeof(uint8),
+	   handshake->session_id_length);
+  }
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
   SKIP_VAR_FIELD(data, data_length, uint8); /* skip session id */
 
   /* Check cipher suite. As we offer all we have, it is sufficient
@@ -2698,6 +2972,21 @@ check_server_hello(dtls_context_t *ctx,
   data += sizeof(uint16ptr);
   data_length -= sizeof(uint16ptr);
 
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  /* The server echoes the session id we offered if it accepts to
+   * resume that session. Otherwise, this is a full handshake. */
+  resumption = dtls_get_resumption(ctx, peer);
+  if (resumption && handshake->session_id_length == resumption->session_id_length &&
+      memcmp(handshake->session_id, resumption->session_id, handshake->session_id_length) == 0) {
+    if (handshake->cipher != resumption->cipher) {
+      dtls_alert("resumed session with a different cipher\r\n");
+      return dtls_alert_fatal_create(DTLS_ALERT_ILLEGAL_PARAMETER);
+    }
+    dtls_info("server accepted to resume the session\r\n");
+    handshake->resumed = 1;
+  }
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+
   /* Check if NULL compression was selected. We do not know any other. */
   if (dtls_uint8_to_int(data) != TLS_COMPRESSION_NULL) {
     dtls_alert("unsupported compression method 0x%02x\r\n", data[0]);
@@ -3183,7 +3472,7 @@ handle_handshake_msg(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
    * we do everything accordingly to the DTLS 1.2 standard this should
    * not be a problem. */
   if (peer) {
-    dtls_stop_retransmission(ctx, peer);
+    dtls_flight_answered(ctx, peer);
   }
 
   /* The following switch construct handles the given message with
@@ -3221,6 +3510,19 @@ handle_handshake_msg(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
       dtls_warn("error in check_server_hello err: %i\r\n", err);
       return err;
     }
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+    if (peer->handshake_params->resumed) {
+      /* abbreviated handshake, the server sends its ChangeCipherSpec
+       * and Finished right away */
+      err = calculate_key_block(ctx, peer->handshake_params, peer,
+				&peer->session, peer->role);
+      if (err < 0) {
+	return err;
+      }
+      peer->state = DTLS_STATE_WAIT_CHANGECIPHERSPEC;
+      break;
+    }
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
     if (is_tls_ecdhe_ecdsa_with_aes_128_ccm_8(peer->handshake_params->cipher))
       peer->state = DTLS_STATE_WAIT_SERVERCERTIFICATE;
     else
@@ -3340,6 +3642,29 @@ handle_handshake_msg(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
         return err;
       }
     }
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+    else if (peer->handshake_params->resumed) {
+      /* abbreviated handshake, the client Finished comes last */
+      update_hs_hash(peer, data, data_length);
+
+      err = dtls_send_ccs(ctx, peer);
+      if (err < 0) {
+        dtls_warn("cannot send CCS message\r\n");
+        return err;
+      }
+
+      dtls_security_params_switch(peer);
+
+      err = dtls_send_finished(ctx, peer, PRF_LABEL(client), PRF_LABEL_SIZE(client));
+      if (err < 0) {
+        dtls_warn("sending client Finished failed\r\n");
+        return err;
+      }
+    }
+    if (role == DTLS_CLIENT) {
+      dtls_update_resumption(ctx, peer);
+    }
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
     dtls_handshake_free(peer->handshake_params);
     peer->handshake_params = NULL;
     dtls_debug("Handshake complete\r\n");
@@ -3898,7 +4223,7 @@ dtls_handle_message(dtls_context_t *ctx,
 
     case DTLS_CT_CHANGE_CIPHER_SPEC:
       if (peer) {
-        dtls_stop_retransmission(ctx, peer);
+        dtls_flight_answered(ctx, peer);
       }
       err = handle_ccs(ctx, peer, msg, data, data_length);
       if (err < 0) {
@@ -3943,6 +4268,14 @@ dtls_handle_message(dtls_context_t *ctx,
 	if (role == DTLS_SERVER && state == DTLS_STATE_WAIT_FINISHED) {
 	  expected_epoch++;
 	}
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+	/* Same for the server's Finished in an abbreviated handshake,
+	 * where the server sends its ChangeCipherSpec first. */
+	if (role == DTLS_CLIENT && state == DTLS_STATE_WAIT_FINISHED &&
+	    peer->handshake_params && peer->handshake_params->resumed) {
+	  expected_epoch++;
+	}
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
 
 	if (expected_epoch != msg_epoch) {
           if (hs_attempt_with_existing_peer(msg, rlen, peer)) {
@@ -3963,8 +4296,15 @@ dtls_handle_message(dtls_context_t *ctx,
 	return err;
       }
       if (peer && peer->state == DTLS_STATE_CONNECTED) {
+	dtls_tick_t now;
+
 	/* stop retransmissions */
 	dtls_stop_retransmission(ctx, peer);
+	if (peer->role == DTLS_CLIENT) {
+	  dtls_ticks(&now);
+	  ctx->handshake_stats.duration = now - ctx->handshake_stats.started;
+	  ctx->handshake_stats.handshakes++;
+	}
 	CALL(ctx, event, &peer->session, 0, DTLS_EVENT_CONNECTED);
       }
       break;
@@ -3997,7 +4337,7 @@ dtls_new_context(void *app_data) {
   dtls_tick_t now;
 #ifdef WITH_POSIX
   FILE *urandom = fopen("/dev/urandom", "r");
-  unsigned char buf[sizeof(unsigned long)];
+  unsigned char buf[32];
 #endif /* WITH_POSIX */
 
   dtls_ticks(&now);
@@ -4024,7 +4364,7 @@ dtls_prng_init(now);
   }
 
   fclose(urandom);
-  dtls_prng_init((unsigned long)*buf);
+  dtls_drbg_add_entropy(buf, sizeof(buf));
 #endif /* WITH_POSIX */
 
   c = malloc_context();
@@ -4033,6 +4373,7 @@ dtls_prng_init(now);
 
   memset(c, 0, sizeof(dtls_context_t));
   c->app = app_data;
+  c->rto.timeout = DTLS_FIRST_RETRANSMIT_SECONDS * CLOCK_SECOND;
 
 #ifdef WITH_CONTIKI
   process_start(&dtls_retransmit_process, (char *)c);
@@ -4112,6 +4453,9 @@ dtls_connect_peer(dtls_context_t *ctx, dtls_peer_t *peer) {
       if (!peer->handshake_params)
         return -1;
 
+  dtls_ticks(&ctx->handshake_stats.started);
+  ctx->handshake_stats.retransmissions = 0;
+
   peer->handshake_params->hs_state.mseq_r = 0;
   peer->handshake_params->hs_state.mseq_s = 0;
   res = dtls_send_client_hello(ctx, peer, NULL, 0);
@@ -4151,6 +4495,207 @@ dtls_connect(dtls_context_t *ctx, const session_t *dst) {
   return res;
 }
 
+int
+dtls_export_session(dtls_context_t *ctx, const session_t *session,
+		    uint8 *buf, size_t len) {
+  dtls_peer_t *peer = dtls_get_peer(ctx, session);
+  dtls_security_parameters_t *security;
+  uint8 *p = buf;
+  size_t cid_length = 0, session_id_length = 0;
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  dtls_resumption_t *resumption;
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+
+  if (!peer || peer->state != DTLS_STATE_CONNECTED || peer->role != DTLS_CLIENT) {
+    dtls_warn("no established session to export\r\n");
+    return -1;
+  }
+  security = dtls_security_params(peer);
+#if (DTLS_MAX_CID_LENGTH > 0)
+  cid_length = security->write_cid_length;
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  resumption = dtls_get_resumption(ctx, peer);
+  if (resumption)
+    session_id_length = resumption->session_id_length;
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+
+  if (len < 1 + 2 + 2 + 6 + 2 + 6 + 8 + dtls_kb_size(security, peer->role)
+      + 1 + cid_length + 1 + session_id_length
+      + (session_id_length ? DTLS_MASTER_SECRET_LENGTH : 0)) {
+    dtls_warn("buffer too small to export the session\r\n");
+    return -1;
+  }
+
+  dtls_int_to_uint8(p, DTLS_SESSION_STATE_VERSION);
+  p += sizeof(uint8);
+  dtls_int_to_uint16(p, security->cipher);
+  p += sizeof(uint16ptr);
+  dtls_int_to_uint16(p, security->epoch);
+  p += sizeof(uint16ptr);
+  dtls_int_to_uint48(p, security->rseq);
+  p += sizeof(uint48ptr);
+  /* none reserved - see dtls_reserve_session() */
+  dtls_int_to_uint16(p, 0);
+  p += sizeof(uint16ptr);
+  dtls_int_to_uint48(p, security->cseq.cseq);
+  p += sizeof(uint48ptr);
+  dtls_int_to_uint64(p, security->cseq.bitfield);
+  p += sizeof(uint64_t);
+  memcpy(p, security->key_block, dtls_kb_size(security, peer->role));
+  p += dtls_kb_size(security, peer->role);
+
+  dtls_int_to_uint8(p, cid_length);
+  p += sizeof(uint8);
+#if (DTLS_MAX_CID_LENGTH > 0)
+  memcpy(p, security->write_cid, cid_length);
+  p += cid_length;
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+
+  dtls_int_to_uint8(p, session_id_length);
+  p += sizeof(uint8);
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  if (session_id_length) {
+    memcpy(p, resumption->session_id, session_id_length);
+    p += session_id_length;
+    memcpy(p, resumption->master_secret, DTLS_MASTER_SECRET_LENGTH);
+    p += DTLS_MASTER_SECRET_LENGTH;
+  }
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+
+  /* the keys leave with the state - sending anything more here would
+   * reuse sequence numbers on the next import */
+  peer->state = DTLS_STATE_CLOSED;
+
+  dtls_debug("exported session state of %d bytes\r\n", (int)(p - buf));
+  return p - buf;
+}
+
+int
+dtls_reserve_session(uint8 *buf, size_t len) {
+  uint8 *p = buf + sizeof(uint8) + sizeof(uint16ptr) + sizeof(uint16ptr);
+
+  if (len < 1 + 2 + 2 + 6 + 2 + 6 + 8 ||
+      dtls_uint8_to_int(buf) != DTLS_SESSION_STATE_VERSION) {
+    dtls_warn("unknown session state format\r\n");
+    return -1;
+  }
+  /* the range of the previous reservation might have been used, so the
+   * new one starts at the base, which then moves past it */
+  dtls_int_to_uint48(p, dtls_uint48_to_int(p) + DTLS_SESSION_RSEQ_RESERVE);
+  p += sizeof(uint48ptr);
+  dtls_int_to_uint16(p, DTLS_SESSION_RSEQ_RESERVE);
+  return 0;
+}
+
+int
+dtls_import_session(dtls_context_t *ctx, const session_t *session,
+		    const uint8 *buf, size_t len) {
+  dtls_peer_t *peer;
+  dtls_security_parameters_t *security;
+  const uint8 *p = buf;
+  dtls_cipher_t cipher;
+  size_t kb_length, cid_length, session_id_length;
+  uint16_t reserved;
+
+  if (dtls_get_peer(ctx, session)) {
+    dtls_warn("a peer already exists for the imported session\r\n");
+    return -1;
+  }
+
+  if (len < 1 + 2 + 2 + 6 + 2 + 6 + 8 ||
+      dtls_uint8_to_int(p) != DTLS_SESSION_STATE_VERSION) {
+    dtls_warn("unknown session state format\r\n");
+    return -1;
+  }
+  cipher = dtls_uint16_to_int(p + 1);
+  if (!known_cipher(ctx, cipher, 1)) {
+    dtls_warn("unsupported cipher 0x%04x in session state\r\n", cipher);
+    return -1;
+  }
+
+  peer = dtls_new_peer(session);
+  if (!peer) {
+    dtls_crit("cannot create new peer\r\n");
+    return -1;
+  }
+  peer->role = DTLS_CLIENT;
+  security = dtls_security_params(peer);
+  kb_length = dtls_kb_size(security, peer->role);
+
+  p += sizeof(uint8);
+  security->cipher = cipher;
+  security->compression = TLS_COMPRESSION_NULL;
+  p += sizeof(uint16ptr);
+  security->epoch = dtls_uint16_to_int(p);
+  p += sizeof(uint16ptr);
+  /* the range which dtls_reserve_session() moved the base past, if any */
+  security->rseq = dtls_uint48_to_int(p);
+  p += sizeof(uint48ptr);
+  reserved = dtls_uint16_to_int(p);
+  p += sizeof(uint16ptr);
+  if (reserved) {
+    if (security->rseq < reserved)
+      goto error;
+    security->rseq_limit = security->rseq;
+    security->rseq -= reserved;
+  }
+  security->cseq.cseq = dtls_uint48_to_int(p);
+  p += sizeof(uint48ptr);
+  security->cseq.bitfield = dtls_uint64_to_int(p);
+  p += sizeof(uint64_t);
+  len -= p - buf;
+
+  if (len < kb_length + 1)
+    goto error;
+  memcpy(security->key_block, p, kb_length);
+  p += kb_length;
+  len -= kb_length;
+
+  cid_length = dtls_uint8_to_int(p);
+  p += sizeof(uint8);
+  len -= sizeof(uint8);
+  if (cid_length > DTLS_MAX_CID_LENGTH || len < cid_length + 1)
+    goto error;
+#if (DTLS_MAX_CID_LENGTH > 0)
+  memcpy(security->write_cid, p, cid_length);
+  security->write_cid_length = cid_length;
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+  p += cid_length;
+  len -= cid_length;
+
+  session_id_length = dtls_uint8_to_int(p);
+  p += sizeof(uint8);
+  len -= sizeof(uint8);
+  if (session_id_length) {
+    if (session_id_length > DTLS_SESSION_ID_MAX_LENGTH ||
+	len < session_id_length + DTLS_MASTER_SECRET_LENGTH)
+      goto error;
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+    memcpy(&ctx->resumption.session, session, sizeof(session_t));
+    ctx->resumption.cipher = cipher;
+    memcpy(ctx->resumption.session_id, p, session_id_length);
+    ctx->resumption.session_id_length = session_id_length;
+    memcpy(ctx->resumption.master_secret, p + session_id_length,
+	   DTLS_MASTER_SECRET_LENGTH);
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+  }
+
+  if (dtls_add_peer(ctx, peer) < 0) {
+    dtls_alert("cannot add peer\r\n");
+    dtls_free_peer(peer);
+    return -1;
+  }
+  peer->state = DTLS_STATE_CONNECTED;
+  dtls_debug("imported session state, epoch %d\r\n", security->epoch);
+  return 0;
+
+ error:
+  dtls_warn("truncated or invalid session state\r\n");
+  dtls_free_peer(peer);
+  return -1;
+}
+
 static void
 dtls_retransmit(dtls_context_t *context, netq_t *node) {
   if (!context || !node)
@@ -4158,8 +4703,13 @@ dtls_retransmit(dtls_context_t *context, netq_t *node) {
 
   /* re-initialize timeout when maximum number of retransmissions are not reached yet */
   if (node->retransmit_cnt < DTLS_DEFAULT_MAX_RETRANSMIT) {
+#ifdef DTLS_SINGLE_PEER_CLIENT
+      unsigned char *sendbuf = dtls_scratch;
+      size_t len = sizeof(dtls_scratch);
+#else /* DTLS_SINGLE_PEER_CLIENT */
       unsigned char sendbuf[DTLS_MAX_BUF];
       size_t len = sizeof(sendbuf);
+#endif /* DTLS_SINGLE_PEER_CLIENT */
       int err;
       unsigned char *data = node->data;
       size_t length = node->length;
@@ -4170,6 +4720,8 @@ dtls_retransmit(dtls_context_t *context, netq_t *node) {
       node->retransmit_cnt++;
       node->t = now + (node->timeout << node->retransmit_cnt);
       netq_insert_node(&context->sendqueue, node);
+      context->handshake_stats.retransmissions++;
+      context->handshake_stats.total_retransmissions++;
 
       if (node->type == DTLS_CT_HANDSHAKE) {
 	dtls_handshake_header_t *hs_header = DTLS_HANDSHAKE_HEADER(data);
@@ -4218,6 +4770,46 @@ dtls_stop_retransmission(dtls_context_t *context, dtls_peer_t *peer) {
   }
 }
 
+static void
+dtls_update_rto(dtls_rto_t *rto, clock_time_t rtt) {
+  clock_time_t delta;
+
+  if (!rto->samples) {
+    rto->srtt = rtt;
+    rto->rttvar = rtt / 2;
+  } else {
+    delta = rto->srtt > rtt ? rto->srtt - rtt : rtt - rto->srtt;
+    rto->rttvar = (3 * rto->rttvar + delta) / 4;
+    rto->srtt = (7 * rto->srtt + rtt) / 8;
+  }
+  rto->samples++;
+
+  rto->timeout = rto->srtt + 4 * rto->rttvar;
+  if (rto->timeout < DTLS_MIN_RETRANSMIT_TIMEOUT)
+    rto->timeout = DTLS_MIN_RETRANSMIT_TIMEOUT;
+  if (rto->timeout > DTLS_MAX_RETRANSMIT_TIMEOUT)
+    rto->timeout = DTLS_MAX_RETRANSMIT_TIMEOUT;
+  dtls_debug("flight rtt %lu, retransmission timeout now %lu\r\n",
+	     (unsigned long)rtt, (unsigned long)rto->timeout);
+}
+
+static void
+dtls_flight_answered(dtls_context_t *context, dtls_peer_t *peer) {
+  netq_t *node;
+  dtls_tick_t now;
+
+  /* By Karn's algorithm, a retransmitted flight tells nothing, as the
+   * answer might be to any of its copies. */
+  for (node = netq_head(&context->sendqueue); node; node = netq_next(node)) {
+    if (node->peer == peer && node->retransmit_cnt == 0) {
+      dtls_ticks(&now);
+      dtls_update_rto(&context->rto, now - (node->t - node->timeout));
+      break;
+    }
+  }
+  dtls_stop_retransmission(context, peer);
+}
+
 void
 dtls_check_retransmit(dtls_context_t *context, clock_time_t *next) {
   dtls_tick_t now;
@@ -211,12 +211,51 @@ typedef struct {
 
 struct netq_t;
 
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+/**
+ * The last session given a session id by the server, which we offer
+ * to resume in the ClientHello of the next handshake with it. When
+ * the server accepts, the keys are derived from this master secret
+ * and the handshake takes a single round trip, without a key exchange.
+ */
+typedef struct {
+  session_t session;		/**< the server of this session */
+  dtls_cipher_t cipher;		/**< cipher suite of this session */
+  uint8 session_id[DTLS_SESSION_ID_MAX_LENGTH];
+  uint8 session_id_length;	/**< @c 0 if there is no session to resume */
+  uint8 master_secret[DTLS_MASTER_SECRET_LENGTH];
+} dtls_resumption_t;
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+
+/**
+ * Initial retransmission timeout of handshake flights, estimated as in
+ * RFC 6298 from the round-trip times of the flights which were
+ * answered without being retransmitted. Times are in clock ticks.
+ */
+typedef struct {
+  clock_time_t srtt;		/**< smoothed round-trip time */
+  clock_time_t rttvar;		/**< round-trip time variation */
+  clock_time_t timeout;		/**< for the next flight sent */
+  unsigned int samples;		/**< round-trip times measured so far */
+} dtls_rto_t;
+
+/** Counters of the handshakes done in a context. */
+typedef struct {
+  clock_time_t started;		/**< start of the last handshake */
+  clock_time_t duration;	/**< of the last completed handshake */
+  unsigned int handshakes;	/**< completed handshakes */
+  unsigned int retransmissions;	/**< flights resent in the last handshake */
+  unsigned int total_retransmissions; /**< flights resent in all of them */
+} dtls_handshake_stats_t;
+
 /** Holds global information of the DTLS engine. */
 typedef struct dtls_context_t {
   unsigned char cookie_secret[DTLS_COOKIE_SECRET_LENGTH];
   clock_time_t cookie_secret_age; /**< the time the secret has been generated */
 
   dtls_peer_t *peers;		/**< peer hash map */
+  dtls_peer_t *last_peer;	/**< peer of the last lookup, checked
+				   before @c peers */
 #ifdef WITH_CONTIKI
   struct etimer retransmit_timer; /**< fires when the next packet must be sent */
 #endif /* WITH_CONTIKI */
@@ -227,7 +266,20 @@ typedef struct dtls_context_t {
 
   dtls_handler_t *h;		/**< callback handlers */
 
+  dtls_rto_t rto;		/**< handshake retransmission timeout */
+  dtls_handshake_stats_t handshake_stats;
+
+#if (DTLS_MAX_CID_LENGTH > 0)
+  int use_cid;			/**< offer Connection IDs in the ClientHello */
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+
+#if (DTLS_SESSION_ID_MAX_LENGTH > 0)
+  dtls_resumption_t resumption;	/**< session to offer for resumption */
+#endif /* DTLS_SESSION_ID_MAX_LENGTH > 0 */
+
+#ifndef DTLS_SINGLE_PEER_CLIENT
   unsigned char readbuf[DTLS_MAX_BUF];
+#endif /* DTLS_SINGLE_PEER_CLIENT */
 } dtls_context_t;
 
 /** 
@@ -252,6 +304,120 @@ static inline void dtls_set_handler(dtls_context_t *ctx, dtls_handler_t *h) {
   ctx->h = h;
 }
 
+/**
+ * Gets the retransmission timeout estimated for @p ctx, e.g. to carry
+ * it over to the context of the next connection with dtls_set_rto().
+ */
+static inline const dtls_rto_t *dtls_get_rto(const dtls_context_t *ctx) {
+  return &ctx->rto;
+}
+
+/** Sets the retransmission timeout estimate of @p ctx to @p rto. */
+static inline void dtls_set_rto(dtls_context_t *ctx, const dtls_rto_t *rto) {
+  ctx->rto = *rto;
+}
+
+/** Gets the duration and the retransmissions of the handshakes. */
+static inline const dtls_handshake_stats_t *
+dtls_get_handshake_stats(const dtls_context_t *ctx) {
+  return &ctx->handshake_stats;
+}
+
+#if (DTLS_MAX_CID_LENGTH > 0)
+/**
+ * Enables or disables offering the Connection ID extension (RFC 9146)
+ * in the ClientHello of the next handshakes. We offer an empty
+ * Connection ID, so the records from the server are unchanged, while
+ * the ones we send carry the Connection ID chosen by the server. This
+ * allows the server to find the session even after a NAT rebinding
+ * changed our address.
+ *
+ * @param ctx     The DTLS context to use.
+ * @param use_cid @c 1 to offer Connection IDs, @c 0 otherwise.
+ */
+static inline void dtls_set_use_cid(dtls_context_t *ctx, int use_cid) {
+  ctx->use_cid = use_cid;
+}
+
+/**
+ * Gets the Connection ID which we send in the records to @p session,
+ * as negotiated in the last handshake.
+ *
+ * @param ctx     The DTLS context to use.
+ * @param session The remote peer.
+ * @param cid     If not NULL, set to point to the Connection ID.
+ * @return The length of the Connection ID, @c 0 if none was negotiated
+ *         or if there is no such peer.
+ */
+int dtls_get_write_cid(dtls_context_t *ctx, const session_t *session,
+		       const uint8 **cid);
+#endif /* DTLS_MAX_CID_LENGTH > 0 */
+
+/** Version of the format written by dtls_export_session(). */
+#define DTLS_SESSION_STATE_VERSION 2
+
+/** Maximum length of the state written by dtls_export_session(). */
+#define DTLS_SESSION_STATE_MAX_LENGTH					\
+  (1 + 2 + 2 + 6 + 2 + 6 + 8 + MAX_KEYBLOCK_LENGTH			\
+   + 1 + DTLS_MAX_CID_LENGTH + 1 + DTLS_SESSION_ID_MAX_LENGTH		\
+   + DTLS_MASTER_SECRET_LENGTH)
+
+/**
+ * Serializes the security parameters of the established session with
+ * @p session (cipher suite, epoch, keys, sequence numbers, Connection
+ * ID), plus the session id and master secret to resume it, such that
+ * they can be kept in flash or backup RAM while powered off. The
+ * session is then closed locally, without a close_notify, such that
+ * no record can be sent with its keys anymore. The state holds the
+ * session keys, so store it accordingly.
+ *
+ * @param ctx     The DTLS context to use.
+ * @param session The remote peer.
+ * @param buf     The buffer to write the state to.
+ * @param len     The size of @p buf, at least
+ *                #DTLS_SESSION_STATE_MAX_LENGTH to be sure.
+ * @return The number of bytes written, or a value less than zero if
+ *         there is no connected session or @p buf is too small.
+ */
+int dtls_export_session(dtls_context_t *ctx, const session_t *session,
+			uint8 *buf, size_t len);
+
+/**
+ * Reserves the next #DTLS_SESSION_RSEQ_RESERVE record sequence numbers
+ * of a saved session for one dtls_import_session(), by moving the
+ * sequence base in @p buf past them. The state in @p buf must replace
+ * the saved one in the storage before it is imported, such that the
+ * next import, after the next reservation, starts past them. This way
+ * no sequence number is ever used twice with the same keys.
+ *
+ * @param buf     The saved state, updated in place.
+ * @param len     The length of @p buf.
+ * @return @c 0 on success, or a value less than zero if the state is
+ *         invalid.
+ */
+int dtls_reserve_session(uint8 *buf, size_t len);
+
+/**
+ * Restores a session saved with dtls_export_session(), after a power
+ * cycle. The peer is created directly in the connected state, so data
+ * can be sent right away, without any handshake. With a state from
+ * dtls_reserve_session(), only the sequence numbers reserved there are
+ * used, then the session stops sending. A state which was not reserved
+ * must be imported only once, e.g. if it never left the RAM. If the
+ * server has dropped the session meanwhile, dtls_connect() still
+ * offers to resume it with an abbreviated handshake, before falling
+ * back to a full one.
+ *
+ * @param ctx     The DTLS context to use.
+ * @param session The remote peer.
+ * @param buf     The saved state.
+ * @param len     The length of @p buf.
+ * @return @c 0 on success, or a value less than zero if the state is
+ *         invalid or a peer with @p session already exists.
+ */
+int dtls_import_session(dtls_context_t *ctx, const session_t *session,
+			const uint8 *buf, size_t len);
+
 /**
  * Establishes a DTLS channel with the specified remote peer @p dst.
  * This function returns @c 0 if that channel already exists, a value
@@ -284,6 +450,31 @@ int dtls_close(dtls_context_t *ctx, const session_t *remote);
 
 int dtls_renegotiate(dtls_context_t *ctx, const session_t *dst);
 
+#ifdef DTLS_SINGLE_PEER_CLIENT
+/**
+ * Offset of the application data in the scratch buffer: after the
+ * longest record header (with a Connection ID) and the explicit
+ * nonce.
+ */
+#define DTLS_SCRATCH_PAYLOAD_OFFSET (13 + DTLS_MAX_CID_LENGTH + 8)
+
+/**
+ * Room for application data in the scratch buffer, leaving space for
+ * the CCM_8 MAC and the inner content type of a Connection ID record.
+ */
+#define DTLS_SCRATCH_PAYLOAD_MAX (DTLS_MAX_BUF - DTLS_SCRATCH_PAYLOAD_OFFSET - 8 - 1)
+
+/**
+ * Returns where to put up to DTLS_SCRATCH_PAYLOAD_MAX bytes of
+ * application data in the scratch buffer, in which all outgoing
+ * records are assembled. Data passed from there to dtls_write() is
+ * encrypted in place, without a copy on the stack. The buffer is
+ * overwritten by the next record sent, including handshake messages
+ * and retransmissions.
+ */
+uint8 *dtls_get_scratch_payload(void);
+#endif /* DTLS_SINGLE_PEER_CLIENT */
+
 /** 
  * Writes the application data given in @p buf to the peer specified
  * by @p session. 
@@ -316,6 +507,7 @@ void dtls_check_retransmit(dtls_context_t *context, clock_time_t *next);
 #define DTLS_CT_ALERT              21
 #define DTLS_CT_HANDSHAKE          22
 #define DTLS_CT_APPLICATION_DATA   23
+#define DTLS_CT_TLS12_CID          25 /* see RFC 9146 */
 
 /** Generic header structure of the DTLS record layer. */
 typedef struct __attribute__((__packed__)) {
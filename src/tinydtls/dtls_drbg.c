@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2018-2018 Twilio
+ */
+
+#include <string.h>
+
+#include "dtls_drbg.h"
+#include "dtls_debug.h"
+#include "hmac.h"
+#include "aes/rijndael.h"
+
+#define DRBG_BLOCK_LENGTH 16
+#define DRBG_SEED_LENGTH  32	/* key and counter */
+
+static struct {
+  rijndael_ctx aes;		/**< keyed with the current key */
+  unsigned char v[DRBG_BLOCK_LENGTH];
+  unsigned char buf[DTLS_DRBG_BUFFER_SIZE];
+  size_t next;			/**< first unread byte of buf */
+  int seeded;
+  int test_seed;		/**< ignore dtls_drbg_add_entropy() */
+} drbg;
+
+static void
+drbg_increment(unsigned char *v) {
+  int i;
+
+  for (i = DRBG_BLOCK_LENGTH - 1; i >= 0 && ++v[i] == 0; i--)
+    ;
+}
+
+/* CTR_DRBG_Update: the next key and counter are the encryption of the
+ * following two counter values, XORed with the provided data. */
+static void
+drbg_update(const unsigned char *provided) {
+  unsigned char temp[DRBG_SEED_LENGTH];
+  int i;
+
+  drbg_increment(drbg.v);
+  rijndael_encrypt(&drbg.aes, drbg.v, temp);
+  drbg_increment(drbg.v);
+  rijndael_encrypt(&drbg.aes, drbg.v, temp + DRBG_BLOCK_LENGTH);
+  if (provided)
+    for (i = 0; i < DRBG_SEED_LENGTH; i++)
+      temp[i] ^= provided[i];
+
+  rijndael_set_key_enc_only(&drbg.aes, temp, 8 * DRBG_BLOCK_LENGTH);
+  memcpy(drbg.v, temp + DRBG_BLOCK_LENGTH, DRBG_BLOCK_LENGTH);
+  memset(temp, 0, sizeof(temp));
+}
+
+static void
+drbg_seed_material(const unsigned char *input, size_t len,
+		   unsigned char *material) {
+  dtls_hash_ctx hash;
+
+  dtls_hash_init(&hash);
+  dtls_hash_update(&hash, input, len);
+  dtls_hash_finalize(material, &hash);
+  memset(&hash, 0, sizeof(hash));
+}
+
+static void
+drbg_instantiate(const unsigned char *material) {
+  unsigned char key[DRBG_BLOCK_LENGTH];
+
+  memset(key, 0, sizeof(key));
+  memset(drbg.v, 0, sizeof(drbg.v));
+  rijndael_set_key_enc_only(&drbg.aes, key, 8 * DRBG_BLOCK_LENGTH);
+  drbg_update(material);
+  drbg.next = sizeof(drbg.buf);
+  drbg.seeded = 1;
+}
+
+static void
+drbg_refill(void) {
+  size_t i;
+
+  if (!drbg.seeded) {
+    dtls_warn("random generator used before adding entropy\r\n");
+    drbg_instantiate(NULL);
+  }
+
+  for (i = 0; i < sizeof(drbg.buf); i += DRBG_BLOCK_LENGTH) {
+    drbg_increment(drbg.v);
+    rijndael_encrypt(&drbg.aes, drbg.v, drbg.buf + i);
+  }
+  /* backtracking resistance: the output is not derivable from the
+   * state after the refill */
+  drbg_update(NULL);
+  drbg.next = 0;
+}
+
+void
+dtls_drbg_add_entropy(const unsigned char *entropy, size_t len) {
+  unsigned char material[DRBG_SEED_LENGTH];
+
+  if (drbg.test_seed)
+    return;
+
+  drbg_seed_material(entropy, len, material);
+  if (drbg.seeded) {
+    /* CTR_DRBG_Reseed without derivation function */
+    drbg_update(material);
+    memset(drbg.buf, 0, sizeof(drbg.buf));
+    drbg.next = sizeof(drbg.buf);
+  } else {
+    drbg_instantiate(material);
+  }
+  memset(material, 0, sizeof(material));
+}
+
+void
+dtls_drbg_set_test_seed(const unsigned char *seed, size_t len) {
+  unsigned char material[DRBG_SEED_LENGTH];
+
+  drbg_seed_material(seed, len, material);
+  drbg_instantiate(material);
+  drbg.test_seed = 1;
+}
+
+int
+dtls_drbg_generate(unsigned char *buf, size_t len) {
+  size_t n;
+
+  while (len) {
+    if (!drbg.seeded || drbg.next == sizeof(drbg.buf))
+      drbg_refill();
+    n = sizeof(drbg.buf) - drbg.next;
+    if (n > len)
+      n = len;
+    /* nothing handed out stays in memory */
+    memcpy(buf, drbg.buf + drbg.next, n);
+    memset(drbg.buf + drbg.next, 0, n);
+    drbg.next += n;
+    buf += n;
+    len -= n;
+  }
+  return 1;
+}
+
+uint32_t
+dtls_drbg_uint32(void) {
+  unsigned char b[4];
+
+  dtls_drbg_generate(b, sizeof(b));
+  return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2018-2018 Twilio
+ */
+
+/**
+ * @file dtls_drbg.h
+ * @brief AES-CTR deterministic random bit generator
+ */
+
+#ifndef _DTLS_DRBG_H_
+#define _DTLS_DRBG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tinydtls.h"
+
+/**
+ * @defgroup drbg Random Bit Generator
+ * CTR_DRBG of NIST SP 800-90A with AES-128 and without derivation
+ * function, the source of dtls_prng() and of the CoAP message IDs and
+ * tokens. Entropy of any length is condensed with SHA-256 into the
+ * 32 bytes of seed material. Output is generated a few blocks at a
+ * time into a small buffer, with the state updated after each refill,
+ * so that a handshake random or a token costs one copy.
+ * @{
+ */
+
+#ifndef DTLS_DRBG_BUFFER_SIZE
+/** Bytes generated per refill, a multiple of the AES block size */
+#define DTLS_DRBG_BUFFER_SIZE 64
+#endif
+
+/**
+ * Mixes @p len bytes of @p entropy into the generator. Any number of
+ * sources can be added, at any time. Buffered output is dropped, so
+ * the next bytes depend on the new entropy.
+ */
+void dtls_drbg_add_entropy(const unsigned char *entropy, size_t len);
+
+/**
+ * Restarts the generator from @p seed alone and ignores all the
+ * entropy added afterwards, so that the output is the same on every
+ * run. For tests and benchmarks only.
+ */
+void dtls_drbg_set_test_seed(const unsigned char *seed, size_t len);
+
+/** Fills @p buf with @p len random bytes. Returns @c 1. */
+int dtls_drbg_generate(unsigned char *buf, size_t len);
+
+/** Returns 32 random bits. */
+uint32_t dtls_drbg_uint32(void);
+
+/** @} */
+
+#endif /* _DTLS_DRBG_H_ */
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2018-2018 Twilio
+ */
+
+#include "dtls_pool.h"
+#include "dtls_debug.h"
+
+void *
+dtls_pool_alloc(dtls_pool_t *pool) {
+  uint16_t i;
+
+  /* the pools hold a handful of blocks, a linear scan is fine */
+  for (i = 0; i < pool->stats.size; i++) {
+    if (!pool->in_use[i]) {
+      pool->in_use[i] = 1;
+      if (++pool->stats.used > pool->stats.high_water)
+	pool->stats.high_water = pool->stats.used;
+      return pool->blocks + i * pool->block_size;
+    }
+  }
+
+  pool->stats.failures++;
+  return NULL;
+}
+
+void
+dtls_pool_free(dtls_pool_t *pool, void *block) {
+  size_t offset;
+
+  if (!block)
+    return;
+
+  offset = (unsigned char *)block - pool->blocks;
+  if ((unsigned char *)block < pool->blocks
+      || offset % pool->block_size != 0
+      || offset / pool->block_size >= pool->stats.size
+      || !pool->in_use[offset / pool->block_size]) {
+    dtls_crit("dtls_pool_free: %p is not an allocated block\r\n", block);
+    return;
+  }
+
+  pool->in_use[offset / pool->block_size] = 0;
+  pool->stats.used--;
+}
+
+#ifdef WITH_ARDUINO
+void
+dtls_get_pools_stats(dtls_pools_stats_t *out) {
+  out->peer = dtls_peer_pool.stats;
+  out->handshake = dtls_handshake_pool.stats;
+  out->security = dtls_security_pool.stats;
+  out->netq = dtls_netq_pool.stats;
+}
+#endif /* WITH_ARDUINO */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018-2018 Twilio
+ */
+
+/**
+ * @file dtls_pool.h
+ * @brief Fixed-size block pools
+ */
+
+#ifndef _DTLS_POOL_H_
+#define _DTLS_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tinydtls.h"
+
+/**
+ * @defgroup pool Memory Pools
+ * Statically allocated pools of equally sized blocks, the Arduino
+ * counterpart of MEMB on Contiki and memarray on RIOT. Peers,
+ * handshake and security parameters and retransmission buffers come
+ * from these, so that handshakes do not fragment the heap of a
+ * long-running device.
+ * @{
+ */
+
+/** Usage counters of a pool. */
+typedef struct {
+  uint16_t size;       /**< number of blocks */
+  uint16_t used;       /**< blocks currently allocated */
+  uint16_t high_water; /**< most blocks ever allocated at the same time */
+  uint16_t failures;   /**< allocations refused because the pool was empty */
+} dtls_pool_stats_t;
+
+typedef struct {
+  unsigned char *blocks;
+  unsigned char *in_use;	/**< one flag per block */
+  size_t block_size;
+  dtls_pool_stats_t stats;
+} dtls_pool_t;
+
+/**
+ * Defines the pool @p name of @p count blocks of @p type.
+ */
+#define DTLS_POOL(name, type, count)					\
+  static type name##_blocks[count];					\
+  static unsigned char name##_in_use[count];				\
+  dtls_pool_t name = { (unsigned char *)name##_blocks, name##_in_use,	\
+		       sizeof(type), { (count), 0, 0, 0 } }
+
+/**
+ * Returns a free block from @p pool, or @c NULL when all are in use.
+ * The block is not cleared.
+ */
+void *dtls_pool_alloc(dtls_pool_t *pool);
+
+/** Returns @p block to @p pool. @p block may be @c NULL. */
+void dtls_pool_free(dtls_pool_t *pool, void *block);
+
+#ifdef WITH_ARDUINO
+extern dtls_pool_t dtls_peer_pool;
+extern dtls_pool_t dtls_handshake_pool;
+extern dtls_pool_t dtls_security_pool;
+extern dtls_pool_t dtls_netq_pool;
+
+/** Usage of all the pools of the library. */
+typedef struct {
+  dtls_pool_stats_t peer;      /**< DTLS_PEER_MAX peers */
+  dtls_pool_stats_t handshake; /**< DTLS_HANDSHAKE_MAX handshake parameters */
+  dtls_pool_stats_t security;  /**< DTLS_SECURITY_MAX security parameters */
+  dtls_pool_stats_t netq;      /**< NETQ_MAXCNT retransmission and reorder buffers */
+} dtls_pools_stats_t;
+
+/** Fills in @p out with the current usage of the pools. */
+void dtls_get_pools_stats(dtls_pools_stats_t *out);
+#endif /* WITH_ARDUINO */
+
+/** @} */
+
+#endif /* _DTLS_POOL_H_ */
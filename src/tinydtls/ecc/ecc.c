@@ -155,100 +155,114 @@ static int fieldSub(const uint32_t *x, const uint32_t *y, const uint32_t *modulu
 }
 
 //finite Field multiplication
-//32bit * 32bit = 64bit
+//32bit * 32bit = 64bit, accumulated row by row with a single carry word
 static int fieldMult(const uint32_t *x, const uint32_t *y, uint32_t *result, uint8_t length){
-	uint32_t temp[length * 2];
-	setZero(temp, length * 2);
-	setZero(result, length * 2);
-	uint8_t k, n;
 	uint64_t l;
+	uint32_t carry;
+	uint8_t k, n;
+	setZero(result, length * 2);
 	for (k = 0; k < length; k++){
-		for (n = 0; n < length; n++){ 
-			l = (uint64_t)x[n]*(uint64_t)y[k];
-			temp[n+k] = l&0xFFFFFFFF;
-			temp[n+k+1] = l>>32;
-			add(&temp[n+k], &result[n+k], &result[n+k], (length * 2) - (n + k));
-
-			setZero(temp, length * 2);
+		carry = 0;
+		for (n = 0; n < length; n++){
+			l = (uint64_t)x[n] * y[k] + result[n+k] + carry;
+			result[n+k] = (uint32_t)l;
+			carry = l >> 32;
 		}
+		result[k+length] = carry;
 	}
 	return 0;
 }
 
-//TODO: maximum:
-//fffffffe00000002fffffffe0000000100000001fffffffe00000001fffffffe00000001fffffffefffffffffffffffffffffffe000000000000000000000001_16
+//finite Field squaring of a 256 bit number
+//every cross product is only calculated once and doubled
+static void fieldSquare(const uint32_t *x, uint32_t *result){
+	uint64_t l;
+	uint32_t carry;
+	uint8_t k, n;
+	setZero(result, 16);
+	for (k = 0; k < 8; k++){
+		carry = 0;
+		for (n = k + 1; n < 8; n++){
+			l = (uint64_t)x[n] * x[k] + result[n+k] + carry;
+			result[n+k] = (uint32_t)l;
+			carry = l >> 32;
+		}
+		result[k+8] = carry;
+	}
+	carry = 0;
+	for (k = 0; k < 16; k++){
+		n = result[k] >> 31;
+		result[k] = (result[k] << 1) | carry;
+		carry = n;
+	}
+	l = 0;
+	for (k = 0; k < 8; k++){
+		uint64_t sq = (uint64_t)x[k] * x[k];
+		l += (uint64_t)result[2*k] + (uint32_t)sq;
+		result[2*k] = (uint32_t)l;
+		l >>= 32;
+		l += (uint64_t)result[2*k+1] + (sq >> 32);
+		result[2*k+1] = (uint32_t)l;
+		l >>= 32;
+	}
+}
+
+/*
+ * Reduces the 512 bit number B modulo p into A, with the special form of the
+ * NIST prime (FIPS 186-4, D.2.3): A = T + 2 S1 + 2 S2 + S3 + S4 - D1 - D2 - D3 - D4,
+ * added up word by word with a signed carry. The carry left over is folded
+ * back in with 2^256 = 2^224 - 2^192 - 2^96 + 1 (mod p), which is done twice as
+ * the first fold can carry once more. This works for any B, not only for B < p^2.
+ */
 static void fieldModP(uint32_t *A, const uint32_t *B)
 {
+	const uint32_t *c = B;
 	uint32_t tempm[8];
-	uint32_t tempm2[8];
-	uint8_t n;
-	setZero(tempm, 8);
-	setZero(tempm2, 8);
-	/* A = T */ 
-	copy(B,A,arrayLength);
-
-	/* Form S1 */ 
-	for(n=0;n<3;n++) tempm[n]=0; 
-	for(n=3;n<8;n++) tempm[n]=B[n+8];
-
-	/* tempm2=T+S1 */ 
-	fieldAdd(A,tempm,ecc_prime_r,tempm2);
-	/* A=T+S1+S1 */ 
-	fieldAdd(tempm2,tempm,ecc_prime_r,A);
-	/* Form S2 */ 
-	for(n=0;n<3;n++) tempm[n]=0; 
-	for(n=3;n<7;n++) tempm[n]=B[n+9]; 
-	for(n=7;n<8;n++) tempm[n]=0;
-	/* tempm2=T+S1+S1+S2 */ 
-	fieldAdd(A,tempm,ecc_prime_r,tempm2);
-	/* A=T+S1+S1+S2+S2 */ 
-	fieldAdd(tempm2,tempm,ecc_prime_r,A);
-	/* Form S3 */ 
-	for(n=0;n<3;n++) tempm[n]=B[n+8]; 
-	for(n=3;n<6;n++) tempm[n]=0; 
-	for(n=6;n<8;n++) tempm[n]=B[n+8];
-	/* tempm2=T+S1+S1+S2+S2+S3 */ 
-	fieldAdd(A,tempm,ecc_prime_r,tempm2);
-	/* Form S4 */ 
-	for(n=0;n<3;n++) tempm[n]=B[n+9]; 
-	for(n=3;n<6;n++) tempm[n]=B[n+10]; 
-	for(n=6;n<7;n++) tempm[n]=B[n+7]; 
-	for(n=7;n<8;n++) tempm[n]=B[n+1];
-	/* A=T+S1+S1+S2+S2+S3+S4 */ 
-	fieldAdd(tempm2,tempm,ecc_prime_r,A);
-	/* Form D1 */ 
-	for(n=0;n<3;n++) tempm[n]=B[n+11]; 
-	for(n=3;n<6;n++) tempm[n]=0; 
-	for(n=6;n<7;n++) tempm[n]=B[n+2]; 
-	for(n=7;n<8;n++) tempm[n]=B[n+3];
-	/* tempm2=T+S1+S1+S2+S2+S3+S4-D1 */ 
-	fieldSub(A,tempm,ecc_prime_m,tempm2);
-	/* Form D2 */ 
-	for(n=0;n<4;n++) tempm[n]=B[n+12]; 
-	for(n=4;n<6;n++) tempm[n]=0; 
-	for(n=6;n<7;n++) tempm[n]=B[n+3]; 
-	for(n=7;n<8;n++) tempm[n]=B[n+4];
-	/* A=T+S1+S1+S2+S2+S3+S4-D1-D2 */ 
-	fieldSub(tempm2,tempm,ecc_prime_m,A);
-	/* Form D3 */ 
-	for(n=0;n<3;n++) tempm[n]=B[n+13]; 
-	for(n=3;n<6;n++) tempm[n]=B[n+5]; 
-	for(n=6;n<7;n++) tempm[n]=0; 
-	for(n=7;n<8;n++) tempm[n]=B[n+5];
-	/* tempm2=T+S1+S1+S2+S2+S3+S4-D1-D2-D3 */ 
-	fieldSub(A,tempm,ecc_prime_m,tempm2);
-	/* Form D4 */ 
-	for(n=0;n<2;n++) tempm[n]=B[n+14]; 
-	for(n=2;n<3;n++) tempm[n]=0; 
-	for(n=3;n<6;n++) tempm[n]=B[n+6]; 
-	for(n=6;n<7;n++) tempm[n]=0; 
-	for(n=7;n<8;n++) tempm[n]=B[n+6];
-	/* A=T+S1+S1+S2+S2+S3+S4-D1-D2-D3-D4 */ 
-	fieldSub(tempm2,tempm,ecc_prime_m,A);
-	if(isGreater(A, ecc_prime_m, arrayLength) >= 0){
-		fieldSub(A, ecc_prime_m, ecc_prime_m, tempm);
-		copy(tempm, A, arrayLength);
+	uint32_t mask;
+	int64_t d;
+	int i;
+
+	d = (int64_t)c[0] + c[8] + c[9] - c[11] - c[12] - c[13] - c[14];
+	A[0] = (uint32_t)d; d >>= 32;
+	d += (int64_t)c[1] + c[9] + c[10] - c[12] - c[13] - c[14] - c[15];
+	A[1] = (uint32_t)d; d >>= 32;
+	d += (int64_t)c[2] + c[10] + c[11] - c[13] - c[14] - c[15];
+	A[2] = (uint32_t)d; d >>= 32;
+	d += (int64_t)c[3] + 2 * (int64_t)c[11] + 2 * (int64_t)c[12] + c[13] - c[15] - c[8] - c[9];
+	A[3] = (uint32_t)d; d >>= 32;
+	d += (int64_t)c[4] + 2 * (int64_t)c[12] + 2 * (int64_t)c[13] + c[14] - c[9] - c[10];
+	A[4] = (uint32_t)d; d >>= 32;
+	d += (int64_t)c[5] + 2 * (int64_t)c[13] + 2 * (int64_t)c[14] + c[15] - c[10] - c[11];
+	A[5] = (uint32_t)d; d >>= 32;
+	d += (int64_t)c[6] + c[13] + 3 * (int64_t)c[14] + 2 * (int64_t)c[15] - c[8] - c[9];
+	A[6] = (uint32_t)d; d >>= 32;
+	d += (int64_t)c[7] + c[8] + 3 * (int64_t)c[15] - c[10] - c[11] - c[12] - c[13];
+	A[7] = (uint32_t)d; d >>= 32;
+
+	for (i = 0; i < 2; i++) {
+		int64_t carry = d;
+		d = (int64_t)A[0] + carry;
+		A[0] = (uint32_t)d; d >>= 32;
+		d += A[1];
+		A[1] = (uint32_t)d; d >>= 32;
+		d += A[2];
+		A[2] = (uint32_t)d; d >>= 32;
+		d += (int64_t)A[3] - carry;
+		A[3] = (uint32_t)d; d >>= 32;
+		d += A[4];
+		A[4] = (uint32_t)d; d >>= 32;
+		d += A[5];
+		A[5] = (uint32_t)d; d >>= 32;
+		d += (int64_t)A[6] - carry;
+		A[6] = (uint32_t)d; d >>= 32;
+		d += (int64_t)A[7] + carry;
+		A[7] = (uint32_t)d; d >>= 32;
 	}
+
+	/* A < 2^256 < 2p now, subtract p once if A >= p, without branching */
+	mask = sub(A, ecc_prime_m, tempm, arrayLength) - 1;
+	for (i = 0; i < arrayLength; i++)
+		A[i] = (tempm[i] & mask) | (A[i] & ~mask);
 }
 
 /**
@@ -488,28 +502,465 @@ static void ec_add(const uint32_t *px, const uint32_t *py, const uint32_t *qx, c
 	fieldSub(tempC, qy, ecc_prime_m, Sy);
 }
 
-void ecc_ec_mult(const uint32_t *px, const uint32_t *py, const uint32_t *secret, uint32_t *resultx, uint32_t *resulty){
-	uint32_t Qx[8];
-	uint32_t Qy[8];
-	setZero(Qx, 8);
-	setZero(Qy, 8);
+/*
+ * The scalar multiplications below work in Jacobian coordinates, (X, Y, Z)
+ * stands for the affine point (X / Z^2, Y / Z^3), so that only the result needs
+ * an inversion. All field elements are kept fully reduced, and the code
+ * that handles secret scalars runs without branches or memory accesses that
+ * depend on the scalar.
+ */
+
+// r = mask ? a : r, mask is 0 or 0xffffffff
+static void condCopy(const uint32_t *a, uint32_t *r, uint32_t mask){
+	int i;
+	for (i = 0; i < arrayLength; i++)
+		r[i] = (a[i] & mask) | (r[i] & ~mask);
+}
 
-	uint32_t tempx[8];
-	uint32_t tempy[8];
+// swaps a and b if mask is 0xffffffff
+static void condSwap(uint32_t *a, uint32_t *b, uint32_t mask){
+	uint32_t t;
+	int i;
+	for (i = 0; i < arrayLength; i++) {
+		t = (a[i] ^ b[i]) & mask;
+		a[i] ^= t;
+		b[i] ^= t;
+	}
+}
 
+static void modpAdd(const uint32_t *x, const uint32_t *y, uint32_t *result){
+	uint32_t tempm[8];
+	uint32_t carry = add(x, y, result, arrayLength);
+	uint32_t borrow = sub(result, ecc_prime_m, tempm, arrayLength);
+	condCopy(tempm, result, -(carry | (borrow ^ 1)));
+}
+
+static void modpSub(const uint32_t *x, const uint32_t *y, uint32_t *result){
+	uint32_t tempm[8];
+	uint32_t mask = -sub(x, y, result, arrayLength);
 	int i;
-	for (i = 256;i--;){
-		ec_double(Qx, Qy, tempx, tempy);
-		copy(tempx, Qx,arrayLength);
-		copy(tempy, Qy,arrayLength);
-		if (((secret[i / 32]) & ((uint32_t)1 << (i % 32)))) {
-			ec_add(Qx, Qy, px, py, tempx, tempy); //eccAdd
-			copy(tempx, Qx,arrayLength);
-			copy(tempy, Qy,arrayLength);
+	for (i = 0; i < arrayLength; i++)
+		tempm[i] = ecc_prime_m[i] & mask;
+	add(result, tempm, result, arrayLength);
+}
+
+static void modpMult(const uint32_t *x, const uint32_t *y, uint32_t *result){
+	uint32_t tempD[16];
+	fieldMult(x, y, tempD, arrayLength);
+	fieldModP(result, tempD);
+}
+
+static void modpSquare(const uint32_t *x, uint32_t *result){
+	uint32_t tempD[16];
+	fieldSquare(x, tempD);
+	fieldModP(result, tempD);
+}
+
+// result = x^(2^n)
+static void modpSquareN(const uint32_t *x, uint32_t *result, int n){
+	copy(x, result, arrayLength);
+	while (n--)
+		modpSquare(result, result);
+}
+
+/*
+ * Inverse in modulo p and output to B, as in^(p - 2) with a fixed addition chain,
+ * which unlike fieldInv() takes the same time for every A.
+ * p - 2 = ffffffff 00000001 00000000 00000000 00000000 ffffffff ffffffff fffffffd
+ */
+static void modpInv(const uint32_t *in, uint32_t *B){
+	uint32_t A[8], x2[8], x3[8], x6[8], x15[8], x30[8], x32[8], t[8];
+
+	copy(in, A, arrayLength);	// A and B may be the same
+	modpSquare(A, t);
+	modpMult(t, A, x2);		// 2^2 - 1
+	modpSquare(x2, t);
+	modpMult(t, A, x3);		// 2^3 - 1
+	modpSquareN(x3, t, 3);
+	modpMult(t, x3, x6);		// 2^6 - 1
+	modpSquareN(x6, t, 6);
+	modpMult(t, x6, x15);		// 2^12 - 1
+	modpSquareN(x15, t, 3);
+	modpMult(t, x3, x15);		// 2^15 - 1
+	modpSquareN(x15, t, 15);
+	modpMult(t, x15, x30);		// 2^30 - 1
+	modpSquareN(x30, t, 2);
+	modpMult(t, x2, x32);		// 2^32 - 1
+
+	modpSquareN(x32, t, 32);
+	modpMult(t, A, B);		// ffffffff 00000001
+	modpSquareN(B, t, 96 + 32);
+	modpMult(t, x32, B);		// ... 00000000 00000000 00000000 ffffffff
+	modpSquareN(B, t, 32);
+	modpMult(t, x32, B);		// ... ffffffff
+	modpSquareN(B, t, 30);
+	modpMult(t, x30, B);		// ... fffffffc >> 2
+	modpSquareN(B, t, 2);
+	modpMult(t, A, B);		// ... fffffffd
+}
+
+/*
+ * Doubles (X, Y, Z) in place, with a = -3. A point with Z = 0 (the point at
+ * infinity) stays at Z = 0.
+ */
+static void ec_double_jacobian(uint32_t *X, uint32_t *Y, uint32_t *Z){
+	uint32_t t4[8];
+	uint32_t t5[8];
+	uint32_t half[8];
+	uint32_t carry;
+	int i;
+
+	modpSquare(Y, t4);		// t4 = y^2
+	modpMult(X, t4, t5);		// t5 = x*y^2 = A
+	modpSquare(t4, t4);		// t4 = y^4
+	modpMult(Y, Z, Y);		// y = y*z = z3
+	modpSquare(Z, Z);		// z = z^2
+
+	modpAdd(X, Z, X);		// x = x + z^2
+	modpAdd(Z, Z, Z);		// z = 2*z^2
+	modpSub(X, Z, Z);		// z = x - z^2
+	modpMult(X, Z, X);		// x = x^2 - z^4
+
+	modpAdd(X, X, Z);		// z = 2*(x^2 - z^4)
+	modpAdd(X, Z, X);		// x = 3*(x^2 - z^4)
+	for (i = 0; i < arrayLength; i++)	// x = x/2, adding p first if x is odd
+		half[i] = ecc_prime_m[i] & -(X[0] & 1);
+	carry = add(X, half, X, arrayLength);
+	rshift(X);
+	X[7] |= carry << 31;		// x = 3/2*(x^2 - z^4) = B
+
+	modpSquare(X, Z);		// z = B^2
+	modpSub(Z, t5, Z);		// z = B^2 - A
+	modpSub(Z, t5, Z);		// z = B^2 - 2A = x3
+	modpSub(t5, Z, t5);		// t5 = A - x3
+	modpMult(X, t5, X);		// x = B*(A - x3)
+	modpSub(X, t4, t4);		// t4 = B*(A - x3) - y^4 = y3
+
+	copy(Z, X, arrayLength);
+	copy(Y, Z, arrayLength);
+	copy(t4, Y, arrayLength);
+}
+
+// (X, Y) = (X * Z^2, Y * Z^3)
+static void applyZ(uint32_t *X, uint32_t *Y, const uint32_t *Z){
+	uint32_t t1[8];
+
+	modpSquare(Z, t1);
+	modpMult(X, t1, X);
+	modpMult(t1, Z, t1);
+	modpMult(Y, t1, Y);
+}
+
+/*
+ * Co-Z addition, the building block of the Montgomery ladder of
+ * Goundar, Joye, Miyaji, Rivain and Venelli, "Scalar Multiplication on
+ * Weierstrass Elliptic Curves from Co-Z Arithmetic".
+ *
+ * Input P = (X1, Y1, Z), Q = (X2, Y2, Z) sharing the same Z.
+ * Output P' = (X1, Y1, Z3) (P with the new Z), P + Q = (X2, Y2, Z3).
+ */
+static void XYcZ_add(uint32_t *X1, uint32_t *Y1, uint32_t *X2, uint32_t *Y2){
+	uint32_t t5[8];
+
+	modpSub(X2, X1, t5);		// t5 = x2 - x1
+	modpSquare(t5, t5);		// t5 = (x2 - x1)^2 = A
+	modpMult(X1, t5, X1);		// x1 = x1*A = B
+	modpMult(X2, t5, X2);		// x2 = x2*A = C
+	modpSub(Y2, Y1, Y2);		// y2 = y2 - y1
+	modpSquare(Y2, t5);		// t5 = (y2 - y1)^2 = D
+
+	modpSub(t5, X1, t5);		// t5 = D - B
+	modpSub(t5, X2, t5);		// t5 = D - B - C = x3
+	modpSub(X2, X1, X2);		// x2 = C - B
+	modpMult(Y1, X2, Y1);		// y1 = y1*(C - B)
+	modpSub(X1, t5, X2);		// x2 = B - x3
+	modpMult(Y2, X2, Y2);		// y2 = (y2 - y1)*(B - x3)
+	modpSub(Y2, Y1, Y2);		// y2 = y3
+
+	copy(t5, X2, arrayLength);
+}
+
+/*
+ * Conjugate co-Z addition.
+ *
+ * Input P = (X1, Y1, Z), Q = (X2, Y2, Z) sharing the same Z.
+ * Output P - Q = (X1, Y1, Z3), P + Q = (X2, Y2, Z3).
+ */
+static void XYcZ_addC(uint32_t *X1, uint32_t *Y1, uint32_t *X2, uint32_t *Y2){
+	uint32_t t5[8];
+	uint32_t t6[8];
+	uint32_t t7[8];
+
+	modpSub(X2, X1, t5);		// t5 = x2 - x1
+	modpSquare(t5, t5);		// t5 = (x2 - x1)^2 = A
+	modpMult(X1, t5, X1);		// x1 = x1*A = B
+	modpMult(X2, t5, X2);		// x2 = x2*A = C
+	modpAdd(Y2, Y1, t5);		// t5 = y2 + y1
+	modpSub(Y2, Y1, Y2);		// y2 = y2 - y1
+
+	modpSub(X2, X1, t6);		// t6 = C - B
+	modpMult(Y1, t6, Y1);		// y1 = y1*(C - B) = E
+	modpAdd(X1, X2, t6);		// t6 = B + C
+	modpSquare(Y2, X2);		// x2 = (y2 - y1)^2 = D
+	modpSub(X2, t6, X2);		// x2 = D - (B + C) = x3
+
+	modpSub(X1, X2, t7);		// t7 = B - x3
+	modpMult(Y2, t7, Y2);		// y2 = (y2 - y1)*(B - x3)
+	modpSub(Y2, Y1, Y2);		// y2 = (y2 - y1)*(B - x3) - E = y3
+
+	modpSquare(t5, t7);		// t7 = (y2 + y1)^2 = F
+	modpSub(t7, t6, t7);		// t7 = F - (B + C) = x3'
+	modpSub(t7, X1, t6);		// t6 = x3' - B
+	modpMult(t6, t5, t6);		// t6 = (y2 + y1)*(x3' - B)
+	modpSub(t6, Y1, Y1);		// y1 = (y2 + y1)*(x3' - B) - E = y3'
+
+	copy(t7, X1, arrayLength);
+}
+
+/*
+ * result = secret * P for an arbitrary point P of the curve, with the co-Z
+ * Montgomery ladder: every bit of the scalar costs the same two co-Z additions,
+ * and R0 and R1 are swapped by masking instead of by indexing.
+ *
+ * The scalar is first turned into k + n or k + 2n, whichever has bit 256 set,
+ * so the ladder always starts with R0 = P, R1 = 2P and runs over 256 bits.
+ */
+static void ec_mult_ladder(const uint32_t *px, const uint32_t *py, const uint32_t *secret, uint32_t *resultx, uint32_t *resulty){
+	uint32_t R0x[8], R0y[8], R1x[8], R1y[8];
+	uint32_t k0[8], k1[8];
+	uint32_t z[8], t[8];
+	uint32_t carry, mask;
+	int i;
+
+	carry = add(secret, ecc_order_m, k0, arrayLength);
+	add(k0, ecc_order_m, k1, arrayLength);
+	condCopy(k0, k1, -carry);
+
+	// R1 = 2P and R0 = P, with the same Z
+	copy(px, R1x, arrayLength);
+	copy(py, R1y, arrayLength);
+	copy(px, R0x, arrayLength);
+	copy(py, R0y, arrayLength);
+	setZero(z, 8);
+	z[0] = 1;
+	ec_double_jacobian(R1x, R1y, z);
+	applyZ(R0x, R0y, z);
+
+	for (i = 255; i > 0; --i) {
+		mask = -((k1[i / 32] >> (i % 32)) & 1);
+		condSwap(R0x, R1x, mask);
+		condSwap(R0y, R1y, mask);
+		XYcZ_addC(R0x, R0y, R1x, R1y);
+		XYcZ_add(R1x, R1y, R0x, R0y);
+		condSwap(R0x, R1x, mask);
+		condSwap(R0y, R1y, mask);
+	}
+
+	mask = -(k1[0] & 1);
+	condSwap(R0x, R1x, mask);
+	condSwap(R0y, R1y, mask);
+	XYcZ_addC(R0x, R0y, R1x, R1y);
+
+	// 1/Z = Xb * yP / (xP * Yb * (X1 - X0)), b being the last bit
+	modpSub(R1x, R0x, z);
+	setZero(t, 8);
+	modpSub(t, z, t);
+	condCopy(t, z, mask);		// X1 - X0 before the swap
+	modpMult(z, R0y, z);
+	modpMult(z, px, z);
+	modpInv(z, z);
+	modpMult(z, py, z);
+	modpMult(z, R0x, z);
+
+	XYcZ_add(R1x, R1y, R0x, R0y);
+	condSwap(R0x, R1x, mask);
+	condSwap(R0y, R1y, mask);
+	applyZ(R0x, R0y, z);
+
+	copy(R0x, resultx, arrayLength);
+	copy(R0y, resulty, arrayLength);
+}
+
+/*
+ * Fixed base comb of width 4 for the generator: ecc_g_comb[i - 1] is the affine
+ * point sum(2^(64 j) G) over the bits j set in i, so secret * G takes 64
+ * doublings and 64 mixed additions. The table was computed offline.
+ */
+static const uint32_t ecc_g_comb[15][2][8] = {
+	{ { 0xD898C296, 0xF4A13945, 0x2DEB33A0, 0x77037D81,
+	    0x63A440F2, 0xF8BCE6E5, 0xE12C4247, 0x6B17D1F2 },
+	  { 0x37BF51F5, 0xCBB64068, 0x6B315ECE, 0x2BCE3357,
+	    0x7C0F9E16, 0x8EE7EB4A, 0xFE1A7F9B, 0x4FE342E2 } },
+	{ { 0x8E14DB63, 0x90E75CB4, 0xAD651F7E, 0x29493BAA,
+	    0x326E25DE, 0x8492592E, 0x2811AAA5, 0x0FA822BC },
+	  { 0x5F462EE7, 0xE4112454, 0x50FE82F5, 0x34B1A650,
+	    0xB3DF188B, 0x6F4AD4BC, 0xF5DBA80D, 0xBFF44AE8 } },
+	{ { 0x097992AF, 0x93391CE2, 0x0D35F1FA, 0xE96C98FD,
+	    0x95E02789, 0xB257C0DE, 0x89D6726F, 0x300A4BBC },
+	  { 0xC08127A0, 0xAA54A291, 0xA9D806A5, 0x5BB1EEAD,
+	    0xFF1E3C6F, 0x7F1DDB25, 0xD09B4644, 0x72AAC7E0 } },
+	{ { 0xD789BD85, 0x57C84FC9, 0xC297EAC3, 0xFC35FF7D,
+	    0x88C6766E, 0xFB982FD5, 0xEEDB5E67, 0x447D739B },
+	  { 0x72E25B32, 0x0C7E33C9, 0xA7FAE500, 0x3D349B95,
+	    0x3A4AAFF7, 0xE12E9D95, 0x834131EE, 0x2D4825AB } },
+	{ { 0x2A1D367F, 0x13949C93, 0x1A0A11B7, 0xEF7FBD2B,
+	    0xB91DFC60, 0xDDC6068B, 0x8A9C72FF, 0xEF951932 },
+	  { 0x7376D8A8, 0x196035A7, 0x95CA1740, 0x23183B08,
+	    0x022C219C, 0xC1EE9807, 0x7DBB2C9B, 0x611E9FC3 } },
+	{ { 0x0B57F4BC, 0xCAE2B192, 0xC6C9BC36, 0x2936DF5E,
+	    0xE11238BF, 0x7DEA6482, 0x7B51F5D8, 0x55066379 },
+	  { 0x348A964C, 0x44FFE216, 0xDBDEFBE1, 0x9FB3D576,
+	    0x8D9D50E5, 0x0AFA4001, 0x8AECB851, 0x15716484 } },
+	{ { 0xFC5CDE01, 0xE48ECAFF, 0x0D715F26, 0x7CCD84E7,
+	    0xF43E4391, 0xA2E8F483, 0xB21141EA, 0xEB5D7745 },
+	  { 0x731A3479, 0xCAC917E2, 0x2844B645, 0x85F22CFE,
+	    0x58006CEE, 0x0990E6A1, 0xDBECC17B, 0xEAFD72EB } },
+	{ { 0x313728BE, 0x6CF20FFB, 0xA3C6B94A, 0x96439591,
+	    0x44315FC5, 0x2736FF83, 0xA7849276, 0xA6D39677 },
+	  { 0xC357F5F4, 0xF2BAB833, 0x2284059B, 0x824A920C,
+	    0x2D27ECDF, 0x66B8BABD, 0x9B0B8816, 0x674F8474 } },
+	{ { 0x677C8A3E, 0x2DF48C04, 0x0203A56B, 0x74E02F08,
+	    0xB8C7FEDB, 0x31855F7D, 0x72C9DDAD, 0x4E769E76 },
+	  { 0xB824BBB0, 0xA4C36165, 0x3B9122A5, 0xFB9AE16F,
+	    0x06947281, 0x1EC00572, 0xDE830663, 0x42B99082 } },
+	{ { 0xDDA868B9, 0x6EF95150, 0x9C0CE131, 0xD1F89E79,
+	    0x08A1C478, 0x7FDC1CA0, 0x1C6CE04D, 0x78878EF6 },
+	  { 0x1FE0D976, 0x9C62B912, 0xBDE08D4F, 0x6ACE570E,
+	    0x12309DEF, 0xDE53142C, 0x7B72C321, 0xB6CB3F5D } },
+	{ { 0xC31A3573, 0x7F991ED2, 0xD54FB496, 0x5B82DD5B,
+	    0x812FFCAE, 0x595C5220, 0x716B1287, 0x0C88BC4D },
+	  { 0x5F48ACA8, 0x3A57BF63, 0xDF2564F3, 0x7C8181F4,
+	    0x9C04E6AA, 0x18D1B5B3, 0xF3901DC6, 0xDD5DDEA3 } },
+	{ { 0x3E72AD0C, 0xE96A79FB, 0x42BA792F, 0x43A0A28C,
+	    0x083E49F3, 0xEFE0A423, 0x6B317466, 0x68F344AF },
+	  { 0x3FB24D4A, 0xCDFE17DB, 0x71F5C626, 0x668BFC22,
+	    0x24D67FF3, 0x604ED93C, 0xF8540A20, 0x31B9C405 } },
+	{ { 0xA2582E7F, 0xD36B4789, 0x4EC39C28, 0x0D1A1014,
+	    0xEDBAD7A0, 0x663C62C3, 0x6F461DB9, 0x4052BF4B },
+	  { 0x188D25EB, 0x235A27C3, 0x99BFCC5B, 0xE724F339,
+	    0x71D70CC8, 0x862BE6BD, 0x90B0FC61, 0xFECF4D51 } },
+	{ { 0xA1D4CFAC, 0x74346C10, 0x8526A7A4, 0xAFDF5CC0,
+	    0xF62BFF7A, 0x123202A8, 0xC802E41A, 0x1EDDBAE2 },
+	  { 0xD603F844, 0x8FA0AF2D, 0x4C701917, 0x36E06B7E,
+	    0x73DB33A0, 0x0C45F452, 0x560EBCFC, 0x43104D86 } },
+	{ { 0x0D1D78E5, 0x9615B511, 0x25C4744B, 0x66B0DE32,
+	    0x6AAF363A, 0x0A4A46FB, 0x84F7A21C, 0xB48E26B4 },
+	  { 0x21A01B2D, 0x06EBB0F6, 0x8B7B0F98, 0xC004E404,
+	    0xFED6F668, 0x64131BCD, 0x4D4D3DAB, 0xFAC01540 } }
+};
+
+/*
+ * (X3, Y3, Z3) = (X1, Y1, Z1) + (x2, y2, 1), the mixed Jacobian-affine addition.
+ * The input and output points must not overlap.
+ * P = Q and P = -Q are not handled, see ec_mult_base().
+ */
+static void ec_add_mixed(const uint32_t *X1, const uint32_t *Y1, const uint32_t *Z1,
+			 const uint32_t *x2, const uint32_t *y2,
+			 uint32_t *X3, uint32_t *Y3, uint32_t *Z3){
+	uint32_t t1[8], h[8], r[8], hh[8], v[8];
+
+	modpSquare(Z1, t1);		// t1 = z1^2
+	modpMult(x2, t1, h);		// h = x2*z1^2 = u2
+	modpMult(t1, Z1, t1);		// t1 = z1^3
+	modpMult(y2, t1, r);		// r = y2*z1^3 = s2
+	modpSub(h, X1, h);		// h = u2 - x1
+	modpSub(r, Y1, r);		// r = s2 - y1
+
+	modpMult(Z1, h, Z3);		// z3 = z1*h
+	modpSquare(h, hh);		// hh = h^2
+	modpMult(hh, h, t1);		// t1 = h^3
+	modpMult(X1, hh, v);		// v = x1*h^2
+
+	modpSquare(r, X3);		// x3 = r^2
+	modpSub(X3, t1, X3);		// x3 = r^2 - h^3
+	modpSub(X3, v, X3);
+	modpSub(X3, v, X3);		// x3 = r^2 - h^3 - 2v
+
+	modpSub(v, X3, v);		// v = v - x3
+	modpMult(r, v, Y3);		// y3 = r*(v - x3)
+	modpMult(Y1, t1, t1);		// t1 = y1*h^3
+	modpSub(Y3, t1, Y3);		// y3 = r*(v - x3) - y1*h^3
+}
+
+/*
+ * result = secret * G with the comb. The table is read in full for every
+ * column and the result of each step is selected by masking, the point at
+ * infinity being tracked in a mask as well.
+ *
+ * For a scalar below n, the running sum can only meet the table point, or its
+ * negation, at the rare scalars for which the comb columns add up to n, which
+ * ec_add_mixed() does not handle; these are as unlikely to be drawn at random
+ * as a guessed private key.
+ */
+static void ec_mult_base(const uint32_t *secret, uint32_t *resultx, uint32_t *resulty){
+	uint32_t X[8], Y[8], Z[8];
+	uint32_t SX[8], SY[8], SZ[8];
+	uint32_t tx[8], ty[8], one[8];
+	uint32_t infinity = 0xffffffff, idx, mask, used;
+	int i, j;
+
+	setZero(X, 8);
+	setZero(Y, 8);
+	setZero(Z, 8);
+	setZero(one, 8);
+	one[0] = 1;
+
+	for (i = 63; i >= 0; --i) {
+		ec_double_jacobian(X, Y, Z);
+
+		idx = ((secret[i / 32] >> (i % 32)) & 1)
+			| (((secret[2 + i / 32] >> (i % 32)) & 1) << 1)
+			| (((secret[4 + i / 32] >> (i % 32)) & 1) << 2)
+			| (((secret[6 + i / 32] >> (i % 32)) & 1) << 3);
+
+		setZero(tx, 8);
+		setZero(ty, 8);
+		for (j = 1; j < 16; j++) {
+			mask = -(((uint32_t)(j ^ idx) - 1) >> 31);
+			condCopy(ecc_g_comb[j - 1][0], tx, mask);
+			condCopy(ecc_g_comb[j - 1][1], ty, mask);
 		}
+
+		ec_add_mixed(X, Y, Z, tx, ty, SX, SY, SZ);
+
+		// from infinity, the sum is the table point itself
+		condCopy(tx, SX, infinity);
+		condCopy(ty, SY, infinity);
+		condCopy(one, SZ, infinity);
+
+		// a zero column leaves the running sum as it is
+		used = -((idx + 0xf) >> 4);
+		condCopy(SX, X, used);
+		condCopy(SY, Y, used);
+		condCopy(SZ, Z, used);
+		infinity &= ~used;
+	}
+
+	modpInv(Z, tx);
+	applyZ(X, Y, tx);
+	setZero(tx, 8);
+	condCopy(tx, X, infinity);
+	condCopy(tx, Y, infinity);
+	copy(X, resultx, arrayLength);
+	copy(Y, resulty, arrayLength);
+}
+
+/*
+ * result = secret * P. The generator takes the comb, any other point the
+ * ladder. A zero scalar gives (0, 0), the encoding of the point at infinity
+ * used by ec_add() and ec_double().
+ */
+void ecc_ec_mult(const uint32_t *px, const uint32_t *py, const uint32_t *secret, uint32_t *resultx, uint32_t *resulty){
+	if (isSame(px, ecc_g_point_x, arrayLength) && isSame(py, ecc_g_point_y, arrayLength)) {
+		ec_mult_base(secret, resultx, resulty);
+		return;
+	}
+	if (isZero(secret)) {
+		setZero(resultx, 8);
+		setZero(resulty, 8);
+		return;
 	}
-	copy(Qx, resultx,arrayLength);
-	copy(Qy, resulty,arrayLength);
+	ec_mult_ladder(px, py, secret, resultx, resulty);
 }
 
 /**
@@ -194,6 +194,82 @@ void ecdsaTest() {
 	assert(!ret);
 }
 
+/*
+ * The generator takes the fixed base comb and every other point the ladder,
+ * so check k * (2G) from the ladder against (2k mod n) * G from the comb.
+ */
+void combLadderTest() {
+	uint32_t twoGx[8];
+	uint32_t twoGy[8];
+	uint32_t k[9];
+	uint32_t k2[9];
+	uint32_t ladderx[8];
+	uint32_t laddery[8];
+	uint32_t combx[8];
+	uint32_t comby[8];
+	int i;
+
+	ecc_ec_double(BasePointx, BasePointy, twoGx, twoGy);
+	for (i = 0; i < 16; i++) {
+		ecc_setRandom(k);
+		k[8] = 0;
+		ecc_fieldModO(k, k, 9);
+		k2[8] = ecc_add(k, k, k2, arrayLength);
+		ecc_fieldModO(k2, k2, 9);
+
+		ecc_ec_mult(twoGx, twoGy, k, ladderx, laddery);
+		ecc_ec_mult(BasePointx, BasePointy, k2, combx, comby);
+		assert(ecc_isSame(ladderx, combx, arrayLength));
+		assert(ecc_isSame(laddery, comby, arrayLength));
+	}
+}
+
+#if !defined(CONTIKI) && !defined(ARDUINO)
+static double elapsed(clock_t start, int rounds) {
+	return (double)(clock() - start) * 1000 / CLOCKS_PER_SEC / rounds;
+}
+
+/*
+ * Times the operations of an ECDHE_ECDSA handshake. Run with any argument to
+ * skip it.
+ */
+void eccBenchmark() {
+	uint32_t priv[8];
+	uint32_t pub_x[8];
+	uint32_t pub_y[8];
+	uint32_t shared_x[8];
+	uint32_t shared_y[8];
+	uint32_t r[9];
+	uint32_t s[9];
+	clock_t start;
+	int i, rounds = 200;
+
+	do {
+		ecc_setRandom(priv);
+	} while (!ecc_is_valid_key(priv));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		ecc_gen_pub_key(priv, pub_x, pub_y);
+	printf("key generation (k * G):  %8.3f ms\n", elapsed(start, rounds));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		ecc_ecdh(Sx, Sy, priv, shared_x, shared_y);
+	printf("ECDH (k * P):            %8.3f ms\n", elapsed(start, rounds));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		ecc_ecdsa_sign(priv, ecdsaTestMessage, ecdsaTestRand1, r, s);
+	printf("ECDSA sign:              %8.3f ms\n", elapsed(start, rounds));
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		assert(ecc_ecdsa_validate(pub_x, pub_y, ecdsaTestMessage, r, s) == 0);
+	printf("ECDSA verify:            %8.3f ms\n", elapsed(start, rounds));
+}
+#endif
+
 #ifdef CONTIKI
 PROCESS(ecc_test, "ECC test");
 AUTOSTART_PROCESSES(&ecc_test);
@@ -207,6 +283,7 @@ PROCESS_THREAD(ecc_test, ev, d)
 	multTest();
 	eccdhTest();
 	ecdsaTest();
+	combLadderTest();
 	printf("%s\n", "All Tests successful.");
 
 	PROCESS_END();
@@ -221,6 +298,7 @@ int testecc()
   multTest();
   eccdhTest();
   ecdsaTest();
+  combLadderTest();
   return 1;
 }
 /* end ARDUINO */
@@ -233,7 +311,10 @@ int main(int argc, char const *argv[])
 	multTest();
 	eccdhTest();
 	ecdsaTest();
+	combLadderTest();
 	printf("%s\n", "All Tests successful.");
+	if (argc < 2)
+		eccBenchmark();
 	return 0;
 }
 #endif /* CONTIKI */
@@ -43,6 +43,8 @@
 
 #ifdef CONTIKI
 #include "contiki.h"
+#else
+#include <time.h>
 #endif /* CONTIKI */
 
 //arbitrary test values and results
@@ -114,7 +116,7 @@ void fieldAddTest(){
 	ecc_fieldAdd(one, one, ecc_prime_r, temp);
 	assert(ecc_isSame(temp, two, arrayLength));
 	nullEverything();
-	ecc_add(full, one, temp, 32);
+	ecc_add(full, one, temp, arrayLength);
 	assert(ecc_isSame(null, temp, arrayLength));
 	nullEverything();
 	ecc_fieldAdd(full, one, ecc_prime_r, temp);
@@ -164,9 +166,9 @@ void fieldModPTest(){
 	ecc_fieldModP(temp, temp2);
 	assert(ecc_isSame(temp, resultDoubleMod, arrayLength));
 	nullEverything();
-	/*fieldMult(full, full, temp2, arrayLength); //not working, maybe because of the number bigger than p^2?
-	fieldModP(temp, temp2);
-	assert(ecc_isSame(temp, resultFullMod, arrayLength));*/
+	ecc_fieldMult(full, full, temp2, arrayLength);
+	ecc_fieldModP(temp, temp2);
+	assert(ecc_isSame(temp, resultFullMod, arrayLength));
 }
 
 void fieldModOTest(){
@@ -236,6 +238,40 @@ void fieldInvTest(){
 
 // }
 
+#if !defined(CONTIKI) && !defined(ARDUINO)
+/*
+ * Times the field operations the point arithmetic is made of. Run with any
+ * argument to skip it.
+ */
+void fieldBenchmark(){
+	uint32_t x[8];
+	uint32_t y[8];
+	clock_t start;
+	int i, rounds = 1000000;
+
+	ecc_setRandom(x);
+	ecc_setRandom(y);
+
+	start = clock();
+	for (i = 0; i < rounds; i++) {
+		ecc_fieldMult(x, y, temp2, arrayLength);
+		ecc_fieldModP(x, temp2);
+	}
+	printf("fieldMult + fieldModP: %8.3f us\n", (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / rounds);
+
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		ecc_fieldModP(x, temp2);
+	printf("fieldModP:             %8.3f us\n", (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / rounds);
+
+	rounds /= 100;
+	start = clock();
+	for (i = 0; i < rounds; i++)
+		ecc_fieldInv(x, ecc_prime_m, ecc_prime_r, y);
+	printf("fieldInv:              %8.3f us\n", (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / rounds);
+}
+#endif
+
 #ifdef CONTIKI
 PROCESS(ecc_field_test, "ECC field test");
 AUTOSTART_PROCESSES(&ecc_field_test);
@@ -306,6 +342,8 @@ int main(int argc, char const *argv[])
 	//rShiftTest();
 	//isOneTest();
 	printf("%s\n", "All Tests succesfull!");
+	if (argc < 2)
+		fieldBenchmark();
 	return 0;
 }
 #endif /* CONTIKI */
@@ -59,6 +59,27 @@ typedef unsigned char uint48ptr[6];
 #endif /* WITH_CONTIKI || RIOT_VERSION */
 #endif
 
+#ifndef DTLS_MAX_CID_LENGTH
+/** Maximum length of the Connection ID (RFC 9146) which the server
+    may ask us to send in each record. Set to 0 to build without
+    Connection ID support. */
+#define DTLS_MAX_CID_LENGTH 16
+#endif
+
+#ifndef DTLS_SESSION_ID_MAX_LENGTH
+/** Maximum length of the session id which the server gives to resume
+    the session with an abbreviated handshake. Set to 0 to build
+    without session resumption. */
+#define DTLS_SESSION_ID_MAX_LENGTH 32
+#endif
+
+#ifndef DTLS_SESSION_RSEQ_RESERVE
+/** The record sequence numbers which dtls_reserve_session() reserves
+    for an imported session, at most 65535. Once used up, the session
+    sends no more records and a new handshake is needed. */
+#define DTLS_SESSION_RSEQ_RESERVE 1024
+#endif
+
 #ifndef DTLS_FIRST_RETRANSMIT_SECONDS
 #ifdef WITH_ARDUINO
 #define DTLS_FIRST_RETRANSMIT_SECONDS 5 /* Setting to 5, because of NB-IoT RTT + Twilio Breakout service. */
@@ -67,6 +88,15 @@ typedef unsigned char uint48ptr[6];
 #endif
 #endif
 
+/** Bounds of the initial retransmission timeout estimated from the
+ * round-trip times of handshake flights (RFC 6347, section 4.2.4.1). */
+#ifndef DTLS_MIN_RETRANSMIT_TIMEOUT
+#define DTLS_MIN_RETRANSMIT_TIMEOUT (1 * CLOCK_SECOND)
+#endif
+#ifndef DTLS_MAX_RETRANSMIT_TIMEOUT
+#define DTLS_MAX_RETRANSMIT_TIMEOUT (60 * CLOCK_SECOND)
+#endif
+
 #ifndef DTLS_DEFAULT_MAX_RETRANSMIT
 /** Number of message retransmissions. */
 #ifdef WITH_ARDUINO
@@ -94,6 +124,7 @@ typedef enum {
 #define TLS_EXT_CLIENT_CERTIFICATE_TYPE	19 /* see RFC 7250 */
 #define TLS_EXT_SERVER_CERTIFICATE_TYPE	20 /* see RFC 7250 */
 #define TLS_EXT_ENCRYPT_THEN_MAC	22 /* see RFC 7366 */
+#define TLS_EXT_CONNECTION_ID		54 /* see RFC 9146 */
 
 #define TLS_CERT_TYPE_RAW_PUBLIC_KEY	2 /* see RFC 7250 */
 
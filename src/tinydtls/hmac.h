@@ -95,13 +95,14 @@ typedef enum {
 /**
  * Context for HMAC generation. This object is initialized with
  * dtls_hmac_init() and must be passed to dtls_hmac_update() and
- * dtls_hmac_finalize(). Once, finalized, the component \c H is
- * invalid and must be initialized again with dtls_hmac_init() before
- * the structure can be used again. 
+ * dtls_hmac_finalize(). Once, finalized, the component \c data is
+ * invalid and must be restarted with dtls_hmac_reset() (same key) or
+ * dtls_hmac_init() (new key) before the structure can be used again.
  */
 typedef struct {
-  unsigned char pad[DTLS_HMAC_BLOCKSIZE]; /**< ipad and opad storage */
-  dtls_hash_ctx data;		          /**< context for hash function */
+  dtls_hash_ctx inner;		/**< hash state after the ipad block */
+  dtls_hash_ctx outer;		/**< hash state after the opad block */
+  dtls_hash_ctx data;		/**< context for hash function */
 } dtls_hmac_context_t;
 
 /**
@@ -113,6 +114,15 @@ typedef struct {
  */
 void dtls_hmac_init(dtls_hmac_context_t *ctx, const unsigned char *key, size_t klen);
 
+/**
+ * Restarts @p ctx for a new message under the key it was initialized
+ * with. This only copies the hash state cached by dtls_hmac_init(),
+ * so no key block needs to be hashed again.
+ *
+ * @param ctx The HMAC context to restart.
+ */
+void dtls_hmac_reset(dtls_hmac_context_t *ctx);
+
 /**
  * Allocates a new HMAC context \p ctx with the given secret key.
  * This function returns \c 1 if \c ctx has been set correctly, or \c
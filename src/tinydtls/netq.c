@@ -84,15 +84,24 @@ netq_init(void) {
 }
 
 #elif defined(WITH_ARDUINO)
+#include "dtls_pool.h"
+
+DTLS_POOL(dtls_netq_pool, netq_t, NETQ_MAXCNT);
 
 static inline netq_t *
 netq_malloc_node(size_t size) {
-  return (netq_t *)owl_malloc(sizeof(netq_t) + size);
+  if (size > sizeof(netq_packet_t))
+    return NULL;
+  return (netq_t *)dtls_pool_alloc(&dtls_netq_pool);
 }
 
 static inline void
 netq_free_node(netq_t *node) {
-  owl_free(node);
+  dtls_pool_free(&dtls_netq_pool, node);
+}
+
+void
+netq_init(void) {
 }
 #endif
 
@@ -58,14 +58,14 @@ typedef struct netq_t {
   unsigned char retransmit_cnt;	/**< retransmission counter, will be removed when zero */
 
   size_t length;		/**< actual length of data */
-#if !(defined (WITH_CONTIKI)) && !(defined (RIOT_VERSION))
+#if !(defined (WITH_CONTIKI)) && !(defined (RIOT_VERSION)) && !(defined (WITH_ARDUINO))
   unsigned char data[];		/**< the datagram to send */
 #else
   netq_packet_t data;		/**< the datagram to send */
 #endif
 } netq_t;
 
-#if !(defined (WITH_CONTIKI)) && !(defined (RIOT_VERSION))
+#if !(defined (WITH_CONTIKI)) && !(defined (RIOT_VERSION)) && !(defined (WITH_ARDUINO))
 static inline void netq_init(void)
 { }
 #else
@@ -84,12 +84,16 @@ dtls_free_peer(dtls_peer_t *peer) {
 }
 
 #elif defined (WITH_ARDUINO)
+#include "dtls_pool.h"
+
+DTLS_POOL(dtls_peer_pool, dtls_peer_t, DTLS_PEER_MAX);
+
 void peer_init(void) {
 }
 
 static inline dtls_peer_t *
 dtls_malloc_peer(void) {
-  return (dtls_peer_t *)owl_malloc(sizeof(dtls_peer_t));
+  return (dtls_peer_t *)dtls_pool_alloc(&dtls_peer_pool);
 }
 
 void
@@ -97,7 +101,7 @@ dtls_free_peer(dtls_peer_t *peer) {
   dtls_handshake_free(peer->handshake_params);
   dtls_security_free(peer->security_params[0]);
   dtls_security_free(peer->security_params[1]);
-  owl_free(peer);
+  dtls_pool_free(&dtls_peer_pool, peer);
 }
 #endif
 
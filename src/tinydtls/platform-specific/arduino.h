@@ -51,15 +51,16 @@
 /* Arduino has assert.h */
 #define HAVE_ASSERT_H 1
 
-/* global constants for constrained devices running Arduino */
+/* global constants for constrained devices running Arduino - these size the static pools in dtls_pool.h, so
+ * they fit one OwlDTLSClient session, plus the one it replaces in takeResumableSession() */
 #ifndef DTLS_PEER_MAX
 /** The maximum number DTLS peers (i.e. sessions). */
-#  define DTLS_PEER_MAX 32
+#  define DTLS_PEER_MAX 2
 #endif
 
 #ifndef DTLS_HANDSHAKE_MAX
 /** The maximum number of concurrent DTLS handshakes. */
-#  define DTLS_HANDSHAKE_MAX 16
+#  define DTLS_HANDSHAKE_MAX 2
 #endif
 
 #ifndef DTLS_SECURITY_MAX
@@ -72,6 +73,22 @@
 #  define DTLS_HASH_MAX (3 * DTLS_PEER_MAX)
 #endif
 
+/* Single-peer client profile: OwlDTLSClient talks to one server, through modem sockets which carry at most
+ * DTLS_CONF_MTU bytes (MODEM_UDP_BUFFER_SIZE), so the record buffers are sized to that and all the outgoing records
+ * are assembled in one shared scratch buffer, instead of 1400 bytes on the stack for each send. */
+#ifndef DTLS_CONF_SINGLE_PEER_CLIENT
+#define DTLS_CONF_SINGLE_PEER_CLIENT 1
+#endif
+#if DTLS_CONF_SINGLE_PEER_CLIENT
+#define DTLS_SINGLE_PEER_CLIENT
+#ifndef DTLS_CONF_MTU
+#define DTLS_CONF_MTU 512
+#endif
+#ifndef DTLS_MAX_BUF
+#define DTLS_MAX_BUF DTLS_CONF_MTU
+#endif
+#endif
+
 /** do not use uthash hash tables */
 #define DTLS_PEERS_NOHASH 1
 
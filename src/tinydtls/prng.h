@@ -31,23 +31,24 @@
  */
 
 #ifndef WITH_CONTIKI
-#include <stdlib.h>
+#include "dtls_drbg.h"
 
 /**
- * Fills \p buf with \p len random bytes. This is the default
- * implementation for prng().  You might want to change prng() to use
- * a better PRNG on your specific platform.
+ * Fills \p buf with \p len random bytes, from the AES-CTR generator
+ * in dtls_drbg.c.
  */
 static inline int
 dtls_prng(unsigned char *buf, size_t len) {
-  while (len--)
-    *buf++ = rand() & 0xFF;
-  return 1;
+  return dtls_drbg_generate(buf, len);
 }
 
+/**
+ * Adds \p seed to the entropy of the generator. Platforms with more
+ * entropy should pass it all to dtls_drbg_add_entropy().
+ */
 static inline void
 dtls_prng_init(unsigned short seed) {
-	srand(seed);
+  dtls_drbg_add_entropy((const unsigned char *)&seed, sizeof(seed));
 }
 #else /* WITH_CONTIKI */
 #include <string.h>
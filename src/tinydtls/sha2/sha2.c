@@ -62,6 +62,19 @@
  *
  *   #define SHA2_UNROLL_TRANSFORM
  *
+ * TRANSFORM NOTE:
+ * SHA-256 has a third version, selected with SHA2_SHA256_TRANSFORM
+ * (see sha2.h), and it is the default: the message schedule lives in
+ * a 16-word window on the stack and the rounds are written out sixteen
+ * at a time, so every schedule index is a constant and the window can
+ * stay in registers on 32-bit MCUs.  It is several times the code of
+ * the rolled loop (about 5K against 0.6K at -Os on x86), so 8-bit
+ * targets short on flash may prefer
+ *
+ *   cc -DSHA2_SHA256_TRANSFORM=SHA2_TRANSFORM_ROLLED ...
+ *
+ * sha2speed, in extras/TinyDTLSBench, checks and times whichever
+ * version was compiled in.
  */
 
 
@@ -152,6 +165,15 @@ typedef u_int64_t sha2_word64;	/* Exactly 8 bytes */
 
 /*** ENDIAN REVERSAL MACROS *******************************************/
 #if BYTE_ORDER == LITTLE_ENDIAN
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))
+/* A single REV on ARMv6 and later, BSWAP on x86: */
+#define REVERSE32(w,x)	{ \
+	(x) = __builtin_bswap32(w); \
+}
+#define REVERSE64(w,x)	{ \
+	(x) = __builtin_bswap64(w); \
+}
+#else /* __GNUC__ */
 #define REVERSE32(w,x)	{ \
 	sha2_word32 tmp = (w); \
 	tmp = (tmp >> 16) | (tmp << 16); \
@@ -165,6 +187,7 @@ typedef u_int64_t sha2_word64;	/* Exactly 8 bytes */
 	(x) = ((tmp & 0xffff0000ffff0000ULL) >> 16) | \
 	      ((tmp & 0x0000ffff0000ffffULL) << 16); \
 }
+#endif /* __GNUC__ */
 #endif /* BYTE_ORDER == LITTLE_ENDIAN */
 
 /*
@@ -223,9 +246,12 @@ typedef u_int64_t sha2_word64;	/* Exactly 8 bytes */
 /* 64-bit Rotate-right (used in SHA-384 and SHA-512): */
 #define S64(b,x)	(((x) >> (b)) | ((x) << (64 - (b))))
 
-/* Two of six logical functions used in SHA-256, SHA-384, and SHA-512: */
-#define Ch(x,y,z)	(((x) & (y)) ^ ((~(x)) & (z)))
-#define Maj(x,y,z)	(((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+/*
+ * Two of six logical functions used in SHA-256, SHA-384, and SHA-512,
+ * in the equivalent forms that take one operation less each:
+ */
+#define Ch(x,y,z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x,y,z)	(((x) & (y)) | ((z) & ((x) | (y))))
 
 /* Four of six logical functions used in SHA-256: */
 #define Sigma0_256(x)	(S32(2,  (x)) ^ S32(13, (x)) ^ S32(22, (x)))
@@ -375,7 +401,83 @@ void dtls_sha256_init(dtls_sha256_ctx* context) {
 	context->bitcount = 0;
 }
 
-#ifdef SHA2_UNROLL_TRANSFORM
+#if SHA2_SHA256_TRANSFORM == SHA2_TRANSFORM_WINDOWED
+
+/* Windowed SHA-256 round macros, i is a constant 0..15: */
+
+#if BYTE_ORDER == LITTLE_ENDIAN
+#define LOAD256(i)	REVERSE32(data[i], W[i])
+#else /* BYTE_ORDER == LITTLE_ENDIAN */
+#define LOAD256(i)	W[i] = data[i]
+#endif /* BYTE_ORDER == LITTLE_ENDIAN */
+
+#define SCHEDULE256(i)	\
+	W[i] += sigma1_256(W[((i)+14)&0x0f]) + W[((i)+9)&0x0f] + \
+		sigma0_256(W[((i)+1)&0x0f])
+
+#define ROUND256_W(a,b,c,d,e,f,g,h,i)	\
+	T1 = (h) + Sigma1_256(e) + Ch((e), (f), (g)) + K[i] + W[i]; \
+	(d) += T1; \
+	(h) = T1 + Sigma0_256(a) + Maj((a), (b), (c))
+
+#define ROUND256_0_TO_15(a,b,c,d,e,f,g,h,i)	\
+	LOAD256(i); \
+	ROUND256_W(a,b,c,d,e,f,g,h,i)
+
+#define ROUND256_16_TO_63(a,b,c,d,e,f,g,h,i)	\
+	SCHEDULE256(i); \
+	ROUND256_W(a,b,c,d,e,f,g,h,i)
+
+#define ROUNDS256(ROUND)	\
+	ROUND(a,b,c,d,e,f,g,h,0);  ROUND(h,a,b,c,d,e,f,g,1); \
+	ROUND(g,h,a,b,c,d,e,f,2);  ROUND(f,g,h,a,b,c,d,e,3); \
+	ROUND(e,f,g,h,a,b,c,d,4);  ROUND(d,e,f,g,h,a,b,c,5); \
+	ROUND(c,d,e,f,g,h,a,b,6);  ROUND(b,c,d,e,f,g,h,a,7); \
+	ROUND(a,b,c,d,e,f,g,h,8);  ROUND(h,a,b,c,d,e,f,g,9); \
+	ROUND(g,h,a,b,c,d,e,f,10); ROUND(f,g,h,a,b,c,d,e,11); \
+	ROUND(e,f,g,h,a,b,c,d,12); ROUND(d,e,f,g,h,a,b,c,13); \
+	ROUND(c,d,e,f,g,h,a,b,14); ROUND(b,c,d,e,f,g,h,a,15)
+
+void dtls_sha256_transform(dtls_sha256_ctx* context, const sha2_word32* data) {
+	sha2_word32	a, b, c, d, e, f, g, h, T1;
+	sha2_word32	W[16];
+	const sha2_word32 *K;
+
+	/* Initialize registers with the prev. intermediate value */
+	a = context->state[0];
+	b = context->state[1];
+	c = context->state[2];
+	d = context->state[3];
+	e = context->state[4];
+	f = context->state[5];
+	g = context->state[6];
+	h = context->state[7];
+
+	/* Rounds 0 to 15 take the message words: */
+	K = K256;
+	ROUNDS256(ROUND256_0_TO_15);
+
+	/* Rounds 16 to 63 expand the window in place: */
+	for (K += 16; K < K256 + 64; K += 16) {
+		ROUNDS256(ROUND256_16_TO_63);
+	}
+
+	/* Compute the current intermediate hash value */
+	context->state[0] += a;
+	context->state[1] += b;
+	context->state[2] += c;
+	context->state[3] += d;
+	context->state[4] += e;
+	context->state[5] += f;
+	context->state[6] += g;
+	context->state[7] += h;
+
+	/* Clean up */
+	a = b = c = d = e = f = g = h = T1 = 0;
+	MEMSET_BZERO(W, sizeof(W));
+}
+
+#elif SHA2_SHA256_TRANSFORM == SHA2_TRANSFORM_UNROLLED
 
 /* Unrolled SHA-256 round macros: */
 
@@ -468,7 +570,7 @@ void dtls_sha256_transform(dtls_sha256_ctx* context, const sha2_word32* data) {
 	a = b = c = d = e = f = g = h = T1 = 0;
 }
 
-#else /* SHA2_UNROLL_TRANSFORM */
+#else /* SHA2_SHA256_TRANSFORM */
 
 void dtls_sha256_transform(dtls_sha256_ctx* context, const sha2_word32* data) {
 	sha2_word32	a, b, c, d, e, f, g, h, s0, s1;
@@ -548,7 +650,7 @@ void dtls_sha256_transform(dtls_sha256_ctx* context, const sha2_word32* data) {
 	a = b = c = d = e = f = g = h = T1 = T2 = 0;
 }
 
-#endif /* SHA2_UNROLL_TRANSFORM */
+#endif /* SHA2_SHA256_TRANSFORM */
 
 void dtls_sha256_update(dtls_sha256_ctx* context, const sha2_byte *data, size_t len) {
 	unsigned int	freespace, usedspace;
@@ -56,6 +56,26 @@ extern "C" {
 #endif /* SHA2_USE_INTTYPES_H */
 
 
+/*** SHA-256 Transform Selection **************************************/
+/*
+ * The SHA-256 compression function is chosen at compile time by
+ * defining SHA2_SHA256_TRANSFORM to one of the values below (see the
+ * TRANSFORM NOTE in sha2.c).  Defining SHA2_UNROLL_TRANSFORM still
+ * selects the unrolled version.
+ */
+#define SHA2_TRANSFORM_ROLLED		0
+#define SHA2_TRANSFORM_UNROLLED		1
+#define SHA2_TRANSFORM_WINDOWED		2
+
+#ifndef SHA2_SHA256_TRANSFORM
+#ifdef SHA2_UNROLL_TRANSFORM
+#define SHA2_SHA256_TRANSFORM		SHA2_TRANSFORM_UNROLLED
+#else
+#define SHA2_SHA256_TRANSFORM		SHA2_TRANSFORM_WINDOWED
+#endif
+#endif /* SHA2_SHA256_TRANSFORM */
+
+
 /*** SHA-256/384/512 Various Length Definitions ***********************/
 #define DTLS_SHA256_BLOCK_LENGTH		64
 #define DTLS_SHA256_DIGEST_LENGTH		32